@@ -18,17 +18,25 @@
  */
 #include "PacketTimestamp.h"
 #include "utils/logger.h"
+#include <tins/radiotap.h>
+#include <tins/dot11.h>
+#include <tins/exceptions.h>
+#include <pcap.h>
 #include <exception>
 #include <string>
 
 using std::string;
 
-wifibeat::PacketTimestamp::PacketTimestamp(const PacketTimestamp & pts) : _pdu(NULL), _ts(pts._ts)
+wifibeat::PacketTimestamp::PacketTimestamp(const PacketTimestamp & pts)
+	: _pdu(NULL), _raw(pts._raw), _linkType(pts._linkType), _wireLength(pts._wireLength), _sequence(pts._sequence), _duplicates(pts._duplicates), _source(pts._source),
+		_checkpoint(pts._checkpoint), _checkpointFile(pts._checkpointFile), _checkpointPosition(pts._checkpointPosition), _ts(pts._ts)
 {
-	this->_pdu = pts._pdu->clone();
+	if (pts._pdu) {
+		this->_pdu = pts._pdu->clone();
+	}
 }
 
-wifibeat::PacketTimestamp::PacketTimestamp(PDU * pdu) : _pdu(pdu), _ts({0,0})
+wifibeat::PacketTimestamp::PacketTimestamp(PDU * pdu) : _pdu(pdu), _linkType(DLT_IEEE802_11_RADIO), _wireLength(0), _sequence(0), _duplicates(0), _source(0), _checkpoint(NULL), _checkpointFile(0), _checkpointPosition(0), _ts({0,0})
 {
 	if (clock_gettime(CLOCK_REALTIME, &(this->_ts)) == -1) {
 		stringstream ss;
@@ -38,6 +46,16 @@ wifibeat::PacketTimestamp::PacketTimestamp(PDU * pdu) : _pdu(pdu), _ts({0,0})
 	}
 }
 
+wifibeat::PacketTimestamp::PacketTimestamp(PDU * pdu, const struct timespec & ts)
+	: _pdu(pdu), _linkType(DLT_IEEE802_11_RADIO), _wireLength(0), _sequence(0), _duplicates(0), _source(0), _checkpoint(NULL), _checkpointFile(0), _checkpointPosition(0), _ts(ts)
+{
+}
+
+wifibeat::PacketTimestamp::PacketTimestamp(const uint8_t * data, unsigned int length, int linkType, const struct timespec & ts)
+	: _pdu(NULL), _raw(data, data + length), _linkType(linkType), _wireLength(0), _sequence(0), _duplicates(0), _source(0), _checkpoint(NULL), _checkpointFile(0), _checkpointPosition(0), _ts(ts)
+{
+}
+
 wifibeat::PacketTimestamp::~PacketTimestamp()
 {
 	delete this->_pdu;
@@ -55,11 +73,103 @@ struct timespec wifibeat::PacketTimestamp::getTimespec() const
 
 PDU * wifibeat::PacketTimestamp::getPDU() const
 {
-	/*
-	if (this->_pdu == NULL) {
-		this->_pdu = this->_rawPacket.pdu();
-		this->_rawPacket.release_pdu();
+	if (this->_pdu == NULL && !this->_raw.empty()) {
+		try {
+			if (this->_linkType == DLT_IEEE802_11_RADIO) {
+				this->_pdu = new Tins::RadioTap(this->_raw.data(), (uint32_t)this->_raw.size());
+			} else if (this->_linkType == DLT_IEEE802_11) {
+				this->_pdu = Tins::Dot11::from_bytes(this->_raw.data(), (uint32_t)this->_raw.size());
+			}
+		} catch (const Tins::exception_base & e) {
+			LOG_DEBUG(string("Failed dissecting frame: ") + e.what());
+			this->_pdu = NULL;
+		}
 	}
-	*/
 	return this->_pdu;
-}
\ No newline at end of file
+}
+
+const uint8_t * wifibeat::PacketTimestamp::getRawData() const
+{
+	if (this->_raw.empty() && this->_pdu) {
+		this->_raw = this->_pdu->serialize();
+	}
+	return this->_raw.data();
+}
+
+size_t wifibeat::PacketTimestamp::getRawLength() const
+{
+	if (this->_raw.empty() && this->_pdu) {
+		this->_raw = this->_pdu->serialize();
+	}
+	return this->_raw.size();
+}
+
+int wifibeat::PacketTimestamp::getLinkType() const
+{
+	if (this->_raw.empty() && this->_pdu) {
+		return (this->_pdu->pdu_type() == PDU::RADIOTAP) ? DLT_IEEE802_11_RADIO : DLT_IEEE802_11;
+	}
+	return this->_linkType;
+}
+
+uint64_t wifibeat::PacketTimestamp::Sequence() const
+{
+	return this->_sequence;
+}
+
+void wifibeat::PacketTimestamp::Sequence(uint64_t sequence)
+{
+	this->_sequence = sequence;
+}
+
+unsigned int wifibeat::PacketTimestamp::Duplicates() const
+{
+	return this->_duplicates;
+}
+
+void wifibeat::PacketTimestamp::Duplicates(unsigned int duplicates)
+{
+	this->_duplicates = duplicates;
+}
+
+unsigned int wifibeat::PacketTimestamp::WireLength() const
+{
+	return (this->_wireLength) ? this->_wireLength : (unsigned int)this->getRawLength();
+}
+
+void wifibeat::PacketTimestamp::WireLength(unsigned int length)
+{
+	this->_wireLength = length;
+}
+
+unsigned int wifibeat::PacketTimestamp::Source() const
+{
+	return this->_source;
+}
+
+void wifibeat::PacketTimestamp::Source(unsigned int source)
+{
+	this->_source = source;
+}
+
+wifibeat::utils::fileCheckpoint * wifibeat::PacketTimestamp::Checkpoint() const
+{
+	return this->_checkpoint;
+}
+
+unsigned int wifibeat::PacketTimestamp::CheckpointFile() const
+{
+	return this->_checkpointFile;
+}
+
+uint64_t wifibeat::PacketTimestamp::CheckpointPosition() const
+{
+	return this->_checkpointPosition;
+}
+
+void wifibeat::PacketTimestamp::Checkpoint(utils::fileCheckpoint * checkpoint, unsigned int file, uint64_t position)
+{
+	this->_checkpoint = checkpoint;
+	this->_checkpointFile = file;
+	this->_checkpointPosition = position;
+}
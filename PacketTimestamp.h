@@ -21,17 +21,41 @@
 
 #include <tins/pdu.h>
 #include <tins/packet.h>
+#include <vector>
+#include <stdint.h>
 
 using Tins::PDU;
 using Tins::PtrPacket;
 
 namespace wifibeat {
+	namespace utils {
+		class fileCheckpoint;
+	}
+
 	class PacketTimestamp
 	{
 		private:
-			// PDUs
-			PDU * _pdu;
-			//PtrPacket _rawPacket;
+			// PDUs, only dissected when needed
+			mutable PDU * _pdu;
+
+			// Frame as captured, link layer header included
+			mutable std::vector<uint8_t> _raw;
+			int _linkType;
+			unsigned int _wireLength; // 0 if it wasn't truncated by the capture (snaplen)
+
+			// Persistent queue sequence number, 0 if it wasn't persisted
+			uint64_t _sequence;
+
+			// Copies of it captured by other interfaces, and dropped
+			unsigned int _duplicates;
+
+			// Interface it was captured on (see threads::capture::Source), 0 if it was read from a file
+			unsigned int _source;
+
+			// File checkpoint: checkpoint, file in it (see utils::fileCheckpoint::track) and position after it, NULL if none
+			utils::fileCheckpoint * _checkpoint;
+			unsigned int _checkpointFile;
+			uint64_t _checkpointPosition;
 
 			// Time stuff
 			struct timespec _ts;
@@ -41,13 +65,41 @@ namespace wifibeat {
 			//PacketTimestamp(const PtrPacket & packet);
 			PacketTimestamp(const PacketTimestamp & pts);
 			explicit PacketTimestamp(PDU * pdu);
+			PacketTimestamp(PDU * pdu, const struct timespec & ts); // Capture time (from pcap header)
+			PacketTimestamp(const uint8_t * data, unsigned int length, int linkType, const struct timespec & ts);
 			~PacketTimestamp();
 
 			// Time related
 			struct timespec getTimespec() const;
 			unsigned long long int nsSinceEpoch();
 
+			// NULL if the frame cannot be dissected
 			PDU * getPDU() const;
+
+			// Raw frame. Serialized from the PDU if it wasn't created from raw data.
+			const uint8_t * getRawData() const;
+			size_t getRawLength() const;
+			int getLinkType() const;
+
+			// Length of the frame on the air, as opposed to what was captured of it
+			unsigned int WireLength() const;
+			void WireLength(unsigned int length);
+
+			// Outputs acknowledge frames to the persistence thread with it
+			uint64_t Sequence() const;
+			void Sequence(uint64_t sequence);
+
+			unsigned int Duplicates() const;
+			void Duplicates(unsigned int duplicates);
+
+			unsigned int Source() const;
+			void Source(unsigned int source);
+
+			// The persistence thread saves it in the file checkpoint once outputs acknowledged the frame
+			utils::fileCheckpoint * Checkpoint() const;
+			unsigned int CheckpointFile() const;
+			uint64_t CheckpointPosition() const;
+			void Checkpoint(utils::fileCheckpoint * checkpoint, unsigned int file, uint64_t position);
 	};
 };
 
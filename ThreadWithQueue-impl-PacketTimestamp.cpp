@@ -32,6 +32,7 @@ template ThreadWithQueue<PacketTimestamp>::ThreadWithQueue();
 template ThreadWithQueue<PacketTimestamp>::~ThreadWithQueue();
 template void ThreadWithQueue<PacketTimestamp>::Name(const string & name);
 template bool ThreadWithQueue<PacketTimestamp>::sendToNextThreadsQueue(PacketTimestamp * item);
+template bool ThreadWithQueue<PacketTimestamp>::sendToNextThreadsQueueWaiting(PacketTimestamp * item);
 template bool ThreadWithQueue<PacketTimestamp>::addItemToInputQueue(PacketTimestamp * item);
 template queue <PacketTimestamp *> ThreadWithQueue<PacketTimestamp>::getAllItemsFromInputQueue();
 template bool ThreadWithQueue<PacketTimestamp>::AddNextThread(ThreadWithQueue * nextThread);
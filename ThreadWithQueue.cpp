@@ -259,6 +259,16 @@ bool wifibeat::ThreadWithQueue<T>::kill(unsigned int ms) {
 // Virtual output queue stuff
 template <class T>
 bool wifibeat::ThreadWithQueue<T>::sendToNextThreadsQueue(T * item) {
+	return this->sendToNextThreads(item, false);
+}
+
+template <class T>
+bool wifibeat::ThreadWithQueue<T>::sendToNextThreadsQueueWaiting(T * item) {
+	return this->sendToNextThreads(item, true);
+}
+
+template <class T>
+bool wifibeat::ThreadWithQueue<T>::sendToNextThreads(T * item, bool wait) {
 	if (item == NULL) {
 		return false;
 	}
@@ -268,7 +278,7 @@ bool wifibeat::ThreadWithQueue<T>::sendToNextThreadsQueue(T * item) {
 			success = false;
 			break;
 		case 1:
-			success = this->_nextThreads[0]->addItemToInputQueue(item);
+			success = this->pushToNextThread(this->_nextThreads[0], item, wait);
 			break;
 		default:
 			// Minimize allocations in case one instance fails
@@ -279,7 +289,7 @@ bool wifibeat::ThreadWithQueue<T>::sendToNextThreadsQueue(T * item) {
 					itemCopy = new T(*item);
 				}
 				success = false;
-				if (itemCopy != NULL && this->_nextThreads[0]->addItemToInputQueue(itemCopy)) {
+				if (itemCopy != NULL && this->pushToNextThread(this->_nextThreads[i], itemCopy, wait)) {
 					success = true;
 					itemCopy = NULL;
 				}
@@ -290,7 +300,7 @@ bool wifibeat::ThreadWithQueue<T>::sendToNextThreadsQueue(T * item) {
 			
 			// Now send the original
 			if (success) {
-				success = this->_nextThreads[0]->addItemToInputQueue(item);
+				success = this->pushToNextThread(this->_nextThreads[0], item, wait);
 			}
 			break;
 	}
@@ -305,6 +315,37 @@ bool wifibeat::ThreadWithQueue<T>::sendToNextThreadsQueue(T * item) {
 	return success;
 }
 
+template <class T>
+bool wifibeat::ThreadWithQueue<T>::pushToNextThread(ThreadWithQueue * nextThread, T * item, bool wait) {
+	if (nextThread->addItemToInputQueue(item)) {
+		return true;
+	}
+
+	// Wait for room as long as both threads are alive. Only a thread running
+	// its own loop waits, a source polled by another thread never blocks it.
+	for (unsigned int attempt = 1; wait; ++attempt) {
+		threadStatus ts = this->Status();
+		if (ts != Running && (ts != Stopping || !this->_stopWaitQueueIsEmpty)) {
+			return false;
+		}
+		ts = nextThread->Status();
+		if (ts != Initialized && ts != Starting && ts != Started && ts != Running && ts != Stopping) {
+			return false;
+		}
+
+		if (attempt < _WIFIBEAT_QUEUE_FULL_YIELDS) {
+			std::this_thread::yield();
+		} else {
+			std::this_thread::sleep_for(std::chrono::microseconds(_WIFIBEAT_QUEUE_FULL_SLEEP_US));
+		}
+		if (nextThread->addItemToInputQueue(item)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 template <class T>
 inline bool wifibeat::ThreadWithQueue<T>::AddNextThread(ThreadWithQueue * nextThread) {
 	if (nextThread == NULL) {
@@ -66,6 +66,10 @@ using std::thread;
  * myThread()->Status(): Get the status of the thread.
  */
 
+// Waiting for room in a full queue: yield a few times, then sleep
+#define _WIFIBEAT_QUEUE_FULL_YIELDS 64
+#define _WIFIBEAT_QUEUE_FULL_SLEEP_US 100
+
 namespace wifibeat {
 
 	enum threadStatus {
@@ -89,6 +93,9 @@ namespace wifibeat {
 			queue <T *> getAllItemsFromInputQueue();
 
 			bool sendToNextThreadsQueue(T * item);
+			// Same, but waits for room when a queue is full instead of dropping the item.
+			// Only fails (and deletes the item) if this thread or the next one is stopping.
+			bool sendToNextThreadsQueueWaiting(T * item);
 			bool addItemToInputQueue(T * item);
 
 			virtual bool init_function();
@@ -101,6 +108,8 @@ namespace wifibeat {
 
 		private:
 			vector<ThreadWithQueue *> _nextThreads;
+			bool sendToNextThreads(T * item, bool wait);
+			bool pushToNextThread(ThreadWithQueue * nextThread, T * item, bool wait);
 
 			pthread_mutex_t _threadMutex;
 			bool _threadMutexInit;
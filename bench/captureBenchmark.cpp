@@ -0,0 +1,202 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Capture throughput benchmark: reads savefiles through the capture engine, with
+// each batch size, and reports how many frames per second and how much CPU it took.
+#include "ThreadWithQueue.h"
+#include "PacketTimestamp.h"
+#include "threads/captureEngine.h"
+#include "threads/filereading.h"
+#include "utils/logger.h"
+#include "utils/beat.h"
+#include "utils/stringHelper.h"
+#include <boost/program_options.hpp>
+#include <sys/resource.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <iomanip>
+
+using std::cout;
+using std::endl;
+using wifibeat::ThreadWithQueue;
+using wifibeat::PacketTimestamp;
+
+namespace po = boost::program_options;
+
+namespace wifibeat
+{
+	namespace bench
+	{
+		// Counts and discards frames
+		class countingSink : public ThreadWithQueue<PacketTimestamp>
+		{
+			private:
+				std::atomic<unsigned long long int> _received;
+
+			public:
+				countingSink() : _received(0)
+				{
+					this->Name("counting sink");
+				}
+
+				virtual void recurring()
+				{
+					queue<PacketTimestamp *> items = this->getAllItemsFromInputQueue();
+					this->_received += items.size();
+					while (!items.empty()) {
+						delete items.front();
+						items.pop();
+					}
+				}
+
+				unsigned long long int Received() { return this->_received; }
+		};
+
+		struct benchmarkResult {
+			unsigned int batchSize;
+			double seconds;
+			double cpuSeconds;
+			unsigned long long int frames;
+			unsigned long long int dropped;
+			unsigned long long int received;
+		};
+
+		static double cpuTime()
+		{
+			struct rusage usage;
+			getrusage(RUSAGE_SELF, &usage);
+			return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+		}
+
+		static void waitStatus(ThreadWithQueue<PacketTimestamp> * thread, bool waitQueueIsEmpty)
+		{
+			thread->stop(waitQueueIsEmpty);
+			while (thread->Status() == Running || thread->Status() == Stopping) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			}
+		}
+
+		static bool run(const string & file, unsigned int nbSources, unsigned int batchSize, benchmarkResult & result)
+		{
+			countingSink * sink = new countingSink();
+			threads::captureEngine * engine = new threads::captureEngine(batchSize);
+			vector<threads::filereading *> sources;
+			bool ok = sink->init(10000);
+			for (unsigned int i = 0; ok && i < nbSources; ++i) {
+				threads::filereading * source = new threads::filereading(file, "");
+				sources.push_back(source);
+				source->BatchSize(batchSize);
+				ok = source->init(1) && source->AddNextThread(sink);
+				engine->addSource(source);
+			}
+			ok = ok && engine->init(0);
+
+			if (ok) {
+				double cpuStart = cpuTime();
+				auto start = std::chrono::steady_clock::now();
+				sink->start();
+				engine->start();
+				while (engine->Status() == Starting || engine->Status() == Started || engine->Status() == Running) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+				waitStatus(sink, true);
+
+				result.batchSize = batchSize;
+				result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				result.cpuSeconds = cpuTime() - cpuStart;
+				result.frames = 0;
+				result.dropped = 0;
+				for (threads::filereading * source: sources) {
+					result.frames += source->Frames();
+					result.dropped += source->Dropped();
+				}
+				result.received = sink->Received();
+			}
+
+			delete engine;
+			for (threads::filereading * source: sources) {
+				delete source;
+			}
+			delete sink;
+			return ok;
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	string file;
+	unsigned int nbSources = 0;
+	string batchSizes;
+
+	po::options_description desc("Options");
+	desc.add_options()
+		("help,h", "Show this message")
+		("file,f", po::value<string>(&file)->required(), "Capture file to read (Radiotap or 802.11)")
+		("sources,s", po::value<unsigned int>(&nbSources)->default_value(4), "Amount of sources reading the file at the same time")
+		("batch-sizes,b", po::value<string>(&batchSizes)->default_value("1,16,64,256"), "Comma separated list of batch sizes to benchmark");
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		if (vm.count("help")) {
+			cout << desc << endl;
+			return EXIT_SUCCESS;
+		}
+		po::notify(vm);
+	} catch (po::error & e) {
+		cout << e.what() << endl << desc << endl;
+		return EXIT_FAILURE;
+	}
+
+	wifibeat::utils::logger::Instance("warning", true);
+
+	vector<unsigned int> sizes;
+	for (const string & size: wifibeat::utils::stringHelper::split(batchSizes + ",", ',')) {
+		if (!size.empty()) {
+			sizes.push_back((unsigned int)std::stoul(size));
+		}
+	}
+
+	cout << std::left << std::setw(8) << "batch" << std::setw(14) << "frames/s" << std::setw(10) << "CPU %"
+		<< std::setw(14) << "CPU us/frame" << std::setw(12) << "frames" << std::setw(10) << "dropped" << endl;
+
+	int ret = EXIT_SUCCESS;
+	for (unsigned int size: sizes) {
+		wifibeat::bench::benchmarkResult result;
+		if (!wifibeat::bench::run(file, nbSources, size, result)) {
+			cout << "Failed running benchmark with batch size " << size << endl;
+			ret = EXIT_FAILURE;
+			continue;
+		}
+		double seconds = (result.seconds > 0) ? result.seconds : 1;
+		double frames = (result.frames > 0) ? result.frames : 1;
+		cout << std::left << std::fixed << std::setprecision(1) << std::setw(8) << size
+			<< std::setw(14) << (result.received / seconds)
+			<< std::setw(10) << (100 * result.cpuSeconds / seconds)
+			<< std::setprecision(3) << std::setw(14) << (1e6 * result.cpuSeconds / frames)
+			<< std::setw(12) << result.frames
+			<< std::setw(10) << result.dropped << endl;
+	}
+
+	wifibeat::utils::beat::Release();
+	wifibeat::utils::logger::Release();
+	return ret;
+}
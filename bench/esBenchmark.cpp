@@ -0,0 +1,278 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Output throughput benchmark: feeds synthetic frames through threads::elasticsearch
+// against a local mock Elasticsearch, for each bulk configuration.
+#include "mockElasticsearch.h"
+#include "ThreadWithQueue.h"
+#include "PacketTimestamp.h"
+#include "threads/elasticsearch.h"
+#include "utils/logger.h"
+#include "utils/beat.h"
+#include "utils/stringHelper.h"
+#include <tins/radiotap.h>
+#include <tins/dot11/dot11_beacon.h>
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <iomanip>
+
+using std::cout;
+using std::endl;
+using wifibeat::ThreadWithQueue;
+using wifibeat::PacketTimestamp;
+
+namespace po = boost::program_options;
+
+namespace wifibeat
+{
+	namespace bench
+	{
+		// Generates beacons, as fast as the queues allow
+		class syntheticSource : public ThreadWithQueue<PacketTimestamp>
+		{
+			private:
+				unsigned long long int _total;
+				unsigned int _batch;
+				std::atomic<unsigned long long int> _sent;
+				std::atomic<unsigned long long int> _dropped;
+				Tins::RadioTap _frame;
+
+			public:
+				syntheticSource(unsigned long long int total, unsigned int batch)
+					: _total(total), _batch(batch), _sent(0), _dropped(0)
+				{
+					this->Name("synthetic source");
+					Tins::Dot11Beacon beacon(Tins::Dot11::BROADCAST, "00:11:22:33:44:55");
+					beacon.addr3("00:11:22:33:44:55");
+					beacon.ssid("wifibeat-benchmark");
+					beacon.ds_parameter_set(6);
+					beacon.supported_rates({ 1.0f, 2.0f, 5.5f, 11.0f, 6.0f, 9.0f, 12.0f, 18.0f });
+					this->_frame = Tins::RadioTap() / beacon;
+				}
+
+				virtual void recurring()
+				{
+					for (unsigned int i = 0; i < this->_batch && this->_sent + this->_dropped < this->_total; ++i) {
+						// Different BSSID for each frame
+						unsigned long long int n = this->_sent + this->_dropped;
+						uint8_t mac[6] = { 0x02, 0x00, (uint8_t)(n >> 24), (uint8_t)(n >> 16), (uint8_t)(n >> 8), (uint8_t)n };
+						Tins::Dot11Beacon * beacon = this->_frame.find_pdu<Tins::Dot11Beacon>();
+						beacon->addr2(Tins::Dot11::address_type(mac));
+						beacon->addr3(Tins::Dot11::address_type(mac));
+
+						struct timespec ts;
+						clock_gettime(CLOCK_REALTIME, &ts);
+						if (this->sendToNextThreadsQueue(new PacketTimestamp(this->_frame.clone(), ts))) {
+							++this->_sent;
+						} else {
+							++this->_dropped;
+						}
+					}
+					if (this->_sent + this->_dropped >= this->_total) {
+						this->ThreadFinished();
+					}
+				}
+
+				unsigned long long int Sent() { return this->_sent; }
+				unsigned long long int Dropped() { return this->_dropped; }
+		};
+
+		struct benchmarkResult {
+			unsigned int bulkSize;
+			double seconds;
+			unsigned long long int sent;
+			unsigned long long int dropped;
+			mockElasticsearchStats stats;
+		};
+
+		static double percentile(const vector<double> & sorted, double p)
+		{
+			if (sorted.empty()) {
+				return 0;
+			}
+			size_t pos = (size_t)(p * sorted.size());
+			if (pos >= sorted.size()) {
+				pos = sorted.size() - 1;
+			}
+			return sorted[pos];
+		}
+
+		static void waitStatus(ThreadWithQueue<PacketTimestamp> * thread, bool waitQueueIsEmpty)
+		{
+			thread->stop(waitQueueIsEmpty);
+			while (thread->Status() == Running || thread->Status() == Stopping) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			}
+		}
+
+		static bool run(mockElasticsearch & es, unsigned int bulkSize, unsigned long long int frames, unsigned int batch,
+						const ESAdaptiveSettings & adaptive, bool tls, benchmarkResult & result)
+		{
+			ElasticSearchConnection conn;
+			conn.hosts.push_back(IPPort("127.0.0.1", es.Port()));
+			if (tls) {
+				// Self-signed
+				conn.protocol = HTTPS;
+				conn.ssl.verification_mode = "none";
+			}
+			conn.bulkMaxSize = bulkSize;
+			conn.adaptive = adaptive;
+
+			es.resetStats();
+			threads::elasticsearch * output = new threads::elasticsearch(conn);
+			syntheticSource * source = new syntheticSource(frames, batch);
+			if (!output->init(100000) || !source->AddNextThread(output) || !source->init(1000000)) {
+				delete source;
+				delete output;
+				return false;
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			auto lastProgress = start;
+			unsigned long long int lastReceived = 0;
+			output->start();
+			source->start();
+
+			// Done when everything sent was received, or nothing moved for 3 seconds.
+			while (true) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				unsigned long long int received = es.Stats().receivedDocuments;
+				auto now = std::chrono::steady_clock::now();
+				if (received != lastReceived) {
+					lastReceived = received;
+					lastProgress = now;
+				}
+				bool sourceDone = source->Status() != Running && source->Status() != Started && source->Status() != Starting;
+				if (sourceDone && received >= source->Sent()) {
+					break;
+				}
+				if (now - lastProgress > std::chrono::seconds(3)) {
+					break;
+				}
+			}
+
+			result.bulkSize = bulkSize;
+			result.seconds = std::chrono::duration<double>(lastProgress - start).count();
+			result.sent = source->Sent();
+			result.dropped = source->Dropped();
+
+			waitStatus(source, false);
+			waitStatus(output, true);
+			result.stats = es.Stats();
+
+			delete source;
+			delete output;
+			return true;
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	wifibeat::bench::mockElasticsearchSettings settings;
+	unsigned long long int frames = 0;
+	unsigned int batch = 0;
+	string bulkSizes;
+	ESAdaptiveSettings adaptive;
+	unsigned int targetLatency = 0;
+
+	po::options_description desc("Options");
+	desc.add_options()
+		("help,h", "Show this message")
+		("frames,n", po::value<unsigned long long int>(&frames)->default_value(200000), "Frames to send for each configuration")
+		("bulk-sizes,b", po::value<string>(&bulkSizes)->default_value("50,200,1000,5000"), "Comma separated list of bulk sizes to benchmark")
+		("batch,B", po::value<unsigned int>(&batch)->default_value(500), "Frames generated per millisecond (at most)")
+		("latency,l", po::value<unsigned int>(&settings.latencyMS)->default_value(0), "Latency added to each _bulk request, in ms")
+		("reject-rate,r", po::value<double>(&settings.rejectRate)->default_value(0), "Ratio of _bulk requests rejected with HTTP 429 (0-1)")
+		("item-failures,i", po::value<double>(&settings.itemFailureRate)->default_value(0), "Ratio of failed items in accepted _bulk requests (0-1)")
+		("es-version,e", po::value<string>(&settings.version)->default_value("7.17.0"), "Elasticsearch version reported by the mock")
+		("adaptive,a", po::bool_switch(&adaptive.enabled), "Adapt bulk size and concurrency (bulk sizes are the initial size)")
+		("max-concurrency,c", po::value<unsigned int>(&adaptive.maxConcurrency)->default_value(4), "Maximum concurrent bulk requests when adaptive")
+		("target-latency,t", po::value<unsigned int>(&targetLatency)->default_value(1000), "Target latency in ms when adaptive")
+		("certificate", po::value<string>(&settings.certificate), "Use HTTPS, with this certificate for the mock (PEM)")
+		("key", po::value<string>(&settings.key), "Key of the mock certificate (PEM)");
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		po::notify(vm);
+	} catch (po::error & e) {
+		cout << e.what() << endl << desc << endl;
+		return EXIT_FAILURE;
+	}
+	if (vm.count("help")) {
+		cout << desc << endl;
+		return EXIT_SUCCESS;
+	}
+
+	if (settings.certificate.empty() != settings.key.empty()) {
+		cout << "Both --certificate and --key are required for HTTPS" << endl;
+		return EXIT_FAILURE;
+	}
+	wifibeat::utils::logger::Instance("warning", true);
+	adaptive.targetLatency = std::chrono::milliseconds(targetLatency);
+
+	vector<unsigned int> sizes;
+	for (const string & size: wifibeat::utils::stringHelper::split(bulkSizes + ",", ',')) {
+		if (!size.empty()) {
+			sizes.push_back((unsigned int)std::stoul(size));
+		}
+	}
+
+	wifibeat::bench::mockElasticsearch es(0, settings);
+	if (!es.start()) {
+		return EXIT_FAILURE;
+	}
+
+	cout << std::left << std::setw(8) << "bulk" << std::setw(12) << "docs/s" << std::setw(10) << "MB/s"
+		<< std::setw(10) << "p50 ms" << std::setw(10) << "p90 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "max ms"
+		<< std::setw(10) << "dropped" << std::setw(10) << "429" << std::setw(10) << "failed" << std::setw(10) << "conns" << endl;
+
+	int ret = EXIT_SUCCESS;
+	for (unsigned int size: sizes) {
+		wifibeat::bench::benchmarkResult result;
+		if (!wifibeat::bench::run(es, size, frames, batch, adaptive, !settings.certificate.empty(), result)) {
+			cout << "Failed running benchmark with bulk size " << size << endl;
+			ret = EXIT_FAILURE;
+			continue;
+		}
+		vector<double> latencies = result.stats.latencies;
+		std::sort(latencies.begin(), latencies.end());
+		double seconds = (result.seconds > 0) ? result.seconds : 1;
+		cout << std::left << std::fixed << std::setprecision(1) << std::setw(8) << size
+			<< std::setw(12) << (result.stats.indexedDocuments / seconds)
+			<< std::setw(10) << (result.stats.bytes / seconds / 1048576.0)
+			<< std::setw(10) << wifibeat::bench::percentile(latencies, 0.5)
+			<< std::setw(10) << wifibeat::bench::percentile(latencies, 0.9)
+			<< std::setw(10) << wifibeat::bench::percentile(latencies, 0.99)
+			<< std::setw(10) << wifibeat::bench::percentile(latencies, 1)
+			<< std::setw(10) << result.dropped
+			<< std::setw(10) << result.stats.rejectedRequests
+			<< std::setw(10) << result.stats.failedItems
+			<< std::setw(10) << result.stats.connections << endl;
+	}
+
+	es.stop();
+	wifibeat::utils::beat::Release();
+	wifibeat::utils::logger::Release();
+	return ret;
+}
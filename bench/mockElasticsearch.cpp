@@ -0,0 +1,330 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mockElasticsearch.h"
+#include "utils/Locker.h"
+#include "utils/logger.h"
+#include "utils/tls.h"
+#include <chrono>
+#include <thread>
+#include <sstream>
+#include <Poco/StreamCopier.h>
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/Net/SecureServerSocket.h>
+#include <Poco/Net/SocketAddress.h>
+#include <Poco/Net/HTTPServerParams.h>
+#include <Poco/Net/HTTPRequestHandler.h>
+#include <Poco/Net/HTTPRequestHandlerFactory.h>
+
+using std::stringstream;
+using Poco::Net::HTTPServerRequest;
+using Poco::Net::HTTPServerResponse;
+using Poco::Net::HTTPResponse;
+using Poco::Net::HTTPRequest;
+
+namespace
+{
+	class mockRequestHandler : public Poco::Net::HTTPRequestHandler
+	{
+		private:
+			wifibeat::bench::mockElasticsearch * _es;
+		public:
+			explicit mockRequestHandler(wifibeat::bench::mockElasticsearch * es) : _es(es) { }
+			void handleRequest(HTTPServerRequest & request, HTTPServerResponse & response) {
+				this->_es->handle(request, response);
+			}
+	};
+
+	class mockRequestHandlerFactory : public Poco::Net::HTTPRequestHandlerFactory
+	{
+		private:
+			wifibeat::bench::mockElasticsearch * _es;
+		public:
+			explicit mockRequestHandlerFactory(wifibeat::bench::mockElasticsearch * es) : _es(es) { }
+			Poco::Net::HTTPRequestHandler * createRequestHandler(const HTTPServerRequest &) {
+				return new mockRequestHandler(this->_es);
+			}
+	};
+}
+
+wifibeat::bench::mockElasticsearch::mockElasticsearch(unsigned short int port, const mockElasticsearchSettings & settings)
+	: _port(port), _settings(settings), _nodesMutexInit(false), _server(NULL), _connectionsReset(0), _mutexInit(false), _random(std::random_device()())
+{
+	if (pthread_mutex_init(&this->_mutex, NULL) != 0) {
+		LOG_CRITICAL("Failed initializing mock Elasticsearch mutex");
+		throw string("Failed initializing mock Elasticsearch mutex");
+	}
+	this->_mutexInit = true;
+	if (pthread_mutex_init(&this->_nodesMutex, NULL) != 0) {
+		LOG_CRITICAL("Failed initializing mock Elasticsearch nodes mutex");
+		throw string("Failed initializing mock Elasticsearch nodes mutex");
+	}
+	this->_nodesMutexInit = true;
+}
+
+wifibeat::bench::mockElasticsearch::~mockElasticsearch()
+{
+	this->stop();
+	if (this->_mutexInit) {
+		pthread_mutex_destroy(&this->_mutex);
+	}
+	if (this->_nodesMutexInit) {
+		pthread_mutex_destroy(&this->_nodesMutex);
+	}
+}
+
+bool wifibeat::bench::mockElasticsearch::start()
+{
+	if (this->_server) {
+		return true;
+	}
+
+	try {
+		Poco::Net::SocketAddress address("127.0.0.1", this->_port);
+		Poco::Net::ServerSocket socket;
+		if (this->_settings.certificate.empty()) {
+			socket = Poco::Net::ServerSocket(address);
+		} else {
+			// Clients resuming their TLS session skip the full handshake
+			socket = Poco::Net::SecureServerSocket(address, 64, utils::tls::serverContext(this->_settings.certificate, this->_settings.key));
+		}
+		Poco::Net::HTTPServerParams::Ptr params = new Poco::Net::HTTPServerParams();
+		params->setKeepAlive(true);
+		params->setMaxThreads(16);
+		this->_server = new Poco::Net::HTTPServer(new mockRequestHandlerFactory(this), socket, params);
+		this->_server->start();
+
+		// Port 0 means any available port
+		this->_port = socket.address().port();
+	} catch (const string & e) {
+		LOG_ERROR("Failed starting mock Elasticsearch: " + e);
+		return false;
+	} catch (const std::exception & e) {
+		LOG_ERROR("Failed starting mock Elasticsearch: " + string(e.what()));
+		delete this->_server;
+		this->_server = NULL;
+		return false;
+	}
+
+	LOG_NOTICE("Mock Elasticsearch listening on <" + this->toString() + ">");
+	return true;
+}
+
+void wifibeat::bench::mockElasticsearch::stop()
+{
+	if (this->_server) {
+		this->_server->stopAll(true);
+		delete this->_server;
+		this->_server = NULL;
+	}
+}
+
+unsigned short int wifibeat::bench::mockElasticsearch::Port()
+{
+	return this->_port;
+}
+
+void wifibeat::bench::mockElasticsearch::Nodes(const string & nodes)
+{
+	utils::Locker l(&this->_nodesMutex);
+	this->_settings.nodes = nodes;
+}
+
+string wifibeat::bench::mockElasticsearch::toString()
+{
+	stringstream ss;
+	ss << ((this->_settings.certificate.empty()) ? "http" : "https") << "://127.0.0.1:" << this->_port;
+	return ss.str();
+}
+
+wifibeat::bench::mockElasticsearchStats wifibeat::bench::mockElasticsearch::Stats()
+{
+	utils::Locker l(&this->_mutex);
+	mockElasticsearchStats stats = this->_stats;
+	if (this->_server) {
+		stats.connections = (unsigned long long int)this->_server->totalConnections() - this->_connectionsReset;
+	}
+	return stats;
+}
+
+void wifibeat::bench::mockElasticsearch::resetStats()
+{
+	utils::Locker l(&this->_mutex);
+	this->_stats = mockElasticsearchStats();
+	this->_connectionsReset = (this->_server) ? this->_server->totalConnections() : 0;
+}
+
+bool wifibeat::bench::mockElasticsearch::randomEvent(double rate)
+{
+	// Mutex must be held
+	if (rate <= 0) {
+		return false;
+	}
+	return std::uniform_real_distribution<double>(0.0, 1.0)(this->_random) < rate;
+}
+
+void wifibeat::bench::mockElasticsearch::sendJSON(HTTPServerResponse & response, int status, const string & body)
+{
+	response.setStatusAndReason(static_cast<HTTPResponse::HTTPStatus>(status));
+	response.setContentType("application/json; charset=UTF-8");
+	response.setContentLength(body.size());
+	response.send() << body;
+}
+
+void wifibeat::bench::mockElasticsearch::handle(HTTPServerRequest & request, HTTPServerResponse & response)
+{
+	{
+		utils::Locker l(&this->_mutex);
+		++this->_stats.requests;
+	}
+
+	string uri = request.getURI();
+	string path = uri.substr(0, uri.find('?'));
+	if (path == "/" || path.empty()) {
+		this->handleRoot(response);
+	} else if (path.size() >= 6 && path.compare(path.size() - 6, 6, "/_bulk") == 0) {
+		this->handleBulk(request, response);
+	} else if (path == "/_nodes" || path.compare(0, 8, "/_nodes/") == 0) {
+		this->handleNodes(response);
+	} else if (path.compare(0, 11, "/_template/") == 0 || path.compare(0, 17, "/_index_template/") == 0) {
+		this->handleTemplate(request, response, path);
+	} else {
+		// Drain body so the connection can be kept alive
+		string body;
+		Poco::StreamCopier::copyToString(request.stream(), body);
+		this->sendJSON(response, 404, "{\"error\":\"not supported by the mock\",\"status\":404}");
+	}
+}
+
+void wifibeat::bench::mockElasticsearch::handleRoot(HTTPServerResponse & response)
+{
+	stringstream ss;
+	ss << "{\"name\":\"mock\",\"cluster_name\":\"wifibeat-mock\",\"version\":{\"number\":\""
+		<< this->_settings.version << "\"},\"tagline\":\"You Know, for Search\"}";
+	this->sendJSON(response, 200, ss.str());
+}
+
+void wifibeat::bench::mockElasticsearch::handleNodes(HTTPServerResponse & response)
+{
+	string nodes;
+	{
+		utils::Locker l(&this->_nodesMutex);
+		nodes = this->_settings.nodes;
+	}
+	if (nodes.empty()) {
+		stringstream address;
+		address << "127.0.0.1:" << this->_port;
+		stringstream ss;
+		ss << "{\"_nodes\":{\"total\":1,\"successful\":1,\"failed\":0},\"cluster_name\":\"wifibeat-mock\",\"nodes\":{"
+			<< "\"mock\":{\"name\":\"mock\",\"version\":\"" << this->_settings.version << "\","
+			<< "\"roles\":[\"data\",\"ingest\",\"master\"],"
+			<< "\"http\":{\"bound_address\":[\"" << address.str() << "\"],\"publish_address\":\"" << address.str() << "\"}}}}";
+		nodes = ss.str();
+	}
+	this->sendJSON(response, 200, nodes);
+}
+
+void wifibeat::bench::mockElasticsearch::handleTemplate(HTTPServerRequest & request, HTTPServerResponse & response, const string & path)
+{
+	string body;
+	Poco::StreamCopier::copyToString(request.stream(), body);
+
+	utils::Locker l(&this->_mutex);
+	auto it = this->_templates.find(path);
+	if (request.getMethod() == HTTPRequest::HTTP_PUT) {
+		this->_templates[path] = body;
+		this->sendJSON(response, 200, "{\"acknowledged\":true}");
+	} else if (request.getMethod() == HTTPRequest::HTTP_HEAD) {
+		response.setStatus((it == this->_templates.end()) ? HTTPResponse::HTTP_NOT_FOUND : HTTPResponse::HTTP_OK);
+		response.setContentLength(0);
+		response.send();
+	} else if (it != this->_templates.end()) {
+		this->sendJSON(response, 200, it->second);
+	} else {
+		this->sendJSON(response, 404, "{}");
+	}
+}
+
+void wifibeat::bench::mockElasticsearch::handleBulk(HTTPServerRequest & request, HTTPServerResponse & response)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	string body;
+	Poco::StreamCopier::copyToString(request.stream(), body);
+
+	// Every document is an action line followed by the source
+	unsigned long long int lines = 0;
+	size_t pos = 0;
+	while (pos < body.size()) {
+		size_t end = body.find('\n', pos);
+		if (end == string::npos) {
+			end = body.size();
+		}
+		if (end > pos) {
+			++lines;
+		}
+		pos = end + 1;
+	}
+	unsigned long long int documents = lines / 2;
+
+	if (this->_settings.latencyMS) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(this->_settings.latencyMS));
+	}
+
+	bool rejected = false;
+	unsigned long long int failed = 0;
+	stringstream ss;
+	{
+		utils::Locker l(&this->_mutex);
+		rejected = this->randomEvent(this->_settings.rejectRate);
+		if (!rejected) {
+			ss << "{\"took\":" << this->_settings.latencyMS << ",\"errors\":";
+			string items;
+			for (unsigned long long int i = 0; i < documents; ++i) {
+				if (i) {
+					items += ',';
+				}
+				if (this->randomEvent(this->_settings.itemFailureRate)) {
+					++failed;
+					items += "{\"index\":{\"status\":429,\"error\":{\"type\":\"es_rejected_execution_exception\",\"reason\":\"mock\"}}}";
+				} else {
+					items += "{\"index\":{\"result\":\"created\",\"status\":201}}";
+				}
+			}
+			ss << ((failed) ? "true" : "false") << ",\"items\":[" << items << "]}";
+		}
+
+		++this->_stats.bulkRequests;
+		this->_stats.receivedDocuments += documents;
+		this->_stats.bytes += body.size();
+		if (rejected) {
+			++this->_stats.rejectedRequests;
+		} else {
+			this->_stats.indexedDocuments += documents - failed;
+			this->_stats.failedItems += failed;
+		}
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		this->_stats.latencies.push_back(elapsed.count());
+	}
+
+	if (rejected) {
+		this->sendJSON(response, 429, "{\"error\":{\"type\":\"es_rejected_execution_exception\",\"reason\":\"mock\"},\"status\":429}");
+	} else {
+		this->sendJSON(response, 200, ss.str());
+	}
+}
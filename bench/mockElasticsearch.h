@@ -0,0 +1,111 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Lightweight stand-in for Elasticsearch, for benchmarking and testing the
+// outputs without a cluster. Only /, _bulk, _nodes and index templates are implemented.
+#ifndef BENCH_MOCKELASTICSEARCH_H
+#define BENCH_MOCKELASTICSEARCH_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <pthread.h>
+#include <Poco/Net/HTTPServer.h>
+#include <Poco/Net/HTTPServerRequest.h>
+#include <Poco/Net/HTTPServerResponse.h>
+
+using std::string;
+using std::vector;
+using std::map;
+
+namespace wifibeat
+{
+	namespace bench
+	{
+		struct mockElasticsearchSettings {
+			unsigned int latencyMS; // Added to every _bulk request
+			double rejectRate; // Ratio of _bulk requests answered with HTTP 429
+			double itemFailureRate; // Ratio of items failing (status 429) in accepted _bulk requests
+			string version; // Version number reported on /
+			string nodes; // _nodes response. If empty, the mock reports itself as the only node
+			string certificate; // HTTPS when set (PEM, can be self-signed)
+			string key;
+			mockElasticsearchSettings() : latencyMS(0), rejectRate(0), itemFailureRate(0), version("7.17.0"), nodes(""),
+											certificate(""), key("") { }
+		};
+
+		struct mockElasticsearchStats {
+			unsigned long long int connections; // Accepted, TLS handshakes when using HTTPS
+			unsigned long long int requests;
+			unsigned long long int bulkRequests;
+			unsigned long long int rejectedRequests; // HTTP 429
+			unsigned long long int receivedDocuments; // All documents in _bulk requests, rejected or not
+			unsigned long long int indexedDocuments;
+			unsigned long long int failedItems;
+			unsigned long long int bytes; // _bulk bodies
+			vector<double> latencies; // Time spent on each _bulk request, in ms
+			mockElasticsearchStats() : connections(0), requests(0), bulkRequests(0), rejectedRequests(0), receivedDocuments(0),
+										indexedDocuments(0), failedItems(0), bytes(0) { }
+		};
+
+		class mockElasticsearch
+		{
+			private:
+				unsigned short int _port;
+				mockElasticsearchSettings _settings;
+				pthread_mutex_t _nodesMutex; // Nodes can be changed while running
+				bool _nodesMutexInit;
+				Poco::Net::HTTPServer * _server;
+				unsigned long long int _connectionsReset; // Connections before the last stats reset
+
+				pthread_mutex_t _mutex;
+				bool _mutexInit;
+				mockElasticsearchStats _stats;
+				std::mt19937 _random;
+				map<string, string> _templates; // Path -> body
+
+				bool randomEvent(double rate);
+				void handleRoot(Poco::Net::HTTPServerResponse & response);
+				void handleBulk(Poco::Net::HTTPServerRequest & request, Poco::Net::HTTPServerResponse & response);
+				void handleNodes(Poco::Net::HTTPServerResponse & response);
+				void handleTemplate(Poco::Net::HTTPServerRequest & request, Poco::Net::HTTPServerResponse & response, const string & path);
+				void sendJSON(Poco::Net::HTTPServerResponse & response, int status, const string & body);
+
+			public:
+				mockElasticsearch(unsigned short int port, const mockElasticsearchSettings & settings);
+				~mockElasticsearch();
+
+				bool start();
+				void stop();
+				unsigned short int Port();
+
+				// Canned _nodes response, to simulate nodes joining or leaving the cluster
+				void Nodes(const string & nodes);
+				string toString();
+
+				mockElasticsearchStats Stats();
+				void resetStats();
+
+				// Called by the HTTP server threads
+				void handle(Poco::Net::HTTPServerRequest & request, Poco::Net::HTTPServerResponse & response);
+		};
+	}
+}
+
+#endif // BENCH_MOCKELASTICSEARCH_H
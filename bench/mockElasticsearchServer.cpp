@@ -0,0 +1,119 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Standalone mock Elasticsearch: wifibeat-mock-es --port 9200 --latency 20 --reject-rate 0.01
+#include "mockElasticsearch.h"
+#include "utils/logger.h"
+#include "utils/file.h"
+#include <iostream>
+#include <signal.h>
+#include <unistd.h>
+#include <boost/program_options.hpp>
+
+using std::cout;
+using std::endl;
+
+namespace po = boost::program_options;
+
+volatile sig_atomic_t _stop;
+volatile sig_atomic_t _reload;
+
+void signal_callback(int signum) {
+	if (signum == SIGTERM || signum == SIGINT) {
+		_stop = 1;
+	} else if (signum == SIGHUP) {
+		_reload = 1;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	wifibeat::bench::mockElasticsearchSettings settings;
+	unsigned short int port = 9200;
+	unsigned int statsInterval = 0;
+	string nodesFile;
+
+	po::options_description desc("Options");
+	desc.add_options()
+		("help,h", "Show this message")
+		("port,p", po::value<unsigned short int>(&port)->default_value(9200), "Port to listen on (127.0.0.1)")
+		("latency,l", po::value<unsigned int>(&settings.latencyMS)->default_value(0), "Latency added to each _bulk request, in ms")
+		("reject-rate,r", po::value<double>(&settings.rejectRate)->default_value(0), "Ratio of _bulk requests rejected with HTTP 429 (0-1)")
+		("item-failures,i", po::value<double>(&settings.itemFailureRate)->default_value(0), "Ratio of failed items in accepted _bulk requests (0-1)")
+		("es-version,e", po::value<string>(&settings.version)->default_value("7.17.0"), "Elasticsearch version to report")
+		("certificate", po::value<string>(&settings.certificate), "Serve HTTPS with this certificate (PEM, can be self-signed)")
+		("key", po::value<string>(&settings.key), "Key of the certificate (PEM)")
+		("nodes,n", po::value<string>(&nodesFile), "File with the _nodes response (reloaded on SIGHUP). Default: the mock only")
+		("stats,s", po::value<unsigned int>(&statsInterval)->default_value(10), "Display statistics every X seconds (0 to disable)");
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		po::notify(vm);
+	} catch (po::error & e) {
+		cout << e.what() << endl << desc << endl;
+		return EXIT_FAILURE;
+	}
+	if (vm.count("help")) {
+		cout << desc << endl;
+		return EXIT_SUCCESS;
+	}
+
+	if (settings.certificate.empty() != settings.key.empty()) {
+		cout << "Both --certificate and --key are required for HTTPS" << endl;
+		return EXIT_FAILURE;
+	}
+	wifibeat::utils::logger::Instance("info", true);
+	if (!nodesFile.empty() && !wifibeat::utils::file::read(nodesFile, settings.nodes)) {
+		cout << "Failed reading <" << nodesFile << '>' << endl;
+		return EXIT_FAILURE;
+	}
+	_stop = 0;
+	_reload = 0;
+	signal(SIGINT, signal_callback);
+	signal(SIGTERM, signal_callback);
+	signal(SIGHUP, signal_callback);
+
+	wifibeat::bench::mockElasticsearch es(port, settings);
+	if (!es.start()) {
+		return EXIT_FAILURE;
+	}
+
+	unsigned int elapsed = 0;
+	while (!_stop) {
+		sleep(1);
+		if (_reload) {
+			_reload = 0;
+			string nodes;
+			if (!nodesFile.empty() && wifibeat::utils::file::read(nodesFile, nodes)) {
+				es.Nodes(nodes);
+				LOG_NOTICE("Reloaded <" + nodesFile + ">");
+			}
+		}
+		if (statsInterval && ++elapsed % statsInterval == 0) {
+			wifibeat::bench::mockElasticsearchStats stats = es.Stats();
+			cout << "Connections: " << stats.connections << " - Requests: " << stats.requests << " - Bulk: " << stats.bulkRequests
+				<< " (rejected: " << stats.rejectedRequests << ") - Documents: " << stats.indexedDocuments
+				<< " (failed: " << stats.failedItems << ") - Bytes: " << stats.bytes << endl;
+		}
+	}
+
+	es.stop();
+	wifibeat::utils::logger::Release();
+	return EXIT_SUCCESS;
+}
@@ -26,6 +26,9 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <chrono>
+#include <stdint.h>
+#include <time.h>
 
 
 using std::string;
@@ -35,14 +38,103 @@ using std::map;
 struct PCAPOutputStruct {
 	bool enabled;
 	string prefix;
-	PCAPOutputStruct() : enabled(false), prefix("") { }
+	bool index; // Write a sidecar index (<file>.idx) next to each file
+	PCAPOutputStruct() : enabled(false), prefix(""), index(false) { }
+};
+
+// Frames with a bad FCS or truncated headers (see utils::wifi::corruption)
+enum corruptedFramesAction {
+	KeepCorruptedFrames, // Not even checked
+	CountCorruptedFrames,
+	DropCorruptedFrames // And count them
+};
+
+struct fileReadingStruct {
+	bool merge; // Send frames of all the files in capture time order
+	unsigned int readAhead; // Frames buffered per file when merging
+	unsigned int readerThreads; // Memory mapped and read on that many threads. 0: disabled
+	unsigned long long int chunkSize; // Bytes read at once by a reader thread
+	bool ordered; // Frames sent in file order when read on several threads
+	double replaySpeed; // Replay at capture timing, that many times faster. 0: disabled
+	unsigned int replayRate; // Replay at that many frames per second. 0: disabled
+	bool replayLoop; // Start over at the end of the file when replaying
+	corruptedFramesAction corruptedFrames; // Files read one by one only
+	fileReadingStruct() : merge(false), readAhead(1000), readerThreads(0), chunkSize(8ULL * 1024 * 1024), ordered(true),
+							replaySpeed(0), replayRate(0), replayLoop(false), corruptedFrames(CountCorruptedFrames) { }
+	bool replay() const { return replaySpeed > 0 || replayRate > 0; }
+};
+
+// How an interface is opened (see threads/capture.h)
+struct interfaceCaptureStruct {
+	unsigned int bufferSize; // Kernel buffer in bytes. 0: libpcap default (2MB)
+	unsigned int snaplen; // 0: libpcap default (256KB)
+	std::chrono::milliseconds timeout; // Frames delivered in blocks after that long. 0: immediate mode
+	bool autoTune; // Double the buffer when the kernel drops frames
+	unsigned int maxBufferSize; // Up to that size, with auto tune: 64MB
+	interfaceCaptureStruct() : bufferSize(0), snaplen(0), timeout(0), autoTune(false), maxBufferSize(64 * 1024 * 1024) { }
+};
+
+// Frames from the interfaces sent in capture time order (see threads/reordering.h)
+struct reorderStruct {
+	bool enabled;
+	std::chrono::milliseconds window; // How late a frame can be: 50ms
+	unsigned int maxFrames; // Held at most, the oldest are sent early past it: 100000
+	reorderStruct() : enabled(false), window(std::chrono::milliseconds(50)), maxFrames(100000) { }
+};
+
+// Copies of a frame captured by several interfaces dropped (see threads/deduplication.h)
+struct dedupStruct {
+	bool enabled;
+	std::chrono::milliseconds window; // How far apart copies can arrive: 20ms
+	unsigned int maxFrames; // Held and checked at most, the oldest are sent early past it: 100000
+	dedupStruct() : enabled(false), window(std::chrono::milliseconds(20)), maxFrames(100000) { }
+};
+
+// Resume reading files where the previous run stopped (see utils/fileCheckpoint.h)
+struct fileCheckpointStruct {
+	bool enabled;
+	string file; // Default: .wifibeat-files-checkpoint in the working directory
+	std::chrono::milliseconds interval; // Progress since then is read again after a crash
+	fileCheckpointStruct() : enabled(false), interval(std::chrono::seconds(1)) { }
+};
+
+// Only read part of the files, using their index (see utils/pcapIndex.h)
+struct fileSeekStruct {
+	bool enabled;
+	bool byTime;
+	struct timespec from;
+	struct timespec to;
+	vector<uint64_t> macs; // Frames with any of these addresses
+	bool buildIndex; // Index files that don't have one (or an outdated one)
+	fileSeekStruct() : enabled(false), byTime(false), from({0, 0}), to({0, 0}), buildIndex(true) { }
+};
+
+enum watchDoneAction {
+	KeepWatchedFile,
+	DeleteWatchedFile,
+	MoveWatchedFile
+};
+
+struct directoryWatchStruct {
+	bool enabled;
+	string directory;
+	string pattern; // fnmatch() pattern of the files to read
+	bool follow; // Read files while they are being written
+	watchDoneAction done;
+	string moveTo; // With MoveWatchedFile
+	string checkpoint; // Progress in each file. Default: .wifibeat-checkpoint in the directory
+	directoryWatchStruct() : enabled(false), pattern("*.pcap*"), follow(false), done(KeepWatchedFile) { }
 };
 
 struct persistentQueueStruct {
 	bool enabled;
-	unsigned int maxSize;
+	unsigned long long int maxSize; // Bytes
 	string directory;
-	persistentQueueStruct() : enabled(false), maxSize(1000) { }
+	unsigned long long int segmentSize; // 64MB
+	std::chrono::milliseconds syncInterval; // 1s, frames written since then can be lost if the system crashes
+	unsigned int replayRate; // Frames per second replayed after a restart, 0: unlimited
+	persistentQueueStruct() : enabled(false), maxSize(1000ULL * 1024 * 1024), segmentSize(64ULL * 1024 * 1024),
+								syncInterval(std::chrono::seconds(1)), replayRate(5000) { }
 };
 
 struct LogstashConnection : outputBeatBase{
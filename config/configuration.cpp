@@ -20,6 +20,10 @@
 #include "utils/file.h"
 #include "utils/stringHelper.h"
 #include "utils/logger.h"
+#include "utils/indexRouter.h"
+#include "utils/bpfFilter.h"
+#include "utils/pcapIndex.h"
+#include "utils/fileCheckpoint.h"
 #include <string.h>
 #include <cstdlib> // NULL
 #include <exception>
@@ -32,7 +36,7 @@ using std::stoi;
 
 wifibeat::configuration* wifibeat::configuration::ms_instance = NULL;
 
-wifibeat::configuration::configuration(const string & path) : _path(path)
+wifibeat::configuration::configuration(const string & path) : captureBatchSize(DEFAULT_CAPTURE_BATCH_SIZE), corruptedFrames(CountCorruptedFrames), _path(path)
 {
 	// Check path
 	if (path.empty()) {
@@ -82,6 +86,184 @@ void wifibeat::configuration::parse_wifibeat_files(const YAML::Node & node)
 	}
 }
 
+void wifibeat::configuration::parse_wifibeat_files_settings(const YAML::Node & node)
+{
+	LOG_DEBUG("Parsing wifibeat.files.settings node");
+	if (node.IsMap() == false) {
+		throw string("wifibeat.files.settings was supposed to be a map.");
+	}
+
+	for (YAML::const_iterator param = node.begin(); param != node.end(); ++param) {
+		string key = param->first.as<string>();
+		if (param->second.IsNull()) {
+			continue;
+		}
+		if (param->second.IsScalar() == false) {
+			throw string("wifibeat.files.settings." + key + " value is invalid.");
+		}
+		string value = param->second.as<string>();
+
+		if (key == "merge") {
+			if (value == "true") {
+				this->fileReading.merge = true;
+			} else if (value == "false") {
+				this->fileReading.merge = false;
+			} else {
+				throw string("wifibeat.files.settings.merge value is invalid. Must be true or false.");
+			}
+		} else if (key == "read_ahead") {
+			char * end = NULL;
+			unsigned long frames = strtoul(value.c_str(), &end, 10);
+			if (value.empty() || *end != '\0' || frames == 0 || frames > 1000000) {
+				throw string("wifibeat.files.settings.read_ahead must be between 1 and 1000000 frames.");
+			}
+			this->fileReading.readAhead = static_cast<unsigned int>(frames);
+		} else if (key == "threads") {
+			char * end = NULL;
+			unsigned long threads = strtoul(value.c_str(), &end, 10);
+			if (value.empty() || *end != '\0' || threads > 256) {
+				throw string("wifibeat.files.settings.threads must be between 0 and 256.");
+			}
+			this->fileReading.readerThreads = static_cast<unsigned int>(threads);
+		} else if (key == "chunk_size") {
+			unsigned long long int size = 0;
+			try {
+				size = wifibeat::utils::stringHelper::parseSize(value);
+			} catch (const string & ex) {
+				throw string("wifibeat.files.settings.chunk_size value is invalid: " + ex);
+			}
+			// Without unit, it is in MB
+			if (value.find_first_not_of("0123456789 ") == string::npos) {
+				size *= 1024ULL * 1024ULL;
+			}
+			if (size < 65536) {
+				throw string("wifibeat.files.settings.chunk_size must be at least 64KB.");
+			}
+			this->fileReading.chunkSize = size;
+		} else if (key == "ordered") {
+			if (value == "true") {
+				this->fileReading.ordered = true;
+			} else if (value == "false") {
+				this->fileReading.ordered = false;
+			} else {
+				throw string("wifibeat.files.settings.ordered value is invalid. Must be true or false.");
+			}
+		} else if (key == "replay_speed") {
+			char * end = NULL;
+			double speed = strtod(value.c_str(), &end);
+			if (value.empty() || *end != '\0' || !(speed >= 0) || speed > 1000000) {
+				throw string("wifibeat.files.settings.replay_speed value is invalid. Must be 0 (disabled) or a multiplier above 0.");
+			}
+			this->fileReading.replaySpeed = speed;
+		} else if (key == "replay_rate") {
+			char * end = NULL;
+			unsigned long rate = strtoul(value.c_str(), &end, 10);
+			if (value.empty() || *end != '\0' || value[0] == '-' || rate > 100000000) {
+				throw string("wifibeat.files.settings.replay_rate value is invalid. Must be 0 (disabled) or a number of frames per second.");
+			}
+			this->fileReading.replayRate = static_cast<unsigned int>(rate);
+		} else if (key == "replay_loop") {
+			if (value == "true") {
+				this->fileReading.replayLoop = true;
+			} else if (value == "false") {
+				this->fileReading.replayLoop = false;
+			} else {
+				throw string("wifibeat.files.settings.replay_loop value is invalid. Must be true or false.");
+			}
+		} else if (key == "corrupted_frames") {
+			this->fileReading.corruptedFrames = corruptedFramesFromString(value, "wifibeat.files.settings.corrupted_frames");
+		} else {
+			throw string("wifibeat.files.settings: unknown setting <" + key + ">.");
+		}
+	}
+
+	if (this->fileReading.merge && this->fileReading.readerThreads) {
+		throw string("wifibeat.files.settings: merge and threads cannot be used together.");
+	}
+	if (this->fileReading.replaySpeed > 0 && this->fileReading.replayRate) {
+		throw string("wifibeat.files.settings: replay_speed and replay_rate cannot be used together.");
+	}
+	if (this->fileReading.replay() && this->fileReading.readerThreads) {
+		throw string("wifibeat.files.settings: files read on several threads cannot be replayed.");
+	}
+	if (this->fileReading.replayLoop && !this->fileReading.replay()) {
+		throw string("wifibeat.files.settings.replay_loop requires replay_speed or replay_rate.");
+	}
+	if (this->fileReading.replayLoop && this->fileReading.merge) {
+		throw string("wifibeat.files.settings: merged files cannot be replayed in a loop.");
+	}
+}
+
+void wifibeat::configuration::parse_wifibeat_files_watch(const YAML::Node & node)
+{
+	LOG_DEBUG("Parsing wifibeat.files.watch node");
+	if (node.IsMap() == false) {
+		throw string("wifibeat.files.watch was supposed to be a map.");
+	}
+
+	this->directoryWatch.enabled = true;
+	for (YAML::const_iterator param = node.begin(); param != node.end(); ++param) {
+		string key = param->first.as<string>();
+		if (param->second.IsNull()) {
+			continue;
+		}
+		if (param->second.IsScalar() == false) {
+			throw string("wifibeat.files.watch." + key + " value is invalid.");
+		}
+		string value = param->second.as<string>();
+
+		if (key == "enabled" || key == "follow") {
+			bool enabled;
+			if (value == "true") {
+				enabled = true;
+			} else if (value == "false") {
+				enabled = false;
+			} else {
+				throw string("wifibeat.files.watch." + key + " value is invalid. Must be true or false.");
+			}
+			if (key == "enabled") {
+				this->directoryWatch.enabled = enabled;
+			} else {
+				this->directoryWatch.follow = enabled;
+			}
+		} else if (key == "directory") {
+			this->directoryWatch.directory = value;
+		} else if (key == "pattern") {
+			this->directoryWatch.pattern = value;
+		} else if (key == "when_done") {
+			wifibeat::utils::stringHelper::to_lower(value);
+			if (value == "keep") {
+				this->directoryWatch.done = KeepWatchedFile;
+			} else if (value == "delete") {
+				this->directoryWatch.done = DeleteWatchedFile;
+			} else if (value == "move") {
+				this->directoryWatch.done = MoveWatchedFile;
+			} else {
+				throw string("wifibeat.files.watch.when_done value is invalid. Must be keep, delete or move.");
+			}
+		} else if (key == "move_to") {
+			this->directoryWatch.moveTo = value;
+		} else if (key == "checkpoint") {
+			this->directoryWatch.checkpoint = value;
+		} else {
+			throw string("wifibeat.files.watch: unknown setting <" + key + ">.");
+		}
+	}
+
+	if (!this->directoryWatch.enabled) {
+		return;
+	}
+	if (this->directoryWatch.directory.empty()) {
+		throw string("wifibeat.files.watch.directory is required.");
+	}
+	if (this->directoryWatch.pattern.empty()) {
+		throw string("wifibeat.files.watch.pattern cannot be empty.");
+	}
+	if (this->directoryWatch.done == MoveWatchedFile && this->directoryWatch.moveTo.empty()) {
+		throw string("wifibeat.files.watch.move_to is required to move files.");
+	}
+}
+
 void wifibeat::configuration::parse_queues_persistent(const YAML::Node & node)
 {
 	LOG_DEBUG("Parsing queues.persistent node");
@@ -104,20 +286,52 @@ void wifibeat::configuration::parse_queues_persistent(const YAML::Node & node)
 			} else if (param->second.as<string>() != "false") {
 				throw string("queues.persistent.enabled value is invalid. Must be true or false.");
 			}
-		} else if (key == "max_size") {
-			int max_size = 0;
+		} else if (key == "max_size" || key == "segment_size") {
+			if (param->second.IsScalar() == false) {
+				throw string("queues.persistent." + key + " value is invalid.");
+			}
+			string value = param->second.as<string>();
+			unsigned long long int size = 0;
 			try {
-				max_size = stoi(param->second.as<string>());
-			} catch (const std::invalid_argument& ia) {
-				throw string("queues.persistent.max_size value is invalid. Must be a number above 0.");
+				size = wifibeat::utils::stringHelper::parseSize(value);
+			} catch (const string & ex) {
+				throw string("queues.persistent." + key + " value is invalid: " + ex);
 			}
-			if (max_size == 0) {
-				this->persistentQueue.enabled = false;
-			} else if (max_size < 0) {
-				throw string("queues.persistent.max_size value is invalid. Must be a number above 0.");
+			// Plain numbers used to be MB
+			if (value.find_first_not_of("0123456789 ") == string::npos) {
+				size *= 1024ULL * 1024ULL;
+			}
+			if (key == "max_size") {
+				if (size == 0) {
+					this->persistentQueue.enabled = false;
+				}
+				this->persistentQueue.maxSize = size;
 			} else {
-				this->persistentQueue.maxSize = (unsigned int)max_size;
+				if (size < 1024 * 1024) {
+					throw string("queues.persistent.segment_size value is invalid. Must be at least 1MB.");
+				}
+				this->persistentQueue.segmentSize = size;
 			}
+		} else if (key == "sync_interval") {
+			try {
+				this->persistentQueue.syncInterval = wifibeat::utils::stringHelper::parseDuration(param->second.as<string>());
+			} catch (const string & ex) {
+				throw string("queues.persistent.sync_interval value is invalid: " + ex);
+			}
+			if (this->persistentQueue.syncInterval.count() == 0) {
+				throw string("queues.persistent.sync_interval value must be above 0.");
+			}
+		} else if (key == "replay_rate") {
+			int rate = 0;
+			try {
+				rate = stoi(param->second.as<string>());
+			} catch (const std::invalid_argument& ia) {
+				throw string("queues.persistent.replay_rate value is invalid. Must be a number.");
+			}
+			if (rate < 0) {
+				throw string("queues.persistent.replay_rate value is invalid. Must be 0 (unlimited) or above.");
+			}
+			this->persistentQueue.replayRate = (unsigned int)rate;
 		} else if (key == "directory") {
 			if (param->second.IsScalar() == false) {
 				throw string("queues.persistent.directory value is not a string.");
@@ -150,7 +364,6 @@ void wifibeat::configuration::parse_output_elasticsearch(const YAML::Node & node
 				conn.protocol = ESProtocol::HTTP;
 			} else if (proto == "https") {
 				conn.protocol = ESProtocol::HTTPS;
-				throw string("HTTPS isn't supported for connecting to ElasticSearch yet.");
 			} else {
 				throw string("Unknown Elastic protocol: " + proto);
 			}
@@ -177,6 +390,101 @@ void wifibeat::configuration::parse_output_elasticsearch(const YAML::Node & node
 				IPPort ipp(host = split[0], (unsigned short int)port);
 				conn.hosts.push_back(ipp);
 			}
+		} else if (key == "index") {
+			if (param->second.IsScalar() == false) {
+				throw string("output.elasticsearch.index value should be a string.");
+			}
+			string error;
+			conn.index = param->second.as<string>();
+			if (!wifibeat::utils::indexRouter::isValidPattern(conn.index, error)) {
+				throw string("output.elasticsearch.index value is invalid: " + error);
+			}
+		} else if (key == "indices") {
+			if (param->second.IsMap() == false) {
+				throw string("output.elasticsearch.indices was supposed to be a map.");
+			}
+			for (YAML::const_iterator idx = param->second.begin(); idx != param->second.end(); ++idx) {
+				string type = idx->first.as<string>();
+				if (type.empty() || type[0] == '#' || idx->second.IsNull()) {
+					continue;
+				}
+				wifibeat::utils::stringHelper::to_lower(type);
+				if (type != "management" && type != "control" && type != "data") {
+					throw string("output.elasticsearch.indices: unknown frame type <" + type + ">. Must be management, control or data.");
+				}
+				string error;
+				string pattern = idx->second.as<string>();
+				if (!wifibeat::utils::indexRouter::isValidPattern(pattern, error)) {
+					throw string("output.elasticsearch.indices." + type + " value is invalid: " + error);
+				}
+				conn.indices[type] = pattern;
+			}
+		} else if (key == "spool") {
+			this->parse_output_elasticsearch_spool(param->second, conn.spool);
+		} else if (key == "max_retries") {
+			int value = 0;
+			try {
+				value = stoi(param->second.as<string>());
+			} catch (const std::invalid_argument& ia) {
+				throw string("output.elasticsearch.max_retries value is invalid. Must be a number.");
+			}
+			if (value < 0) {
+				throw string("output.elasticsearch.max_retries value is invalid. Must be 0 or above.");
+			}
+			conn.maxRetries = (unsigned int)value;
+		} else if (key == "bulk_max_size" || key == "max_documents_per_second") {
+			int value = 0;
+			try {
+				value = stoi(param->second.as<string>());
+			} catch (const std::invalid_argument& ia) {
+				throw string("output.elasticsearch." + key + " value is invalid. Must be a number.");
+			}
+			if (key == "bulk_max_size") {
+				if (value <= 0) {
+					throw string("output.elasticsearch.bulk_max_size value is invalid. Must be a number above 0.");
+				}
+				conn.bulkMaxSize = (unsigned int)value;
+			} else {
+				if (value < 0) {
+					throw string("output.elasticsearch.max_documents_per_second value is invalid. Must be 0 (unlimited) or above.");
+				}
+				conn.maxDocumentsPerSecond = (unsigned int)value;
+			}
+		} else if (key == "flush_interval") {
+			try {
+				conn.flushInterval = wifibeat::utils::stringHelper::parseDuration(param->second.as<string>());
+			} catch (const string & ex) {
+				throw string("output.elasticsearch.flush_interval value is invalid: " + ex);
+			}
+		} else if (key == "ssl") {
+			this->parse_output_ssl(param->second, "output.elasticsearch.ssl", conn.ssl);
+		} else if (key == "sniffing") {
+			this->parse_output_elasticsearch_sniffing(param->second, conn.sniffing);
+		} else if (key == "adaptive") {
+			this->parse_output_elasticsearch_adaptive(param->second, conn.adaptive);
+		} else if (key == "template") {
+			this->parse_output_elasticsearch_template(param->second, conn);
+		} else if (key == "document_id") {
+			string mode = param->second.as<string>();
+			wifibeat::utils::stringHelper::to_lower(mode);
+			if (mode == "none") {
+				conn.documentID = DOCUMENT_ID_NONE;
+			} else if (mode == "unique") {
+				conn.documentID = DOCUMENT_ID_UNIQUE;
+			} else if (mode == "dedup") {
+				conn.documentID = DOCUMENT_ID_DEDUP;
+			} else {
+				throw string("output.elasticsearch.document_id value is invalid. Must be none, unique or dedup.");
+			}
+		} else if (key == "dedup_window") {
+			try {
+				conn.dedupWindow = wifibeat::utils::stringHelper::parseDuration(param->second.as<string>());
+			} catch (const string & ex) {
+				throw string("output.elasticsearch.dedup_window value is invalid: " + ex);
+			}
+			if (conn.dedupWindow.count() == 0) {
+				throw string("output.elasticsearch.dedup_window value must be above 0.");
+			}
 		} else if (key == "password") {
 			conn.password = param->second.as<string>();
 		} else if (key == "username") {
@@ -194,12 +502,342 @@ void wifibeat::configuration::parse_output_elasticsearch(const YAML::Node & node
 		}
 		// Only some of the fields are parsed now.
 	}
+	if (conn.protocol == HTTPS && !conn.ssl.enabled) {
+		throw string("output.elasticsearch: protocol is https but ssl is disabled.");
+	}
 	// Disable it if no host are present or if disabled
 	if (conn.hosts.size() != 0 && conn.enabled) {
 		this->ESOutputs.push_back(conn);
 	}
 }
 
+void wifibeat::configuration::parse_output_elasticsearch_spool(const YAML::Node & node, ESSpoolSettings & spool)
+{
+	LOG_DEBUG("Parsing output.elasticsearch.spool node");
+	if (node.IsMap() == false) {
+		throw string("output.elasticsearch.spool was supposed to be a map.");
+	}
+	for (YAML::const_iterator param = node.begin(); param != node.end(); ++param) {
+		string key = param->first.as<string>();
+		if (param->second.IsNull()) {
+			continue;
+		}
+		if (param->second.IsScalar() == false) {
+			throw string("output.elasticsearch.spool." + key + " value is invalid.");
+		}
+		string value = param->second.as<string>();
+
+		if (key == "enabled" || key == "compress") {
+			if (value != "true" && value != "false") {
+				throw string("output.elasticsearch.spool." + key + " value is invalid. Must be true or false.");
+			}
+			if (key == "enabled") {
+				spool.enabled = value == "true";
+			} else {
+				spool.compress = value == "true";
+			}
+		} else if (key == "directory") {
+			if (value.empty()) {
+				throw string("output.elasticsearch.spool.directory cannot be empty.");
+			}
+			spool.directory = value;
+		} else if (key == "max_size" || key == "segment_size") {
+			unsigned long long int size = 0;
+			try {
+				size = wifibeat::utils::stringHelper::parseSize(value);
+			} catch (const string & ex) {
+				throw string("output.elasticsearch.spool." + key + " value is invalid: " + ex);
+			}
+			if (size == 0) {
+				throw string("output.elasticsearch.spool." + key + " value must be above 0.");
+			}
+			if (key == "max_size") {
+				spool.maxSize = size;
+			} else {
+				spool.segmentSize = size;
+			}
+		} else if (key == "replay_rate") {
+			int rate = 0;
+			try {
+				rate = stoi(value);
+			} catch (const std::invalid_argument& ia) {
+				throw string("output.elasticsearch.spool.replay_rate value is invalid. Must be a number above 0.");
+			}
+			if (rate <= 0) {
+				throw string("output.elasticsearch.spool.replay_rate value is invalid. Must be a number above 0.");
+			}
+			spool.replayRate = (unsigned int)rate;
+		} else if (key == "retry_interval") {
+			try {
+				spool.retryInterval = wifibeat::utils::stringHelper::parseDuration(value);
+			} catch (const string & ex) {
+				throw string("output.elasticsearch.spool.retry_interval value is invalid: " + ex);
+			}
+		} else {
+			throw string("output.elasticsearch.spool: unknown setting <" + key + ">.");
+		}
+	}
+}
+
+void wifibeat::configuration::parse_output_elasticsearch_adaptive(const YAML::Node & node, ESAdaptiveSettings & adaptive)
+{
+	LOG_DEBUG("Parsing output.elasticsearch.adaptive node");
+	if (node.IsMap() == false) {
+		throw string("output.elasticsearch.adaptive was supposed to be a map.");
+	}
+	for (YAML::const_iterator param = node.begin(); param != node.end(); ++param) {
+		string key = param->first.as<string>();
+		if (param->second.IsNull()) {
+			continue;
+		}
+		if (param->second.IsScalar() == false) {
+			throw string("output.elasticsearch.adaptive." + key + " value is invalid.");
+		}
+		string value = param->second.as<string>();
+
+		if (key == "enabled") {
+			if (value != "true" && value != "false") {
+				throw string("output.elasticsearch.adaptive.enabled value is invalid. Must be true or false.");
+			}
+			adaptive.enabled = value == "true";
+		} else if (key == "min_bulk_size" || key == "max_bulk_size" || key == "max_concurrency") {
+			int number = 0;
+			try {
+				number = stoi(value);
+			} catch (const std::invalid_argument& ia) {
+				throw string("output.elasticsearch.adaptive." + key + " value is invalid. Must be a number above 0.");
+			}
+			if (number <= 0) {
+				throw string("output.elasticsearch.adaptive." + key + " value is invalid. Must be a number above 0.");
+			}
+			if (key == "min_bulk_size") {
+				adaptive.minBulkSize = (unsigned int)number;
+			} else if (key == "max_bulk_size") {
+				adaptive.maxBulkSize = (unsigned int)number;
+			} else {
+				adaptive.maxConcurrency = (unsigned int)number;
+			}
+		} else if (key == "target_latency") {
+			try {
+				adaptive.targetLatency = wifibeat::utils::stringHelper::parseDuration(value);
+			} catch (const string & ex) {
+				throw string("output.elasticsearch.adaptive.target_latency value is invalid: " + ex);
+			}
+			if (adaptive.targetLatency.count() == 0) {
+				throw string("output.elasticsearch.adaptive.target_latency value must be above 0.");
+			}
+		} else {
+			throw string("output.elasticsearch.adaptive: unknown setting <" + key + ">.");
+		}
+	}
+	if (adaptive.minBulkSize > adaptive.maxBulkSize) {
+		throw string("output.elasticsearch.adaptive.min_bulk_size cannot be above max_bulk_size.");
+	}
+}
+
+void wifibeat::configuration::parse_output_elasticsearch_sniffing(const YAML::Node & node, ESSniffingSettings & sniffing)
+{
+	LOG_DEBUG("Parsing output.elasticsearch.sniffing node");
+	if (node.IsMap() == false) {
+		throw string("output.elasticsearch.sniffing was supposed to be a map.");
+	}
+	for (YAML::const_iterator param = node.begin(); param != node.end(); ++param) {
+		string key = param->first.as<string>();
+		if (param->second.IsNull()) {
+			continue;
+		}
+		if (param->second.IsScalar() == false) {
+			throw string("output.elasticsearch.sniffing." + key + " value is invalid.");
+		}
+		string value = param->second.as<string>();
+
+		if (key == "enabled" || key == "data_nodes_only") {
+			if (value != "true" && value != "false") {
+				throw string("output.elasticsearch.sniffing." + key + " value is invalid. Must be true or false.");
+			}
+			if (key == "enabled") {
+				sniffing.enabled = value == "true";
+			} else {
+				sniffing.dataNodesOnly = value == "true";
+			}
+		} else if (key == "interval") {
+			try {
+				sniffing.interval = wifibeat::utils::stringHelper::parseDuration(value);
+			} catch (const string & ex) {
+				throw string("output.elasticsearch.sniffing.interval value is invalid: " + ex);
+			}
+			if (sniffing.interval.count() == 0) {
+				throw string("output.elasticsearch.sniffing.interval value must be above 0.");
+			}
+		} else {
+			throw string("output.elasticsearch.sniffing: unknown setting <" + key + ">.");
+		}
+	}
+}
+
+void wifibeat::configuration::parse_output_ssl(const YAML::Node & node, const string & name, outputSSLSettings & ssl)
+{
+	LOG_DEBUG("Parsing " + name + " node");
+	if (node.IsMap() == false) {
+		throw string(name + " was supposed to be a map.");
+	}
+	for (YAML::const_iterator param = node.begin(); param != node.end(); ++param) {
+		string key = param->first.as<string>();
+		if (param->second.IsNull()) {
+			continue;
+		}
+
+		// Lists
+		if (key == "supported_protocols" || key == "certificate_authorities" || key == "cipher_suites" || key == "curve_types") {
+			vector<string> values;
+			if (param->second.IsScalar()) {
+				values.push_back(param->second.as<string>());
+			} else if (param->second.IsSequence()) {
+				for (unsigned int i = 0; i < param->second.size(); ++i) {
+					values.push_back(param->second[i].as<string>());
+				}
+			} else {
+				throw string(name + "." + key + " was supposed to be a sequence.");
+			}
+
+			if (key == "supported_protocols") {
+				for (const string & protocol: values) {
+					if (protocol != "TLSv1.0" && protocol != "TLSv1.1" && protocol != "TLSv1.2" && protocol != "TLSv1.3") {
+						throw string(name + ".supported_protocols: unknown protocol <" + protocol + ">. Must be TLSv1.0, TLSv1.1, TLSv1.2 or TLSv1.3.");
+					}
+				}
+				if (values.empty()) {
+					throw string(name + ".supported_protocols can't be empty.");
+				}
+				ssl.supportedProtocols = values;
+			} else if (key == "certificate_authorities") {
+				for (const string & ca: values) {
+					if (!wifibeat::utils::file::exists(ca)) {
+						throw string(name + ".certificate_authorities: <" + ca + "> doesn't exist.");
+					}
+				}
+				ssl.certificateAuthorities = values;
+			} else if (key == "cipher_suites") {
+				ssl.cipherSuites = values;
+			} else {
+				ssl.curveTypes = values;
+			}
+			continue;
+		}
+
+		if (param->second.IsScalar() == false) {
+			throw string(name + "." + key + " value is invalid.");
+		}
+		string value = param->second.as<string>();
+		if (key == "enabled") {
+			if (value != "true" && value != "false") {
+				throw string(name + ".enabled value is invalid. Must be true or false.");
+			}
+			ssl.enabled = value == "true";
+		} else if (key == "verification_mode") {
+			wifibeat::utils::stringHelper::to_lower(value);
+			if (value != "full" && value != "certificate" && value != "none") {
+				throw string(name + ".verification_mode value is invalid. Must be full, certificate or none.");
+			}
+			ssl.verification_mode = value;
+		} else if (key == "certificate" || key == "key") {
+			if (!wifibeat::utils::file::exists(value)) {
+				throw string(name + "." + key + ": <" + value + "> doesn't exist.");
+			}
+			if (key == "certificate") {
+				ssl.certificate = value;
+			} else {
+				ssl.key = value;
+			}
+		} else if (key == "key_passphrase") {
+			ssl.keyPassphrase = value;
+		} else {
+			throw string(name + ": unknown setting <" + key + ">.");
+		}
+	}
+
+	if (ssl.certificate.empty() != ssl.key.empty()) {
+		throw string(name + ": certificate and key must both be set for client authentication.");
+	}
+}
+
+void wifibeat::configuration::parse_output_elasticsearch_template(const YAML::Node & node, ElasticSearchConnection & conn)
+{
+	LOG_DEBUG("Parsing output.elasticsearch.template node");
+	if (node.IsMap() == false) {
+		throw string("output.elasticsearch.template was supposed to be a map.");
+	}
+	for (YAML::const_iterator param = node.begin(); param != node.end(); ++param) {
+		string key = param->first.as<string>();
+		if (param->second.IsNull()) {
+			continue;
+		}
+
+		if (key == "versions") {
+			if (param->second.IsMap() == false) {
+				throw string("output.elasticsearch.template.versions was supposed to be a map.");
+			}
+			for (YAML::const_iterator version = param->second.begin(); version != param->second.end(); ++version) {
+				string name = version->first.as<string>();
+				ESTemplateVersion * tv = NULL;
+				if (name == "2x") {
+					tv = &conn.version2x;
+				} else if (name == "6x") {
+					tv = &conn.version6x;
+				} else {
+					throw string("output.elasticsearch.template.versions: unknown version <" + name + ">. Must be 2x or 6x.");
+				}
+				if (version->second.IsMap() == false) {
+					throw string("output.elasticsearch.template.versions." + name + " was supposed to be a map.");
+				}
+				for (YAML::const_iterator vp = version->second.begin(); vp != version->second.end(); ++vp) {
+					string vkey = vp->first.as<string>();
+					string value = vp->second.as<string>();
+					if (vkey == "enabled") {
+						if (value != "true" && value != "false") {
+							throw string("output.elasticsearch.template.versions." + name + ".enabled value is invalid. Must be true or false.");
+						}
+						tv->enabled = value == "true";
+					} else if (vkey == "path") {
+						if (!value.empty() && !wifibeat::utils::file::exists(value)) {
+							throw string("output.elasticsearch.template.versions." + name + ".path: file <" + value + "> does not exists.");
+						}
+						tv->path = value;
+					} else {
+						throw string("output.elasticsearch.template.versions." + name + ": unknown setting <" + vkey + ">.");
+					}
+				}
+			}
+			continue;
+		}
+
+		if (param->second.IsScalar() == false) {
+			throw string("output.elasticsearch.template." + key + " value is invalid.");
+		}
+		string value = param->second.as<string>();
+		if (key == "enabled" || key == "overwrite") {
+			if (value != "true" && value != "false") {
+				throw string("output.elasticsearch.template." + key + " value is invalid. Must be true or false.");
+			}
+			if (key == "enabled") {
+				conn.indexTemplate.enabled = value == "true";
+			} else {
+				conn.indexTemplate.overwrite = value == "true";
+			}
+		} else if (key == "name") {
+			if (value.empty() || value.find_first_of("/\\*?\"<>| ,#") != string::npos) {
+				throw string("output.elasticsearch.template.name value is invalid.");
+			}
+			conn.indexTemplate.name = value;
+		} else if (key == "refresh_interval") {
+			// Checked by Elasticsearch, -1 disables refresh
+			conn.indexTemplate.refreshInterval = value;
+		} else {
+			throw string("output.elasticsearch.template: unknown setting <" + key + ">.");
+		}
+	}
+}
+
 #define HOP_TU_STR_LEN 2
 #define S_(x) #x
 #define STR(x) S_(x)
@@ -341,6 +979,380 @@ void wifibeat::configuration::parse_wifibeat_interfaces_filters(const YAML::Node
 	}
 }
 
+void wifibeat::configuration::parse_wifibeat_interfaces_settings(const YAML::Node & node)
+{
+	LOG_DEBUG("Parsing wifibeat.interfaces.settings node");
+	if (node.IsMap() == false) {
+		throw string("wifibeat.interfaces.settings was supposed to be a map.");
+	}
+	for (YAML::const_iterator item = node.begin(); item != node.end(); ++item) {
+		string interface = item->first.as<string>();
+		if (interface.empty() || interface[0] == '#') {
+			continue;
+		}
+		string prefix = "wifibeat.interfaces.settings." + interface;
+		if (item->second.IsMap() == false) {
+			throw string(prefix + " was supposed to be a map.");
+		}
+
+		interfaceCaptureStruct settings;
+		for (YAML::const_iterator param = item->second.begin(); param != item->second.end(); ++param) {
+			string key = param->first.as<string>();
+			if (param->second.IsScalar() == false) {
+				throw string(prefix + "." + key + " value is invalid.");
+			}
+			string value = param->second.as<string>();
+			if (key == "buffer_size" || key == "max_buffer_size") {
+				unsigned long long int size = 0;
+				try {
+					size = wifibeat::utils::stringHelper::parseSize(value);
+				} catch (const string & ex) {
+					throw string(prefix + "." + key + " value is invalid: " + ex);
+				}
+				if (size < MIN_CAPTURE_BUFFER_SIZE || size > MAX_CAPTURE_BUFFER_SIZE) {
+					throw string(prefix + "." + key + " must be between 64KB and 1GB.");
+				}
+				if (key == "buffer_size") {
+					settings.bufferSize = static_cast<unsigned int>(size);
+				} else {
+					settings.maxBufferSize = static_cast<unsigned int>(size);
+				}
+			} else if (key == "snaplen") {
+				char * end = NULL;
+				unsigned long snaplen = strtoul(value.c_str(), &end, 10);
+				if (value.empty() || *end != '\0' || snaplen < 128 || snaplen > MAX_CAPTURE_SNAPLEN) {
+					throw string(prefix + ".snaplen must be between 128 and " + std::to_string(MAX_CAPTURE_SNAPLEN) + " bytes.");
+				}
+				settings.snaplen = static_cast<unsigned int>(snaplen);
+			} else if (key == "timeout") {
+				try {
+					settings.timeout = wifibeat::utils::stringHelper::parseDuration(value);
+				} catch (const string & ex) {
+					throw string(prefix + ".timeout value is invalid: " + ex);
+				}
+				if (settings.timeout > std::chrono::seconds(10)) {
+					throw string(prefix + ".timeout must be 10s at most.");
+				}
+			} else if (key == "auto_tune") {
+				if (value == "true") {
+					settings.autoTune = true;
+				} else if (value == "false") {
+					settings.autoTune = false;
+				} else {
+					throw string(prefix + ".auto_tune value is invalid. Must be true or false.");
+				}
+			} else {
+				throw string(prefix + ": unknown setting <" + key + ">.");
+			}
+		}
+		if (settings.autoTune && settings.bufferSize > settings.maxBufferSize) {
+			throw string(prefix + ": buffer_size is above max_buffer_size.");
+		}
+		this->interfaceSettings[interface] = settings;
+	}
+}
+
+interfaceCaptureStruct wifibeat::configuration::interfaceSetting(const string & interface)
+{
+	map<string, interfaceCaptureStruct>::const_iterator it = this->interfaceSettings.find(interface);
+	if (it == this->interfaceSettings.end()) {
+		it = this->interfaceSettings.find("default");
+	}
+	return (it == this->interfaceSettings.end()) ? interfaceCaptureStruct() : it->second;
+}
+
+void wifibeat::configuration::parse_wifibeat_files_filters(const YAML::Node & node)
+{
+	LOG_DEBUG("Parsing wifibeat.files.filters node");
+	if (node.IsMap() == false) {
+		throw string("wifibeat.files.filters was supposed to be a map.");
+	}
+	for (YAML::const_iterator param = node.begin(); param != node.end(); ++param) {
+		if (param->second.IsScalar() == false) {
+			throw string("wifibeat.files.filters item was supposed to be a string");
+		}
+		string key = param->first.as<string>();
+		if (key.empty() || key[0] == '#') {
+			continue;
+		}
+
+		// Catch syntax errors now rather than when the file gets opened
+		string filter = param->second.as<string>();
+		string error;
+		if (!wifibeat::utils::bpfFilter::valid(filter, DLT_IEEE802_11_RADIO, error)) {
+			throw string("wifibeat.files.filters." + key + " is invalid: " + error);
+		}
+		this->fileFilters.insert({key, filter});
+	}
+}
+
+void wifibeat::configuration::parse_wifibeat_files_seek(const YAML::Node & node)
+{
+	LOG_DEBUG("Parsing wifibeat.files.seek node");
+	if (node.IsMap() == false) {
+		throw string("wifibeat.files.seek was supposed to be a map.");
+	}
+
+	bool from = false, to = false;
+	this->fileSeek.enabled = true;
+	for (YAML::const_iterator param = node.begin(); param != node.end(); ++param) {
+		string key = param->first.as<string>();
+		if (param->second.IsNull()) {
+			continue;
+		}
+
+		if (key == "mac") {
+			// A single address, comma separated addresses or a list
+			vector<string> macs;
+			if (param->second.IsSequence()) {
+				for (YAML::const_iterator mac = param->second.begin(); mac != param->second.end(); ++mac) {
+					macs.push_back(mac->as<string>());
+				}
+			} else if (param->second.IsScalar()) {
+				macs = wifibeat::utils::stringHelper::split(param->second.as<string>(), ',');
+			} else {
+				throw string("wifibeat.files.seek.mac value is invalid.");
+			}
+			for (const string & mac: macs) {
+				uint64_t value;
+				if (!wifibeat::utils::pcapIndex::parseMac(mac, value)) {
+					throw string("wifibeat.files.seek.mac: invalid MAC address <" + mac + ">.");
+				}
+				this->fileSeek.macs.push_back(value);
+			}
+			continue;
+		}
+
+		if (param->second.IsScalar() == false) {
+			throw string("wifibeat.files.seek." + key + " value is invalid.");
+		}
+		string value = param->second.as<string>();
+		if (key == "from" || key == "to") {
+			struct timespec ts;
+			try {
+				ts = wifibeat::utils::stringHelper::parseTime(value);
+			} catch (const string & ex) {
+				throw string("wifibeat.files.seek." + key + " value is invalid: " + ex);
+			}
+			if (key == "from") {
+				this->fileSeek.from = ts;
+				from = true;
+			} else {
+				this->fileSeek.to = ts;
+				to = true;
+			}
+		} else if (key == "build_index") {
+			if (value == "true") {
+				this->fileSeek.buildIndex = true;
+			} else if (value == "false") {
+				this->fileSeek.buildIndex = false;
+			} else {
+				throw string("wifibeat.files.seek.build_index value is invalid. Must be true or false.");
+			}
+		} else {
+			throw string("wifibeat.files.seek: unknown setting <" + key + ">.");
+		}
+	}
+
+	// Open ended time ranges
+	if (from || to) {
+		this->fileSeek.byTime = true;
+		if (!to) {
+			this->fileSeek.to = { (time_t)(INT64_MAX / 1000000000LL), 0 };
+		}
+		if (this->fileSeek.from.tv_sec > this->fileSeek.to.tv_sec
+			|| (this->fileSeek.from.tv_sec == this->fileSeek.to.tv_sec && this->fileSeek.from.tv_nsec > this->fileSeek.to.tv_nsec)) {
+			throw string("wifibeat.files.seek: from must be before to.");
+		}
+	}
+	if (!this->fileSeek.byTime && this->fileSeek.macs.empty()) {
+		throw string("wifibeat.files.seek needs a time range (from, to) and/or MAC addresses (mac).");
+	}
+}
+
+void wifibeat::configuration::parse_wifibeat_files_checkpoint(const YAML::Node & node)
+{
+	LOG_DEBUG("Parsing wifibeat.files.checkpoint node");
+	if (node.IsMap() == false) {
+		throw string("wifibeat.files.checkpoint was supposed to be a map.");
+	}
+
+	this->fileCheckpoint.enabled = true;
+	for (YAML::const_iterator param = node.begin(); param != node.end(); ++param) {
+		string key = param->first.as<string>();
+		if (param->second.IsNull()) {
+			continue;
+		}
+		if (param->second.IsScalar() == false) {
+			throw string("wifibeat.files.checkpoint." + key + " value is invalid.");
+		}
+		string value = param->second.as<string>();
+
+		if (key == "enabled") {
+			if (value == "true") {
+				this->fileCheckpoint.enabled = true;
+			} else if (value == "false") {
+				this->fileCheckpoint.enabled = false;
+			} else {
+				throw string("wifibeat.files.checkpoint.enabled value is invalid. Must be true or false.");
+			}
+		} else if (key == "file") {
+			this->fileCheckpoint.file = value;
+		} else if (key == "interval") {
+			try {
+				this->fileCheckpoint.interval = wifibeat::utils::stringHelper::parseDuration(value);
+			} catch (const string & ex) {
+				throw string("wifibeat.files.checkpoint.interval value is invalid: " + ex);
+			}
+		} else {
+			throw string("wifibeat.files.checkpoint: unknown setting <" + key + ">.");
+		}
+	}
+}
+
+string wifibeat::configuration::fileFilter(const string & file)
+{
+	map<string, string>::const_iterator it = this->fileFilters.find(file);
+	if (it == this->fileFilters.end()) {
+		it = this->fileFilters.find("default");
+	}
+	return (it == this->fileFilters.end()) ? "" : it->second;
+}
+
+void wifibeat::configuration::parse_wifibeat_interfaces_batch_size(const YAML::Node & node)
+{
+	LOG_DEBUG("Parsing wifibeat.interfaces.batch_size node");
+	if (node.IsScalar() == false) {
+		throw string("wifibeat.interfaces.batch_size was supposed to be a number.");
+	}
+	string value = node.as<string>();
+	char * end = NULL;
+	unsigned long size = strtoul(value.c_str(), &end, 10);
+	if (value.empty() || *end != '\0' || size == 0 || size > MAX_CAPTURE_BATCH_SIZE) {
+		throw string("wifibeat.interfaces.batch_size must be between 1 and " + std::to_string(MAX_CAPTURE_BATCH_SIZE) + ".");
+	}
+	this->captureBatchSize = static_cast<unsigned int>(size);
+}
+
+corruptedFramesAction wifibeat::configuration::corruptedFramesFromString(const string & value, const string & setting)
+{
+	if (value == "keep") {
+		return KeepCorruptedFrames;
+	}
+	if (value == "count") {
+		return CountCorruptedFrames;
+	}
+	if (value == "drop") {
+		return DropCorruptedFrames;
+	}
+	throw string(setting + " value is invalid. Must be keep, count or drop.");
+}
+
+void wifibeat::configuration::parse_wifibeat_interfaces_corrupted_frames(const YAML::Node & node)
+{
+	LOG_DEBUG("Parsing wifibeat.interfaces.corrupted_frames node");
+	if (node.IsScalar() == false) {
+		throw string("wifibeat.interfaces.corrupted_frames was supposed to be a string.");
+	}
+	this->corruptedFrames = corruptedFramesFromString(node.as<string>(), "wifibeat.interfaces.corrupted_frames");
+}
+
+void wifibeat::configuration::parse_wifibeat_interfaces_reorder(const YAML::Node & node)
+{
+	LOG_DEBUG("Parsing wifibeat.interfaces.reorder node");
+	if (node.IsMap() == false) {
+		throw string("wifibeat.interfaces.reorder was supposed to be a map.");
+	}
+
+	this->reorder.enabled = true;
+	for (YAML::const_iterator param = node.begin(); param != node.end(); ++param) {
+		string key = param->first.as<string>();
+		if (param->second.IsNull()) {
+			continue;
+		}
+		if (param->second.IsScalar() == false) {
+			throw string("wifibeat.interfaces.reorder." + key + " value is invalid.");
+		}
+		string value = param->second.as<string>();
+
+		if (key == "enabled") {
+			if (value == "true") {
+				this->reorder.enabled = true;
+			} else if (value == "false") {
+				this->reorder.enabled = false;
+			} else {
+				throw string("wifibeat.interfaces.reorder.enabled value is invalid. Must be true or false.");
+			}
+		} else if (key == "window") {
+			try {
+				this->reorder.window = wifibeat::utils::stringHelper::parseDuration(value);
+			} catch (const string & ex) {
+				throw string("wifibeat.interfaces.reorder.window value is invalid: " + ex);
+			}
+			if (this->reorder.window.count() == 0 || this->reorder.window > std::chrono::seconds(60)) {
+				throw string("wifibeat.interfaces.reorder.window must be between 1ms and 60s.");
+			}
+		} else if (key == "max_frames") {
+			char * end = NULL;
+			unsigned long frames = strtoul(value.c_str(), &end, 10);
+			if (value.empty() || *end != '\0' || frames == 0 || frames > 10000000) {
+				throw string("wifibeat.interfaces.reorder.max_frames must be between 1 and 10000000 frames.");
+			}
+			this->reorder.maxFrames = static_cast<unsigned int>(frames);
+		} else {
+			throw string("wifibeat.interfaces.reorder: unknown setting <" + key + ">.");
+		}
+	}
+}
+
+void wifibeat::configuration::parse_wifibeat_interfaces_dedup(const YAML::Node & node)
+{
+	LOG_DEBUG("Parsing wifibeat.interfaces.dedup node");
+	if (node.IsMap() == false) {
+		throw string("wifibeat.interfaces.dedup was supposed to be a map.");
+	}
+
+	this->dedup.enabled = true;
+	for (YAML::const_iterator param = node.begin(); param != node.end(); ++param) {
+		string key = param->first.as<string>();
+		if (param->second.IsNull()) {
+			continue;
+		}
+		if (param->second.IsScalar() == false) {
+			throw string("wifibeat.interfaces.dedup." + key + " value is invalid.");
+		}
+		string value = param->second.as<string>();
+
+		if (key == "enabled") {
+			if (value == "true") {
+				this->dedup.enabled = true;
+			} else if (value == "false") {
+				this->dedup.enabled = false;
+			} else {
+				throw string("wifibeat.interfaces.dedup.enabled value is invalid. Must be true or false.");
+			}
+		} else if (key == "window") {
+			try {
+				this->dedup.window = wifibeat::utils::stringHelper::parseDuration(value);
+			} catch (const string & ex) {
+				throw string("wifibeat.interfaces.dedup.window value is invalid: " + ex);
+			}
+			if (this->dedup.window.count() == 0 || this->dedup.window > std::chrono::seconds(10)) {
+				throw string("wifibeat.interfaces.dedup.window must be between 1ms and 10s.");
+			}
+		} else if (key == "max_frames") {
+			char * end = NULL;
+			unsigned long frames = strtoul(value.c_str(), &end, 10);
+			if (value.empty() || *end != '\0' || frames == 0 || frames > 10000000) {
+				throw string("wifibeat.interfaces.dedup.max_frames must be between 1 and 10000000 frames.");
+			}
+			this->dedup.maxFrames = static_cast<unsigned int>(frames);
+		} else {
+			throw string("wifibeat.interfaces.dedup: unknown setting <" + key + ">.");
+		}
+	}
+}
+
 void wifibeat::configuration::parse_wifibeat_output_pcap(const YAML::Node & node)
 {
 	LOG_DEBUG("Parsing wifibeat.output.pcap node");
@@ -371,6 +1383,17 @@ void wifibeat::configuration::parse_wifibeat_output_pcap(const YAML::Node & node
 				throw string("wifibeat.output.pcap.prefix value should be a string.");
 			}
 			this->PCAPOutput.prefix = param->second.as<string>();
+		} else if (key == "index") {
+			if (param->second.IsScalar() == false) {
+				throw string("wifibeat.output.pcap.index value is invalid. Must be true or false.");
+			}
+			if (param->second.as<string>() == "true") {
+				this->PCAPOutput.index = true;
+			} else if (param->second.as<string>() == "false") {
+				this->PCAPOutput.index = false;
+			} else {
+				throw string("wifibeat.output.pcap.index value is invalid. Must be true or false.");
+			}
 		}
 	}
 }
@@ -388,6 +1411,16 @@ bool wifibeat::configuration::parse(const YAML::Node & config)
 
 		if (key == "wifibeat.files") {
 			this->parse_wifibeat_files(it->second);
+		} else if (key == "wifibeat.files.settings") {
+			this->parse_wifibeat_files_settings(it->second);
+		} else if (key == "wifibeat.files.filters") {
+			this->parse_wifibeat_files_filters(it->second);
+		} else if (key == "wifibeat.files.seek") {
+			this->parse_wifibeat_files_seek(it->second);
+		} else if (key == "wifibeat.files.checkpoint") {
+			this->parse_wifibeat_files_checkpoint(it->second);
+		} else if (key == "wifibeat.files.watch") {
+			this->parse_wifibeat_files_watch(it->second);
 		} else if (key == "queues.persistent") {
 			this->parse_queues_persistent(it->second);
 		} else if (key == "output.elasticsearch") {
@@ -400,11 +1433,36 @@ bool wifibeat::configuration::parse(const YAML::Node & config)
 			this->parse_logging_level(it->second);
 		} else if (key == "wifibeat.interfaces.filters") {
 			this->parse_wifibeat_interfaces_filters(it->second);
+		} else if (key == "wifibeat.interfaces.batch_size") {
+			this->parse_wifibeat_interfaces_batch_size(it->second);
+		} else if (key == "wifibeat.interfaces.reorder") {
+			this->parse_wifibeat_interfaces_reorder(it->second);
+		} else if (key == "wifibeat.interfaces.dedup") {
+			this->parse_wifibeat_interfaces_dedup(it->second);
+		} else if (key == "wifibeat.interfaces.corrupted_frames") {
+			this->parse_wifibeat_interfaces_corrupted_frames(it->second);
+		} else if (key == "wifibeat.interfaces.settings") {
+			this->parse_wifibeat_interfaces_settings(it->second);
 		} else if (key == "wifibeat.output.pcap") {
 			this->parse_wifibeat_output_pcap(it->second);
 		}
 	}
 
+	if (this->fileSeek.enabled && (this->fileReading.merge || this->fileReading.readerThreads || this->fileReading.replay())) {
+		throw string("wifibeat.files.seek cannot be combined with merge, threads or replay in wifibeat.files.settings.");
+	}
+	if (this->fileCheckpoint.enabled && (this->fileSeek.enabled || this->fileReading.merge || this->fileReading.readerThreads || this->fileReading.replayLoop)) {
+		throw string("wifibeat.files.checkpoint cannot be combined with wifibeat.files.seek, or with merge, threads or replay_loop in wifibeat.files.settings.");
+	}
+	if (this->fileCheckpoint.enabled && !this->persistentQueue.enabled) {
+		// Positions are saved once the outputs acknowledged the frames to the persistent queue
+		throw string("wifibeat.files.checkpoint requires queues.persistent.");
+	}
+	if (this->directoryWatch.enabled && this->directoryWatch.done != KeepWatchedFile && !this->persistentQueue.enabled) {
+		// Files are only deleted or moved once the outputs acknowledged all their frames
+		throw string("wifibeat.files.watch.when_done: delete and move require queues.persistent.");
+	}
+
 	// TODO: Move interface filters to the cards (create a class for that)
 
 	return true;
@@ -443,12 +1501,87 @@ string wifibeat::configuration::toString()
 	} else {
 		ss << "No!" << endl;
 	}
-	ss << "- Max Size: " << this->persistentQueue.maxSize << endl;
+	ss << "- Max Size: " << this->persistentQueue.maxSize / 1048576 << "MB (segments of "
+		<< this->persistentQueue.segmentSize / 1048576 << "MB)" << endl;
 	ss << "- Directory: " << this->persistentQueue.directory << endl;
+	ss << "- Sync interval: " << this->persistentQueue.syncInterval.count() << "ms" << endl;
+	ss << "- Replay rate: ";
+	if (this->persistentQueue.replayRate) {
+		ss << this->persistentQueue.replayRate << " frames/s" << endl;
+	} else {
+		ss << "unlimited" << endl;
+	}
 
-	ss << "Files to read: " << this->filesToRead.size() << endl;
+	ss << "Files to read: " << this->filesToRead.size();
+	if (this->fileReading.merge) {
+		ss << " (merged by capture time, " << this->fileReading.readAhead << " frames read ahead)";
+	} else if (this->fileReading.readerThreads) {
+		ss << " (" << this->fileReading.readerThreads << " threads each, " << this->fileReading.chunkSize / 1048576 << "MB chunks";
+		if (!this->fileReading.ordered) {
+			ss << ", unordered";
+		}
+		ss << ')';
+	}
+	if (this->fileReading.replayRate) {
+		ss << ", replayed at " << this->fileReading.replayRate << " frames/s";
+	} else if (this->fileReading.replaySpeed > 0) {
+		ss << ", replayed at " << this->fileReading.replaySpeed << "x capture speed";
+	}
+	if (this->fileReading.replayLoop) {
+		ss << " in a loop";
+	}
+	if (this->fileReading.corruptedFrames == DropCorruptedFrames) {
+		ss << ", corrupted frames dropped";
+	} else if (this->fileReading.corruptedFrames == KeepCorruptedFrames) {
+		ss << ", corrupted frames not checked";
+	}
+	ss << endl;
 	for (const string & item: this->filesToRead) {
-		ss << "- " << item << endl;
+		ss << "- " << item;
+		string filter = this->fileFilter(item);
+		if (!filter.empty()) {
+			ss << " - Filter <" << filter << '>';
+		}
+		ss << endl;
+	}
+
+	if (this->fileCheckpoint.enabled) {
+		ss << "Files resume from checkpoint <" << ((this->fileCheckpoint.file.empty()) ? FILECHECKPOINT_DEFAULT_PATH : this->fileCheckpoint.file)
+			<< ">, saved every " << this->fileCheckpoint.interval.count() << "ms" << endl;
+	}
+
+	if (this->fileSeek.enabled) {
+		ss << "Files are only partly read, with their index:" << endl;
+		if (this->fileSeek.byTime) {
+			ss << "- From " << this->fileSeek.from.tv_sec << " to " << this->fileSeek.to.tv_sec << " (seconds since epoch)" << endl;
+		}
+		for (uint64_t mac: this->fileSeek.macs) {
+			char buffer[18];
+			snprintf(buffer, sizeof(buffer), "%02x:%02x:%02x:%02x:%02x:%02x", (unsigned int)(mac >> 40) & 0xFF, (unsigned int)(mac >> 32) & 0xFF,
+				(unsigned int)(mac >> 24) & 0xFF, (unsigned int)(mac >> 16) & 0xFF, (unsigned int)(mac >> 8) & 0xFF, (unsigned int)mac & 0xFF);
+			ss << "- MAC: " << buffer << endl;
+		}
+	}
+
+	ss << "Watched directory: ";
+	if (this->directoryWatch.enabled) {
+		ss << this->directoryWatch.directory << " (" << this->directoryWatch.pattern;
+		if (this->directoryWatch.follow) {
+			ss << ", follow";
+		}
+		switch (this->directoryWatch.done) {
+			case DeleteWatchedFile:
+				ss << ", delete when done";
+				break;
+			case MoveWatchedFile:
+				ss << ", move to " << this->directoryWatch.moveTo << " when done";
+				break;
+			default:
+				break;
+		}
+		ss << ')' << endl;
+	} else {
+		ss << "None" << endl;
 	}
 
 	ss << "Logging level: <" << this->loggingLevel << ">" << endl;
@@ -499,6 +1632,57 @@ string wifibeat::configuration::toString()
 		ss << "- " << kv.first << ": " << kv.second << endl;
 	}
 
+	ss << "Interface settings: " << this->interfaceSettings.size() << endl;
+	for (const auto & kv: this->interfaceSettings) {
+		ss << "- " << kv.first << ": buffer ";
+		if (kv.second.bufferSize) {
+			ss << kv.second.bufferSize / 1024 << "KB";
+		} else {
+			ss << "default";
+		}
+		if (kv.second.autoTune) {
+			ss << " (auto tune, up to " << kv.second.maxBufferSize / 1024 << "KB)";
+		}
+		ss << ", snaplen ";
+		if (kv.second.snaplen) {
+			ss << kv.second.snaplen;
+		} else {
+			ss << "default";
+		}
+		if (kv.second.timeout.count()) {
+			ss << ", timeout " << kv.second.timeout.count() << "ms";
+		} else {
+			ss << ", immediate mode";
+		}
+		ss << endl;
+	}
+
+	ss << "Capture batch size: " << this->captureBatchSize << " frames" << endl;
+	ss << "Reordering frames from the interfaces: ";
+	if (this->reorder.enabled) {
+		ss << this->reorder.window.count() << "ms window, up to " << this->reorder.maxFrames << " frames" << endl;
+	} else {
+		ss << "No" << endl;
+	}
+	ss << "Dropping frames captured by several interfaces: ";
+	if (this->dedup.enabled) {
+		ss << this->dedup.window.count() << "ms window, up to " << this->dedup.maxFrames << " frames" << endl;
+	} else {
+		ss << "No" << endl;
+	}
+	ss << "Frames with a bad FCS or truncated: ";
+	switch (this->corruptedFrames) {
+		case KeepCorruptedFrames:
+			ss << "kept, not checked" << endl;
+			break;
+		case CountCorruptedFrames:
+			ss << "counted" << endl;
+			break;
+		case DropCorruptedFrames:
+			ss << "dropped" << endl;
+			break;
+	}
+
 	ss << "PCAP Export (";
 	if (this->PCAPOutput.enabled) {
 		ss << "enabled)" << endl;
@@ -508,6 +1692,9 @@ string wifibeat::configuration::toString()
 	if (this->PCAPOutput.prefix.empty() == false) {
 		ss << "- Prefix: " << this->PCAPOutput.prefix << endl;
 	}
+	if (this->PCAPOutput.index) {
+		ss << "- Sidecar index: Yes" << endl;
+	}
 
 	ss << "ElasticSearch outputs: " << this->ESOutputs.size() << endl;
 	for (const ElasticSearchConnection & esc: this->ESOutputs) {
@@ -529,7 +1716,48 @@ string wifibeat::configuration::toString()
 		}
 
 		ss << '(' << ((esc.enabled) ? "En" : "Dis") << "abled)";
-		ss << " - Bulk Max size: " << esc.bulkMaxSize << endl;
+		ss << " - Bulk Max size: " << esc.bulkMaxSize << " - Max retries: " << esc.maxRetries << endl;
+		if (esc.adaptive.enabled) {
+			ss << "  - Adaptive: bulk size " << esc.adaptive.minBulkSize << '-' << esc.adaptive.maxBulkSize
+				<< ", up to " << esc.adaptive.maxConcurrency << " concurrent requests, target latency "
+				<< esc.adaptive.targetLatency.count() << "ms" << endl;
+		}
+		if (esc.protocol == HTTPS) {
+			ss << "  - TLS: verification " << esc.ssl.verification_mode;
+			for (const string & protocol: esc.ssl.supportedProtocols) {
+				ss << ' ' << protocol;
+			}
+			if (!esc.ssl.certificate.empty()) {
+				ss << ", client certificate <" << esc.ssl.certificate << '>';
+			}
+			ss << endl;
+		}
+		if (esc.sniffing.enabled) {
+			ss << "  - Sniffing every " << esc.sniffing.interval.count() << "ms"
+				<< ((esc.sniffing.dataNodesOnly) ? " (data nodes only)" : "") << endl;
+		}
+		if (esc.maxDocumentsPerSecond) {
+			ss << "  - Max documents per second: " << esc.maxDocumentsPerSecond << endl;
+		}
+		if (esc.index.empty() == false) {
+			ss << "  - Index: " << esc.index << endl;
+		}
+		for (const auto & kv: esc.indices) {
+			ss << "  - Index for " << kv.first << " frames: " << kv.second << endl;
+		}
+		if (esc.indexTemplate.enabled) {
+			ss << "  - Template: " << esc.indexTemplate.name << ((esc.indexTemplate.overwrite) ? " (overwrite)" : "") << endl;
+		}
+		if (esc.documentID == DOCUMENT_ID_UNIQUE) {
+			ss << "  - Document ID: unique" << endl;
+		} else if (esc.documentID == DOCUMENT_ID_DEDUP) {
+			ss << "  - Document ID: dedup (" << esc.dedupWindow.count() << "ms window)" << endl;
+		}
+		if (esc.spool.enabled) {
+			ss << "  - Spool: " << esc.spool.directory << " (max " << esc.spool.maxSize << " bytes, segments of "
+				<< esc.spool.segmentSize << " bytes" << ((esc.spool.compress) ? ", compressed" : "")
+				<< "), replay " << esc.spool.replayRate << " bulk/s" << endl;
+		}
 	}
 
 	return ss.str();
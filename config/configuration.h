@@ -21,7 +21,7 @@
 
 #define CONFIG_FILE_PATH "/etc/wifibeat.yml"
 #define PERSISTENT_QUEUE_DEFAULT_PATH "/var/wifibeat"
-#define PERSISTENT_QUEUE_DEFAULT_MAX_SIZE 1000
+#define PERSISTENT_QUEUE_DEFAULT_MAX_SIZE (1000ULL * 1024 * 1024) // max_size without unit is in MB
 
 #include <string>
 #include <vector>
@@ -34,6 +34,11 @@ using std::vector;
 using std::map;
 
 #define DEFAULT_HOP_TIME_MS 700
+#define DEFAULT_CAPTURE_BATCH_SIZE 64
+#define MAX_CAPTURE_BATCH_SIZE 65536
+#define MIN_CAPTURE_BUFFER_SIZE (64 * 1024)
+#define MAX_CAPTURE_BUFFER_SIZE (1024U * 1024 * 1024)
+#define MAX_CAPTURE_SNAPLEN 262144
 
 namespace wifibeat {
 	class configuration
@@ -54,6 +59,14 @@ namespace wifibeat {
 
 		// PCAP reading
 		vector<string> filesToRead;
+		fileReadingStruct fileReading;
+		directoryWatchStruct directoryWatch;
+		fileSeekStruct fileSeek;
+		fileCheckpointStruct fileCheckpoint;
+
+		// Filters, per file (or watched directory). "default" applies to the others.
+		map <string, string> fileFilters;
+		string fileFilter(const string & file);
 
 		// Decryption keys
 		vector<decryptionKey> decryptionKeys;
@@ -67,6 +80,22 @@ namespace wifibeat {
 		// Filters, per card
 		map <string, string> interfaceFilters;
 
+		// Buffer size, snaplen, timeout and auto tune, per card ("default" for the others)
+		map <string, interfaceCaptureStruct> interfaceSettings;
+		interfaceCaptureStruct interfaceSetting(const string & interface);
+
+		// Maximum amount of frames read at once from an interface or a file
+		unsigned int captureBatchSize;
+
+		// Frames from the interfaces put back in capture time order
+		reorderStruct reorder;
+
+		// Copies of the same frame from several interfaces dropped
+		dedupStruct dedup;
+
+		// Frames from the interfaces with a bad FCS or truncated
+		corruptedFramesAction corruptedFrames;
+
 		// Outputs
 		vector <ElasticSearchConnection> ESOutputs;
 		vector <LogstashConnection> LSOutputs;
@@ -77,12 +106,28 @@ namespace wifibeat {
 		~configuration();
 		bool parse(const YAML::Node & config);
 		void parse_wifibeat_files(const YAML::Node & node);
+		void parse_wifibeat_files_settings(const YAML::Node & node);
+		void parse_wifibeat_files_watch(const YAML::Node & node);
 		void parse_queues_persistent(const YAML::Node & node);
 		void parse_output_elasticsearch(const YAML::Node & node);
+		void parse_output_elasticsearch_spool(const YAML::Node & node, ESSpoolSettings & spool);
+		void parse_output_elasticsearch_adaptive(const YAML::Node & node, ESAdaptiveSettings & adaptive);
+		void parse_output_elasticsearch_sniffing(const YAML::Node & node, ESSniffingSettings & sniffing);
+		void parse_output_ssl(const YAML::Node & node, const string & name, outputSSLSettings & ssl);
+		void parse_output_elasticsearch_template(const YAML::Node & node, ElasticSearchConnection & conn);
 		void parse_wifibeat_interfaces_devices(const YAML::Node & node);
 		void parse_decryption_keys(const YAML::Node & node);
 		void parse_logging_level(const YAML::Node & node);
 		void parse_wifibeat_interfaces_filters(const YAML::Node & node);
+		void parse_wifibeat_files_filters(const YAML::Node & node);
+		void parse_wifibeat_files_seek(const YAML::Node & node);
+		void parse_wifibeat_files_checkpoint(const YAML::Node & node);
+		void parse_wifibeat_interfaces_batch_size(const YAML::Node & node);
+		void parse_wifibeat_interfaces_reorder(const YAML::Node & node);
+		void parse_wifibeat_interfaces_dedup(const YAML::Node & node);
+		void parse_wifibeat_interfaces_corrupted_frames(const YAML::Node & node);
+		void parse_wifibeat_interfaces_settings(const YAML::Node & node);
+		static corruptedFramesAction corruptedFramesFromString(const string & value, const string & setting);
 		void parse_wifibeat_output_pcap(const YAML::Node & node);
 
 		string _path;
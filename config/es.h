@@ -34,12 +34,60 @@ enum ESProtocol {
 	HTTPS
 };
 
+// How the _id of documents is generated
+enum ESDocumentID {
+	DOCUMENT_ID_NONE, // Elasticsearch generates it
+	DOCUMENT_ID_UNIQUE, // Hash of frame, capture time and sensor: retries don't duplicate documents
+	DOCUMENT_ID_DEDUP // Hash of the 802.11 frame and a time bucket: the same frame seen by several sensors is stored once
+};
+
 struct ESTemplateVersion {
 	bool enabled; // true
 	string path;
 	ESTemplateVersion(): enabled(true), path("") { }
 };
 
+// Index template installed at startup
+struct ESTemplateSettings {
+	bool enabled; // true
+	string name; // wifibeat
+	bool overwrite; // false
+	string refreshInterval; // 5s, empty to keep the Elasticsearch default
+	ESTemplateSettings(): enabled(true), name("wifibeat"), overwrite(false), refreshInterval("5s") { }
+};
+
+struct ESSpoolSettings {
+	bool enabled; // false
+	string directory; // /var/lib/wifibeat/spool (a subdirectory is created per output)
+	unsigned long long int maxSize; // 1GB
+	unsigned long long int segmentSize; // 64MB
+	bool compress; // false
+	unsigned int replayRate; // 5 bulk requests per second
+	std::chrono::milliseconds retryInterval; // 5 sec
+	ESSpoolSettings(): enabled(false), directory("/var/lib/wifibeat/spool"), maxSize(1024ULL * 1024 * 1024),
+						segmentSize(64ULL * 1024 * 1024), compress(false), replayRate(5),
+						retryInterval(std::chrono::seconds(5)) { }
+};
+
+// Bulk size and concurrency adjusted on Elasticsearch feedback (AIMD)
+struct ESAdaptiveSettings {
+	bool enabled; // false
+	unsigned int minBulkSize; // 50
+	unsigned int maxBulkSize; // 5000
+	unsigned int maxConcurrency; // 4
+	std::chrono::milliseconds targetLatency; // 1 sec
+	ESAdaptiveSettings(): enabled(false), minBulkSize(50), maxBulkSize(5000), maxConcurrency(4),
+							targetLatency(std::chrono::seconds(1)) { }
+};
+
+// Discover the nodes of the cluster from the hosts (seeds) and spread requests over them
+struct ESSniffingSettings {
+	bool enabled; // false
+	std::chrono::milliseconds interval; // 5 min
+	bool dataNodesOnly; // true
+	ESSniffingSettings(): enabled(false), interval(std::chrono::minutes(5)), dataNodesOnly(true) { }
+};
+
 struct ElasticSearchConnection : outputBeatBase{
 	ESProtocol protocol; // HTTP
 	string username;
@@ -50,14 +98,23 @@ struct ElasticSearchConnection : outputBeatBase{
 	string HTTPPath;
 	string proxyURL;
 	unsigned int maxRetries; // 3
-	unsigned int bulkMaxSize; // 50
+	unsigned int bulkMaxSize; // 50 (initial size when adaptive)
 	unsigned int timeout; // 90
-	std::chrono::seconds flushInterval; // 1 sec
-	ESTemplateVersion version2x;
-	ESTemplateVersion version6x;
+	std::chrono::milliseconds flushInterval; // 1 sec
+	ESAdaptiveSettings adaptive;
+	unsigned int maxDocumentsPerSecond; // 0: unlimited
+	ESSniffingSettings sniffing;
+	ESTemplateSettings indexTemplate;
+	ESTemplateVersion version2x; // Used before 6.0
+	ESTemplateVersion version6x; // Used from 6.0
+	map <string, string> indices; // Index pattern per frame type (management, control, data). Default: index
+	ESSpoolSettings spool;
+	ESDocumentID documentID; // DOCUMENT_ID_NONE
+	std::chrono::milliseconds dedupWindow; // 1 sec
 	ElasticSearchConnection() : protocol(HTTP), username(""), password(""), pipeline(""), HTTPPath(""),
 								proxyURL(""), maxRetries(3), bulkMaxSize(50), timeout(90),
-								flushInterval(std::chrono::seconds(1)) { }
+								flushInterval(std::chrono::seconds(1)), maxDocumentsPerSecond(0), documentID(DOCUMENT_ID_NONE),
+								dedupWindow(std::chrono::seconds(1)) { }
 };
 
 #endif // CONFIG_ES_H
@@ -35,17 +35,16 @@ struct IPPort {
 
 struct outputSSLSettings {
 	bool enabled; // true
-	string verification_mode; // full
-	vector <string> supportedProtocols; // TLSv1.0, TLSv1.1, TLSv1.2
-	vector <string> certificateAuthorities; // /etc/pki/root/ca.pem
-	string certificate; // /etc/pki/client/cert.pem
-	string key; // /etc/pki/client/cert.key
+	string verification_mode; // full, certificate or none
+	vector <string> supportedProtocols; // TLSv1.1, TLSv1.2, TLSv1.3
+	vector <string> certificateAuthorities; // Added to the system ones. Ex: /etc/pki/root/ca.pem
+	string certificate; // Client authentication. Ex: /etc/pki/client/cert.pem
+	string key; // Ex: /etc/pki/client/cert.key
 	string keyPassphrase;
-	vector <string> cipherSuites;
+	vector <string> cipherSuites; // OpenSSL names, empty for the defaults
 	vector <string> curveTypes;
-	outputSSLSettings() : enabled(true), verification_mode("full"), supportedProtocols({"TLSv1.0", "TLSv1.1", "TLSv1.2"}),
-						certificateAuthorities({"/etc/pki/root/ca.pem"}), certificate("/etc/pki/client/cert.pem"),
-						key("/etc/pki/client/cert.key") { }
+	outputSSLSettings() : enabled(true), verification_mode("full"), supportedProtocols({"TLSv1.1", "TLSv1.2", "TLSv1.3"}),
+						certificate(""), key(""), keyPassphrase("") { }
 };
 
 struct outputBeatBase {
@@ -20,7 +20,6 @@
 #include <string>
 #include <cstdint>
 #include <tins/tins.h>
-#include <elasticbeat-cpp/elastic.h>
 #include <boost/program_options.hpp>
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
@@ -31,6 +30,8 @@
 #include "utils/wifi.h"
 #include "utils/logger.h"
 #include "utils/file.h"
+#include "utils/pcapStream.h"
+#include <algorithm>
 
 using Tins::Sniffer;
 using std::string;
@@ -89,6 +90,10 @@ bool parseArguments(const po::variables_map & vm)
 		_appSettings.PCAPPrefix = vm["pcap-prefix"].as<string>();
 	}
 
+	if (vm.count("read")) {
+		configuration::Instance()->filesToRead = vm["read"].as<vector<string> >();
+	}
+
 	// PID file location
 	_appSettings.PIDFile = vm["pid"].as<string>();
 
@@ -138,7 +143,8 @@ int main(int argc, char **argv)
 		("dump-config,d", "Display parsed configuration")
 		("pid,p", po::value<string>()->default_value(_PID_DEFAULT_FILENAME), "Where to write PID file. Ignored if no-daemon is set")
 		("no-pid,n", "Do not write PID to file. Automatically set when no-daemon is set.")
-		("pcap-prefix,a", po::value<string>(), "Per interface export PCAP file prefix.");
+		("pcap-prefix,a", po::value<string>(), "Per interface export PCAP file prefix.")
+		("read,r", po::value<vector<string> >()->composing(), "Read that file (can be used several times) instead of the ones in the configuration. - reads from the standard input (requires --no-daemon).");
 
 	po::variables_map vm;
 	try {
@@ -231,6 +237,14 @@ int main(int argc, char **argv)
 		}
 	}
 
+	// The standard input is closed when going in the background
+	const vector<string> & files = configuration::Instance()->filesToRead;
+	if (_appSettings.daemonize && std::find(files.begin(), files.end(), PCAPSTREAM_STDIN) != files.end()) {
+		LOG_ERROR("Reading from the standard input requires --no-daemon");
+		cleanup();
+		return EXIT_FAILURE;
+	}
+
 	// Daemonize
 	if (_appSettings.daemonize) {
 		if (daemon(1, 0) == -1) {
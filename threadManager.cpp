@@ -27,7 +27,7 @@
 
 using std::stringstream;
 
-wifibeat::threadManager::threadManager(const string & pcapPrefix) : _decryption(NULL), _persistence(NULL), _mutexInit(false)
+wifibeat::threadManager::threadManager(const string & pcapPrefix) : _fileMerging(NULL), _directoryWatching(NULL), _fileCheckpoint(NULL), _captureEngine(NULL), _reordering(NULL), _deduplication(NULL), _decryption(NULL), _persistence(NULL), _mutexInit(false)
 {
 	if (pthread_mutex_init(&this->_mutex, NULL) != 0) {
 		LOG_CRITICAL("Failed initializing Thread Manager mutex");
@@ -37,10 +37,62 @@ wifibeat::threadManager::threadManager(const string & pcapPrefix) : _decryption(
 	wifibeat::utils::Locker l(&this->_mutex); // Avoid tsan complaining of race condition
 
 	// Capture files
-	for (const string & file: configuration::Instance()->filesToRead) {
-		LOG_DEBUG("Adding new file to read: " + file);
-		threads::filereading * pcap = new threads::filereading(file, "");
-		this->_filereadings.push_back(pcap);
+	const fileReadingStruct & fileReading = configuration::Instance()->fileReading;
+	if (configuration::Instance()->fileSeek.enabled) {
+		for (const string & file: configuration::Instance()->filesToRead) {
+			LOG_DEBUG("Adding new file to read with its index: " + file);
+			threads::indexedfilereading * ifr = new threads::indexedfilereading(file, configuration::Instance()->fileSeek);
+			ifr->Filter(configuration::Instance()->fileFilter(file));
+			this->_indexedFileReadings.push_back(ifr);
+		}
+	} else if (fileReading.merge && configuration::Instance()->filesToRead.size() > 1) {
+		LOG_DEBUG("Adding file merging");
+		this->_fileMerging = new threads::filemerging(configuration::Instance()->filesToRead, fileReading.readAhead);
+		this->_fileMerging->Replay(fileReading.replaySpeed, fileReading.replayRate);
+		for (const string & file: configuration::Instance()->filesToRead) {
+			this->_fileMerging->Filter(file, configuration::Instance()->fileFilter(file));
+		}
+	} else if (fileReading.readerThreads) {
+		for (const string & file: configuration::Instance()->filesToRead) {
+			if (utils::pcapStream::needed(file)) {
+				// Compressed and pcapng files can only be read sequentially
+				LOG_NOTICE("<" + file + "> is compressed or in pcapng format, it will be read on a single thread");
+				threads::filereading * pcap = new threads::filereading(file, configuration::Instance()->fileFilter(file));
+				pcap->BatchSize(configuration::Instance()->captureBatchSize);
+				pcap->CorruptedFrames(fileReading.corruptedFrames);
+				this->_filereadings.push_back(pcap);
+				continue;
+			}
+			LOG_DEBUG("Adding new file to read on multiple threads: " + file);
+			threads::parallelfilereading * pfr = new threads::parallelfilereading(file, fileReading);
+			pfr->Filter(configuration::Instance()->fileFilter(file));
+			this->_parallelFileReadings.push_back(pfr);
+		}
+	} else {
+		const fileCheckpointStruct & checkpoint = configuration::Instance()->fileCheckpoint;
+		if (checkpoint.enabled) {
+			this->_fileCheckpoint = new utils::fileCheckpoint(checkpoint.file, checkpoint.interval);
+			if (!this->_fileCheckpoint->load()) {
+				LOG_ERROR("Files will be read from the start");
+			}
+		}
+		for (const string & file: configuration::Instance()->filesToRead) {
+			LOG_DEBUG("Adding new file to read: " + file);
+			threads::filereading * pcap = new threads::filereading(file, configuration::Instance()->fileFilter(file));
+			pcap->BatchSize(configuration::Instance()->captureBatchSize);
+			pcap->Replay(fileReading.replaySpeed, fileReading.replayRate, fileReading.replayLoop);
+			pcap->Checkpoint(this->_fileCheckpoint);
+			pcap->CorruptedFrames(fileReading.corruptedFrames);
+			this->_filereadings.push_back(pcap);
+		}
+	}
+
+	// Files appearing in a directory
+	if (configuration::Instance()->directoryWatch.enabled) {
+		LOG_DEBUG("Adding directory watch: " + configuration::Instance()->directoryWatch.directory);
+		this->_directoryWatching = new threads::directorywatching(configuration::Instance()->directoryWatch);
+		this->_directoryWatching->Filter(configuration::Instance()->fileFilter(configuration::Instance()->directoryWatch.directory));
+		this->_directoryWatching->Persistent(configuration::Instance()->persistentQueue.enabled);
 	}
 
 	// Ouput PCAP Prefix
@@ -61,14 +113,27 @@ wifibeat::threadManager::threadManager(const string & pcapPrefix) : _decryption(
 		}
 
 		LOG_DEBUG("Adding new live capture: " + kv.first + " (with filter: " + filter + ")" );
-		this->_captures.push_back(new threads::capture(kv.first, filter));
+		threads::capture * cap = new threads::capture(kv.first, filter);
+		cap->BatchSize(configuration::Instance()->captureBatchSize);
+		cap->Source(this->_captures.size() + 1);
+		cap->CorruptedFrames(configuration::Instance()->corruptedFrames);
+		cap->Settings(configuration::Instance()->interfaceSetting(kv.first));
+		this->_captures.push_back(cap);
 
 		if (prefix.empty() == false) {
 			LOG_DEBUG("Adding new File writer for interface <" + kv.first + ">");
-			this->_filewriters.push_back(new threads::filewriting(kv.first, prefix));
+			threads::filewriting * fw = new threads::filewriting(kv.first, prefix);
+			fw->Index(configuration::Instance()->PCAPOutput.index);
+			this->_filewriters.push_back(fw);
 		}
 	}
 
+	// Capture engine: reads all the interfaces from a single thread
+	this->_captureEngine = new threads::captureEngine(configuration::Instance()->captureBatchSize);
+	for (threads::capture * cap: this->_captures) {
+		this->_captureEngine->addSource(cap);
+	}
+
 	// Hopper
 	for (auto & kv : configuration::Instance()->channelHopping) {
 		LOG_DEBUG("Adding new hopper on " + kv.first);
@@ -76,10 +141,22 @@ wifibeat::threadManager::threadManager(const string & pcapPrefix) : _decryption(
 		this->_hoppers.push_back(hop);
 	}
 
+	// Frames from the interfaces put back in capture time order
+	if (configuration::Instance()->reorder.enabled && !this->_captures.empty()) {
+		LOG_DEBUG("Adding reordering");
+		this->_reordering = new threads::reordering(configuration::Instance()->reorder);
+	}
+
+	// Copies of a frame captured by several interfaces dropped
+	if (configuration::Instance()->dedup.enabled && this->_captures.size() > 1) {
+		LOG_DEBUG("Adding deduplication");
+		this->_deduplication = new threads::deduplication(configuration::Instance()->dedup);
+	}
+
 	// Persistence
 	LOG_DEBUG("Adding persistence");
 	LOG_DEBUG("Note: It will do just passthrough if disabled");
-	this->_persistence = new threads::persistence();
+	this->_persistence = new threads::persistence(configuration::Instance()->persistentQueue);
 
 	// Decryption
 	if (configuration::Instance()->decryptionKeys.size() != 0) {
@@ -97,6 +174,10 @@ wifibeat::threadManager::threadManager(const string & pcapPrefix) : _decryption(
 		}
 		LOG_DEBUG(ss.str());
 		threads::elasticsearch * es = new threads::elasticsearch(conn);
+		if (this->_persistence->Enabled()) {
+			// Frames are removed from the persistent queue once all outputs are done with them
+			es->Persistence(this->_persistence, this->_persistence->addOutput());
+		}
 		this->_elasticsearches.push_back(es);
 	}
 
@@ -121,9 +202,19 @@ wifibeat::threadManager::~threadManager()
 	this->stop();
 
 	wifibeat::utils::Locker * l = new wifibeat::utils::Locker(&this->_mutex); // Avoid tsan complaining of race condition
+	delete this->_captureEngine;
+	delete this->_fileMerging;
+	delete this->_directoryWatching;
+	for (threads::parallelfilereading * pfr: this->_parallelFileReadings) {
+		delete pfr;
+	}
+	for (threads::indexedfilereading * ifr: this->_indexedFileReadings) {
+		delete ifr;
+	}
 	for (threads::filereading * fr: this->_filereadings) {
 		delete fr;
 	}
+	delete this->_fileCheckpoint;
 	for (threads::capture * cap: this->_captures) {
 		delete cap;
 	}
@@ -133,6 +224,8 @@ wifibeat::threadManager::~threadManager()
 	for (threads::hopper * hop: this->_hoppers) {
 		delete hop;
 	}
+	delete _reordering;
+	delete _deduplication;
 	delete _decryption;
 	for (threads::elasticsearch * es: this->_elasticsearches) {
 		delete es;
@@ -187,6 +280,18 @@ bool wifibeat::threadManager::start()
 		return false;
 	}
 
+	// Deduplication
+	if (this->_deduplication && !this->_deduplication->start()) {
+		LOG_ERROR("Failed starting deduplication thread");
+		return false;
+	}
+
+	// Reordering
+	if (this->_reordering && !this->_reordering->start()) {
+		LOG_ERROR("Failed starting reordering thread");
+		return false;
+	}
+
 	// Hoppers
 	for (threads::hopper * hop: this->_hoppers) {
 		if (!hop->start()) {
@@ -205,24 +310,51 @@ bool wifibeat::threadManager::start()
 		}
 	}
 
-	// Capture threads
-	for (threads::capture * cap: this->_captures) {
-		if (!cap->start()) {
-			ss << "Failed starting " << cap->toString();
+	// Merged files
+	if (this->_fileMerging && !this->_fileMerging->start()) {
+		LOG_ERROR("Failed starting file merging thread");
+		return false;
+	}
+
+	// Files, each on its own thread so that waiting for a full queue doesn't stall the others
+	for (threads::filereading * fr: this->_filereadings) {
+		if (!fr->start()) {
+			ss << "Failed starting " << fr->toString();
 			LOG_ERROR(ss.str());
 			return false;
 		}
 	}
 
-	// Files to read
-	for (threads::filereading * fr: this->_filereadings) {
-		if (!fr->start()) {
-			ss << "Failed initializing " << fr->toString();
+	// Watched directory
+	if (this->_directoryWatching && !this->_directoryWatching->start()) {
+		LOG_ERROR("Failed starting directory watch thread");
+		return false;
+	}
+
+	// Files read on multiple threads
+	for (threads::parallelfilereading * pfr: this->_parallelFileReadings) {
+		if (!pfr->start()) {
+			ss << "Failed starting " << pfr->toString();
 			LOG_ERROR(ss.str());
 			return false;
 		}
 	}
 
+	// Parts of files, read with their index
+	for (threads::indexedfilereading * ifr: this->_indexedFileReadings) {
+		if (!ifr->start()) {
+			ss << "Failed starting " << ifr->toString();
+			LOG_ERROR(ss.str());
+			return false;
+		}
+	}
+
+	// Capture engine (interfaces)
+	if (!this->_captureEngine->start()) {
+		LOG_ERROR("Failed starting capture engine");
+		return false;
+	}
+
 	return true;
 }
 
@@ -245,11 +377,17 @@ bool wifibeat::threadManager::stop()
 	LOG_DEBUG("threadManager stop");
 
 	// Stop all threads cleanly
+	this->stopWait(this->_captureEngine);
+	this->stopWait(this->_fileMerging);
+	this->stopWait(this->_directoryWatching);
 	for (threads::filereading * fr: this->_filereadings) {
 		this->stopWait(fr);
 	}
-	for (threads::capture * cap: this->_captures) {
-		this->stopWait(cap);
+	for (threads::parallelfilereading * pfr: this->_parallelFileReadings) {
+		this->stopWait(pfr);
+	}
+	for (threads::indexedfilereading * ifr: this->_indexedFileReadings) {
+		this->stopWait(ifr);
 	}
 	for (threads::filewriting * fw: this->_filewriters) {
 		this->stopWait(fw);
@@ -257,6 +395,8 @@ bool wifibeat::threadManager::stop()
 	for (threads::hopper * hop: this->_hoppers) {
 		this->stopWait(hop);
 	}
+	this->stopWait(this->_reordering, true);
+	this->stopWait(this->_deduplication, true);
 	this->stopWait(this->_decryption, true);
 	for (threads::elasticsearch * es: this->_elasticsearches) {
 		this->stopWait(es, true);
@@ -265,6 +405,9 @@ bool wifibeat::threadManager::stop()
 		this->stopWait(ls, true);
 	}
 	this->stopWait(this->_persistence, true);
+	if (this->_fileCheckpoint) {
+		this->_fileCheckpoint->save();
+	}
 	return true;
 }
 
@@ -293,6 +436,45 @@ bool wifibeat::threadManager::init()
 		}
 	}
 
+	// Merged files
+	if (this->_fileMerging && !this->_fileMerging->init(1)) {
+		ss << "Failed initializing " << this->_fileMerging->toString();
+		LOG_ERROR(ss.str());
+		return false;
+	}
+
+	// Files read on multiple threads
+	for (threads::parallelfilereading * pfr: this->_parallelFileReadings) {
+		if (!pfr->init(1)) {
+			ss << "Failed initializing " << pfr->toString();
+			LOG_ERROR(ss.str());
+			return false;
+		}
+	}
+
+	// Parts of files, read with their index (built here if needed)
+	for (threads::indexedfilereading * ifr: this->_indexedFileReadings) {
+		if (!ifr->init(1)) {
+			ss << "Failed initializing " << ifr->toString();
+			LOG_ERROR(ss.str());
+			return false;
+		}
+	}
+
+	// Watched directory
+	if (this->_directoryWatching && !this->_directoryWatching->init(1)) {
+		ss << "Failed initializing " << this->_directoryWatching->toString();
+		LOG_ERROR(ss.str());
+		return false;
+	}
+
+	// Capture engine, once the interfaces are opened.
+	// No sleep between loops, it waits on the interfaces.
+	if (!this->_captureEngine->init(0)) {
+		LOG_ERROR("Failed initializing capture engine");
+		return false;
+	}
+
 	// File writing
 	for (threads::filewriting * fw: this->_filewriters) {
 		if (!fw->init(100)) {
@@ -317,6 +499,18 @@ bool wifibeat::threadManager::init()
 		return false;
 	}
 
+	// Reordering
+	if (this->_reordering && !this->_reordering->init(100)) {
+		LOG_ERROR("Failed initializing reordering thread");
+		return false;
+	}
+
+	// Deduplication
+	if (this->_deduplication && !this->_deduplication->init(100)) {
+		LOG_ERROR("Failed initializing deduplication thread");
+		return false;
+	}
+
 	// Decryption
 	if (this->_decryption && !this->_decryption->init()) {
 		LOG_ERROR("Failed initializing decryption thread");
@@ -343,11 +537,28 @@ bool wifibeat::threadManager::init()
 
 	// 2. Link them together
 	LOG_DEBUG("threadManager: linking all thread's queues together");
+	// Live frames go to persistence, through reordering and deduplication if enabled
+	ThreadWithQueue<PacketTimestamp> * live = this->_persistence;
+	if (this->_deduplication) {
+		if (!this->_deduplication->AddNextThread(live)) {
+			LOG_ERROR("Failed linking deduplication to persistence thread's queue");
+			return false;
+		}
+		live = this->_deduplication;
+	}
+	if (this->_reordering) {
+		if (!this->_reordering->AddNextThread(live)) {
+			ss << "Failed linking reordering to " << live->Name() << " thread's queue";
+			LOG_ERROR(ss.str());
+			return false;
+		}
+		live = this->_reordering;
+	}
 	if (this->_filewriters.size() == 0) {
 		// Directly linking to persistence
 		for (threads::capture * cap: this->_captures) {
-			if (!cap->AddNextThread(this->_persistence)) {
-				ss << "Failed linking " << cap->toString() << " to persistence thread's queue";
+			if (!cap->AddNextThread(live)) {
+				ss << "Failed linking " << cap->toString() << " to " << live->Name() << " thread's queue";
 				LOG_ERROR(ss.str());
 				return false;
 			}
@@ -369,18 +580,45 @@ bool wifibeat::threadManager::init()
 
 		// Then linking all filewriting to persistence
 		for (threads::filewriting * fw: this->_filewriters) {
-			if (!fw->AddNextThread(this->_persistence)) {
-				ss << "Failed linking " << fw->toString() << " to persistence thread's queue";
+			if (!fw->AddNextThread(live)) {
+				ss << "Failed linking " << fw->toString() << " to " << live->Name() << " thread's queue";
 				LOG_ERROR(ss.str());
 				return false;
 			}
 		}
 	} 
 
+	// Files, read one by one, merged or on multiple threads. With a checkpoint, frames go
+	// through the persistent queue: positions are saved once the outputs acknowledged them.
+	vector<ThreadWithQueue<PacketTimestamp> *> files;
+	for (threads::filereading * fr: this->_filereadings) {
+		if (this->_fileCheckpoint == NULL) {
+			files.push_back(fr);
+		} else if (!fr->AddNextThread(this->_persistence)) {
+			ss << "Failed linking " << fr->toString() << " to persistence thread's queue";
+			LOG_ERROR(ss.str());
+			return false;
+		}
+	}
+	if (this->_fileMerging) {
+		files.push_back(this->_fileMerging);
+	}
+	files.insert(files.end(), this->_parallelFileReadings.begin(), this->_parallelFileReadings.end());
+	files.insert(files.end(), this->_indexedFileReadings.begin(), this->_indexedFileReadings.end());
+	if (this->_directoryWatching) {
+		if (!configuration::Instance()->persistentQueue.enabled) {
+			files.push_back(this->_directoryWatching);
+		} else if (!this->_directoryWatching->AddNextThread(this->_persistence)) {
+			ss << "Failed linking " << this->_directoryWatching->toString() << " to persistence thread's queue";
+			LOG_ERROR(ss.str());
+			return false;
+		}
+	}
+
 	// Different depending on if decryption is required
 	if (this->_decryption) {
 		// Files don't need persistence, they are already on disk
-		for (threads::filereading * fr: this->_filereadings) {
+		for (ThreadWithQueue<PacketTimestamp> * fr: files) {
 			if (!fr->AddNextThread(this->_decryption)) {
 				ss << "Failed linking " << fr->toString() << " to decryption thread's queue";
 				LOG_ERROR(ss.str());
@@ -410,7 +648,7 @@ bool wifibeat::threadManager::init()
 		// No decryption
 		for (threads::elasticsearch * es: this->_elasticsearches) {
 			// Files don't need persistence, they are already on disk
-			for (threads::filereading * fr: this->_filereadings) {
+			for (ThreadWithQueue<PacketTimestamp> * fr: files) {
 				if (!fr->AddNextThread(es)) {
 					ss << "Failed linking " << fr->toString() << " to " << es->toString() << " thread's queue";
 					LOG_ERROR(ss.str());
@@ -426,7 +664,7 @@ bool wifibeat::threadManager::init()
 		}
 		for (threads::logstash * ls: this->_logstashes) {
 			// Files don't need persistence, they are already on disk
-			for (threads::filereading * fr: this->_filereadings) {
+			for (ThreadWithQueue<PacketTimestamp> * fr: files) {
 				if (!fr->AddNextThread(ls)) {
 					ss << "Failed linking " << fr->toString() << " to " << ls->toString() << " thread's queue";
 					LOG_ERROR(ss.str());
@@ -451,15 +689,36 @@ bool wifibeat::threadManager::canStop()
 	// And all persistence threads
 	threadStatus ts;
 	wifibeat::utils::Locker l(&this->_mutex); // Avoid tsan complaining of race condition
+	ts = this->_captureEngine->Status();
+	if (ts == Starting || ts == Started || ts == Running) {
+		return false;
+	}
+	if (this->_fileMerging) {
+		ts = this->_fileMerging->Status();
+		if (ts == Starting || ts == Started || ts == Running) {
+			return false;
+		}
+	}
+	for (threads::parallelfilereading * pfr: this->_parallelFileReadings) {
+		ts = pfr->Status();
+		if (ts == Starting || ts == Started || ts == Running) {
+			return false;
+		}
+	}
+	for (threads::indexedfilereading * ifr: this->_indexedFileReadings) {
+		ts = ifr->Status();
+		if (ts == Starting || ts == Started || ts == Running) {
+			return false;
+		}
+	}
 	for (threads::filereading * fr: this->_filereadings) {
 		ts = fr->Status();
 		if (ts == Starting || ts == Started || ts == Running) {
 			return false;
 		}
 	}
-
-	for (threads::capture * cap: this->_captures) {
-		ts = cap->Status();
+	if (this->_directoryWatching) {
+		ts = this->_directoryWatching->Status();
 		if (ts == Starting || ts == Started || ts == Running) {
 			return false;
 		}
@@ -20,12 +20,19 @@
 #define THREADMANAGER_H
 
 #include "threads/capture.h"
+#include "threads/captureEngine.h"
 #include "threads/decryption.h"
 #include "threads/elasticsearch.h"
 #include "threads/filereading.h"
+#include "threads/filemerging.h"
+#include "threads/directorywatching.h"
+#include "threads/parallelfilereading.h"
+#include "threads/indexedfilereading.h"
 #include "threads/hopper.h"
 #include "threads/logstash.h"
 #include "threads/persistence.h"
+#include "threads/reordering.h"
+#include "threads/deduplication.h"
 #include "threads/filewriting.h"
 #include <pthread.h>
 
@@ -38,8 +45,16 @@ namespace wifibeat
 			vector<threads::hopper *> _hoppers;
 			vector<threads::capture *> _captures;
 			vector<threads::filereading *> _filereadings;
+			threads::filemerging * _fileMerging;
+			vector<threads::parallelfilereading *> _parallelFileReadings;
+			vector<threads::indexedfilereading *> _indexedFileReadings;
+			threads::directorywatching * _directoryWatching;
+			utils::fileCheckpoint * _fileCheckpoint;
+			threads::captureEngine * _captureEngine;
 			vector<threads::elasticsearch *> _elasticsearches;
 			vector<threads::logstash *> _logstashes;
+			threads::reordering * _reordering;
+			threads::deduplication * _deduplication;
 			threads::decryption * _decryption;
 			threads::persistence * _persistence;
 			vector<threads::filewriting *> _filewriters;
@@ -20,40 +20,57 @@
 #include "utils/wifi.h"
 #include "utils/logger.h"
 #include <exception>
+#include <poll.h>
+#include <string.h>
 #include <sstream>
 
 using std::stringstream;
 using std::exception;
 
 wifibeat::threads::capture::capture(const string & interface, const string & filter)
-	: _interface(interface), _filter(filter), _sniffer(NULL), _pcapFd(-1), _string("")
+	: _interface(interface), _filter(filter), _sniffer(NULL), _pcapFd(-1),
+		_batchSize(_WIFIBEAT_CAPTURE_DEFAULT_BATCH_SIZE), _source(0), _bufferSize(0), _kernelReceived(0),
+		_kernelDropped(0), _interfaceDropped(0), _lastKernelDropped(0), _string("")
 {
 	this->Name("capture");
+	memset(&this->_stats, 0, sizeof(this->_stats));
 }
 
 wifibeat::threads::capture::~capture()
 {
 	delete this->_sniffer;
+
+	if (this->_frames) {
+		stringstream ss;
+		ss << "Done capturing on <" << this->_interface << ">: " << this->Statistics() << " - kernel: "
+			<< this->KernelReceived() << " received, " << this->KernelDropped() << " dropped, "
+			<< this->InterfaceDropped() << " dropped by the interface";
+		LOG_NOTICE(ss.str());
+	}
 }
 
 void wifibeat::threads::capture::recurring()
 {
-	// Initialize structures
-	FD_ZERO(&(this->_fdSet));
-	FD_SET(this->_pcapFd, &(this->_fdSet));
-	this->_tv.tv_sec = 0;
-	this->_tv.tv_usec = 1;
-
-	// Check if there is data to read
-	if (select (FD_SETSIZE, &this->_fdSet, NULL, NULL, &this->_tv) < 1) {
-		return;
+	// Only used when the interface isn't handled by the capture engine.
+	// Wait for the descriptor, then drain up to a batch of frames at once.
+	struct pollfd pfd = { this->_pcapFd, POLLIN, 0 };
+	if (poll(&pfd, 1, 100) > 0) {
+		this->dispatch(this->_batchSize);
 	}
+	this->pollStatistics();
+}
 
-	// Get packet
-	//Tins::PtrPacket packet();
-	Tins::PDU * packet = this->_sniffer->next_packet();
-	PacketTimestamp * pts = new PacketTimestamp(packet);
-	this->sendToNextThreadsQueue(pts);
+bool wifibeat::threads::capture::frame(const struct pcap_pkthdr * header, const u_char * data)
+{
+	// Keep the raw frame and the capture time from the pcap header.
+	// Dissection happens later, in the thread that needs it.
+	struct timespec ts = { header->ts.tv_sec, header->ts.tv_usec * 1000 };
+	PacketTimestamp * pts = new PacketTimestamp(data, header->caplen, this->_linkType, ts);
+	pts->Source(this->_source);
+	if (header->len > header->caplen) {
+		pts->WireLength(header->len);
+	}
+	return this->sendToNextThreadsQueue(pts);
 }
 
 bool wifibeat::threads::capture::init_function()
@@ -80,11 +97,31 @@ bool wifibeat::threads::capture::init_function()
 		return false;
 	}
 
-	// Configure sniffer
+	this->_bufferSize = this->_settings.bufferSize;
+	this->_lastPoll = std::chrono::steady_clock::now();
+	return this->open();
+}
+
+bool wifibeat::threads::capture::open()
+{
+	stringstream ss;
+
+	// Configure sniffer. Buffer size, snaplen and timeout can only be set
+	// before the handle is activated: growing the buffer means reopening.
 	Tins::SnifferConfiguration snifferConfig;
-	// https://github.com/mfontanini/libtins/issues/41
-	//snifferConfig.set_timeout(1);
-	snifferConfig.set_immediate_mode(true);
+	if (this->_settings.timeout.count()) {
+		// Frames are delivered a block at a time: fewer wakeups, more latency
+		snifferConfig.set_timeout(static_cast<unsigned int>(this->_settings.timeout.count()));
+	} else {
+		// https://github.com/mfontanini/libtins/issues/41
+		snifferConfig.set_immediate_mode(true);
+	}
+	if (this->_bufferSize) {
+		snifferConfig.set_buffer_size(this->_bufferSize);
+	}
+	if (this->_settings.snaplen) {
+		snifferConfig.set_snap_len(this->_settings.snaplen);
+	}
 
 	// Add filter
 	if (!this->_filter.empty()) {
@@ -107,9 +144,9 @@ bool wifibeat::threads::capture::init_function()
 	//this->_sniffer->set_extract_raw_pdus(true); 
 
 	try {
-		// Get handle so we can use select to know if there is a packet available
-		pcap_t * pcap_handle = this->_sniffer->get_pcap_handle();
-		this->_pcapFd = pcap_get_selectable_fd(pcap_handle);
+		// Get handle so we can poll to know if there are packets available
+		this->_pcapHandle = this->_sniffer->get_pcap_handle();
+		this->_pcapFd = pcap_get_selectable_fd(this->_pcapHandle);
 	} catch (const exception & e) {
 		ss << "Failed obtaining PCAP handle on sniffer for " << this->_interface << ": " << e.what();
 		LOG_CRITICAL(ss.str());
@@ -123,14 +160,94 @@ bool wifibeat::threads::capture::init_function()
 		LOG_CRITICAL(ss.str());
 		delete this->_sniffer;
 		this->_sniffer = NULL;
+		this->_pcapHandle = NULL;
+		this->_pcapFd = -1;
+		return false;
+	}
+	this->_linkType = linktype;
+
+	// pcap_dispatch() must return as soon as the ring buffer is empty
+	char errbuf[PCAP_ERRBUF_SIZE];
+	if (this->_pcapFd == -1 || pcap_setnonblock(this->_pcapHandle, 1, errbuf) == PCAP_ERROR) {
+		ss << "Failed setting <" << this->_interface << "> in non-blocking mode";
+		LOG_CRITICAL(ss.str());
+		delete this->_sniffer;
+		this->_sniffer = NULL;
+		this->_pcapHandle = NULL;
+		this->_pcapFd = -1;
 		return false;
 	}
 
 	LOG_NOTICE("Link type on <" + this->_interface + ">: " + std::to_string(linktype));
+	if (this->_bufferSize) {
+		LOG_NOTICE("Buffer size on <" + this->_interface + ">: " + std::to_string(this->_bufferSize / 1024) + "KB");
+	}
 
 	return true;
 }
 
+bool wifibeat::threads::capture::reopen(unsigned int bufferSize)
+{
+	// Whatever is left in the old buffer, frames arriving meanwhile are lost
+	for (int i = 0; i < 1000 && this->dispatch(this->_batchSize) > 0; ++i);
+
+	this->_kernelReceived += this->_stats.ps_recv;
+	this->_kernelDropped += this->_stats.ps_drop;
+	this->_interfaceDropped += this->_stats.ps_ifdrop;
+	memset(&this->_stats, 0, sizeof(this->_stats));
+
+	delete this->_sniffer;
+	this->_sniffer = NULL;
+	this->_pcapHandle = NULL;
+	this->_pcapFd = -1;
+
+	this->_bufferSize = bufferSize;
+	return this->open();
+}
+
+bool wifibeat::threads::capture::pollStatistics()
+{
+	if (this->_pcapHandle == NULL) {
+		return false;
+	}
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - this->_lastPoll < std::chrono::milliseconds(_WIFIBEAT_CAPTURE_STATS_INTERVAL_MS)) {
+		return false;
+	}
+	this->_lastPoll = now;
+
+	// Counters are since the handle was opened
+	struct pcap_stat stats;
+	if (pcap_stats(this->_pcapHandle, &stats) == PCAP_ERROR) {
+		LOG_DEBUG("Failed getting statistics of <" + this->_interface + ">: " + pcap_geterr(this->_pcapHandle));
+		return false;
+	}
+	this->_stats = stats;
+
+	unsigned long long int dropped = this->KernelDropped();
+	if (dropped == this->_lastKernelDropped) {
+		return false;
+	}
+	stringstream ss;
+	ss << "Kernel dropped " << dropped - this->_lastKernelDropped << " frames on <" << this->_interface << "> ("
+		<< dropped << " out of " << this->KernelReceived() << " so far)";
+	this->_lastKernelDropped = dropped;
+
+	unsigned int current = (this->_bufferSize) ? this->_bufferSize : _WIFIBEAT_CAPTURE_DEFAULT_BUFFER_SIZE;
+	if (!this->_settings.autoTune || current >= this->_settings.maxBufferSize) {
+		LOG_WARN(ss.str());
+		return false;
+	}
+
+	unsigned int size = (current > this->_settings.maxBufferSize / 2) ? this->_settings.maxBufferSize : current * 2;
+	ss << ", growing its buffer to " << size / 1024 << "KB";
+	LOG_WARN(ss.str());
+	if (!this->reopen(size)) {
+		LOG_CRITICAL("Failed reopening <" + this->_interface + ">, it isn't captured anymore");
+	}
+	return true;
+}
+
 string wifibeat::threads::capture::toString()
 {
 	if (this->_interface.empty()) {
@@ -155,3 +272,38 @@ string wifibeat::threads::capture::Interface()
 {
 	return this->_interface;
 }
+
+void wifibeat::threads::capture::BatchSize(int size)
+{
+	this->_batchSize = (size > 0) ? size : _WIFIBEAT_CAPTURE_DEFAULT_BATCH_SIZE;
+}
+
+void wifibeat::threads::capture::Source(unsigned int source)
+{
+	this->_source = source;
+}
+
+int wifibeat::threads::capture::SelectableFd()
+{
+	return this->_pcapFd;
+}
+
+void wifibeat::threads::capture::Settings(const interfaceCaptureStruct & settings)
+{
+	this->_settings = settings;
+}
+
+unsigned long long int wifibeat::threads::capture::KernelReceived()
+{
+	return this->_kernelReceived + this->_stats.ps_recv;
+}
+
+unsigned long long int wifibeat::threads::capture::KernelDropped()
+{
+	return this->_kernelDropped + this->_stats.ps_drop;
+}
+
+unsigned long long int wifibeat::threads::capture::InterfaceDropped()
+{
+	return this->_interfaceDropped + this->_stats.ps_ifdrop;
+}
@@ -21,31 +21,67 @@
 
 #include "ThreadWithQueue.h"
 #include "PacketTimestamp.h"
+#include "captureSource.h"
+#include "config/configstructs.h"
 #include <tins/sniffer.h>
+#include <chrono>
 #include <time.h>
 
+// pcap_stats() is polled that often
+#define _WIFIBEAT_CAPTURE_STATS_INTERVAL_MS 1000
+
+// libpcap's buffer when none is set, the first auto tune step doubles it
+#define _WIFIBEAT_CAPTURE_DEFAULT_BUFFER_SIZE (2 * 1024 * 1024)
+
 namespace wifibeat
 {
 	namespace threads
 	{
-		class capture : public ThreadWithQueue<PacketTimestamp>
+		class capture : public ThreadWithQueue<PacketTimestamp>, public captureSource
 		{
 			private:
 				string _interface;
 				string _filter;
 
 				Tins::Sniffer * _sniffer;
-
 				int _pcapFd;
-				fd_set _fdSet;
-				struct timeval _tv;
+				int _batchSize;
+				unsigned int _source;
+				interfaceCaptureStruct _settings;
+				unsigned int _bufferSize; // Current one, grows with auto tune
+
+				// Kernel counters of the current handle, and of the ones closed by auto tune
+				struct pcap_stat _stats;
+				unsigned long long int _kernelReceived;
+				unsigned long long int _kernelDropped;
+				unsigned long long int _interfaceDropped;
+				unsigned long long int _lastKernelDropped;
+				std::chrono::steady_clock::time_point _lastPoll;
 
 				string _string;
 
+				bool open();
+				bool reopen(unsigned int bufferSize);
+
+			protected:
+				virtual bool frame(const struct pcap_pkthdr * header, const u_char * data);
+
 			public:
 				capture(const string & interface, const string & filter);
 				~capture();
 				string Interface();
+				void BatchSize(int size);
+
+				// Frames are tagged with it, to tell which interface captured them. Above 0.
+				void Source(unsigned int source);
+				void Settings(const interfaceCaptureStruct & settings);
+				virtual int SelectableFd();
+				virtual bool pollStatistics();
+
+				// Totals from pcap_stats(), since the interface was first opened
+				unsigned long long int KernelReceived();
+				unsigned long long int KernelDropped(); // No room in the buffer
+				unsigned long long int InterfaceDropped(); // By the driver or the card
 
 				virtual string toString();
 				virtual void recurring();
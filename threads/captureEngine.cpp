@@ -0,0 +1,182 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "captureEngine.h"
+#include "utils/logger.h"
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <sstream>
+
+#define _WIFIBEAT_CAPTURE_ENGINE_MAX_EVENTS 32
+#define _WIFIBEAT_CAPTURE_ENGINE_TIMEOUT_MS 100
+
+using std::stringstream;
+
+wifibeat::threads::captureEngine::captureEngine(int batchSize)
+	: _epollFd(-1), _batchSize(batchSize > 0 ? batchSize : _WIFIBEAT_CAPTURE_DEFAULT_BATCH_SIZE), _active(0)
+{
+	this->Name("capture engine");
+}
+
+wifibeat::threads::captureEngine::~captureEngine()
+{
+	if (this->_epollFd != -1) {
+		close(this->_epollFd);
+	}
+}
+
+void wifibeat::threads::captureEngine::addSource(captureSource * source)
+{
+	if (source) {
+		this->_sources.push_back(source);
+	}
+}
+
+size_t wifibeat::threads::captureEngine::Sources()
+{
+	return this->_sources.size();
+}
+
+bool wifibeat::threads::captureEngine::init_function()
+{
+	if (this->_epollFd != -1) {
+		return true;
+	}
+
+	this->_epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (this->_epollFd == -1) {
+		LOG_CRITICAL(string("Failed creating epoll instance: ") + strerror(errno));
+		return false;
+	}
+
+	this->_alwaysReady.clear();
+	this->_polled.clear();
+	for (captureSource * source : this->_sources) {
+		if (source->SelectableFd() == -1) {
+			this->_alwaysReady.push_back(source);
+			continue;
+		}
+		if (!this->watch(source)) {
+			close(this->_epollFd);
+			this->_epollFd = -1;
+			return false;
+		}
+		this->_polled.push_back(source);
+	}
+	this->_active = this->_sources.size();
+
+	stringstream ss;
+	ss << "Capture engine reading " << this->_sources.size() << " source(s), up to " << this->_batchSize << " frames per read";
+	LOG_NOTICE(ss.str());
+
+	return true;
+}
+
+bool wifibeat::threads::captureEngine::watch(captureSource * source)
+{
+	// Level-triggered: a source that still has frames after its batch
+	// is reported again on the next wait, after the other ones got their turn.
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = source;
+	if (epoll_ctl(this->_epollFd, EPOLL_CTL_ADD, source->SelectableFd(), &event) == -1) {
+		LOG_CRITICAL("Failed adding " + source->toString() + " to the capture engine: " + strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+void wifibeat::threads::captureEngine::remove(captureSource * source)
+{
+	int fd = source->SelectableFd();
+	if (fd == -1) {
+		this->_alwaysReady.erase(std::remove(this->_alwaysReady.begin(), this->_alwaysReady.end(), source), this->_alwaysReady.end());
+	} else {
+		epoll_ctl(this->_epollFd, EPOLL_CTL_DEL, fd, NULL);
+	}
+	this->_polled.erase(std::remove(this->_polled.begin(), this->_polled.end(), source), this->_polled.end());
+	--this->_active;
+
+	stringstream ss;
+	ss << "Done reading " << source->toString() << ": " << source->Statistics();
+	LOG_NOTICE(ss.str());
+}
+
+void wifibeat::threads::captureEngine::recurring()
+{
+	if (this->_active == 0) {
+		this->ThreadFinished();
+		return;
+	}
+
+	// Don't block when there are files to read
+	int timeout = (this->_alwaysReady.empty()) ? _WIFIBEAT_CAPTURE_ENGINE_TIMEOUT_MS : 0;
+	struct epoll_event events[_WIFIBEAT_CAPTURE_ENGINE_MAX_EVENTS];
+	int nbEvents = epoll_wait(this->_epollFd, events, _WIFIBEAT_CAPTURE_ENGINE_MAX_EVENTS, timeout);
+	if (nbEvents == -1) {
+		if (errno != EINTR) {
+			LOG_ERROR(string("Failed waiting on capture sources: ") + strerror(errno));
+		}
+		return;
+	}
+
+	for (int i = 0; i < nbEvents; ++i) {
+		captureSource * source = reinterpret_cast<captureSource *>(events[i].data.ptr);
+		if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+			LOG_ERROR("Capture source " + source->toString() + " is gone");
+			this->remove(source);
+			continue;
+		}
+		if (source->dispatch(this->_batchSize) == -1) {
+			this->remove(source);
+		}
+	}
+
+	// Kernel statistics. A source reopened with a larger buffer has a new
+	// descriptor, the old one was removed from epoll when it got closed.
+	for (size_t i = 0; i < this->_polled.size();) {
+		captureSource * source = this->_polled[i];
+		if (source->pollStatistics() && (source->SelectableFd() == -1 || !this->watch(source))) {
+			LOG_ERROR("Capture source " + source->toString() + " is gone");
+			this->remove(source);
+			continue;
+		}
+		++i;
+	}
+
+	// Files: a batch each, until they are done
+	for (size_t i = 0; i < this->_alwaysReady.size();) {
+		captureSource * source = this->_alwaysReady[i];
+		if (source->dispatch(this->_batchSize) <= 0) {
+			this->remove(source);
+			continue;
+		}
+		++i;
+	}
+}
+
+string wifibeat::threads::captureEngine::toString()
+{
+	stringstream ss;
+	ss << "Capture engine - " << this->_sources.size() << " source(s), batch size " << this->_batchSize;
+	return ss.str();
+}
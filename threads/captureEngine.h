@@ -0,0 +1,68 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef THREAD_CAPTUREENGINE_H
+#define THREAD_CAPTUREENGINE_H
+
+#include "ThreadWithQueue.h"
+#include "PacketTimestamp.h"
+#include "captureSource.h"
+#include <vector>
+
+using std::vector;
+
+namespace wifibeat
+{
+	namespace threads
+	{
+		// Reads all capture sources from a single thread: waits on every
+		// interface with epoll and drains up to a batch of frames from each
+		// one that is ready. Sources without a descriptor (files, only added
+		// by the capture benchmark) are always considered ready. Frames are
+		// sent to each source's next threads.
+		class captureEngine : public ThreadWithQueue<PacketTimestamp>
+		{
+			private:
+				vector<captureSource *> _sources;
+				vector<captureSource *> _alwaysReady;
+				vector<captureSource *> _polled; // Sources with a descriptor, still read
+				int _epollFd;
+				int _batchSize;
+				unsigned int _active;
+
+				void remove(captureSource * source);
+				bool watch(captureSource * source);
+
+			public:
+				captureEngine(int batchSize = _WIFIBEAT_CAPTURE_DEFAULT_BATCH_SIZE);
+				~captureEngine();
+
+				// Must be called before init()
+				void addSource(captureSource * source);
+				size_t Sources();
+
+				virtual string toString();
+				virtual void recurring();
+				virtual bool init_function();
+		};
+
+	}
+
+}
+
+#endif // THREAD_CAPTUREENGINE_H
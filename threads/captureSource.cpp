@@ -0,0 +1,135 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "captureSource.h"
+#include "utils/logger.h"
+#include "utils/wifi.h"
+#include <sstream>
+
+using std::stringstream;
+
+wifibeat::threads::captureSource::captureSource()
+	: _pcapHandle(NULL), _linkType(0), _frames(0), _dropped(0), _corruptedFrames(CountCorruptedFrames),
+		_badFCS(0), _truncated(0)
+{
+}
+
+wifibeat::threads::captureSource::~captureSource()
+{
+}
+
+void wifibeat::threads::captureSource::handler(u_char * user, const struct pcap_pkthdr * header, const u_char * data)
+{
+	captureSource * source = reinterpret_cast<captureSource *>(user);
+	++source->_frames;
+	if (source->corrupted(source->_linkType, data, header->caplen)) {
+		return;
+	}
+	if (!source->frame(header, data)) {
+		++source->_dropped;
+	}
+}
+
+bool wifibeat::threads::captureSource::corrupted(int linkType, const u_char * data, size_t length)
+{
+	if (this->_corruptedFrames == KeepCorruptedFrames) {
+		return false;
+	}
+
+	switch (wifibeat::utils::wifi::corruption(linkType, data, length)) {
+		case wifibeat::utils::BadFCS:
+			++this->_badFCS;
+			break;
+		case wifibeat::utils::Truncated:
+			++this->_truncated;
+			break;
+		default:
+			return false;
+	}
+	return this->_corruptedFrames == DropCorruptedFrames;
+}
+
+int wifibeat::threads::captureSource::dispatch(int max)
+{
+	if (this->_pcapHandle == NULL) {
+		return -1;
+	}
+
+	// One call (and for live captures, one read of the ring buffer) for the whole batch
+	int ret = pcap_dispatch(this->_pcapHandle, max, &captureSource::handler, reinterpret_cast<u_char *>(this));
+	if (ret == PCAP_ERROR) {
+		LOG_ERROR("Failed reading frames from " + this->toString() + ": " + pcap_geterr(this->_pcapHandle));
+		return -1;
+	}
+	if (ret == PCAP_ERROR_BREAK) {
+		return 0;
+	}
+	return ret;
+}
+
+int wifibeat::threads::captureSource::SelectableFd()
+{
+	return -1;
+}
+
+bool wifibeat::threads::captureSource::pollStatistics()
+{
+	return false;
+}
+
+unsigned long long int wifibeat::threads::captureSource::Frames()
+{
+	return this->_frames;
+}
+
+unsigned long long int wifibeat::threads::captureSource::Dropped()
+{
+	return this->_dropped;
+}
+
+unsigned long long int wifibeat::threads::captureSource::BadFCS()
+{
+	return this->_badFCS;
+}
+
+unsigned long long int wifibeat::threads::captureSource::Truncated()
+{
+	return this->_truncated;
+}
+
+void wifibeat::threads::captureSource::CorruptedFrames(corruptedFramesAction action)
+{
+	this->_corruptedFrames = action;
+}
+
+string wifibeat::threads::captureSource::Statistics()
+{
+	stringstream ss;
+	ss << this->_frames << " frames";
+	if (this->_dropped) {
+		ss << ", " << this->_dropped << " dropped";
+	}
+	string what = (this->_corruptedFrames == DropCorruptedFrames) ? " (dropped)" : "";
+	if (this->_badFCS) {
+		ss << ", " << this->_badFCS << " with a bad FCS" << what;
+	}
+	if (this->_truncated) {
+		ss << ", " << this->_truncated << " truncated" << what;
+	}
+	return ss.str();
+}
@@ -0,0 +1,88 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Frames read in batches with pcap_dispatch, by the source's own thread or by
+// the capture engine (see captureEngine.h).
+#ifndef THREAD_CAPTURESOURCE_H
+#define THREAD_CAPTURESOURCE_H
+
+#include "config/configstructs.h"
+#include <string>
+#include <pcap.h>
+
+using std::string;
+
+#define _WIFIBEAT_CAPTURE_DEFAULT_BATCH_SIZE 64
+
+namespace wifibeat
+{
+	namespace threads
+	{
+		class captureSource
+		{
+			private:
+				static void handler(u_char * user, const struct pcap_pkthdr * header, const u_char * data);
+
+			protected:
+				pcap_t * _pcapHandle;
+				int _linkType;
+				unsigned long long int _frames;
+				unsigned long long int _dropped; // Next thread's queue was full
+				corruptedFramesAction _corruptedFrames;
+				unsigned long long int _badFCS;
+				unsigned long long int _truncated;
+
+				// Called for each frame read by dispatch(). Returns false if it was dropped.
+				virtual bool frame(const struct pcap_pkthdr * header, const u_char * data) = 0;
+
+				// Counts bad FCS and truncated frames, true if the frame has to be dropped.
+				// Only looks at the radiotap flags and the length, nothing is dissected.
+				bool corrupted(int linkType, const u_char * data, size_t length);
+
+			public:
+				captureSource();
+				virtual ~captureSource();
+
+				// Read up to max frames. Returns the amount read, 0 if none were available
+				// (or end of file), -1 on error.
+				virtual int dispatch(int max);
+
+				// Descriptor to wait on, -1 if it is always readable (files)
+				virtual int SelectableFd();
+
+				// Called regularly by whoever dispatches, to poll capture statistics.
+				// Returns true if the source was reopened: its descriptor changed.
+				virtual bool pollStatistics();
+				virtual string toString() = 0;
+
+				void CorruptedFrames(corruptedFramesAction action);
+
+				unsigned long long int Frames();
+				unsigned long long int Dropped();
+				unsigned long long int BadFCS();
+				unsigned long long int Truncated();
+
+				// "x frames, y dropped, ..." - only the counters above 0 after the frames
+				string Statistics();
+		};
+
+	}
+
+}
+
+#endif // THREAD_CAPTURESOURCE_H
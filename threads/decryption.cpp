@@ -50,12 +50,15 @@ void wifibeat::threads::decryption::recurring()
 			Tins::PDU * pdu = item->getPDU();
 
 			// 2. Attempt decryption
-			this->_decrypter.decrypt(*pdu);
+			if (pdu) {
+				this->_decrypter.decrypt(*pdu);
+			}
 		
 		}
 
-		// 3. Put the decrypted packet in the queue
-		this->sendToNextThreadsQueue(item);
+		// 3. Put the decrypted packet in the queue. Wait for the outputs instead of
+		// dropping it so that file sources are slowed down rather than losing frames.
+		this->sendToNextThreadsQueueWaiting(item);
 	}
 }
 
@@ -0,0 +1,194 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "deduplication.h"
+#include "utils/hash.h"
+#include "utils/wifi.h"
+#include "utils/logger.h"
+#include <sstream>
+
+#define _WIFIBEAT_DEDUPLICATION_SEED 0x77696669626561ULL
+
+// Interfaces past 64 share bits, a few copies may then get through
+#define SOURCE_BIT(source) (1ULL << ((source) % 64))
+
+wifibeat::threads::deduplication::deduplication(const dedupStruct & settings)
+	: _settings(settings), _bucket(0), _arrivals(0), _duplicates(0), _lateDuplicates(0), _untracked(0), _early(0), _dropped(0)
+{
+	this->Name("deduplication");
+}
+
+wifibeat::threads::deduplication::~deduplication()
+{
+	for (const dedupHeld & held: this->_held) {
+		delete held.frame;
+	}
+
+	if (this->_arrivals) {
+		stringstream ss;
+		ss << "Deduplication: " << this->_arrivals << " frames, " << this->_duplicates << " duplicates dropped";
+		if (this->_lateDuplicates) {
+			ss << " (" << this->_lateDuplicates << " after the first copy was sent)";
+		}
+		if (this->_untracked) {
+			ss << ", " << this->_untracked << " not checked (" << this->_settings.maxFrames << " frames tracked)";
+		}
+		if (this->_early) {
+			ss << ", " << this->_early << " sent early (" << this->_settings.maxFrames << " frames held)";
+		}
+		if (this->_dropped) {
+			ss << ", " << this->_dropped << " dropped";
+		}
+		LOG_NOTICE(ss.str());
+	}
+}
+
+bool wifibeat::threads::deduplication::allQueuesEmpty()
+{
+	return this->_held.empty() && ThreadWithQueue<PacketTimestamp>::allQueuesEmpty();
+}
+
+void wifibeat::threads::deduplication::send(PacketTimestamp * frame)
+{
+	if (!this->sendToNextThreadsQueueWaiting(frame)) {
+		++this->_dropped;
+	}
+}
+
+void wifibeat::threads::deduplication::hold(PacketTimestamp * frame, uint64_t hash, unsigned long long int arrival, const std::chrono::steady_clock::time_point & now)
+{
+	if (this->_held.size() >= this->_settings.maxFrames) {
+		// Copies of that one arriving later get through
+		++this->_early;
+		this->release(this->_held.front());
+		this->_held.pop_front();
+	}
+	this->_held.push_back({ frame, hash, arrival, now });
+}
+
+void wifibeat::threads::deduplication::release(const dedupHeld & held)
+{
+	if (held.arrival) {
+		for (std::unordered_map<uint64_t, dedupEntry> & bucket: this->_buckets) {
+			std::unordered_map<uint64_t, dedupEntry>::iterator it = bucket.find(held.hash);
+			if (it != bucket.end() && it->second.arrival == held.arrival) {
+				held.frame->Duplicates(it->second.duplicates);
+				it->second.frame = NULL;
+				break;
+			}
+		}
+	}
+	this->send(held.frame);
+}
+
+void wifibeat::threads::deduplication::expire(const std::chrono::steady_clock::time_point & now)
+{
+	// Send the frames once they were held for a window, or all of them when stopping
+	bool stopping = (this->Status() == Stopping);
+	while (!this->_held.empty() && (stopping || now - this->_held.front().received >= this->_settings.window)) {
+		this->release(this->_held.front());
+		this->_held.pop_front();
+	}
+}
+
+void wifibeat::threads::deduplication::rotate(const std::chrono::steady_clock::time_point & now)
+{
+	long long int bucket = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() / this->_settings.window.count();
+	if (bucket == this->_bucket) {
+		return;
+	}
+
+	// Frames in the dropped buckets were held for at least a window, expire() sent them
+	this->_buckets[1].clear();
+	if (bucket == this->_bucket + 1) {
+		this->_buckets[1].swap(this->_buckets[0]);
+	} else {
+		this->_buckets[0].clear();
+	}
+	this->_bucket = bucket;
+}
+
+void wifibeat::threads::deduplication::recurring()
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	this->expire(now);
+	this->rotate(now);
+
+	queue<PacketTimestamp *> q = this->getAllItemsFromInputQueue();
+	while (!q.empty()) {
+		PacketTimestamp * item = q.front();
+		q.pop();
+		if (item == NULL) {
+			continue;
+		}
+		++this->_arrivals;
+
+		const uint8_t * frame = NULL;
+		size_t length = 0;
+		if (!utils::wifi::ieee80211Frame(item->getLinkType(), item->getRawData(), item->getRawLength(), &frame, &length)) {
+			this->hold(item, 0, 0, now);
+			continue;
+		}
+		uint64_t hash = utils::hash::murmur64(frame, length, _WIFIBEAT_DEDUPLICATION_SEED);
+
+		// Seen in this window or the previous one?
+		dedupEntry * first = NULL;
+		for (std::unordered_map<uint64_t, dedupEntry> & bucket: this->_buckets) {
+			std::unordered_map<uint64_t, dedupEntry>::iterator it = bucket.find(hash);
+			if (it != bucket.end()) {
+				first = &(it->second);
+				break;
+			}
+		}
+		uint64_t source = SOURCE_BIT(item->Source());
+		if (first && (first->sources & source) == 0) {
+			first->sources |= source;
+			++this->_duplicates;
+			if (first->frame) {
+				++first->duplicates;
+			} else {
+				++this->_lateDuplicates;
+			}
+			delete item;
+			continue;
+		}
+
+		if (first) {
+			// Same frame again on the same interface
+			this->hold(item, hash, 0, now);
+			continue;
+		}
+
+		if (this->_buckets[0].size() + this->_buckets[1].size() >= this->_settings.maxFrames) {
+			++this->_untracked;
+			this->hold(item, hash, 0, now);
+			continue;
+		}
+		this->_buckets[0][hash] = { item, this->_arrivals, 0, source };
+		this->hold(item, hash, this->_arrivals, now);
+	}
+
+	this->expire(now);
+}
+
+string wifibeat::threads::deduplication::toString()
+{
+	stringstream ss;
+	ss << "Deduplication (" << this->_settings.window.count() << "ms window, up to " << this->_settings.maxFrames << " frames)";
+	return ss.str();
+}
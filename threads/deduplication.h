@@ -0,0 +1,100 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Drops copies of the same frame captured by several interfaces (radios on the
+// same channel). Frames are identified by a hash of the 802.11 frame, without
+// radiotap header and FCS, so copies from different cards match. Identical
+// frames captured by the same interface (ACKs, retransmissions without retry
+// flag) are different frames: a copy is only dropped if no frame with that hash
+// came from its interface yet.
+// Hashes are kept in two buckets, the current and the previous window, the
+// older one being dropped every window: a copy is caught if it arrives within
+// one to two windows of the first one. The first one is held for a window so
+// that the amount of copies dropped can be added to it (duplicates field).
+// Every other frame is held as well, frames leave in the order they came in.
+// Memory is bounded by the window and by a maximum amount of frames, both held
+// and tracked.
+#ifndef THREAD_DEDUPLICATION_H
+#define THREAD_DEDUPLICATION_H
+
+#include "ThreadWithQueue.h"
+#include "PacketTimestamp.h"
+#include "config/configstructs.h"
+#include <unordered_map>
+#include <deque>
+#include <chrono>
+#include <stdint.h>
+
+namespace wifibeat
+{
+	namespace threads
+	{
+		struct dedupEntry {
+			PacketTimestamp * frame; // Held in _held, NULL once sent
+			unsigned long long int arrival;
+			unsigned int duplicates;
+			uint64_t sources; // Interfaces it was seen on, one bit each
+		};
+
+		struct dedupHeld {
+			PacketTimestamp * frame;
+			uint64_t hash;
+			unsigned long long int arrival; // 0 when not tracked
+			std::chrono::steady_clock::time_point received;
+		};
+
+		class deduplication : public ThreadWithQueue<PacketTimestamp>
+		{
+			private:
+				dedupStruct _settings;
+
+				// Current and previous window
+				std::unordered_map<uint64_t, dedupEntry> _buckets[2];
+				long long int _bucket;
+				void rotate(const std::chrono::steady_clock::time_point & now);
+
+				// All frames, in the order they arrived
+				std::deque<dedupHeld> _held;
+				void hold(PacketTimestamp * frame, uint64_t hash, unsigned long long int arrival, const std::chrono::steady_clock::time_point & now);
+				void release(const dedupHeld & held);
+				void expire(const std::chrono::steady_clock::time_point & now);
+
+				unsigned long long int _arrivals;
+				unsigned long long int _duplicates;
+				unsigned long long int _lateDuplicates; // The first copy was already sent
+				unsigned long long int _untracked; // Buckets full
+				unsigned long long int _early; // Sent before the end of the window, too many frames held
+				unsigned long long int _dropped;
+
+				void send(PacketTimestamp * frame);
+
+			protected:
+				virtual bool allQueuesEmpty();
+
+			public:
+				explicit deduplication(const dedupStruct & settings);
+				~deduplication();
+				virtual string toString();
+				virtual void recurring();
+		};
+
+	}
+
+}
+
+#endif // THREAD_DEDUPLICATION_H
@@ -0,0 +1,524 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "directorywatching.h"
+#include "utils/logger.h"
+#include <pcap.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <sstream>
+
+using std::stringstream;
+
+wifibeat::threads::directorywatching::directorywatching(const directoryWatchStruct & settings)
+	: _settings(settings), _checkpoint(NULL), _inotifyFd(-1), _map(NULL), _stream(NULL), _frames(0), _dropped(0),
+		_bpf(NULL), _filtered(0), _checkpointFile(0), _sent(0), _persistent(false)
+{
+	this->Name("directorywatching");
+	string checkpoint = this->_settings.checkpoint;
+	if (checkpoint.empty()) {
+		checkpoint = this->_settings.directory + "/" _WIFIBEAT_DIRECTORYWATCHING_CHECKPOINT_FILE;
+	}
+	this->_checkpoint = new utils::fileCheckpoint(checkpoint, std::chrono::seconds(1));
+}
+
+wifibeat::threads::directorywatching::~directorywatching()
+{
+	delete this->_checkpoint; // Saves it
+	delete this->_map;
+	delete this->_stream;
+	delete this->_bpf;
+	if (this->_inotifyFd != -1) {
+		close(this->_inotifyFd);
+	}
+}
+
+bool wifibeat::threads::directorywatching::matches(const string & name)
+{
+	// Hidden files: checkpoint, temporary files
+	if (name.empty() || name[0] == '.') {
+		return false;
+	}
+	return fnmatch(this->_settings.pattern.c_str(), name.c_str(), 0) == 0;
+}
+
+string wifibeat::threads::directorywatching::path(const string & name)
+{
+	return this->_settings.directory + "/" + name;
+}
+
+wifibeat::threads::watchedFile & wifibeat::threads::directorywatching::file(const string & name)
+{
+	map<string, watchedFile>::iterator it = this->_files.find(name);
+	if (it != this->_files.end()) {
+		return it->second;
+	}
+
+	// Position first, it forgets about the file if it changed
+	watchedFile & file = this->_files[name];
+	file.position = this->_checkpoint->position(this->path(name), this->_settings.follow);
+	utils::fileState state = this->_checkpoint->state(this->path(name));
+	file.done = (state == utils::FileDone);
+	file.failed = (state == utils::FileFailed);
+	return file;
+}
+
+bool wifibeat::threads::directorywatching::init_function()
+{
+	if (this->_inotifyFd != -1) {
+		return true;
+	}
+
+	struct stat st;
+	if (stat(this->_settings.directory.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+		LOG_ERROR("Directory to watch <" + this->_settings.directory + "> does not exist");
+		return false;
+	}
+
+	this->_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (this->_inotifyFd == -1) {
+		LOG_ERROR(string("Failed initializing inotify: ") + strerror(errno));
+		return false;
+	}
+
+	// Watch before listing the directory so no file is missed
+	uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_DELETE_SELF | IN_MOVE_SELF;
+	if (this->_settings.follow) {
+		mask |= IN_MODIFY;
+	}
+	if (inotify_add_watch(this->_inotifyFd, this->_settings.directory.c_str(), mask) == -1) {
+		LOG_ERROR("Failed watching <" + this->_settings.directory + ">: " + strerror(errno));
+		close(this->_inotifyFd);
+		this->_inotifyFd = -1;
+		return false;
+	}
+
+	if (!this->_checkpoint->load()) {
+		return false;
+	}
+	this->scan(false);
+
+	stringstream ss;
+	ss << "Watching <" << this->_settings.directory << "> for <" << this->_settings.pattern << ">, "
+		<< this->_files.size() << " file(s) already there";
+	LOG_NOTICE(ss.str());
+
+	return true;
+}
+
+void wifibeat::threads::directorywatching::scan(bool rescan)
+{
+	DIR * dir = opendir(this->_settings.directory.c_str());
+	if (dir == NULL) {
+		LOG_ERROR("Failed listing <" + this->_settings.directory + ">: " + strerror(errno));
+		return;
+	}
+
+	map<string, watchedFile> files;
+	files.swap(this->_files);
+	struct dirent * entry;
+	while ((entry = readdir(dir)) != NULL) {
+		string name = entry->d_name;
+		if (!this->matches(name)) {
+			continue;
+		}
+		struct stat st;
+		if (stat(this->path(name).c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+			continue;
+		}
+
+		// Files already there are considered complete. With follow, the newest
+		// one might still be written to: it is done once a newer file shows up.
+		auto it = files.find(name);
+		bool known = (it != files.end());
+		if (known) {
+			this->_files[name] = it->second;
+		}
+		watchedFile & file = this->file(name);
+		if (!rescan || !known) {
+			file.complete = !this->_settings.follow;
+		}
+	}
+	closedir(dir);
+
+	// Entries of files that are gone are dropped
+	string prefix = this->path("");
+	for (const string & path: this->_checkpoint->files()) {
+		if (path.compare(0, prefix.size(), prefix) == 0 && this->_files.find(path.substr(prefix.size())) == this->_files.end()) {
+			this->_checkpoint->remove(path);
+		}
+	}
+}
+
+bool wifibeat::threads::directorywatching::events()
+{
+	char buffer[16384] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	while (true) {
+		ssize_t len = read(this->_inotifyFd, buffer, sizeof(buffer));
+		if (len <= 0) {
+			break;
+		}
+
+		for (char * ptr = buffer; ptr < buffer + len; ptr += sizeof(struct inotify_event) + ((struct inotify_event *) ptr)->len) {
+			const struct inotify_event * event = (const struct inotify_event *) ptr;
+			if (event->mask & IN_Q_OVERFLOW) {
+				LOG_WARN("Too many events in <" + this->_settings.directory + ">, listing it again");
+				this->scan(true);
+				continue;
+			}
+			if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+				LOG_CRITICAL("Watched directory <" + this->_settings.directory + "> was removed");
+				return false;
+			}
+			if (event->len == 0) {
+				continue;
+			}
+
+			string name = event->name;
+			if (!this->matches(name)) {
+				continue;
+			}
+			if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+				this->file(name).complete = true;
+			} else if (event->mask & IN_CREATE) {
+				this->file(name);
+			} else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+				if (name == this->_current) {
+					// Still open, whatever was written can be read
+					this->_files[name].complete = true;
+				} else {
+					this->_files.erase(name);
+					this->_checkpoint->remove(this->path(name));
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+void wifibeat::threads::directorywatching::wait()
+{
+	struct pollfd pfd = { this->_inotifyFd, POLLIN, 0 };
+	poll(&pfd, 1, 100);
+}
+
+bool wifibeat::threads::directorywatching::next(string & name)
+{
+	for (const auto & kv: this->_files) {
+		if (kv.second.done || kv.second.failed) {
+			continue;
+		}
+		// Unless a newer file shows the writer moved on, files are read once
+		// complete. With follow, pcap files are read as soon as their header is
+		// there; pcapng and compressed files still have to be complete.
+		if (!kv.second.complete && std::next(this->_files.find(kv.first)) == this->_files.end()) {
+			if (!this->_settings.follow) {
+				return false;
+			}
+			string path = this->path(kv.first);
+			struct stat st;
+			if (stat(path.c_str(), &st) != 0 || st.st_size < PCAP_FILE_HEADER_SIZE || utils::pcapStream::needed(path)) {
+				return false;
+			}
+		}
+		name = kv.first;
+		return true;
+	}
+	return false;
+}
+
+bool wifibeat::threads::directorywatching::open(const string & name)
+{
+	string path = this->path(name);
+	watchedFile & file = this->_files[name];
+	this->_current = name;
+	this->_frames = 0;
+	this->_dropped = 0;
+	this->_filtered = 0;
+	this->_checkpointFile = this->_checkpoint->track(path);
+	this->_sent = 0;
+
+	if (utils::pcapStream::needed(path)) {
+		this->_stream = new utils::pcapStream();
+		if (!this->_stream->open(path)) {
+			LOG_ERROR(this->_stream->Error());
+			return false;
+		}
+
+		// Skip what was read before a restart
+		utils::pcapRecord record;
+		for (unsigned long long int i = 0; i < file.position; ++i) {
+			if (!this->_stream->next(record)) {
+				break;
+			}
+		}
+	} else {
+		string error;
+		this->_map = new utils::pcapMap();
+		if (!this->_map->open(path, error)) {
+			LOG_ERROR(error);
+			return false;
+		}
+		if (this->_map->LinkType() != DLT_IEEE802_11_RADIO && this->_map->LinkType() != DLT_IEEE802_11) {
+			LOG_ERROR("Invalid link type for <" + path + ">: " + std::to_string(this->_map->LinkType()));
+			return false;
+		}
+		if (file.position < this->_map->First()) {
+			file.position = this->_map->First();
+		}
+	}
+
+	stringstream ss;
+	ss << "Reading <" << path << ">";
+	if (file.position) {
+		ss << ", resuming at " << file.position << ((this->_stream) ? " frames" : " bytes");
+	}
+	LOG_NOTICE(ss.str());
+
+	return true;
+}
+
+void wifibeat::threads::directorywatching::finish(bool failed)
+{
+	string path = this->path(this->_current);
+	delete this->_map;
+	this->_map = NULL;
+	delete this->_stream;
+	this->_stream = NULL;
+
+	watchedFile & file = this->_files[this->_current];
+	if (failed) {
+		file.failed = true;
+		LOG_ERROR("Failed reading <" + path + ">, it will be left as is");
+	} else {
+		file.done = true;
+		stringstream ss;
+		ss << "Finished reading <" << path << ">: " << this->_frames << " frames";
+		if (this->_dropped) {
+			ss << ", " << this->_dropped << " dropped";
+		}
+		if (this->_filtered) {
+			ss << ", " << this->_filtered << " filtered out";
+		}
+		LOG_NOTICE(ss.str());
+	}
+
+	if (!failed && this->_persistent && this->_sent) {
+		this->_unacknowledged.push_back({ this->_current, this->_checkpointFile, this->_sent });
+	} else {
+		this->done(this->_current, failed);
+	}
+	this->_current.clear();
+}
+
+void wifibeat::threads::directorywatching::done(const string & name, bool failed)
+{
+	string path = this->path(name);
+	if (!failed) {
+		bool removed = false;
+		if (this->_settings.done == DeleteWatchedFile) {
+			removed = (unlink(path.c_str()) == 0);
+			if (!removed) {
+				LOG_ERROR("Failed deleting <" + path + ">: " + strerror(errno));
+			}
+		} else if (this->_settings.done == MoveWatchedFile) {
+			string destination = this->_settings.moveTo + "/" + name;
+			removed = (rename(path.c_str(), destination.c_str()) == 0);
+			if (!removed) {
+				LOG_ERROR("Failed moving <" + path + "> to <" + destination + ">: " + strerror(errno));
+			}
+		}
+		if (removed) {
+			this->_files.erase(name);
+			this->_checkpoint->remove(path);
+			this->_checkpoint->save();
+		}
+	}
+
+	if (this->_files.find(name) != this->_files.end()) {
+		this->_checkpoint->finish(path, failed);
+	}
+}
+
+void wifibeat::threads::directorywatching::acknowledged()
+{
+	// Files are read one after the other, their frames are acknowledged in that order
+	while (!this->_unacknowledged.empty()) {
+		const unacknowledgedFile & file = this->_unacknowledged.front();
+		map<string, watchedFile>::iterator it = this->_files.find(file.name);
+		if (it != this->_files.end()) {
+			if (this->_checkpoint->updated(file.checkpointFile) < file.position) {
+				return;
+			}
+			// Frames filtered out after the last one sent
+			this->_checkpoint->update(this->path(file.name), it->second.position);
+			this->done(file.name, false);
+		}
+		this->_unacknowledged.pop_front();
+	}
+}
+
+int wifibeat::threads::directorywatching::readPcap(int max)
+{
+	watchedFile & file = this->_files[this->_current];
+	int count = 0;
+	bool refreshed = false;
+	size_t offset = file.position;
+	struct timespec ts;
+	const uint8_t * data;
+	uint32_t length;
+	string error;
+	while (count < max) {
+		if (this->_map->next(offset, ts, data, length, error)) {
+			this->send(data, length, this->_map->LinkType(), ts, offset);
+			++count;
+			continue;
+		}
+		if (!error.empty()) {
+			LOG_ERROR(error);
+			return -1;
+		}
+		// The rest of the record may have been written since the file was mapped.
+		// Once per call at most, if it's still incomplete it wasn't written yet.
+		if (refreshed) {
+			break;
+		}
+		if (!this->_map->refresh(error)) {
+			LOG_ERROR(error);
+			return -1;
+		}
+		refreshed = true;
+	}
+
+	if (count) {
+		utils::pcapChunk read = { file.position, offset - file.position, (unsigned int)count };
+		this->_map->release(read);
+		file.position = offset;
+		if (!this->_persistent) {
+			this->_checkpoint->update(this->path(this->_current), file.position);
+		}
+	}
+	return count;
+}
+
+int wifibeat::threads::directorywatching::readStream(int max)
+{
+	watchedFile & file = this->_files[this->_current];
+	int count = 0;
+	utils::pcapRecord record;
+	while (count < max && this->_stream->next(record)) {
+		++count;
+		++file.position;
+		if (record.linkType == DLT_IEEE802_11_RADIO || record.linkType == DLT_IEEE802_11) {
+			this->send(record.data, record.length, record.linkType, record.ts, file.position);
+		}
+	}
+
+	if (count == 0 && !this->_stream->Error().empty()) {
+		LOG_ERROR(this->_stream->Error());
+		return -1;
+	}
+	if (count && !this->_persistent) {
+		this->_checkpoint->update(this->path(this->_current), file.position);
+	}
+	return count;
+}
+
+void wifibeat::threads::directorywatching::send(const uint8_t * data, uint32_t length, int linkType, const struct timespec & ts, unsigned long long int position)
+{
+	++this->_frames;
+	if (this->_bpf && !this->_bpf->matches(linkType, data, length, length)) {
+		++this->_filtered;
+		return;
+	}
+	PacketTimestamp * pts = new PacketTimestamp(data, length, linkType, ts);
+	if (this->_persistent) {
+		pts->Checkpoint(this->_checkpoint, this->_checkpointFile, position);
+	}
+	if (this->sendToNextThreadsQueueWaiting(pts)) {
+		this->_sent = position;
+	} else {
+		++this->_dropped;
+	}
+}
+
+void wifibeat::threads::directorywatching::recurring()
+{
+	if (!this->events()) {
+		this->ThreadFinished();
+		return;
+	}
+	this->acknowledged();
+
+	if (this->_current.empty()) {
+		string name;
+		if (!this->next(name)) {
+			this->_checkpoint->save();
+			this->wait();
+			return;
+		}
+		if (!this->open(name)) {
+			this->finish(true);
+			return;
+		}
+	}
+
+	int ret = (this->_stream) ? this->readStream(_WIFIBEAT_DIRECTORYWATCHING_FRAMES_PER_LOOP) : this->readPcap(_WIFIBEAT_DIRECTORYWATCHING_FRAMES_PER_LOOP);
+	if (ret < 0) {
+		this->finish(true);
+	} else if (ret == 0) {
+		// End of what's there. Done if the writer is, or if it moved on to a newer file.
+		auto it = this->_files.find(this->_current);
+		if (this->_stream || it->second.complete || std::next(it) != this->_files.end()) {
+			if (this->_map && this->_map->Size() > it->second.position) {
+				LOG_WARN("<" + this->_current + "> is truncated, last frame is incomplete");
+			}
+			this->finish(false);
+		} else {
+			this->wait();
+		}
+	}
+}
+
+string wifibeat::threads::directorywatching::toString()
+{
+	string ret = "Directory <" + this->_settings.directory + "> - Pattern <" + this->_settings.pattern + ">";
+	if (this->_bpf) {
+		ret += " - Filter <" + this->_bpf->Expression() + ">";
+	}
+	return ret;
+}
+
+void wifibeat::threads::directorywatching::Filter(const string & expression)
+{
+	delete this->_bpf;
+	this->_bpf = (expression.empty()) ? NULL : new utils::bpfFilter(expression);
+}
+
+void wifibeat::threads::directorywatching::Persistent(bool persistent)
+{
+	this->_persistent = persistent;
+}
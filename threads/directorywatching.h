@@ -0,0 +1,118 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Reads the capture files that appear in a directory, for instance the one a
+// capture tool rotates its files into. The directory is watched with inotify
+// and files are read in name order, once they are closed by the writer or,
+// with follow, while they are being written. Progress in each file is saved in
+// a checkpoint (see utils/fileCheckpoint.h) so nothing is read twice after a
+// restart. With the persistent queue, positions are saved once the outputs
+// acknowledged the frames (see threads/persistence.h) and a file is only done
+// with, and then deleted or moved, once its last frame was acknowledged.
+#ifndef THREAD_DIRECTORYWATCHING_H
+#define THREAD_DIRECTORYWATCHING_H
+
+#include "ThreadWithQueue.h"
+#include "PacketTimestamp.h"
+#include "config/configstructs.h"
+#include "utils/pcapStream.h"
+#include "utils/pcapMap.h"
+#include "utils/bpfFilter.h"
+#include "utils/fileCheckpoint.h"
+#include <map>
+#include <deque>
+
+using std::map;
+
+#define _WIFIBEAT_DIRECTORYWATCHING_FRAMES_PER_LOOP 1024
+#define _WIFIBEAT_DIRECTORYWATCHING_CHECKPOINT_FILE ".wifibeat-checkpoint"
+
+namespace wifibeat
+{
+	namespace threads
+	{
+		struct watchedFile {
+			// Bytes for pcap files, frames for pcapng and compressed files
+			unsigned long long int position;
+			bool complete; // Writer is done with it
+			bool done;
+			bool failed;
+			watchedFile() : position(0), complete(false), done(false), failed(false) { }
+		};
+
+		// Read, waiting for the outputs to acknowledge its last frame
+		struct unacknowledgedFile {
+			string name;
+			unsigned int checkpointFile;
+			unsigned long long int position;
+		};
+
+		class directorywatching : public ThreadWithQueue<PacketTimestamp>
+		{
+			private:
+				directoryWatchStruct _settings;
+				utils::fileCheckpoint * _checkpoint;
+				int _inotifyFd;
+				map<string, watchedFile> _files; // By name, it's the reading order
+
+				// File being read
+				string _current;
+				utils::pcapMap * _map; // pcap files
+				utils::pcapStream * _stream; // pcapng and compressed files
+				unsigned long long int _frames;
+				unsigned long long int _dropped;
+				utils::bpfFilter * _bpf;
+				unsigned long long int _filtered;
+				unsigned int _checkpointFile; // See utils::fileCheckpoint::track
+				unsigned long long int _sent; // Position after the last frame sent
+
+				// Frames are tagged for the persistence thread, which saves their position
+				bool _persistent;
+				std::deque<unacknowledgedFile> _unacknowledged;
+				void acknowledged();
+
+				bool matches(const string & name);
+				string path(const string & name);
+				watchedFile & file(const string & name); // From the checkpoint if it's new
+				void scan(bool rescan);
+				bool events(); // false if the directory is gone
+				void wait();
+
+				bool next(string & name);
+				bool open(const string & name);
+				void finish(bool failed);
+				void done(const string & name, bool failed); // Deletes or moves it
+				int readPcap(int max); // Frames read, -1 on error
+				int readStream(int max);
+				void send(const uint8_t * data, uint32_t length, int linkType, const struct timespec & ts, unsigned long long int position);
+
+			public:
+				explicit directorywatching(const directoryWatchStruct & settings);
+				~directorywatching();
+				virtual string toString();
+				virtual void recurring();
+				virtual bool init_function();
+				void Filter(const string & expression);
+				void Persistent(bool persistent);
+		};
+
+	}
+
+}
+
+#endif // THREAD_DIRECTORYWATCHING_H
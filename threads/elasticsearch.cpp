@@ -22,38 +22,75 @@
 #include "utils/Locker.h"
 #include "utils/beat.h"
 #include "utils/stringHelper.h"
+#include "utils/hash.h"
+#include "utils/esTemplate.h"
+#include "utils/file.h"
+#include "utils/tls.h"
+#include <tins/radiotap.h>
+#include <pcap.h>
+#include <signal.h>
+#include <cstdio>
+#include <algorithm>
 #include <sstream>
-#include <rapidjson/document.h>
-
-using namespace rapidjson;
 
 wifibeat::threads::elasticsearch::elasticsearch(const ElasticSearchConnection & connection)
-	: _settings(connection), _mutexInit(false)
+	: _settings(connection), _preferredHosts(0), _hostsGeneration(0), _hostsMutexInit(false),
+		_router(NULL), _controller(NULL), _bulkBody(""), _bulkDocuments(0),
+		_bulkSequence(0), _persistence(NULL), _persistenceOutput(0), _nextBulkID(0), _firstUnacknowledged(0),
+		_inFlight(0), _stopSenders(false), _spoolMutexInit(false), _spool(NULL), _healthy(true), _sensorSeed(0)
 {
 	this->Name("elasticsearch");
 
-	// Initialize mutex
-	if (pthread_mutex_init(&this->_connectionMutex, NULL) != 0) {
-		LOG_CRITICAL("Failed initializing elasticsearch connections mutex");
-		throw string("Failed initializing elasticsearch connections mutex");
+	// Initialize mutexes
+	if (pthread_mutex_init(&this->_hostsMutex, NULL) != 0) {
+		LOG_CRITICAL("Failed initializing elasticsearch hosts mutex");
+		throw string("Failed initializing elasticsearch hosts mutex");
+	}
+	this->_hostsMutexInit = true;
+	if (pthread_mutex_init(&this->_spoolMutex, NULL) != 0) {
+		LOG_CRITICAL("Failed initializing elasticsearch spool mutex");
+		throw string("Failed initializing elasticsearch spool mutex");
 	}
-	this->_mutexInit = true;
+	this->_spoolMutexInit = true;
 }
 
 wifibeat::threads::elasticsearch::~elasticsearch()
 {
-	if (this->_mutexInit) {
-		utils::Locker * l = new utils::Locker(&this->_connectionMutex);
-		for (elastic * conn : this->_connections) {
-			delete conn;
-		}
-		delete l;
-		pthread_mutex_destroy(&this->_connectionMutex);
-	} else {
-		for (elastic * conn : this->_connections) {
+	// Send what is left then wait for the senders to be done
+	if (this->_controller && this->_bulkDocuments) {
+		this->flush();
+	}
+	{
+		std::lock_guard<std::mutex> lock(this->_pendingMutex);
+		this->_stopSenders = true;
+	}
+	this->_pendingCondition.notify_all();
+	for (std::thread * sender: this->_senders) {
+		sender->join();
+		delete sender;
+	}
+	for (pendingBulk * bulk: this->_pending) {
+		delete bulk;
+	}
+	for (pendingBulk * bulk: this->_freeBulks) {
+		delete bulk;
+	}
+
+	for (vector<utils::esClient *> & connections: this->_connections) {
+		for (utils::esClient * conn: connections) {
+			this->logStats(conn);
 			delete conn;
 		}
 	}
+	delete this->_router;
+	delete this->_controller;
+	delete this->_spool;
+	if (this->_spoolMutexInit) {
+		pthread_mutex_destroy(&this->_spoolMutex);
+	}
+	if (this->_hostsMutexInit) {
+		pthread_mutex_destroy(&this->_hostsMutex);
+	}
 }
 
 void wifibeat::threads::elasticsearch::recurring()
@@ -61,6 +98,10 @@ void wifibeat::threads::elasticsearch::recurring()
 	queue<PacketTimestamp *> items = this->getAllItemsFromInputQueue();
 
 	if (items.empty()) {
+		// Don't keep documents forever when there isn't much traffic
+		if (this->_bulkDocuments && std::chrono::steady_clock::now() - this->_bulkStarted >= this->_settings.flushInterval) {
+			this->flush();
+		}
 		return;
 	}
 
@@ -73,14 +114,31 @@ void wifibeat::threads::elasticsearch::recurring()
 		}
 	}
 
-	// Parse and and add documents to vector
-	vector <string> documents;
+	// Serialize documents straight into the bulk body: action line then source
 	while (!items.empty()) {
 		PacketTimestamp * item = items.front();
 		items.pop();
+		if (this->_bulkDocuments == 0) {
+			this->_bulkStarted = std::chrono::steady_clock::now();
+		}
+
+		// Find out which index it goes to
+		unsigned int frameType = INDEX_ROUTER_FRAME_TYPES;
+		const Dot11 * dot11 = (item->getPDU()) ? item->getPDU()->find_pdu<Dot11>() : NULL;
+		if (dot11) {
+			frameType = dot11->type();
+		}
+		const utils::indexRouter::target * target = this->_router->route(frameType, item->getTimespec());
+		if (item->Sequence() > this->_bulkSequence) {
+			this->_bulkSequence = item->Sequence();
+		}
+
+		// Explicit _id so that sending it again overwrites the document instead of duplicating it
+		char id[_WIFIBEAT_ES_DOCUMENT_ID_LENGTH + 1];
+		bool hasID = this->_settings.documentID != DOCUMENT_ID_NONE
+						&& this->documentID(item, id, sizeof(id));
 
 		// Generate document from frame
-		Document d;
 		JSONObject * json = wifibeat::utils::tins::PacketTimestamp2String(item);
 		delete item;
 		if (!json) {
@@ -88,95 +146,699 @@ void wifibeat::threads::elasticsearch::recurring()
 			continue;
 		}
 
-		// Add the beat field then add document to vector.
+		// Add the beat field then add document to the body.
 		if (wifibeat::utils::beat::Instance()->addBeatToDocument(json) == false) {
 			LOG_ERROR("Failed adding Beat to JSON");
 			delete json;
 			continue;
 		}
-		string temp = json->toString();
-		documents.push_back(temp);
+		if (hasID) {
+			this->_bulkBody.append(target->actionPrefix);
+			this->_bulkBody.append(",\"_id\":\"");
+			this->_bulkBody.append(id, _WIFIBEAT_ES_DOCUMENT_ID_LENGTH);
+			this->_bulkBody.append("\"}}\n");
+		} else {
+			this->_bulkBody.append(target->actionLine);
+		}
+		this->_bulkBody.append(json->toString());
+		this->_bulkBody.push_back('\n');
+		delete json;
+
+		if (++this->_bulkDocuments >= this->_controller->BulkSize()) {
+			this->flush();
+		}
+	}
+
+	if (this->_bulkDocuments && std::chrono::steady_clock::now() - this->_bulkStarted >= this->_settings.flushInterval) {
+		this->flush();
+	}
+}
+
+bool wifibeat::threads::elasticsearch::documentID(const PacketTimestamp * item, char * id, size_t idLength)
+{
+	const uint8_t * data = item->getRawData();
+	size_t length = item->getRawLength();
+	if (data == NULL || length == 0) {
+		return false;
+	}
+	struct timespec ts = item->getTimespec();
+	uint64_t ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+
+	uint64_t seed = 0;
+	if (this->_settings.documentID == DOCUMENT_ID_UNIQUE) {
+		// Whole frame, capture time and sensor
+		seed = this->_sensorSeed ^ utils::hash::mix64(ns);
+	} else {
+		// Sensors don't report the same radiotap fields (signal, antenna, ...) so only
+		// the 802.11 frame is hashed, along with a coarse time bucket.
+		if (item->getLinkType() == DLT_IEEE802_11_RADIO) {
+			if (length < 4) {
+				return false;
+			}
+			size_t radiotapLength = data[2] | (data[3] << 8);
+			if (radiotapLength >= length) {
+				return false;
+			}
+
+			// Not all of them keep the FCS either
+			const RadioTap * radiotap = (item->getPDU()) ? item->getPDU()->find_pdu<RadioTap>() : NULL;
+			if (radiotap && (radiotap->present() & RadioTap::FLAGS) && (radiotap->flags() & RadioTap::FCS)
+					&& length - radiotapLength > 4) {
+				length -= 4;
+			}
+			data += radiotapLength;
+			length -= radiotapLength;
+		}
+		uint64_t window = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(this->_settings.dedupWindow).count();
+		seed = utils::hash::mix64(ns / window);
 	}
-	
-	// Now insert all documents
-	if (documents.empty()) {
+
+	uint64_t high = utils::hash::murmur64(data, length, seed);
+	uint64_t low = utils::hash::murmur64(data, length, utils::hash::mix64(seed + 1));
+	snprintf(id, idLength, "%016llx%016llx", (unsigned long long int)high, (unsigned long long int)low);
+
+	return true;
+}
+
+bool wifibeat::threads::elasticsearch::installTemplate()
+{
+	utils::esClient * conn = this->_connections[0][0];
+	unsigned int majorVersion = conn->MajorVersion();
+	const ESTemplateVersion & tv = (majorVersion < 6) ? this->_settings.version2x : this->_settings.version6x;
+	if (!this->_settings.indexTemplate.enabled || !tv.enabled) {
+		LOG_INFO("Index template installation disabled");
+		return true;
+	}
+
+	string path = utils::esTemplate::path(majorVersion, this->_settings.indexTemplate.name);
+	string response;
+	int status = conn->request("HEAD", path, "", response);
+	if (status == 200 && !this->_settings.indexTemplate.overwrite) {
+		LOG_INFO("Index template <" + this->_settings.indexTemplate.name + "> already present in <" + conn->toString() + ">");
+		return true;
+	}
+	if (status != 200 && status != 404) {
+		stringstream ss;
+		ss << "Failed checking index template <" << this->_settings.indexTemplate.name << "> in <" << conn->toString() << ">: ";
+		if (status) {
+			ss << "HTTP status " << status << ' ';
+		}
+		ss << response;
+		LOG_ERROR(ss.str());
+		return false;
+	}
+
+	// Template from file or the one shipped
+	string body;
+	if (!tv.path.empty()) {
+		if (!utils::file::read(tv.path, body)) {
+			LOG_ERROR("Failed reading index template <" + tv.path + ">");
+			return false;
+		}
+	} else {
+		// Every index the router can write to
+		vector<string> patterns;
+		patterns.push_back(utils::indexRouter::wildcard((this->_settings.index.empty()) ? _WIFIBEAT_ES_INDEX_BASENAME : this->_settings.index));
+		for (const auto & kv: this->_settings.indices) {
+			string wildcard = utils::indexRouter::wildcard(kv.second);
+			if (std::find(patterns.begin(), patterns.end(), wildcard) == patterns.end()) {
+				patterns.push_back(wildcard);
+			}
+		}
+		body = utils::esTemplate::build(majorVersion, patterns, this->_settings.indexTemplate.refreshInterval,
+										(majorVersion < 7) ? "doc" : "");
+	}
+
+	status = conn->request("PUT", path, body, response);
+	if (status < 200 || status > 299) {
+		stringstream ss;
+		ss << "Failed installing index template <" << this->_settings.indexTemplate.name << "> in <" << conn->toString() << ">: ";
+		if (status) {
+			ss << "HTTP status " << status << ' ';
+		}
+		ss << response;
+		LOG_ERROR(ss.str());
+		return false;
+	}
+
+	LOG_NOTICE("Installed index template <" + this->_settings.indexTemplate.name + "> in <" + conn->toString() + ">");
+	return true;
+}
+
+bool wifibeat::threads::elasticsearch::sniff(bool force)
+{
+	if (!this->_settings.sniffing.enabled) {
+		return true;
+	}
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (!force && now - this->_lastSniff < this->_settings.sniffing.interval) {
+		return true;
+	}
+	this->_lastSniff = now;
+
+	// Ask the nodes currently in use, then the configured hosts
+	vector<IPPort> candidates;
+	{
+		utils::Locker l(&this->_hostsMutex);
+		candidates = this->_hosts;
+	}
+	for (const IPPort & seed: this->_settings.hosts) {
+		if (std::find_if(candidates.begin(), candidates.end(), [&seed](const IPPort & h) {
+				return h.host == seed.host && h.port == seed.port; }) == candidates.end()) {
+			candidates.push_back(seed);
+		}
+	}
+
+	vector<IPPort> discovered;
+	bool found = false;
+	for (const IPPort & candidate: candidates) {
+		utils::esClient conn(candidate.host, candidate.port, this->_settings, this->_tlsContext);
+		string error;
+		if (conn.nodes(this->_settings.sniffing.dataNodesOnly, discovered, error) && !discovered.empty()) {
+			found = true;
+			break;
+		}
+		if (!error.empty()) {
+			LOG_WARN("Failed getting nodes from <" + conn.toString() + ">: " + error);
+		}
+	}
+	if (!found) {
+		LOG_WARN("Sniffing failed, keeping current Elasticsearch nodes");
+		return false;
+	}
+
+	// Configured hosts stay as a fallback
+	unsigned int preferred = discovered.size();
+	vector<IPPort> hosts = discovered;
+	for (const IPPort & seed: this->_settings.hosts) {
+		if (std::find_if(hosts.begin(), hosts.end(), [&seed](const IPPort & h) {
+				return h.host == seed.host && h.port == seed.port; }) == hosts.end()) {
+			hosts.push_back(seed);
+		}
+	}
+
+	utils::Locker l(&this->_hostsMutex);
+	bool changed = hosts.size() != this->_hosts.size() || preferred != this->_preferredHosts;
+	for (const IPPort & h: hosts) {
+		if (std::find_if(this->_hosts.begin(), this->_hosts.end(), [&h](const IPPort & o) {
+				return h.host == o.host && h.port == o.port; }) == this->_hosts.end()) {
+			stringstream ss;
+			ss << "Added Elasticsearch node <" << h.host << ':' << h.port << '>';
+			LOG_NOTICE(ss.str());
+			changed = true;
+		}
+	}
+	for (const IPPort & o: this->_hosts) {
+		if (std::find_if(hosts.begin(), hosts.end(), [&o](const IPPort & h) {
+				return h.host == o.host && h.port == o.port; }) == hosts.end()) {
+			stringstream ss;
+			ss << "Removed Elasticsearch node <" << o.host << ':' << o.port << '>';
+			LOG_NOTICE(ss.str());
+		}
+	}
+	if (changed) {
+		this->_hosts = hosts;
+		this->_preferredHosts = preferred;
+		++this->_hostsGeneration;
+	}
+
+	return true;
+}
+
+void wifibeat::threads::elasticsearch::logStats(utils::esClient * conn)
+{
+	const utils::connectionStats & stats = conn->Stats();
+	if (stats.connections == 0) {
 		return;
 	}
+	stringstream ss;
+	ss << '<' << conn->toString() << ">: " << stats.connections << " connection(s)";
+	if (this->_settings.protocol == HTTPS) {
+		ss << ", " << stats.handshakes << " full TLS handshake(s), " << stats.resumedSessions << " resumed TLS session(s)";
+	}
+	LOG_NOTICE(ss.str());
+}
 
-	vector <string> temp;
-	utils::Locker l(&this->_connectionMutex);
-
-	while (documents.size() > 0) {
-		// Calculate amount of elements per bulk request
-		unsigned int amountElt = documents.size();
-		if (amountElt > this->_settings.bulkMaxSize) {
-			amountElt = this->_settings.bulkMaxSize;
-		}
-		
-		// Move elements from one vector to another
-		auto it = std::next(documents.begin(), amountElt);
-		temp.clear();
-		std::move(documents.begin(), it, std::back_inserter(temp));
-		documents.erase(documents.begin(), it);
-
-		// Do the request
-		// XXX: Make sure this behavior is the same as packetbeat:
-		//      connect to first host that responds and send document
-		for (elastic * conn: this->_connections) {
-			beat::protocols::BulkResponse * response = conn->bulkRequest(temp, _WIFIBEAT_ES_INDEX_BASENAME);
-
-			// Handle errors
-			if (response->errors || response->httpStatus != 200) {
-				stringstream ss;
-				ss << "Failed inserting " << temp.size() << " documents in <" << conn->toString() << 
-					">: HTTP error " << response->httpStatus;
-				LOG_ERROR(ss.str());
+void wifibeat::threads::elasticsearch::updateConnections(unsigned int sender)
+{
+	vector<IPPort> hosts;
+	{
+		utils::Locker l(&this->_hostsMutex);
+		if (this->_senderGenerations[sender] == this->_hostsGeneration && !this->_connections[sender].empty()) {
+			return;
+		}
+		this->_senderGenerations[sender] = this->_hostsGeneration;
+		this->_senderPreferred[sender] = this->_preferredHosts;
+		hosts = this->_hosts;
+	}
+
+	// Keep connections (and their keep-alive session) to hosts still there
+	vector<utils::esClient *> & current = this->_connections[sender];
+	vector<utils::esClient *> connections;
+	for (const IPPort & h: hosts) {
+		auto it = std::find_if(current.begin(), current.end(), [&h](utils::esClient * c) {
+			return c->Host() == h.host && c->Port() == h.port; });
+		if (it != current.end()) {
+			connections.push_back(*it);
+			current.erase(it);
+		} else {
+			connections.push_back(new utils::esClient(h.host, h.port, this->_settings, this->_tlsContext));
+		}
+	}
+	for (utils::esClient * conn: current) {
+		this->logStats(conn);
+		delete conn;
+	}
+	current.swap(connections);
+}
+
+bool wifibeat::threads::elasticsearch::send(unsigned int sender, const string & body, unsigned int documents, bool & overloaded)
+{
+	utils::bulkResult result;
+	overloaded = false;
+
+	// Spread requests over the discovered nodes, then fall back on the configured hosts
+	vector<utils::esClient *> & connections = this->_connections[sender];
+	unsigned int preferred = std::min((size_t)this->_senderPreferred[sender], connections.size());
+	unsigned int start = 0;
+	if (preferred > 1) {
+		start = this->_roundRobin[sender]++ % preferred;
+	}
+
+	// XXX: Make sure this behavior is the same as packetbeat:
+	//      connect to first host that responds and send document
+	for (size_t i = 0; i < connections.size(); ++i) {
+		utils::esClient * conn = connections[(i < preferred) ? (start + i) % preferred : i];
+		if (!conn->bulk(body, result)) {
+			stringstream ss;
+			ss << "Failed inserting " << documents << " documents in <" << conn->toString() << ">: ";
+			if (result.httpStatus) {
+				ss << "HTTP error " << result.httpStatus << ' ';
+			}
+			ss << result.error;
+			LOG_ERROR(ss.str());
+			if (result.httpStatus == 429) {
+				overloaded = true;
+			}
+			continue;
+		}
+
+		// Request went through, sending it again elsewhere would duplicate the others.
+		// Documents rejected (429) or failed on the node (5xx) are sent again, to the same node.
+		string retryBody;
+		for (unsigned int attempt = 0; ; ++attempt) {
+			unsigned int retrying = (attempt < this->_settings.maxRetries) ? result.retryItems.size() : 0;
+			stringstream ss;
+			if (result.failedItems) {
+				ss << "Failed inserting " << result.failedItems << " out of " << documents
+					<< " documents in <" << conn->toString() << "> (" << result.rejectedItems << " rejected";
+				if (retrying) {
+					ss << ", " << retrying << " retried";
+				}
+				ss << "): " << result.error;
+				if (retrying == result.failedItems) {
+					LOG_WARN(ss.str());
+				} else {
+					LOG_ERROR(ss.str());
+				}
 			} else {
-				stringstream ss;
-				ss << "Inserted " << temp.size() << " documents in <" << conn->toString() << ">";
+				ss << "Inserted " << documents << " documents in <" << conn->toString() << ">";
 				LOG_DEBUG(ss.str());
-				delete response;
+			}
+			if (result.rejectedItems) {
+				overloaded = true;
+			}
+			if (retrying == 0) {
 				break;
 			}
-			delete response;
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(_WIFIBEAT_ES_RETRY_BACKOFF_MS << std::min(attempt, 6u)));
+			retryBody = utils::esClient::items((attempt == 0) ? body : retryBody, result.retryItems);
+			documents = retrying;
+			if (!conn->bulk(retryBody, result)) {
+				ss.str("");
+				ss << "Failed retrying " << documents << " documents in <" << conn->toString() << ">: ";
+				if (result.httpStatus) {
+					ss << "HTTP error " << result.httpStatus << ' ';
+				}
+				ss << result.error;
+				LOG_ERROR(ss.str());
+				if (result.httpStatus == 429) {
+					overloaded = true;
+				}
+				break;
+			}
+		}
+		return true;
+	}
+
+	return false;
+}
+
+bool wifibeat::threads::elasticsearch::flush()
+{
+	if (this->_bulkDocuments == 0) {
+		return true;
+	}
+
+	// Documents per second limit
+	std::chrono::microseconds wait = this->_controller->throttle(this->_bulkDocuments);
+	if (wait.count() > 0) {
+		std::this_thread::sleep_for(wait);
+	}
+
+	{
+		// Don't queue more than what the senders can handle, it slows down this thread
+		// (and the ones before it) when Elasticsearch can't keep up.
+		std::unique_lock<std::mutex> lock(this->_pendingMutex);
+		this->_pendingCondition.wait(lock, [this] {
+			return this->_stopSenders || this->_pending.size() < this->_controller->Concurrency();
+		});
+
+		pendingBulk * bulk = NULL;
+		if (this->_freeBulks.empty()) {
+			bulk = new pendingBulk();
+		} else {
+			bulk = this->_freeBulks.back();
+			this->_freeBulks.pop_back();
+		}
+
+		// Swapping keeps the memory of both bodies for the next bulks
+		bulk->body.swap(this->_bulkBody);
+		bulk->documents = this->_bulkDocuments;
+		bulk->id = this->_nextBulkID++;
+		bulk->sequence = this->_bulkSequence;
+		bulk->retryAt = std::chrono::steady_clock::time_point();
+		this->_unacknowledged.push_back(std::make_pair(this->_bulkSequence, false));
+		this->_pending.push_back(bulk);
+	}
+	this->_pendingCondition.notify_all();
+
+	this->_bulkBody.clear();
+	this->_bulkDocuments = 0;
+	this->_bulkSequence = 0;
+	if (this->_bulkBody.capacity() == 0) {
+		this->_bulkBody.reserve(this->_controller->BulkSize() * _WIFIBEAT_ES_ESTIMATED_DOCUMENT_SIZE);
+	}
+
+	return true;
+}
+
+bool wifibeat::threads::elasticsearch::deliver(unsigned int sender, pendingBulk * bulk)
+{
+	bool success = false;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	// While ES is down, don't wait for each request to time out: spool it directly
+	bool trySending = true;
+	if (this->_spool) {
+		utils::Locker l(&this->_spoolMutex);
+		trySending = this->_healthy || now >= this->_retryAt;
+	}
+
+	if (trySending) {
+		bool overloaded = false;
+		success = this->send(sender, bulk->body, bulk->documents, overloaded);
+		if (overloaded) {
+			this->_controller->overloaded();
+		} else if (success) {
+			this->_controller->success(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - now));
+		}
+
+		if (this->_spool) {
+			utils::Locker l(&this->_spoolMutex);
+			if (!success) {
+				if (this->_healthy) {
+					LOG_WARN("Elasticsearch unavailable, spooling bulk requests to disk");
+				}
+				this->_healthy = false;
+				this->_retryAt = now + this->_settings.spool.retryInterval;
+			} else {
+				this->_healthy = true;
+			}
+		}
+	}
+
+	if (!success && this->_spool) {
+		utils::Locker l(&this->_spoolMutex);
+		success = this->_spool->write(bulk->body, bulk->documents);
+		if (!success) {
+			stringstream ss;
+			ss << "Failed spooling " << bulk->documents << " documents";
+			LOG_ERROR(ss.str());
+		}
+	}
+
+	return success;
+}
+
+std::chrono::milliseconds wifibeat::threads::elasticsearch::replay()
+{
+	string body;
+	unsigned int documents = 0;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::chrono::milliseconds interval(1000 / this->_settings.spool.replayRate);
+	{
+		utils::Locker l(&this->_spoolMutex);
+		if (this->_spool == NULL || this->_spool->empty()) {
+			return std::chrono::milliseconds(_WIFIBEAT_ES_SENDER_IDLE_MS);
+		}
+		if (!this->_healthy && now < this->_retryAt) {
+			return std::chrono::duration_cast<std::chrono::milliseconds>(this->_retryAt - now) + std::chrono::milliseconds(1);
+		}
+		if (now - this->_lastReplay < interval) {
+			return std::chrono::duration_cast<std::chrono::milliseconds>(this->_lastReplay + interval - now) + std::chrono::milliseconds(1);
+		}
+		this->_lastReplay = now;
+
+		if (!this->_spool->peek(body, documents)) {
+			return interval;
+		}
+	}
+
+	// Only the first sender replays, the record peeked is still the oldest when popping it
+	bool overloaded = false;
+	bool success = this->send(0, body, documents, overloaded);
+	if (overloaded) {
+		this->_controller->overloaded();
+	}
+
+	utils::Locker l(&this->_spoolMutex);
+	if (success) {
+		this->_spool->pop();
+		if (!this->_healthy) {
+			LOG_NOTICE("Elasticsearch is available again, replaying spooled bulk requests");
+		}
+		this->_healthy = true;
+		if (this->_spool->empty()) {
+			LOG_NOTICE("Done replaying spooled bulk requests");
+		}
+	} else {
+		this->_healthy = false;
+		this->_retryAt = now + this->_settings.spool.retryInterval;
+	}
+	return interval;
+}
+
+void wifibeat::threads::elasticsearch::senderLoop(unsigned int sender)
+{
+	// Signals are handled by the main thread
+	sigset_t signal_set;
+	sigemptyset(&signal_set);
+	sigaddset(&signal_set, SIGINT);
+	sigaddset(&signal_set, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signal_set, NULL);
+
+	std::chrono::milliseconds idle(_WIFIBEAT_ES_SENDER_IDLE_MS);
+	while (true) {
+		if (sender == 0) {
+			this->sniff(false);
+
+			// Whether or not there are new bulks, the spool keeps draining
+			idle = std::min(this->replay(), std::chrono::milliseconds(_WIFIBEAT_ES_SENDER_IDLE_MS));
+		}
+		this->updateConnections(sender);
+
+		pendingBulk * bulk = NULL;
+		{
+			std::unique_lock<std::mutex> lock(this->_pendingMutex);
+			// A bulk that failed holds the ones after it until it can be retried, unless stopping.
+			// Checked at least every 'idle', which is short compared to the retry interval.
+			auto ready = [this] {
+				return !this->_pending.empty() && this->_inFlight < this->_controller->Concurrency()
+					&& (this->_stopSenders || this->_pending.front()->retryAt <= std::chrono::steady_clock::now());
+			};
+			this->_pendingCondition.wait_for(lock, idle,
+				[this, &ready] { return this->_stopSenders || ready(); });
+			if (ready()) {
+				bulk = this->_pending.front();
+				this->_pending.pop_front();
+				++this->_inFlight;
+			} else if (this->_stopSenders && this->_pending.empty()) {
+				break;
+			}
+		}
+
+		if (bulk) {
+			// Sent or spooled. It only fails when neither worked.
+			bool delivered = this->deliver(sender, bulk);
+			uint64_t acknowledge = 0;
+			bool retry = false;
+			{
+				std::unique_lock<std::mutex> lock(this->_pendingMutex);
+				--this->_inFlight;
+				if (!delivered && this->_persistence && !this->_stopSenders) {
+					// Its frames are still in the persistent queue: keep trying, a little later,
+					// whichever sender picks it. Nothing after it gets acknowledged meanwhile.
+					bulk->retryAt = std::chrono::steady_clock::now() + this->_settings.spool.retryInterval;
+					this->_pending.push_front(bulk);
+					retry = true;
+				} else if (delivered) {
+					this->_unacknowledged[bulk->id - this->_firstUnacknowledged].second = true;
+					while (!this->_unacknowledged.empty() && this->_unacknowledged.front().second) {
+						if (this->_unacknowledged.front().first) {
+							acknowledge = this->_unacknowledged.front().first;
+						}
+						this->_unacknowledged.pop_front();
+						++this->_firstUnacknowledged;
+					}
+				} else {
+					// Without persistence, or when stopping (the persistent queue replays
+					// them on the next start), the documents aren't sent.
+					stringstream ss;
+					ss << bulk->documents << " documents couldn't be sent";
+					if (!this->_persistence) {
+						ss << ", they are lost";
+					}
+					LOG_ERROR(ss.str());
+				}
+				if (!retry) {
+					bulk->body.clear();
+					this->_freeBulks.push_back(bulk);
+				}
+			}
+			this->_pendingCondition.notify_all();
+			if (acknowledge && this->_persistence) {
+				this->_persistence->acknowledge(this->_persistenceOutput, acknowledge);
+			}
 		}
 	}
 }
 
 bool wifibeat::threads::elasticsearch::init_function()
 {
+	if (!this->_senders.empty()) {
+		return true;
+	}
+
+	// Shared by all connections, TLS sessions are cached in it
+	if (this->_settings.protocol == HTTPS && this->_tlsContext.isNull()) {
+		try {
+			this->_tlsContext = utils::tls::clientContext(this->_settings.ssl);
+		} catch (const string & ex) {
+			LOG_CRITICAL("Elasticsearch output TLS settings: " + ex);
+			return false;
+		}
+	}
+
 	// TODO: allow keeping invalid connection and retry from time to time
+	vector<utils::esClient *> connections;
 	for (IPPort ipp: this->_settings.hosts) {
-		string host = "://" + ipp.host + ":" + std::to_string(ipp.port);
-		if (this->_settings.protocol == HTTP) {
-			host = "http" + host;
-		} else {
-			host = "https" + host;
-		}
+		utils::esClient * conn = new utils::esClient(ipp.host, ipp.port, this->_settings, this->_tlsContext);
 		try {
-			elastic * conn = new elastic(host);
-			LOG_DEBUG("Connection successful to <" + host + ">");
-			LOG_NOTICE(host + " version: " + conn->Version());
-			this->_connections.push_back(conn);
+			conn->connect();
+			LOG_DEBUG("Connection successful to <" + conn->toString() + ">");
+			LOG_NOTICE(conn->toString() + " version: " + conn->Version());
+			connections.push_back(conn);
 		} catch (const string & ex) {
-			LOG_ERROR("Failed connecting to <" + host + ">: " + ex);
-		} catch (const std::exception & e) {
-			LOG_ERROR("Failed connecting to <" + host + ">: " + e.what());
+			LOG_ERROR("Failed connecting to <" + conn->toString() + ">: " + ex);
+			delete conn;
 		}
 	}
+	this->_connections.push_back(connections);
 
 	if (this->_settings.enabled == false) {
 		LOG_WARN("Elasticsearch connection disabled, dropping all frames!");
 	}
 
-	if (this->_connections.empty()) {
+	if (connections.empty()) {
 		LOG_CRITICAL("Not a single valid Elasticsearch host!");
 		return false;
 	}
 
+	// Not fatal, documents can still be indexed with dynamic mapping
+	this->installTemplate();
+
+	// Spool, one directory per output
+	if (this->_settings.spool.enabled && this->_spool == NULL) {
+		stringstream ss;
+		ss << this->_settings.spool.directory << '/' << this->_settings.hosts[0].host << '_' << this->_settings.hosts[0].port;
+		this->_spool = new utils::spool(ss.str(), this->_settings.spool.maxSize, this->_settings.spool.segmentSize, this->_settings.spool.compress);
+		if (!this->_spool->open()) {
+			LOG_CRITICAL("Failed opening Elasticsearch spool");
+			return false;
+		}
+		LOG_DEBUG(this->_spool->toString());
+	}
+
+	// Index routing. Versions before 7 require a document type in the action line.
+	if (this->_router == NULL) {
+		string pattern = this->_settings.index;
+		if (pattern.empty()) {
+			pattern = _WIFIBEAT_ES_INDEX_BASENAME;
+		}
+		string documentType = "";
+		if (connections[0]->MajorVersion() < 7) {
+			documentType = "doc";
+		}
+		try {
+			this->_router = new utils::indexRouter(pattern, this->_settings.indices, documentType);
+		} catch (const string & ex) {
+			LOG_CRITICAL(ex);
+			return false;
+		}
+	}
+
+	// Sensor part of the document IDs
+	const string & hostname = wifibeat::utils::beat::Instance()->Hostname();
+	this->_sensorSeed = utils::hash::murmur64(hostname.data(), hostname.size(), 0);
+
+	// Bulk size and concurrency
+	const ESAdaptiveSettings & adaptive = this->_settings.adaptive;
+	unsigned int senders = (adaptive.enabled) ? adaptive.maxConcurrency : 1;
+	this->_controller = new utils::bulkController(adaptive.enabled, this->_settings.bulkMaxSize, adaptive.minBulkSize,
+													adaptive.maxBulkSize, senders, adaptive.targetLatency,
+													this->_settings.maxDocumentsPerSecond);
+	LOG_NOTICE("Elasticsearch output: " + this->_controller->toString());
+
+	// Avoid growing the body document by document
+	this->_bulkBody.reserve(this->_controller->BulkSize() * _WIFIBEAT_ES_ESTIMATED_DOCUMENT_SIZE);
+
+	// Each sender has its own connections (they aren't thread safe), the others are created
+	// by the senders from the hosts.
+	for (utils::esClient * conn: connections) {
+		this->_hosts.push_back(IPPort(conn->Host(), conn->Port()));
+	}
+	this->_connections.resize(senders);
+	this->_senderGenerations.resize(senders, 0);
+	this->_senderPreferred.resize(senders, 0);
+	this->_roundRobin.resize(senders, 0);
+	if (this->_settings.sniffing.enabled) {
+		this->sniff(true);
+	}
+	for (unsigned int i = 0; i < senders; ++i) {
+		this->_senders.push_back(new std::thread(&elasticsearch::senderLoop, this, i));
+	}
+
 	return true;
 }
 
+void wifibeat::threads::elasticsearch::Persistence(persistence * persistence, unsigned int output)
+{
+	this->_persistence = persistence;
+	this->_persistenceOutput = output;
+}
+
 string wifibeat::threads::elasticsearch::toString()
 {
 	std::stringstream ss;
@@ -21,26 +21,130 @@
 
 #include "ThreadWithQueue.h"
 #include "PacketTimestamp.h"
+#include "persistence.h"
 #include "config/es.h"
-#include <elasticbeat-cpp/elastic.h>
+#include "utils/indexRouter.h"
+#include "utils/esClient.h"
+#include "utils/spool.h"
+#include "utils/bulkController.h"
 #include <vector>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #define _WIFIBEAT_ES_INDEX_BASENAME "wifibeat"
+#define _WIFIBEAT_ES_ESTIMATED_DOCUMENT_SIZE 2048 // Used to pre-allocate bulk body
+#define _WIFIBEAT_ES_DOCUMENT_ID_LENGTH 32 // 128 bit hash, in hex
+#define _WIFIBEAT_ES_SENDER_IDLE_MS 100 // Senders wake up at least that often
+#define _WIFIBEAT_ES_RETRY_BACKOFF_MS 100 // Before retrying rejected documents, doubled every time
 
-using beat::protocols::elastic;
 using std::vector;
 
 namespace wifibeat
 {
 	namespace threads
 	{
+		// Documents are serialized in this thread, then bulk requests are sent
+		// by one or more sender threads (more with output.elasticsearch.adaptive).
 		class elasticsearch : public ThreadWithQueue<PacketTimestamp>
 		{
 			private:
+				struct pendingBulk {
+					string body;
+					unsigned int documents;
+					unsigned long long int id; // Order of the bulks
+					uint64_t sequence; // Highest persistent queue sequence in it
+					std::chrono::steady_clock::time_point retryAt; // Not sent again before that, after a failure
+				};
+
 				ElasticSearchConnection _settings;
-				vector<elastic *> _connections;
-				pthread_mutex_t _connectionMutex;
-				bool _mutexInit;
+
+				// One set of connections per sender
+				vector<vector<utils::esClient *> > _connections;
+
+				// Hosts requests are sent to: discovered nodes first (sniffing), then the
+				// configured hosts that weren't discovered. Senders update their connections
+				// when the generation changes.
+				vector<IPPort> _hosts;
+				unsigned int _preferredHosts; // Discovered nodes, at the beginning of _hosts
+				unsigned long long _hostsGeneration;
+				pthread_mutex_t _hostsMutex;
+				bool _hostsMutexInit;
+				vector<unsigned long long> _senderGenerations;
+				vector<unsigned int> _senderPreferred;
+				vector<unsigned int> _roundRobin;
+				std::chrono::steady_clock::time_point _lastSniff;
+				Poco::Net::Context::Ptr _tlsContext; // HTTPS only
+
+				// Connections and TLS handshakes of a connection, before deleting it
+				void logStats(utils::esClient * conn);
+				utils::indexRouter * _router;
+				utils::bulkController * _controller;
+
+				// NDJSON body of the current bulk request. Documents are serialized
+				// straight into it and its memory is reused from one bulk to the next.
+				string _bulkBody;
+				unsigned int _bulkDocuments;
+				std::chrono::steady_clock::time_point _bulkStarted; // First document of the current bulk
+				uint64_t _bulkSequence;
+
+				// Frames are acknowledged to the persistence thread in order: a bulk sent by
+				// one sender is only acknowledged once the ones before it are done.
+				persistence * _persistence;
+				unsigned int _persistenceOutput;
+				unsigned long long int _nextBulkID;
+				unsigned long long int _firstUnacknowledged; // ID of _unacknowledged.front()
+				std::deque<std::pair<uint64_t, bool> > _unacknowledged; // Sequence, done
+
+				// Bulk requests waiting for a sender. Not using Locker: its timeout
+				// doesn't work with waiting for a condition.
+				std::deque<pendingBulk *> _pending;
+				vector<pendingBulk *> _freeBulks; // Sent, kept to reuse their memory
+				unsigned int _inFlight;
+				bool _stopSenders;
+				std::mutex _pendingMutex;
+				std::condition_variable _pendingCondition;
+				vector<std::thread *> _senders;
+
+				// Bulk bodies that couldn't be sent are kept on disk and replayed once ES is back
+				pthread_mutex_t _spoolMutex; // Spool and health
+				bool _spoolMutexInit;
+				utils::spool * _spool;
+				bool _healthy;
+				std::chrono::steady_clock::time_point _retryAt;
+				std::chrono::steady_clock::time_point _lastReplay;
+
+				// Document IDs (output.elasticsearch.document_id)
+				uint64_t _sensorSeed;
+				bool documentID(const PacketTimestamp * item, char * id, size_t idLength);
+
+				// Install the index template if it isn't there yet (or overwrite is set)
+				bool installTemplate();
+
+				// Get the nodes of the cluster (output.elasticsearch.sniffing)
+				bool sniff(bool force);
+
+				// Create/delete the connections of a sender after the hosts changed
+				void updateConnections(unsigned int sender);
+
+				// Send a bulk body to the first host that accepts it, starting from a different
+				// discovered node each time. overloaded is set if Elasticsearch rejected the
+				// request or some items with 429.
+				bool send(unsigned int sender, const string & body, unsigned int documents, bool & overloaded);
+
+				// Queue the current bulk body for the senders
+				bool flush();
+
+				// Sender threads: send (or spool) queued bulk requests.
+				// deliver() returns false if the bulk was neither sent nor spooled.
+				void senderLoop(unsigned int sender);
+				bool deliver(unsigned int sender, pendingBulk * bulk);
+
+				// Send the oldest spooled body, at most spool.replayRate per second, in
+				// between new bulks. Returns how long until the next one is due.
+				std::chrono::milliseconds replay();
 
 			public:
 				explicit elasticsearch(const ElasticSearchConnection & connection);
@@ -49,6 +153,8 @@ namespace wifibeat
 				virtual void recurring();
 				virtual bool init_function();
 
+				// Acknowledge frames to the persistence thread, as output
+				void Persistence(persistence * persistence, unsigned int output);
 		};
 
 	}
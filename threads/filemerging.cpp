@@ -0,0 +1,335 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "filemerging.h"
+#include "utils/file.h"
+#include "utils/logger.h"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+#define _WIFIBEAT_FILEMERGING_READ_CHUNK 64 // Frames read before handing them to the merge
+
+using std::stringstream;
+
+bool wifibeat::threads::mergeHeadLater::operator()(const mergeHead & a, const mergeHead & b) const
+{
+	struct timespec ta = a.frame->getTimespec();
+	struct timespec tb = b.frame->getTimespec();
+	if (ta.tv_sec != tb.tv_sec) {
+		return ta.tv_sec > tb.tv_sec;
+	}
+	if (ta.tv_nsec != tb.tv_nsec) {
+		return ta.tv_nsec > tb.tv_nsec;
+	}
+	// Same time: keep the order of the files in the configuration
+	return a.input > b.input;
+}
+
+wifibeat::threads::filemerging::filemerging(const vector<string> & files, unsigned int readAhead)
+	: _readAhead((readAhead) ? readAhead : 1), _stopReaders(false), _dropped(0), _pacer(NULL)
+{
+	this->Name("filemerging");
+	for (const string & file: files) {
+		this->_inputs.push_back(new mergeInput(file));
+	}
+}
+
+wifibeat::threads::filemerging::~filemerging()
+{
+	this->stopReaders();
+	delete this->_pacer;
+	while (!this->_heap.empty()) {
+		delete this->_heap.top().frame;
+		this->_heap.pop();
+	}
+	for (mergeInput * input: this->_inputs) {
+		for (PacketTimestamp * pts: input->buffer) {
+			delete pts;
+		}
+		if (input->handle) {
+			pcap_close(input->handle);
+		}
+		delete input->stream;
+		delete input->filter;
+		delete input;
+	}
+}
+
+void wifibeat::threads::filemerging::stopReaders()
+{
+	this->_stopReaders = true;
+	for (mergeInput * input: this->_inputs) {
+		if (input->reader == NULL) {
+			continue;
+		}
+		{
+			std::lock_guard<std::mutex> lock(input->mutex);
+			input->condition.notify_all();
+		}
+		input->reader->join();
+		delete input->reader;
+		input->reader = NULL;
+	}
+}
+
+bool wifibeat::threads::filemerging::init_function()
+{
+	if (!this->_waiting.empty() || !this->_heap.empty()) {
+		return true;
+	}
+
+	for (mergeInput * input: this->_inputs) {
+		stringstream ss;
+		if (input->file != PCAPSTREAM_STDIN && !wifibeat::utils::file::exists(input->file)) {
+			ss << "File <" << input->file << "> does not exists.";
+			LOG_ERROR(ss.str());
+			return false;
+		}
+
+		if (utils::pcapStream::needed(input->file)) {
+			// Link type is checked for each frame
+			input->stream = new utils::pcapStream();
+			if (!input->stream->open(input->file)) {
+				LOG_ERROR(input->stream->Error());
+				return false;
+			}
+			input->stream->Interrupt([this] { return this->_stopReaders.load(); });
+			continue;
+		}
+
+		char errbuf[PCAP_ERRBUF_SIZE];
+		input->handle = pcap_open_offline(input->file.c_str(), errbuf);
+		if (input->handle == NULL) {
+			ss << "Failed opening file <" << input->file << ">: " << errbuf;
+			LOG_ERROR(ss.str());
+			return false;
+		}
+
+		// Make sure we're getting wifi frames
+		input->linkType = pcap_datalink(input->handle);
+		if (input->linkType != DLT_IEEE802_11_RADIO && input->linkType != DLT_IEEE802_11) {
+			ss << "Invalid link type for <" << input->file << ">: " << input->linkType;
+			LOG_ERROR(ss.str());
+			return false;
+		}
+		if (input->filter && !input->filter->compile(input->linkType)) {
+			LOG_ERROR(input->filter->Error());
+			return false;
+		}
+	}
+
+	// Start reading ahead right away
+	for (size_t i = 0; i < this->_inputs.size(); ++i) {
+		this->_inputs[i]->reader = new std::thread(&filemerging::read, this, this->_inputs[i]);
+		this->_waiting.push_back(i);
+	}
+
+	stringstream ss;
+	ss << "Merging " << this->_inputs.size() << " files by capture time, reading up to "
+		<< this->_readAhead << " frames ahead in each";
+	LOG_NOTICE(ss.str());
+
+	return true;
+}
+
+void wifibeat::threads::filemerging::read(mergeInput * input)
+{
+	vector<PacketTimestamp *> chunk;
+	chunk.reserve(_WIFIBEAT_FILEMERGING_READ_CHUNK);
+	bool eof = false;
+	while (!eof && !this->_stopReaders) {
+		// Wait for room in the buffer
+		{
+			std::unique_lock<std::mutex> lock(input->mutex);
+			input->condition.wait(lock, [this, input] {
+				return this->_stopReaders || input->buffer.size() < this->_readAhead;
+			});
+		}
+
+		// Read outside of the lock, the merge keeps going meanwhile
+		while (input->stream && chunk.size() < _WIFIBEAT_FILEMERGING_READ_CHUNK) {
+			utils::pcapRecord record;
+			if (!input->stream->next(record)) {
+				if (!input->stream->Error().empty()) {
+					LOG_ERROR(input->stream->Error());
+				}
+				eof = true;
+				break;
+			}
+			if (record.linkType != DLT_IEEE802_11_RADIO && record.linkType != DLT_IEEE802_11) {
+				continue;
+			}
+			if (input->filter && !input->filter->matches(record.linkType, record.data, record.length, record.length)) {
+				++input->filtered;
+				continue;
+			}
+			chunk.push_back(new PacketTimestamp(record.data, record.length, record.linkType, record.ts));
+		}
+		while (input->handle && !eof && chunk.size() < _WIFIBEAT_FILEMERGING_READ_CHUNK) {
+			struct pcap_pkthdr * header = NULL;
+			const u_char * data = NULL;
+			int ret = pcap_next_ex(input->handle, &header, &data);
+			if (ret != 1) {
+				if (ret == PCAP_ERROR) {
+					LOG_ERROR("Failed reading <" + input->file + ">: " + pcap_geterr(input->handle));
+				}
+				eof = true;
+				break;
+			}
+			if (input->filter && !input->filter->matches(input->linkType, data, header->caplen, header->len)) {
+				++input->filtered;
+				continue;
+			}
+			struct timespec ts = { header->ts.tv_sec, header->ts.tv_usec * 1000 };
+			chunk.push_back(new PacketTimestamp(data, header->caplen, input->linkType, ts));
+		}
+
+		std::lock_guard<std::mutex> lock(input->mutex);
+		input->buffer.insert(input->buffer.end(), chunk.begin(), chunk.end());
+		input->frames += chunk.size();
+		input->eof = eof;
+		chunk.clear();
+		input->condition.notify_all();
+	}
+
+	// Stopped before the end
+	for (PacketTimestamp * pts: chunk) {
+		delete pts;
+	}
+}
+
+bool wifibeat::threads::filemerging::next(size_t index, bool wait)
+{
+	mergeInput * input = this->_inputs[index];
+	std::unique_lock<std::mutex> lock(input->mutex);
+	if (wait && input->buffer.empty() && !input->eof) {
+		// Don't block for long, so the thread can still be stopped
+		input->condition.wait_for(lock, std::chrono::milliseconds(100));
+	}
+
+	if (input->buffer.empty()) {
+		if (input->eof) {
+			stringstream ss;
+			ss << "Finished reading <" << input->file << ">: " << input->frames << " frames";
+			LOG_NOTICE(ss.str());
+			return true;
+		}
+		return false;
+	}
+
+	mergeHead head = { input->buffer.front(), index };
+	input->buffer.pop_front();
+	input->condition.notify_all();
+	lock.unlock();
+
+	this->_heap.push(head);
+	return true;
+}
+
+void wifibeat::threads::filemerging::recurring()
+{
+	// Every file that isn't done must have its next frame in the heap
+	// before the earliest one can be sent.
+	while (!this->_waiting.empty()) {
+		if (!this->next(this->_waiting.back(), true)) {
+			return;
+		}
+		this->_waiting.pop_back();
+	}
+
+	for (unsigned int i = 0; i < _WIFIBEAT_FILEMERGING_FRAMES_PER_LOOP && !this->_heap.empty(); ++i) {
+		mergeHead head = this->_heap.top();
+		if (this->_pacer) {
+			std::chrono::nanoseconds delay = this->_pacer->delay(head.frame->getTimespec());
+			if (delay.count() > 0) {
+				std::this_thread::sleep_for(std::min(delay, std::chrono::nanoseconds(_WIFIBEAT_REPLAY_MAX_SLEEP_NS)));
+				return;
+			}
+			this->_pacer->sent();
+		}
+		this->_heap.pop();
+		if (!this->sendToNextThreadsQueueWaiting(head.frame)) {
+			++this->_dropped;
+		}
+
+		if (!this->next(head.input, false)) {
+			// Reader is behind, wait for it on the next loop
+			this->_waiting.push_back(head.input);
+			return;
+		}
+	}
+
+	if (this->_heap.empty() && this->_waiting.empty()) {
+		this->stopReaders();
+		stringstream ss;
+		ss << "Finished merging " << this->_inputs.size() << " files";
+		if (this->_dropped) {
+			ss << ", " << this->_dropped << " frames dropped";
+		}
+		unsigned long long int filtered = 0;
+		for (mergeInput * input: this->_inputs) {
+			filtered += input->filtered;
+		}
+		if (filtered) {
+			ss << ", " << filtered << " frames filtered out";
+		}
+		LOG_NOTICE(ss.str());
+		this->ThreadFinished();
+	}
+}
+
+string wifibeat::threads::filemerging::toString()
+{
+	stringstream ss;
+	ss << "Merged files <";
+	for (size_t i = 0; i < this->_inputs.size(); ++i) {
+		if (i) {
+			ss << ", ";
+		}
+		ss << this->_inputs[i]->file;
+	}
+	ss << '>';
+	if (this->_pacer) {
+		if (this->_pacer->Rate()) {
+			ss << " - Replay at " << this->_pacer->Rate() << " frames/s";
+		} else {
+			ss << " - Replay at " << this->_pacer->Speed() << "x";
+		}
+	}
+	return ss.str();
+}
+
+void wifibeat::threads::filemerging::Filter(const string & file, const string & expression)
+{
+	for (mergeInput * input: this->_inputs) {
+		if (input->file == file) {
+			delete input->filter;
+			input->filter = (expression.empty()) ? NULL : new utils::bpfFilter(expression);
+		}
+	}
+}
+
+void wifibeat::threads::filemerging::Replay(double speed, unsigned int rate)
+{
+	delete this->_pacer;
+	this->_pacer = NULL;
+	if (speed > 0 || rate) {
+		this->_pacer = new utils::replayPacer(speed, rate);
+	}
+}
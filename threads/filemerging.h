@@ -0,0 +1,110 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Reads several capture files at once and sends their frames in capture time
+// order, as if they were a single file. Each file is read ahead by its own thread
+// into a bounded buffer; frames are merged with a min-heap holding the next
+// frame of each file.
+#ifndef THREAD_FILEMERGING_H
+#define THREAD_FILEMERGING_H
+
+#include "ThreadWithQueue.h"
+#include "PacketTimestamp.h"
+#include "utils/pcapStream.h"
+#include "utils/replayPacer.h"
+#include "utils/bpfFilter.h"
+#include <pcap.h>
+#include <deque>
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+#define _WIFIBEAT_FILEMERGING_FRAMES_PER_LOOP 1024 // Frames merged per loop, at most
+
+namespace wifibeat
+{
+	namespace threads
+	{
+		struct mergeInput {
+			string file;
+			pcap_t * handle;
+			int linkType;
+			utils::pcapStream * stream; // pcapng and compressed files, instead of handle
+			utils::bpfFilter * filter; // Only used by the reader thread
+			unsigned long long int filtered;
+
+			// Read ahead by the reader thread
+			std::deque<PacketTimestamp *> buffer;
+			std::mutex mutex;
+			std::condition_variable condition;
+			bool eof;
+			std::thread * reader;
+
+			unsigned long long int frames;
+			mergeInput(const string & path) : file(path), handle(NULL), linkType(0), stream(NULL), filter(NULL), filtered(0),
+												eof(false), reader(NULL), frames(0) { }
+		};
+
+		// Next frame of an input, in the heap
+		struct mergeHead {
+			PacketTimestamp * frame;
+			size_t input;
+		};
+
+		struct mergeHeadLater {
+			bool operator()(const mergeHead & a, const mergeHead & b) const;
+		};
+
+		class filemerging : public ThreadWithQueue<PacketTimestamp>
+		{
+			private:
+				vector<mergeInput *> _inputs;
+				unsigned int _readAhead;
+				std::atomic<bool> _stopReaders;
+
+				std::priority_queue<mergeHead, vector<mergeHead>, mergeHeadLater> _heap;
+				// Inputs without a frame in the heap that aren't done yet.
+				// Nothing can be merged until they have one.
+				vector<size_t> _waiting;
+				unsigned long long int _dropped;
+				utils::replayPacer * _pacer; // Replay the merged frames at capture timing or a fixed rate
+
+				void read(mergeInput * input);
+				void stopReaders();
+
+				// Moves the next frame of the input to the heap. Returns false if it
+				// has to be waited for.
+				bool next(size_t input, bool wait);
+
+			public:
+				filemerging(const vector<string> & files, unsigned int readAhead);
+				~filemerging();
+				virtual string toString();
+				virtual void recurring();
+				virtual bool init_function();
+				void Replay(double speed, unsigned int rate);
+				void Filter(const string & file, const string & expression);
+		};
+
+	}
+
+}
+
+#endif // THREAD_FILEMERGING_H
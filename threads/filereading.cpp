@@ -20,9 +20,13 @@
 #include "utils/file.h"
 #include "utils/logger.h"
 #include <exception>
+#include <algorithm>
+#include <thread>
 
 wifibeat::threads::filereading::filereading(const string & file, const string & filter)
-	: _file(file), _filter(filter), _sniffer(NULL), _string("")
+	: _file(file), _filter(filter), _sniffer(NULL), _batchSize(_WIFIBEAT_CAPTURE_DEFAULT_BATCH_SIZE),
+		_stream(NULL), _skipped(0), _bpf(NULL), _filtered(0), _records(0),
+		_checkpoint(NULL), _checkpointFile(0), _pacer(NULL), _loop(false), _pending(false), _loops(0), _string("")
 {
 	this->Name("filereading");
 }
@@ -30,21 +34,201 @@ wifibeat::threads::filereading::filereading(const string & file, const string &
 wifibeat::threads::filereading::~filereading()
 {
 	delete this->_sniffer;
+	delete this->_stream;
+	delete this->_pacer;
+	delete this->_bpf;
 }
 
 void wifibeat::threads::filereading::recurring()
 {
-	// Get packet
-	//Tins::PtrPacket packet();
-	Tins::PDU * packet = this->_sniffer->next_packet();
-	if (packet == NULL) {
-		// EOF: https://github.com/mfontanini/libtins/issues/95#issuecomment-130759119
-		this->ThreadFinished();
-		LOG_NOTICE("Finished reading <" + this->_file + ">");
+	if (this->_pacer) {
+		this->replay();
 		return;
 	}
-	PacketTimestamp * pts = new PacketTimestamp(packet);
-	this->sendToNextThreadsQueue(pts);
+
+	if (this->dispatch(this->_batchSize) > 0) {
+		return;
+	}
+
+	this->finished();
+}
+
+void wifibeat::threads::filereading::finished()
+{
+	this->ThreadFinished();
+	stringstream ss;
+	ss << "Finished reading <" << this->_file << ">: " << this->Statistics();
+	if (this->_skipped) {
+		ss << ", " << this->_skipped << " skipped (not 802.11)";
+	}
+	if (this->_filtered) {
+		ss << ", " << this->_filtered << " filtered out";
+	}
+	if (this->_pacer) {
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - this->_replayStarted;
+		ss << ", replayed in " << elapsed.count() << "s";
+		if (elapsed.count() > 0) {
+			ss << " (" << (unsigned long long int)(this->_frames / elapsed.count()) << " frames/s)";
+		}
+	}
+	LOG_NOTICE(ss.str());
+}
+
+void wifibeat::threads::filereading::replay()
+{
+	if (this->_frames == 0 && this->_loops == 0 && !this->_pending) {
+		this->_replayStarted = std::chrono::steady_clock::now();
+	}
+
+	for (int i = 0; i < this->_batchSize; ++i) {
+		if (!this->_pending) {
+			if (!this->nextRecord()) {
+				// Start over, unless nothing could be read
+				if (this->_loop && this->_frames && this->reopen()) {
+					++this->_loops;
+					this->_pacer->restart();
+					LOG_INFO("Replaying <" + this->_file + "> again (" + std::to_string(this->_loops) + " loops so far)");
+					return;
+				}
+				this->finished();
+				return;
+			}
+			this->_pending = true;
+		}
+
+		std::chrono::nanoseconds delay = this->_pacer->delay(this->_record.ts);
+		if (delay.count() > 0) {
+			// Sleep a little at a time, so long gaps in the capture don't delay stopping
+			std::this_thread::sleep_for(std::min(delay, std::chrono::nanoseconds(_WIFIBEAT_REPLAY_MAX_SLEEP_NS)));
+			return;
+		}
+
+		this->_pending = false;
+		this->_pacer->sent();
+		++this->_frames;
+		PacketTimestamp * pts = new PacketTimestamp(this->_record.data, this->_record.length, this->_record.linkType, this->_record.ts);
+		this->checkpoint(pts);
+		if (!this->sendToNextThreadsQueueWaiting(pts)) {
+			++this->_dropped;
+		}
+	}
+}
+
+bool wifibeat::threads::filereading::nextRecord()
+{
+	if (this->_stream) {
+		while (this->_stream->next(this->_record)) {
+			++this->_records;
+			if (this->_record.linkType != DLT_IEEE802_11_RADIO && this->_record.linkType != DLT_IEEE802_11) {
+				++this->_skipped;
+			} else if (this->corrupted(this->_record.linkType, this->_record.data, this->_record.length)) {
+				++this->_frames;
+			} else if (this->_bpf && !this->_bpf->matches(this->_record.linkType, this->_record.data, this->_record.length, this->_record.length)) {
+				++this->_frames;
+				++this->_filtered;
+			} else {
+				return true;
+			}
+		}
+		if (!this->_stream->Error().empty()) {
+			LOG_ERROR(this->_stream->Error());
+		}
+		return false;
+	}
+
+	struct pcap_pkthdr * header = NULL;
+	const u_char * data = NULL;
+	int ret;
+	while ((ret = pcap_next_ex(this->_pcapHandle, &header, &data)) == 1) {
+		if (this->corrupted(this->_linkType, data, header->caplen)) {
+			++this->_frames;
+			continue;
+		}
+		if (this->_bpf == NULL || this->_bpf->matches(this->_linkType, data, header->caplen, header->len)) {
+			break;
+		}
+		++this->_frames;
+		++this->_filtered;
+	}
+	if (ret != 1) {
+		if (ret == PCAP_ERROR) {
+			LOG_ERROR("Failed reading <" + this->_file + ">: " + string(pcap_geterr(this->_pcapHandle)));
+		}
+		return false;
+	}
+
+	// Valid until the next call
+	this->_record.ts.tv_sec = header->ts.tv_sec;
+	this->_record.ts.tv_nsec = header->ts.tv_usec * 1000;
+	this->_record.data = data;
+	this->_record.length = header->caplen;
+	this->_record.linkType = this->_linkType;
+	this->_record.interface = 0;
+	return true;
+}
+
+bool wifibeat::threads::filereading::reopen()
+{
+	delete this->_sniffer;
+	this->_sniffer = NULL;
+	this->_pcapHandle = NULL;
+	delete this->_stream;
+	this->_stream = NULL;
+	return this->init_function();
+}
+
+int wifibeat::threads::filereading::dispatch(int max)
+{
+	if (this->_stream == NULL) {
+		return captureSource::dispatch(max);
+	}
+
+	int count = 0;
+	utils::pcapRecord record;
+	while (count < max && this->_stream->next(record)) {
+		++count;
+		++this->_records;
+		// pcapng files can have interfaces of any type
+		if (record.linkType != DLT_IEEE802_11_RADIO && record.linkType != DLT_IEEE802_11) {
+			++this->_skipped;
+			continue;
+		}
+		++this->_frames;
+		if (this->corrupted(record.linkType, record.data, record.length)) {
+			continue;
+		}
+		if (this->_bpf && !this->_bpf->matches(record.linkType, record.data, record.length, record.length)) {
+			++this->_filtered;
+			continue;
+		}
+		PacketTimestamp * pts = new PacketTimestamp(record.data, record.length, record.linkType, record.ts);
+		this->checkpoint(pts);
+		if (!this->sendToNextThreadsQueueWaiting(pts)) {
+			++this->_dropped;
+		}
+	}
+
+	if (count == 0 && !this->_stream->Error().empty()) {
+		LOG_ERROR(this->_stream->Error());
+		return -1;
+	}
+	return count;
+}
+
+bool wifibeat::threads::filereading::frame(const struct pcap_pkthdr * header, const u_char * data)
+{
+	// Filtered out before anything gets dissected
+	if (this->_bpf && !this->_bpf->matches(this->_linkType, data, header->caplen, header->len)) {
+		++this->_filtered;
+		return true;
+	}
+
+	// Get raw frame, it gets dissected in the thread that needs it.
+	// Use the time the frame was captured, not the time it was read.
+	struct timespec ts = { header->ts.tv_sec, header->ts.tv_usec * 1000 };
+	PacketTimestamp * pts = new PacketTimestamp(data, header->caplen, this->_linkType, ts);
+	this->checkpoint(pts);
+	return this->sendToNextThreadsQueueWaiting(pts);
 }
 
 bool wifibeat::threads::filereading::init_function()
@@ -53,12 +237,34 @@ bool wifibeat::threads::filereading::init_function()
 	if (this->_sniffer) {
 		return true;
 	}
-	if (!wifibeat::utils::file::exists(this->_file)) {
+	if (this->_stream) {
+		return true;
+	}
+	if (this->_file != PCAPSTREAM_STDIN && !wifibeat::utils::file::exists(this->_file)) {
 		ss << "File <" << this->_file << "> does not exists.";
 		LOG_ERROR(ss.str());
 		return false;
 	}
 
+	if (!this->_filter.empty() && this->_bpf == NULL) {
+		this->_bpf = new utils::bpfFilter(this->_filter);
+	}
+
+	// libpcap can't read compressed files and only reads pcapng files with a single link type.
+	// Standard input and named pipes are read the same way.
+	if (utils::pcapStream::needed(this->_file)) {
+		this->_stream = new utils::pcapStream();
+		this->_stream->Interrupt([this] { return this->Status() == Stopping; });
+		if (!this->_stream->open(this->_file)) {
+			LOG_ERROR(this->_stream->Error());
+			delete this->_stream;
+			this->_stream = NULL;
+			return false;
+		}
+		LOG_NOTICE("Created file reader for <" + this->_file + "> (" + this->_stream->Format() + ")");
+		return this->resume();
+	}
+
 	try {
 		this->_sniffer = new Tins::FileSniffer(this->_file);
 	} catch (const std::exception & e) {
@@ -78,12 +284,84 @@ bool wifibeat::threads::filereading::init_function()
 		this->_sniffer = NULL;
 		return false;
 	}
+	this->_linkType = linktype;
+	this->_pcapHandle = this->_sniffer->get_pcap_handle();
+
+	if (this->_bpf && !this->_bpf->compile(linktype)) {
+		LOG_ERROR(this->_bpf->Error());
+		delete this->_sniffer;
+		this->_sniffer = NULL;
+		this->_pcapHandle = NULL;
+		return false;
+	}
 
 	LOG_NOTICE("Link type for <" + this->_file + ">: " + std::to_string(linktype));
 
+	return this->resume();
+}
+
+bool wifibeat::threads::filereading::resume()
+{
+	if (this->_checkpoint == NULL || this->_frames || this->_records) {
+		return true;
+	}
+	// Nothing to resume, the data is gone
+	if (utils::pcapStream::pipe(this->_file)) {
+		this->_checkpoint = NULL;
+		return true;
+	}
+	this->_checkpointFile = this->_checkpoint->track(this->_file);
+	unsigned long long int position = this->_checkpoint->position(this->_file);
+	if (position == 0) {
+		return true;
+	}
+
+	stringstream ss;
+	if (this->_stream) {
+		// Can't seek into those, skip the records that were already read
+		utils::pcapRecord record;
+		while (this->_records < position && this->_stream->next(record)) {
+			++this->_records;
+		}
+		if (this->_records < position) {
+			LOG_ERROR("<" + this->_file + "> is shorter than its checkpoint: " + this->_stream->Error());
+			return false;
+		}
+		ss << "Resuming <" << this->_file << "> after " << position << " records";
+	} else {
+		FILE * f = pcap_file(this->_pcapHandle);
+		if (f == NULL || position < PCAP_FILE_HEADER_SIZE || fseeko(f, (off_t)position, SEEK_SET) != 0) {
+			ss << "Failed resuming <" << this->_file << "> at byte " << position;
+			LOG_ERROR(ss.str());
+			return false;
+		}
+		ss << "Resuming <" << this->_file << "> at byte " << position;
+	}
+	LOG_NOTICE(ss.str());
 	return true;
 }
 
+void wifibeat::threads::filereading::checkpoint(PacketTimestamp * pts)
+{
+	if (this->_checkpointFile == 0) {
+		return;
+	}
+
+	// Position of the next record: the one of this frame was just read
+	unsigned long long int position;
+	if (this->_stream) {
+		position = this->_records;
+	} else {
+		FILE * f = pcap_file(this->_pcapHandle);
+		off_t offset = (f) ? ftello(f) : -1;
+		if (offset < 0) {
+			return;
+		}
+		position = (unsigned long long int)offset;
+	}
+	pts->Checkpoint(this->_checkpoint, this->_checkpointFile, position);
+}
+
 string wifibeat::threads::filereading::toString()
 {
 	if (this->_file.empty()) {
@@ -98,8 +376,39 @@ string wifibeat::threads::filereading::toString()
 			ss << " - Filter <" << this->_filter << '>';
 		}
 
+		if (this->_pacer) {
+			if (this->_pacer->Rate()) {
+				ss << " - Replay at " << this->_pacer->Rate() << " frames/s";
+			} else {
+				ss << " - Replay at " << this->_pacer->Speed() << "x";
+			}
+			if (this->_loop) {
+				ss << ", looping";
+			}
+		}
+
 		this->_string = ss.str();
 	}
 
 	return this->_string;
-}
\ No newline at end of file
+}
+void wifibeat::threads::filereading::BatchSize(int size)
+{
+	this->_batchSize = (size > 0) ? size : _WIFIBEAT_CAPTURE_DEFAULT_BATCH_SIZE;
+}
+
+void wifibeat::threads::filereading::Checkpoint(utils::fileCheckpoint * checkpoint)
+{
+	this->_checkpoint = checkpoint;
+}
+
+void wifibeat::threads::filereading::Replay(double speed, unsigned int rate, bool loop)
+{
+	delete this->_pacer;
+	this->_pacer = NULL;
+	if (speed > 0 || rate) {
+		this->_pacer = new utils::replayPacer(speed, rate);
+	}
+	this->_loop = loop;
+	this->_string = "";
+}
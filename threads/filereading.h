@@ -21,6 +21,12 @@
 
 #include "ThreadWithQueue.h"
 #include "PacketTimestamp.h"
+#include "captureSource.h"
+#include "utils/pcapStream.h"
+#include "utils/replayPacer.h"
+#include "utils/bpfFilter.h"
+#include "utils/fileCheckpoint.h"
+#include "utils/pcapFormat.h"
 #include <tins/sniffer.h>
 #include <tins/tins.h>
 
@@ -28,23 +34,56 @@ namespace wifibeat
 {
 	namespace threads
 	{
-		class filereading : public ThreadWithQueue<PacketTimestamp>
+		class filereading : public ThreadWithQueue<PacketTimestamp>, public captureSource
 		{
 			private:
 				string _file;
 				string _filter;
 
 				Tins::FileSniffer * _sniffer;
+				int _batchSize;
+
+				// pcapng and compressed files
+				utils::pcapStream * _stream;
+				unsigned long long int _skipped; // Not 802.11
+				utils::bpfFilter * _bpf;
+				unsigned long long int _filtered;
+				unsigned long long int _records; // Read from _stream, including the skipped ones
+
+				// Resume where the previous run stopped. Frames are tagged with the
+				// position after them, saved once the outputs acknowledged them.
+				utils::fileCheckpoint * _checkpoint;
+				unsigned int _checkpointFile;
+				bool resume();
+				void checkpoint(PacketTimestamp * pts);
+
+				// Replay at capture timing or at a fixed rate, on its own thread
+				utils::replayPacer * _pacer;
+				bool _loop;
+				bool _pending; // _record read but not sent yet
+				utils::pcapRecord _record;
+				unsigned long long int _loops;
+				std::chrono::steady_clock::time_point _replayStarted;
+				void replay();
+				bool nextRecord(); // Skips non-802.11 frames
+				bool reopen();
+				void finished();
 
 				string _string;
 
+			protected:
+				virtual bool frame(const struct pcap_pkthdr * header, const u_char * data);
+
 			public:
 				filereading(const string & file, const string & filter);
 				~filereading();
 				virtual string toString();
 				virtual void recurring();
 				virtual bool init_function();
-
+				void BatchSize(int size);
+				void Replay(double speed, unsigned int rate, bool loop);
+				void Checkpoint(utils::fileCheckpoint * checkpoint);
+				virtual int dispatch(int max);
 		};
 
 	}
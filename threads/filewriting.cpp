@@ -25,7 +25,8 @@
 using std::stringstream;
 
 wifibeat::threads::filewriting::filewriting(const string & interface, const string & filePrefix) 
-	: _string(""), _interface(interface), _filePrefix(filePrefix), _packet_writer(NULL)
+	: _string(""), _interface(interface), _filePrefix(filePrefix), _pcap(NULL), _dumper(NULL), _linkType(-1),
+		_skipped(0), _index(NULL)
 {
 	this->Name("File Writing");
 	if (pthread_mutex_init(&this->_mutex, NULL) != 0) {
@@ -39,11 +40,70 @@ wifibeat::threads::filewriting::~filewriting()
 {
 	if (this->_mutexInit) {
 		wifibeat::utils::Locker * l = new wifibeat::utils::Locker(&this->_mutex);
-		delete this->_packet_writer;
+		this->close();
 		delete l;
 		pthread_mutex_destroy(&this->_mutex);
 	} else {
-		delete this->_packet_writer;
+		this->close();
+	}
+	delete this->_index;
+}
+
+bool wifibeat::threads::filewriting::open(int linkType)
+{
+	this->_pcap = pcap_open_dead(linkType, 262144);
+	if (this->_pcap == NULL) {
+		LOG_ERROR("Failed creating output PCAP file <" + this->_filename + ">");
+		return false;
+	}
+	this->_dumper = pcap_dump_open(this->_pcap, this->_filename.c_str());
+	if (this->_dumper == NULL) {
+		LOG_ERROR("Failed creating output PCAP file <" + this->_filename + ">: " + pcap_geterr(this->_pcap));
+		pcap_close(this->_pcap);
+		this->_pcap = NULL;
+		return false;
+	}
+	this->_linkType = linkType;
+	this->_indexWritten = std::chrono::steady_clock::now();
+	return true;
+}
+
+bool wifibeat::threads::filewriting::writeIndex(string & error)
+{
+	// Only what is in the file
+	pcap_dump_flush(this->_dumper);
+	long size = pcap_dump_ftell(this->_dumper);
+	this->_indexWritten = std::chrono::steady_clock::now();
+	if (size <= 0) {
+		return true;
+	}
+	return this->_index->write(this->_filename + PCAPINDEX_EXTENSION, (uint64_t)size, this->_linkType, error);
+}
+
+void wifibeat::threads::filewriting::close()
+{
+	if (this->_dumper == NULL) {
+		return;
+	}
+
+	if (this->_index) {
+		string error;
+		if (this->writeIndex(error)) {
+			LOG_INFO("Wrote index of <" + this->_filename + ">");
+		} else {
+			LOG_ERROR(error);
+		}
+	}
+
+	pcap_dump_close(this->_dumper);
+	this->_dumper = NULL;
+	pcap_close(this->_pcap);
+	this->_pcap = NULL;
+
+	if (this->_skipped) {
+		stringstream ss;
+		ss << this->_skipped << " frames were not written to <" << this->_filename << ">, their link type is different";
+		LOG_WARN(ss.str());
 	}
 }
 
@@ -71,14 +131,7 @@ bool wifibeat::threads::filewriting::init_function()
 		<< ".pcap";
 	this->_filename = ss.str();
 
-	wifibeat::utils::Locker l(&this->_mutex);
-	try {
-		this->_packet_writer = new PacketWriter(this->_filename, Tins::DataLinkType<Tins::RadioTap>());
-	} catch (...) {
-		LOG_ERROR("Failed creating output PCAP file <" + this->_filename + ">");
-		return false;
-	}
-
+	// The file itself is created with the first frame
 	return true;
 }
 
@@ -94,15 +147,40 @@ void wifibeat::threads::filewriting::recurring()
 			continue;
 		}
 
-		// 2. Write to file
+		// 2. Write to file, as captured
 		wifibeat::utils::Locker l(&this->_mutex);
-		if (this->_packet_writer != NULL) {
-			this->_packet_writer->write(*(item->getPDU()));
+		int linkType = item->getLinkType();
+		if (this->_dumper == NULL && this->_linkType == -1 && !this->open(linkType)) {
+			this->_linkType = -2; // Don't try again
+		}
+		if (this->_dumper != NULL && linkType == this->_linkType) {
+			struct timespec ts = item->getTimespec();
+			struct pcap_pkthdr header;
+			header.ts.tv_sec = ts.tv_sec;
+			header.ts.tv_usec = ts.tv_nsec / 1000;
+			header.caplen = (uint32_t)item->getRawLength();
+			header.len = item->WireLength();
+			long offset = pcap_dump_ftell(this->_dumper);
+			pcap_dump((u_char *)this->_dumper, &header, item->getRawData());
+			if (this->_index && offset >= 0) {
+				this->_index->add((uint64_t)offset, ts, linkType, item->getRawData(), header.caplen);
+			}
+		} else if (this->_dumper != NULL) {
+			++this->_skipped;
 		}
 
 		// 3. Put the decrypted packet in the queue
 		this->sendToNextThreadsQueue(item);
 	}
+
+	if (this->_index && this->_dumper != NULL
+			&& std::chrono::steady_clock::now() - this->_indexWritten >= std::chrono::seconds(_WIFIBEAT_FILEWRITING_INDEX_INTERVAL_SEC)) {
+		wifibeat::utils::Locker l(&this->_mutex);
+		string error;
+		if (!this->writeIndex(error)) {
+			LOG_ERROR(error);
+		}
+	}
 }
 
 string wifibeat::threads::filewriting::toString()
@@ -130,3 +208,9 @@ string wifibeat::threads::filewriting::Interface()
 {
 	return this->_interface;
 }
+
+void wifibeat::threads::filewriting::Index(bool enabled)
+{
+	delete this->_index;
+	this->_index = (enabled) ? new utils::pcapIndexBuilder() : NULL;
+}
@@ -20,13 +20,16 @@
 #define THREAD_FILEWRITING_H
 
 #include <string>
-#include <tins/packet_writer.h>
+#include <pcap.h>
 #include <pthread.h>
+#include <chrono>
 #include "ThreadWithQueue.h"
 #include "PacketTimestamp.h"
+#include "utils/pcapIndex.h"
 
 using std::string;
-using Tins::PacketWriter;
+
+#define _WIFIBEAT_FILEWRITING_INDEX_INTERVAL_SEC 60
 
 namespace wifibeat
 {
@@ -43,12 +46,27 @@ namespace wifibeat
 				
 				pthread_mutex_t _mutex;
 				bool _mutexInit;
-				PacketWriter * _packet_writer;
+
+				// Frames are written as captured, with their capture time. The file
+				// is created with the link type of the first frame.
+				pcap_t * _pcap;
+				pcap_dumper_t * _dumper;
+				int _linkType;
+				unsigned long long int _skipped; // Other link type
+
+				// Written again every interval while capturing, a crash only loses the end of it
+				utils::pcapIndexBuilder * _index;
+				std::chrono::steady_clock::time_point _indexWritten;
+				bool writeIndex(string & error);
+
+				bool open(int linkType);
+				void close();
 
 			public:
 				filewriting(const string & interface, const string & filePrefix);
 				~filewriting();
 				string Interface();
+				void Index(bool enabled);
 				
 				virtual string toString();
 				virtual void recurring();
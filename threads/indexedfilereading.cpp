@@ -0,0 +1,240 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "indexedfilereading.h"
+#include "utils/logger.h"
+#include <pcap.h>
+#include <algorithm>
+#include <sstream>
+
+#define _WIFIBEAT_INDEXEDFILEREADING_CHUNK_SIZE (1024 * 1024)
+
+using std::stringstream;
+
+wifibeat::threads::indexedfilereading::indexedfilereading(const string & file, const fileSeekStruct & settings)
+	: _file(file), _settings(settings), _from(1), _to(0), _bpf(NULL), _range(0), _offset(0), _chunkEnd(0),
+		_records(0), _read(0), _frames(0), _dropped(0), _filtered(0)
+{
+	this->Name("indexedfilereading");
+	if (this->_settings.byTime) {
+		this->_from = (int64_t)this->_settings.from.tv_sec * 1000000000LL + this->_settings.from.tv_nsec;
+		this->_to = (int64_t)this->_settings.to.tv_sec * 1000000000LL + this->_settings.to.tv_nsec;
+	}
+	this->_chunk.offset = this->_chunk.length = 0;
+	this->_chunk.frames = 0;
+}
+
+wifibeat::threads::indexedfilereading::~indexedfilereading()
+{
+	delete this->_bpf;
+}
+
+bool wifibeat::threads::indexedfilereading::loadIndex(utils::pcapIndex & index)
+{
+	string path = this->_file + PCAPINDEX_EXTENSION;
+	string error;
+	bool loaded = index.load(path, error);
+	if (loaded && index.FileSize() == this->_map.Size()) {
+		return true;
+	}
+	if (loaded && index.FileSize() < this->_map.Size() && !this->_settings.buildIndex) {
+		// Written while capturing (see threads/filewriting.h), before a crash
+		stringstream ss;
+		ss << "Index <" << path << "> only covers the first " << index.FileSize() << " bytes, the rest is read in full";
+		LOG_WARN(ss.str());
+		return true;
+	}
+	if (!this->_settings.buildIndex) {
+		LOG_ERROR((error.empty()) ? "Index <" + path + "> is outdated" : error);
+		return false;
+	}
+
+	LOG_NOTICE("Indexing <" + this->_file + ">");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (!utils::pcapIndexBuilder::build(this->_file, error) || !index.load(path, error)) {
+		LOG_ERROR(error);
+		return false;
+	}
+	stringstream ss;
+	ss << "Indexed <" << this->_file << "> in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s";
+	LOG_NOTICE(ss.str());
+	return true;
+}
+
+bool wifibeat::threads::indexedfilereading::init_function()
+{
+	if (this->_map.Size()) {
+		return true;
+	}
+
+	string error;
+	if (!this->_map.open(this->_file, error)) {
+		LOG_ERROR(error + " (seeking only works in pcap files, not in pcapng or compressed files)");
+		return false;
+	}
+
+	// Make sure we're getting wifi frames
+	int linktype = this->_map.LinkType();
+	if (linktype != DLT_IEEE802_11_RADIO && linktype != DLT_IEEE802_11) {
+		stringstream ss;
+		ss << "Invalid link type for <" << this->_file << ">: " << linktype;
+		LOG_ERROR(ss.str());
+		return false;
+	}
+	if (this->_bpf && !this->_bpf->compile(linktype)) {
+		LOG_ERROR(this->_bpf->Error());
+		return false;
+	}
+
+	utils::pcapIndex index;
+	if (!this->loadIndex(index)) {
+		return false;
+	}
+	this->_records = index.Records();
+	index.lookup(this->_from, this->_to, this->_settings.macs, this->_ranges);
+	if (index.FileSize() < this->_map.Size() && (this->_ranges.empty() || this->_ranges.back().end < index.FileSize())) {
+		this->_ranges.push_back({ index.FileSize(), UINT64_MAX });
+	}
+	this->_offset = this->_map.First();
+	this->_chunkEnd = this->_offset;
+
+	stringstream ss;
+	ss << "Reading <" << this->_file << "> with its index: " << this->_ranges.size() << " ranges";
+	LOG_NOTICE(ss.str());
+
+	this->_started = std::chrono::steady_clock::now();
+	return true;
+}
+
+bool wifibeat::threads::indexedfilereading::matches(const struct timespec & ts, const uint8_t * data, uint32_t length)
+{
+	if (this->_settings.byTime) {
+		int64_t time = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+		if (time < this->_from || time > this->_to) {
+			return false;
+		}
+	}
+	if (this->_settings.macs.empty()) {
+		return true;
+	}
+
+	uint64_t macs[4];
+	unsigned int count = utils::pcapIndex::addresses(this->_map.LinkType(), data, length, macs);
+	for (unsigned int i = 0; i < count; ++i) {
+		if (std::find(this->_settings.macs.begin(), this->_settings.macs.end(), macs[i]) != this->_settings.macs.end()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void wifibeat::threads::indexedfilereading::recurring()
+{
+	for (unsigned int count = 0; count < _WIFIBEAT_INDEXEDFILEREADING_RECORDS_PER_LOOP; ) {
+		if (this->_offset >= this->_chunkEnd) {
+			if (this->_chunk.frames) {
+				this->_map.release(this->_chunk);
+			}
+
+			// Next chunk, in the current range or the next one
+			while (this->_range < this->_ranges.size() && this->_offset >= this->_ranges[this->_range].end) {
+				++this->_range;
+			}
+			if (this->_range == this->_ranges.size()) {
+				this->finished();
+				return;
+			}
+			const utils::pcapIndexRange & range = this->_ranges[this->_range];
+			if (this->_offset < range.start) {
+				this->_offset = range.start;
+			}
+
+			size_t next = this->_offset;
+			size_t chunkSize = (size_t)std::min<uint64_t>(range.end - this->_offset, _WIFIBEAT_INDEXEDFILEREADING_CHUNK_SIZE);
+			string error;
+			bool scanned = this->_map.scan(next, chunkSize, this->_chunk, error);
+			if (!error.empty()) {
+				LOG_WARN(error);
+			}
+			if (!scanned) {
+				this->finished();
+				return;
+			}
+			this->_chunkEnd = next;
+		}
+
+		// Past the range, skip the rest of the chunk
+		if (this->_offset >= this->_ranges[this->_range].end) {
+			this->_chunkEnd = this->_offset;
+			continue;
+		}
+
+		struct timespec ts;
+		const uint8_t * data = NULL;
+		uint32_t length = 0;
+		this->_map.record(this->_offset, ts, data, length);
+		++this->_read;
+		++count;
+
+		if (!this->matches(ts, data, length)) {
+			continue;
+		}
+		if (this->_bpf && !this->_bpf->matches(this->_map.LinkType(), data, length, length)) {
+			++this->_filtered;
+			continue;
+		}
+		++this->_frames;
+		if (!this->sendToNextThreadsQueueWaiting(new PacketTimestamp(data, length, this->_map.LinkType(), ts))) {
+			++this->_dropped;
+		}
+	}
+}
+
+void wifibeat::threads::indexedfilereading::finished()
+{
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->_started).count();
+	stringstream ss;
+	ss << "Finished reading <" << this->_file << ">: " << this->_frames << " matching frames, "
+		<< this->_read << " records read out of " << this->_records;
+	if (this->_dropped) {
+		ss << ", " << this->_dropped << " dropped";
+	}
+	if (this->_filtered) {
+		ss << ", " << this->_filtered << " filtered out";
+	}
+	ss << " (" << seconds << "s)";
+	LOG_NOTICE(ss.str());
+	this->_map.close();
+	this->ThreadFinished();
+}
+
+string wifibeat::threads::indexedfilereading::toString()
+{
+	stringstream ss;
+	ss << "Indexed file <" << this->_file << '>';
+	if (this->_bpf) {
+		ss << " - Filter <" << this->_bpf->Expression() << '>';
+	}
+	return ss.str();
+}
+
+void wifibeat::threads::indexedfilereading::Filter(const string & expression)
+{
+	delete this->_bpf;
+	this->_bpf = (expression.empty()) ? NULL : new utils::bpfFilter(expression);
+}
@@ -0,0 +1,79 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Reads only the records of a pcap file that match a time range and/or MAC
+// addresses, seeking to them with the file's sidecar index (utils/pcapIndex.h).
+// The index is built first if it's missing or outdated.
+#ifndef THREAD_INDEXEDFILEREADING_H
+#define THREAD_INDEXEDFILEREADING_H
+
+#include "ThreadWithQueue.h"
+#include "PacketTimestamp.h"
+#include "config/configstructs.h"
+#include "utils/pcapMap.h"
+#include "utils/pcapIndex.h"
+#include "utils/bpfFilter.h"
+#include <chrono>
+
+#define _WIFIBEAT_INDEXEDFILEREADING_RECORDS_PER_LOOP 1024
+
+namespace wifibeat
+{
+	namespace threads
+	{
+		class indexedfilereading : public ThreadWithQueue<PacketTimestamp>
+		{
+			private:
+				string _file;
+				fileSeekStruct _settings;
+				int64_t _from; // ns since epoch
+				int64_t _to;
+				utils::bpfFilter * _bpf;
+
+				utils::pcapMap _map;
+				vector<utils::pcapIndexRange> _ranges;
+				size_t _range; // Being read
+				size_t _offset; // Next record
+				utils::pcapChunk _chunk; // Scanned, where _offset is
+				size_t _chunkEnd;
+
+				unsigned long long int _records; // In the file
+				unsigned long long int _read; // Records
+				unsigned long long int _frames; // Matching, sent
+				unsigned long long int _dropped;
+				unsigned long long int _filtered;
+				std::chrono::steady_clock::time_point _started;
+
+				bool loadIndex(utils::pcapIndex & index);
+				bool matches(const struct timespec & ts, const uint8_t * data, uint32_t length);
+				void finished();
+
+			public:
+				indexedfilereading(const string & file, const fileSeekStruct & settings);
+				~indexedfilereading();
+				virtual string toString();
+				virtual void recurring();
+				virtual bool init_function();
+				void Filter(const string & expression);
+		};
+
+	}
+
+}
+
+#endif // THREAD_INDEXEDFILEREADING_H
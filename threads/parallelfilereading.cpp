@@ -0,0 +1,238 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "parallelfilereading.h"
+#include "utils/logger.h"
+#include <pcap.h>
+#include <sstream>
+
+using std::stringstream;
+
+wifibeat::threads::parallelfilereading::parallelfilereading(const string & file, const fileReadingStruct & settings)
+	: _file(file), _settings(settings), _bpf(NULL), _stopWorkers(false), _scanOffset(0), _nextChunk(0), _nextToSend(0),
+		_runningWorkers(0), _frames(0), _dropped(0), _filtered(0)
+{
+	this->Name("parallelfilereading");
+	if (this->_settings.readerThreads == 0) {
+		this->_settings.readerThreads = 1;
+	}
+}
+
+wifibeat::threads::parallelfilereading::~parallelfilereading()
+{
+	this->stopWorkers();
+	for (auto & kv: this->_ready) {
+		for (PacketTimestamp * pts: kv.second.frames) {
+			delete pts;
+		}
+	}
+	delete this->_bpf;
+}
+
+void wifibeat::threads::parallelfilereading::stopWorkers()
+{
+	this->_stopWorkers = true;
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		this->_condition.notify_all();
+	}
+	for (std::thread * worker: this->_workers) {
+		worker->join();
+		delete worker;
+	}
+	this->_workers.clear();
+}
+
+bool wifibeat::threads::parallelfilereading::init_function()
+{
+	if (!this->_workers.empty()) {
+		return true;
+	}
+
+	string error;
+	if (!this->_map.open(this->_file, error)) {
+		LOG_ERROR(error);
+		return false;
+	}
+
+	// Make sure we're getting wifi frames
+	int linktype = this->_map.LinkType();
+	if (linktype != DLT_IEEE802_11_RADIO && linktype != DLT_IEEE802_11) {
+		stringstream ss;
+		ss << "Invalid link type for <" << this->_file << ">: " << linktype;
+		LOG_ERROR(ss.str());
+		return false;
+	}
+	if (this->_bpf && !this->_bpf->compile(linktype)) {
+		LOG_ERROR(this->_bpf->Error());
+		return false;
+	}
+	this->_scanOffset = this->_map.First();
+
+	// Workers start right away, they stop when they are too far ahead
+	this->_started = std::chrono::steady_clock::now();
+	this->_runningWorkers = this->_settings.readerThreads;
+	for (unsigned int i = 0; i < this->_settings.readerThreads; ++i) {
+		this->_workers.push_back(new std::thread(&parallelfilereading::work, this));
+	}
+
+	stringstream ss;
+	ss << "Reading <" << this->_file << "> (" << this->_map.Size() / 1048576 << "MB) with "
+		<< this->_settings.readerThreads << " threads, in chunks of " << this->_settings.chunkSize / 1048576 << "MB";
+	if (!this->_settings.ordered) {
+		ss << ", unordered";
+	}
+	LOG_NOTICE(ss.str());
+
+	return true;
+}
+
+void wifibeat::threads::parallelfilereading::work()
+{
+	// Chunks read but not sent yet, at most. Bounds memory usage.
+	const unsigned long long int window = 2ULL * this->_settings.readerThreads;
+
+	while (!this->_stopWorkers) {
+		parallelChunk chunk;
+		unsigned long long int id;
+		{
+			std::unique_lock<std::mutex> lock(this->_mutex);
+			this->_condition.wait(lock, [this, window] {
+				return this->_stopWorkers || this->_nextChunk - this->_nextToSend < window;
+			});
+			if (this->_stopWorkers) {
+				break;
+			}
+
+			// Only record headers are read here, it's quick
+			string error;
+			if (!this->_map.scan(this->_scanOffset, this->_settings.chunkSize, chunk.chunk, error)) {
+				if (!error.empty()) {
+					LOG_WARN(error);
+				}
+				break;
+			}
+			if (!error.empty()) {
+				LOG_WARN(error);
+			}
+			id = this->_nextChunk++;
+		}
+
+		// Copy and dissect the frames, outside of the lock
+		chunk.frames.reserve(chunk.chunk.frames);
+		size_t offset = chunk.chunk.offset;
+		unsigned long long int filtered = 0;
+		for (unsigned int i = 0; i < chunk.chunk.frames; ++i) {
+			struct timespec ts;
+			const uint8_t * data = NULL;
+			uint32_t length = 0;
+			this->_map.record(offset, ts, data, length);
+			if (this->_bpf && !this->_bpf->matches(this->_map.LinkType(), data, length, length)) {
+				++filtered;
+				continue;
+			}
+			PacketTimestamp * pts = new PacketTimestamp(data, length, this->_map.LinkType(), ts);
+			pts->getPDU();
+			chunk.frames.push_back(pts);
+		}
+
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		this->_filtered += filtered;
+		this->_ready.insert({id, std::move(chunk)});
+		this->_condition.notify_all();
+	}
+
+	std::lock_guard<std::mutex> lock(this->_mutex);
+	--this->_runningWorkers;
+	this->_condition.notify_all();
+}
+
+void wifibeat::threads::parallelfilereading::recurring()
+{
+	vector<parallelChunk> toSend;
+	bool finished = false;
+	{
+		std::unique_lock<std::mutex> lock(this->_mutex);
+		if (this->_ready.empty() && this->_runningWorkers) {
+			this->_condition.wait_for(lock, std::chrono::milliseconds(100));
+		}
+
+		if (this->_settings.ordered) {
+			auto it = this->_ready.find(this->_nextToSend);
+			while (it != this->_ready.end()) {
+				toSend.push_back(std::move(it->second));
+				this->_ready.erase(it);
+				it = this->_ready.find(++this->_nextToSend);
+			}
+		} else {
+			for (auto & kv: this->_ready) {
+				toSend.push_back(std::move(kv.second));
+			}
+			this->_nextToSend += this->_ready.size();
+			this->_ready.clear();
+		}
+		if (!toSend.empty()) {
+			// Workers can go ahead
+			this->_condition.notify_all();
+		}
+		finished = this->_runningWorkers == 0 && this->_ready.empty();
+	}
+
+	for (parallelChunk & chunk: toSend) {
+		for (PacketTimestamp * pts: chunk.frames) {
+			if (!this->sendToNextThreadsQueueWaiting(pts)) {
+				++this->_dropped;
+			}
+		}
+		this->_frames += chunk.frames.size();
+		this->_map.release(chunk.chunk);
+	}
+
+	if (finished) {
+		this->stopWorkers();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->_started).count();
+		stringstream ss;
+		ss << "Finished reading <" << this->_file << ">: " << this->_frames << " frames";
+		if (this->_dropped) {
+			ss << ", " << this->_dropped << " dropped";
+		}
+		if (this->_filtered) {
+			ss << ", " << this->_filtered << " filtered out";
+		}
+		if (seconds > 0) {
+			ss << " (" << (unsigned long long int)(this->_frames / seconds) << " frames/s, "
+				<< (unsigned long long int)(this->_map.Size() / seconds / 1048576) << "MB/s)";
+		}
+		LOG_NOTICE(ss.str());
+		this->_map.close();
+		this->ThreadFinished();
+	}
+}
+
+void wifibeat::threads::parallelfilereading::Filter(const string & expression)
+{
+	delete this->_bpf;
+	this->_bpf = (expression.empty()) ? NULL : new utils::bpfFilter(expression);
+}
+
+string wifibeat::threads::parallelfilereading::toString()
+{
+	stringstream ss;
+	ss << "File <" << this->_file << "> - " << this->_settings.readerThreads << " reader threads";
+	return ss.str();
+}
@@ -0,0 +1,90 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Reads a large pcap file on several threads. The file is memory mapped (see
+// utils/pcapMap.h) and cut into chunks; workers copy and dissect the frames of
+// a chunk each. Chunks are sent in file order, or as soon as they are ready if
+// ordering isn't needed.
+#ifndef THREAD_PARALLELFILEREADING_H
+#define THREAD_PARALLELFILEREADING_H
+
+#include "ThreadWithQueue.h"
+#include "PacketTimestamp.h"
+#include "config/configstructs.h"
+#include "utils/pcapMap.h"
+#include "utils/bpfFilter.h"
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+using std::map;
+
+namespace wifibeat
+{
+	namespace threads
+	{
+		struct parallelChunk {
+			utils::pcapChunk chunk;
+			vector<PacketTimestamp *> frames;
+		};
+
+		class parallelfilereading : public ThreadWithQueue<PacketTimestamp>
+		{
+			private:
+				string _file;
+				fileReadingStruct _settings;
+				utils::pcapMap _map;
+				utils::bpfFilter * _bpf; // Compiled before the workers start, then only read
+
+				vector<std::thread *> _workers;
+				std::atomic<bool> _stopWorkers;
+
+				// Protects everything below
+				std::mutex _mutex;
+				std::condition_variable _condition;
+				size_t _scanOffset;
+				unsigned long long int _nextChunk; // Next chunk given to a worker
+				unsigned long long int _nextToSend; // Ordered: next chunk to send. Otherwise: chunks sent.
+				map<unsigned long long int, parallelChunk> _ready;
+				unsigned int _runningWorkers;
+
+				unsigned long long int _frames;
+				unsigned long long int _dropped;
+				unsigned long long int _filtered;
+				std::chrono::steady_clock::time_point _started;
+
+				void work();
+				void stopWorkers();
+
+			public:
+				parallelfilereading(const string & file, const fileReadingStruct & settings);
+				~parallelfilereading();
+				virtual string toString();
+				virtual void recurring();
+				virtual bool init_function();
+				void Filter(const string & expression);
+		};
+
+	}
+
+}
+
+#endif // THREAD_PARALLELFILEREADING_H
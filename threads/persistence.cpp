@@ -18,42 +18,68 @@
  */
 #include "persistence.h"
 #include "utils/logger.h"
+#include "utils/Locker.h"
 #include <queue>
+#include <sstream>
 
 using std::queue;
+using std::stringstream;
 
-/*
-persistence: add path in config
-
-persistence: add function in thread to delete item -> referenced by its pointer -> wouldn't work since split
-		-> Add uuid (apt-get install uuid-dev)
-		http://graemehill.ca/minimalist-cross-platform-uuid-guid-generation-in-c++/
-
-So, we need to add a field in the PacketTimestamp for uuid. However, this will only be added
-in the persistence thread, so the end thread can notify packet is no longer needed
+wifibeat::threads::persistence::persistence(const persistentQueueStruct & settings)
+	: _settings(settings), _wal(NULL), _replaying(false), _replayed(0), _outputsMutexInit(false)
+{
+	this->Name("persistence");
 
-Regarding multiple destinations. As long as one persists it, it's fine. But technically, we should have
-persistence in the output threads too.
+	if (pthread_mutex_init(&this->_outputsMutex, NULL) != 0) {
+		LOG_CRITICAL("Failed initializing persistence mutex");
+		throw string("Failed initializing persistence mutex");
+	}
+	this->_outputsMutexInit = true;
+}
 
-What can be done is:
-- persistence at capture time which is handled by persistence thread
-- persistence at decryption time (which call the persistence thread to notify it's taking care of it)
-  - it takes note of the different pointers which are symlinks to the original one pointer + hash)
-- persistence at each output
+wifibeat::threads::persistence::~persistence()
+{
+	// Flushes it, what wasn't acknowledged will be replayed next time
+	delete this->_wal;
+	if (this->_outputsMutexInit) {
+		pthread_mutex_destroy(&this->_outputsMutex);
+	}
+}
 
-Need to discuss this issue, issue is complex
+unsigned int wifibeat::threads::persistence::addOutput()
+{
+	utils::Locker l(&this->_outputsMutex);
+	this->_acknowledged.push_back(0);
+	return this->_acknowledged.size() - 1;
+}
 
-Something that can be done is merging persistence in decryption into processing
-which would do persistence too.
-*/
+void wifibeat::threads::persistence::acknowledge(unsigned int output, uint64_t sequence)
+{
+	utils::Locker l(&this->_outputsMutex);
+	if (output < this->_acknowledged.size() && sequence > this->_acknowledged[output]) {
+		this->_acknowledged[output] = sequence;
+	}
+}
 
-wifibeat::threads::persistence::persistence()
+uint64_t wifibeat::threads::persistence::acknowledged()
 {
-	this->Name("persistence");
+	utils::Locker l(&this->_outputsMutex);
+	if (this->_acknowledged.empty()) {
+		// Nobody to wait for
+		return this->_wal->LastSequence();
+	}
+	uint64_t ret = this->_acknowledged[0];
+	for (uint64_t sequence: this->_acknowledged) {
+		if (sequence < ret) {
+			ret = sequence;
+		}
+	}
+	return ret;
 }
 
-wifibeat::threads::persistence::~persistence()
+bool wifibeat::threads::persistence::Enabled()
 {
+	return this->_settings.enabled;
 }
 
 void wifibeat::threads::persistence::recurring()
@@ -61,15 +87,124 @@ void wifibeat::threads::persistence::recurring()
 	queue<PacketTimestamp *> q = this->getAllItemsFromInputQueue();
 	while (!q.empty()) {
 		PacketTimestamp * item = q.front();
-		if (item != NULL) { // Should never be null be better be safe than soory
-			this->sendToNextThreadsQueue(item);
-		}
 		q.pop();
+		if (item == NULL) { // Should never be null be better be safe than soory
+			continue;
+		}
+		uint64_t sequence = 0;
+		if (this->_wal) {
+			sequence = this->_wal->append(item->getRawData(), (uint32_t)item->getRawLength(),
+													item->getLinkType(), item->getTimespec());
+			if (sequence && item->Checkpoint()) {
+				checkpointMark * last = (this->_checkpointMarks.empty()) ? NULL : &(this->_checkpointMarks.back());
+				if (last && last->checkpoint == item->Checkpoint() && last->file == item->CheckpointFile()
+						&& last->frames < _WIFIBEAT_PERSISTENCE_CHECKPOINT_MARK_FRAMES) {
+					last->sequence = sequence;
+					last->position = item->CheckpointPosition();
+					++last->frames;
+				} else {
+					this->_checkpointMarks.push_back({ sequence, item->Checkpoint(), item->CheckpointFile(), item->CheckpointPosition(), 1 });
+				}
+			}
+			if (sequence && this->_replaying) {
+				// It will be read back from the log, after the older ones
+				delete item;
+				continue;
+			}
+			item->Sequence(sequence);
+		}
+		// Waits for room: failing with several outputs would leave a copy in some of
+		// them only. It only fails when stopping, the log replays it on the next start.
+		this->sendToNextThreadsQueueWaiting(item);
+	}
+
+	if (this->_wal == NULL) {
+		return;
+	}
+	if (this->_replaying) {
+		this->replay();
+	}
+
+	// Release what all outputs are done with, and flush from time to time
+	uint64_t acknowledged = this->acknowledged();
+	this->_wal->acknowledge(acknowledged);
+	std::map<std::pair<utils::fileCheckpoint *, unsigned int>, uint64_t> positions; // Furthest acknowledged one of each file
+	while (!this->_checkpointMarks.empty() && this->_checkpointMarks.front().sequence <= acknowledged) {
+		const checkpointMark & mark = this->_checkpointMarks.front();
+		positions[std::make_pair(mark.checkpoint, mark.file)] = mark.position;
+		this->_checkpointMarks.pop_front();
+	}
+	for (const auto & kv: positions) {
+		kv.first.first->update(kv.first.second, kv.second);
+	}
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - this->_lastSync >= this->_settings.syncInterval) {
+		this->_wal->sync();
+		this->_lastSync = now;
+	}
+}
+
+void wifibeat::threads::persistence::replay()
+{
+	// Frames allowed so far at replay_rate
+	unsigned long long int budget = _WIFIBEAT_PERSISTENCE_REPLAY_BATCH;
+	if (this->_settings.replayRate) {
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - this->_replayStarted;
+		unsigned long long int allowed = (unsigned long long int)(elapsed.count() * this->_settings.replayRate) + 1;
+		budget = (allowed > this->_replayed) ? allowed - this->_replayed : 0;
+		if (budget > _WIFIBEAT_PERSISTENCE_REPLAY_BATCH) {
+			budget = _WIFIBEAT_PERSISTENCE_REPLAY_BATCH;
+		}
+	}
+
+	utils::walRecord record;
+	for (unsigned long long int i = 0; i < budget; ++i) {
+		if (!this->_wal->read(this->_cursor, record)) {
+			// Caught up, new frames go straight through again
+			stringstream ss;
+			ss << "Done replaying persistent queue (" << this->_replayed << " frames)";
+			LOG_NOTICE(ss.str());
+			this->_replaying = false;
+			return;
+		}
+
+		PacketTimestamp * item = new PacketTimestamp(record.data, record.length, record.linkType, record.ts);
+		item->Sequence(record.sequence);
+		if (!this->sendToNextThreadsQueueWaiting(item)) {
+			// Stopping, the rest is replayed on the next start
+			this->_replaying = false;
+			return;
+		}
+		++this->_replayed;
 	}
 }
 
 bool wifibeat::threads::persistence::init_function()
 {
-	LOG_NOTICE("Persistence thread is set to passthrough for now!");
+	if (!this->_settings.enabled) {
+		LOG_NOTICE("Persistent queue disabled, persistence thread is set to passthrough");
+		return true;
+	}
+	if (this->_wal) {
+		return true;
+	}
+
+	this->_wal = new utils::wal(this->_settings.directory, this->_settings.maxSize, this->_settings.segmentSize);
+	if (!this->_wal->open()) {
+		LOG_CRITICAL("Failed opening persistent queue");
+		delete this->_wal;
+		this->_wal = NULL;
+		return false;
+	}
+	LOG_DEBUG(this->_wal->toString());
+
+	if (this->_wal->Recovered() > this->_wal->Acknowledged()) {
+		this->_replaying = true;
+		this->_cursor.sequence = this->_wal->Acknowledged() + 1;
+		this->_replayStarted = std::chrono::steady_clock::now();
+		LOG_NOTICE("Replaying frames from the persistent queue");
+	}
+	this->_lastSync = std::chrono::steady_clock::now();
+
 	return true;
-}
\ No newline at end of file
+}
@@ -16,14 +16,28 @@
  *    You should have received a copy of the GNU General Public License
  *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
-// It will still run no matter what in case there are some stuff persisted on the
-// disk that needs to be inserted. If disabled, it will just pass-through anything
-// on its queue
+// Every frame is appended to a write-ahead log (see utils/wal.h) before being
+// sent to the next threads, tagged with its sequence number. Outputs acknowledge
+// the frames they are done with and the log is truncated once all of them did.
+// Frames that weren't acknowledged by the previous run are replayed first, in
+// order, at queues.persistent.replay_rate. Frames wait for room in the outputs'
+// queues: dropping one would leave copies in some outputs only. If disabled, it
+// will just pass-through anything on its queue.
 #ifndef THREAD_PERSISTENCE_H
 #define THREAD_PERSISTENCE_H
 
 #include "ThreadWithQueue.h"
 #include "PacketTimestamp.h"
+#include "config/configstructs.h"
+#include "utils/wal.h"
+#include "utils/fileCheckpoint.h"
+#include <chrono>
+#include <deque>
+#include <map>
+#include <pthread.h>
+
+#define _WIFIBEAT_PERSISTENCE_REPLAY_BATCH 256 // Frames replayed per loop, at most
+#define _WIFIBEAT_PERSISTENCE_CHECKPOINT_MARK_FRAMES 1024 // Consecutive frames of a file sharing a checkpoint mark
 
 namespace wifibeat
 {
@@ -31,12 +45,47 @@ namespace wifibeat
 	{
 		class persistence : public ThreadWithQueue<PacketTimestamp>
 		{
+			private:
+				persistentQueueStruct _settings;
+				utils::wal * _wal;
+				std::chrono::steady_clock::time_point _lastSync;
+
+				// While replaying, new frames are only written to the log and are read back
+				// from it so that outputs get them in order.
+				bool _replaying;
+				utils::walCursor _cursor;
+				std::chrono::steady_clock::time_point _replayStarted;
+				unsigned long long int _replayed;
+				void replay();
+
+				// Last sequence acknowledged by each output
+				pthread_mutex_t _outputsMutex;
+				bool _outputsMutexInit;
+				vector<uint64_t> _acknowledged;
+				uint64_t acknowledged();
+
+				// Frames from checkpointed files: their position is saved once acknowledged.
+				// Consecutive frames of the same file share a mark, the one of the last of them.
+				struct checkpointMark {
+					uint64_t sequence;
+					utils::fileCheckpoint * checkpoint;
+					unsigned int file;
+					uint64_t position;
+					unsigned int frames;
+				};
+				std::deque<checkpointMark> _checkpointMarks;
+
 			public:
-				persistence();
+				explicit persistence(const persistentQueueStruct & settings);
 				~persistence();
 				virtual void recurring();
 				virtual bool init_function();
 
+				// Outputs register before the threads start, then acknowledge frames in order:
+				// acknowledging a sequence means everything up to it is done.
+				unsigned int addOutput();
+				void acknowledge(unsigned int output, uint64_t sequence);
+				bool Enabled();
 		};
 
 	}
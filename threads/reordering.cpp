@@ -0,0 +1,128 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "reordering.h"
+#include "utils/logger.h"
+#include <sstream>
+
+static bool before(const struct timespec & a, const struct timespec & b)
+{
+	return a.tv_sec < b.tv_sec || (a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec);
+}
+
+bool wifibeat::threads::reorderItemLater::operator()(const reorderItem & a, const reorderItem & b) const
+{
+	if (a.ts.tv_sec != b.ts.tv_sec) {
+		return a.ts.tv_sec > b.ts.tv_sec;
+	}
+	if (a.ts.tv_nsec != b.ts.tv_nsec) {
+		return a.ts.tv_nsec > b.ts.tv_nsec;
+	}
+	return a.arrival > b.arrival;
+}
+
+wifibeat::threads::reordering::reordering(const reorderStruct & settings)
+	: _settings(settings), _arrivals(0), _lastSent({0, 0}), _late(0), _early(0), _dropped(0)
+{
+	this->Name("reordering");
+}
+
+wifibeat::threads::reordering::~reordering()
+{
+	while (!this->_heap.empty()) {
+		delete this->_heap.top().frame;
+		this->_heap.pop();
+	}
+
+	if (this->_arrivals) {
+		stringstream ss;
+		ss << "Reordering: " << this->_arrivals << " frames, " << this->_late << " too late";
+		if (this->_early) {
+			ss << ", " << this->_early << " sent early (" << this->_settings.maxFrames << " frames held)";
+		}
+		if (this->_dropped) {
+			ss << ", " << this->_dropped << " dropped";
+		}
+		LOG_NOTICE(ss.str());
+	}
+}
+
+bool wifibeat::threads::reordering::allQueuesEmpty()
+{
+	return this->_heap.empty() && ThreadWithQueue<PacketTimestamp>::allQueuesEmpty();
+}
+
+void wifibeat::threads::reordering::send(PacketTimestamp * frame)
+{
+	if (!this->sendToNextThreadsQueueWaiting(frame)) {
+		++this->_dropped;
+	}
+}
+
+void wifibeat::threads::reordering::recurring()
+{
+	queue<PacketTimestamp *> q = this->getAllItemsFromInputQueue();
+	while (!q.empty()) {
+		PacketTimestamp * item = q.front();
+		q.pop();
+		if (item == NULL) {
+			continue;
+		}
+		++this->_arrivals;
+		struct timespec ts = item->getTimespec();
+
+		// What came before it was already sent
+		if (before(ts, this->_lastSent)) {
+			++this->_late;
+			this->send(item);
+			continue;
+		}
+
+		this->_heap.push({ ts, this->_arrivals, item });
+		if (this->_heap.size() > this->_settings.maxFrames) {
+			++this->_early;
+			this->_lastSent = this->_heap.top().ts;
+			this->send(this->_heap.top().frame);
+			this->_heap.pop();
+		}
+	}
+
+	// Send what is older than the window, or everything when stopping
+	struct timespec limit;
+	clock_gettime(CLOCK_REALTIME, &limit);
+	long long int windowNS = (long long int)this->_settings.window.count() * 1000000LL;
+	limit.tv_sec -= (time_t)(windowNS / 1000000000LL);
+	limit.tv_nsec -= (long)(windowNS % 1000000000LL);
+	if (limit.tv_nsec < 0) {
+		--limit.tv_sec;
+		limit.tv_nsec += 1000000000L;
+	}
+	bool stopping = (this->Status() == Stopping);
+	while (!this->_heap.empty() && (stopping || !before(limit, this->_heap.top().ts))) {
+		this->_lastSent = this->_heap.top().ts;
+		this->send(this->_heap.top().frame);
+		this->_heap.pop();
+	}
+}
+
+string wifibeat::threads::reordering::toString()
+{
+	stringstream ss;
+	ss << "Reordering (" << this->_settings.window.count() << "ms window, up to " << this->_settings.maxFrames << " frames)";
+	return ss.str();
+}
@@ -0,0 +1,77 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Puts frames captured on several interfaces back in capture time order before
+// they reach persistence and the outputs. Frames are held in a min-heap until
+// they are older than the lateness window (against the system clock, which is
+// what live captures are timestamped with), then sent oldest first.
+// A frame older than the last one sent arrived too late: it is counted and
+// sent right away. Memory is bounded by the window and by a maximum amount of
+// frames held; past it, the oldest ones are sent early.
+#ifndef THREAD_REORDERING_H
+#define THREAD_REORDERING_H
+
+#include "ThreadWithQueue.h"
+#include "PacketTimestamp.h"
+#include "config/configstructs.h"
+#include <queue>
+#include <time.h>
+
+namespace wifibeat
+{
+	namespace threads
+	{
+		struct reorderItem {
+			struct timespec ts;
+			unsigned long long int arrival; // Same time: keep the order they arrived in
+			PacketTimestamp * frame;
+		};
+
+		struct reorderItemLater {
+			bool operator()(const reorderItem & a, const reorderItem & b) const;
+		};
+
+		class reordering : public ThreadWithQueue<PacketTimestamp>
+		{
+			private:
+				reorderStruct _settings;
+				std::priority_queue<reorderItem, vector<reorderItem>, reorderItemLater> _heap;
+				unsigned long long int _arrivals;
+				struct timespec _lastSent;
+
+				unsigned long long int _late;
+				unsigned long long int _early; // Sent before the end of the window, too many frames held
+				unsigned long long int _dropped;
+
+				void send(PacketTimestamp * frame);
+
+			protected:
+				virtual bool allQueuesEmpty();
+
+			public:
+				explicit reordering(const reorderStruct & settings);
+				~reordering();
+				virtual string toString();
+				virtual void recurring();
+		};
+
+	}
+
+}
+
+#endif // THREAD_REORDERING_H
@@ -21,6 +21,7 @@
 #define UTILS_LOCKER_H
 
 #include <pthread.h>
+#include <stdexcept>
 #include <time.h>
 
 namespace wifibeat
@@ -62,6 +62,11 @@ void wifibeat::utils::beat::Release()
 	ms_instance = NULL;
 }
 
+const string & wifibeat::utils::beat::Hostname() const
+{
+	return this->_hostname;
+}
+
 bool wifibeat::utils::beat::addBeatToDocument(JSONObject * doc)
 {
 	if (doc == NULL || this->_hostname.empty()) {
@@ -37,6 +37,7 @@ namespace wifibeat
 				static beat* Instance();
 				static void Release();
 				bool addBeatToDocument(JSONObject * doc);
+				const string & Hostname() const;
 
 			private:
 				beat();
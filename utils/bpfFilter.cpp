@@ -0,0 +1,101 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "bpfFilter.h"
+#include "logger.h"
+
+wifibeat::utils::bpfFilter::bpfFilter(const string & expression) : _expression(expression)
+{
+}
+
+wifibeat::utils::bpfFilter::~bpfFilter()
+{
+	for (auto & kv: this->_programs) {
+		if (kv.second) {
+			pcap_freecode(kv.second);
+			delete kv.second;
+		}
+	}
+}
+
+bool wifibeat::utils::bpfFilter::compile(int linkType)
+{
+	std::map<int, struct bpf_program *>::const_iterator it = this->_programs.find(linkType);
+	if (it != this->_programs.end()) {
+		return it->second != NULL;
+	}
+
+	struct bpf_program * program = NULL;
+	pcap_t * handle = pcap_open_dead(linkType, BPFFILTER_SNAPLEN);
+	if (handle == NULL) {
+		this->_error = "Failed compiling filter <" + this->_expression + ">: out of memory";
+	} else {
+		program = new struct bpf_program;
+		if (pcap_compile(handle, program, this->_expression.c_str(), 1, PCAP_NETMASK_UNKNOWN) != 0) {
+			this->_error = "Failed compiling filter <" + this->_expression + "> for link type "
+							+ std::to_string(linkType) + ": " + string(pcap_geterr(handle));
+			delete program;
+			program = NULL;
+		}
+		pcap_close(handle);
+	}
+
+	this->_programs[linkType] = program;
+	return program != NULL;
+}
+
+bool wifibeat::utils::bpfFilter::matches(int linkType, const uint8_t * data, uint32_t capturedLength, uint32_t length)
+{
+	std::map<int, struct bpf_program *>::const_iterator it = this->_programs.find(linkType);
+	if (it == this->_programs.end()) {
+		if (!this->compile(linkType)) {
+			LOG_WARN(this->_error);
+		}
+		it = this->_programs.find(linkType);
+	}
+	if (it->second == NULL) {
+		return false;
+	}
+
+	struct pcap_pkthdr header;
+	header.ts.tv_sec = 0;
+	header.ts.tv_usec = 0;
+	header.caplen = capturedLength;
+	header.len = length;
+	return pcap_offline_filter(it->second, &header, data) != 0;
+}
+
+const string & wifibeat::utils::bpfFilter::Expression() const
+{
+	return this->_expression;
+}
+
+const string & wifibeat::utils::bpfFilter::Error() const
+{
+	return this->_error;
+}
+
+bool wifibeat::utils::bpfFilter::valid(const string & expression, int linkType, string & error)
+{
+	bpfFilter filter(expression);
+	if (!filter.compile(linkType)) {
+		error = filter.Error();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,65 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// pcap filter expression applied to frames read from files, on the raw record
+// and before anything gets dissected. Compiled once per link type (pcapng
+// files can have several) without needing a capture handle.
+#ifndef UTILS_BPFFILTER_H
+#define UTILS_BPFFILTER_H
+
+#include <string>
+#include <map>
+#include <stdint.h>
+#include <pcap.h>
+
+using std::string;
+
+#define BPFFILTER_SNAPLEN (256 * 1024)
+
+namespace wifibeat
+{
+	namespace utils
+	{
+		class bpfFilter
+		{
+			private:
+				string _expression;
+				std::map<int, struct bpf_program *> _programs; // Per link type, NULL if it failed compiling
+				string _error;
+
+			public:
+				bpfFilter(const string & expression);
+				~bpfFilter();
+
+				// Must be called before matching frames of that link type
+				// from several threads. Error() tells why it failed.
+				bool compile(int linkType);
+
+				// Frames of a link type the expression doesn't compile for never match
+				bool matches(int linkType, const uint8_t * data, uint32_t capturedLength, uint32_t length);
+
+				const string & Expression() const;
+				const string & Error() const;
+
+				// Check the syntax without keeping anything
+				static bool valid(const string & expression, int linkType, string & error);
+		};
+	}
+}
+
+#endif // UTILS_BPFFILTER_H
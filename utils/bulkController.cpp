@@ -0,0 +1,144 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "bulkController.h"
+#include "Locker.h"
+#include "logger.h"
+#include <sstream>
+#include <algorithm>
+
+using std::stringstream;
+
+wifibeat::utils::bulkController::bulkController(bool adaptive, unsigned int initialBulkSize, unsigned int minBulkSize, unsigned int maxBulkSize,
+												unsigned int maxConcurrency, std::chrono::milliseconds targetLatency, unsigned int maxDocumentsPerSecond)
+	: _mutexInit(false), _adaptive(adaptive), _minBulkSize(std::max(1U, minBulkSize)), _maxBulkSize(std::max(this->_minBulkSize, maxBulkSize)),
+		_maxConcurrency(std::max(1U, maxConcurrency)), _targetLatency(targetLatency), _bulkSize(std::max(1U, initialBulkSize)),
+		_concurrency(1), _successes(0), _maxDocumentsPerSecond(maxDocumentsPerSecond), _tokens(maxDocumentsPerSecond),
+		_lastRefill(std::chrono::steady_clock::now())
+{
+	if (pthread_mutex_init(&this->_mutex, NULL) != 0) {
+		LOG_CRITICAL("Failed initializing bulk controller mutex");
+		throw string("Failed initializing bulk controller mutex");
+	}
+	this->_mutexInit = true;
+
+	if (this->_adaptive) {
+		this->_bulkSize = std::min(std::max(this->_bulkSize, this->_minBulkSize), this->_maxBulkSize);
+	} else {
+		this->_concurrency = this->_maxConcurrency;
+	}
+}
+
+wifibeat::utils::bulkController::~bulkController()
+{
+	if (this->_mutexInit) {
+		pthread_mutex_destroy(&this->_mutex);
+	}
+}
+
+unsigned int wifibeat::utils::bulkController::BulkSize()
+{
+	Locker l(&this->_mutex);
+	return this->_bulkSize;
+}
+
+unsigned int wifibeat::utils::bulkController::Concurrency()
+{
+	Locker l(&this->_mutex);
+	return this->_concurrency;
+}
+
+void wifibeat::utils::bulkController::success(std::chrono::milliseconds latency)
+{
+	if (!this->_adaptive) {
+		return;
+	}
+	Locker l(&this->_mutex);
+	if (latency > this->_targetLatency) {
+		this->decrease();
+		return;
+	}
+
+	// Additive increase: bulk size first, then concurrency
+	if (this->_bulkSize < this->_maxBulkSize) {
+		this->_bulkSize = std::min(this->_bulkSize + this->_minBulkSize, this->_maxBulkSize);
+	} else if (this->_concurrency < this->_maxConcurrency && ++this->_successes >= this->_concurrency) {
+		++this->_concurrency;
+		this->_successes = 0;
+		stringstream ss;
+		ss << "Elasticsearch keeps up, increasing concurrency: " << this->toString();
+		LOG_DEBUG(ss.str());
+	}
+}
+
+void wifibeat::utils::bulkController::overloaded()
+{
+	if (!this->_adaptive) {
+		return;
+	}
+	Locker l(&this->_mutex);
+	this->decrease();
+}
+
+void wifibeat::utils::bulkController::decrease()
+{
+	// Requests sent before the last decrease are likely to be slow/rejected too
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - this->_lastDecrease < this->_targetLatency) {
+		return;
+	}
+	this->_lastDecrease = now;
+
+	// Multiplicative decrease
+	this->_bulkSize = std::max(this->_bulkSize / 2, this->_minBulkSize);
+	this->_concurrency = std::max(this->_concurrency / 2, 1U);
+	this->_successes = 0;
+
+	LOG_INFO("Elasticsearch is overloaded, backing off: " + this->toString());
+}
+
+std::chrono::microseconds wifibeat::utils::bulkController::throttle(unsigned int documents)
+{
+	if (this->_maxDocumentsPerSecond == 0) {
+		return std::chrono::microseconds(0);
+	}
+	Locker l(&this->_mutex);
+
+	// Refill, the bucket holds a second worth of documents
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double elapsed = std::chrono::duration<double>(now - this->_lastRefill).count();
+	this->_lastRefill = now;
+	this->_tokens = std::min(this->_tokens + elapsed * this->_maxDocumentsPerSecond, (double)this->_maxDocumentsPerSecond);
+
+	// Can go below 0 if a bulk is larger than the bucket, following requests will wait longer
+	this->_tokens -= documents;
+	if (this->_tokens >= 0) {
+		return std::chrono::microseconds(0);
+	}
+	return std::chrono::microseconds((long long int)(-this->_tokens * 1000000.0 / this->_maxDocumentsPerSecond));
+}
+
+string wifibeat::utils::bulkController::toString()
+{
+	stringstream ss;
+	ss << "bulk size " << this->_bulkSize << ", concurrency " << this->_concurrency;
+	if (this->_maxDocumentsPerSecond) {
+		ss << ", max " << this->_maxDocumentsPerSecond << " documents/s";
+	}
+	return ss.str();
+}
@@ -0,0 +1,84 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UTILS_BULKCONTROLLER_H
+#define UTILS_BULKCONTROLLER_H
+
+#include <string>
+#include <chrono>
+#include <pthread.h>
+
+using std::string;
+
+namespace wifibeat
+{
+	namespace utils
+	{
+		// Sizes Elasticsearch bulk requests and the amount of them in flight (AIMD).
+		// - Response under the target latency: bulk size grows by minBulkSize then,
+		//   once at its maximum, concurrency grows by one.
+		// - HTTP 429, rejected items or slow response: both are halved, at most once
+		//   per target latency period (responses to requests already in flight don't count).
+		// It also limits the amount of documents per second (token bucket).
+		// Thread safe.
+		class bulkController
+		{
+			private:
+				pthread_mutex_t _mutex;
+				bool _mutexInit;
+
+				bool _adaptive;
+				unsigned int _minBulkSize;
+				unsigned int _maxBulkSize;
+				unsigned int _maxConcurrency;
+				std::chrono::milliseconds _targetLatency;
+
+				unsigned int _bulkSize;
+				unsigned int _concurrency;
+				unsigned int _successes; // Since concurrency was last changed
+				std::chrono::steady_clock::time_point _lastDecrease;
+
+				// Token bucket, 0 is unlimited
+				unsigned int _maxDocumentsPerSecond;
+				double _tokens;
+				std::chrono::steady_clock::time_point _lastRefill;
+
+				void decrease();
+
+			public:
+				// Not adaptive: fixed bulk size (initialBulkSize) and concurrency (maxConcurrency)
+				bulkController(bool adaptive, unsigned int initialBulkSize, unsigned int minBulkSize, unsigned int maxBulkSize,
+								unsigned int maxConcurrency, std::chrono::milliseconds targetLatency, unsigned int maxDocumentsPerSecond);
+				~bulkController();
+
+				unsigned int BulkSize();
+				unsigned int Concurrency();
+
+				// Feedback from Elasticsearch
+				void success(std::chrono::milliseconds latency);
+				void overloaded();
+
+				// How long to wait before sending that many documents (and take them from the bucket)
+				std::chrono::microseconds throttle(unsigned int documents);
+
+				string toString();
+		};
+	}
+}
+
+#endif // UTILS_BULKCONTROLLER_H
@@ -0,0 +1,426 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "esClient.h"
+#include "logger.h"
+#include "tls.h"
+#include <sstream>
+#include <exception>
+#include <Poco/Exception.h>
+#include <Poco/StreamCopier.h>
+#include <Poco/URI.h>
+#include <Poco/Timespan.h>
+#include <Poco/Net/HTTPRequest.h>
+#include <Poco/Net/HTTPResponse.h>
+#include <Poco/Net/HTTPBasicCredentials.h>
+#include <Poco/Net/HTTPSClientSession.h>
+#include <Poco/Net/SecureStreamSocket.h>
+#include <rapidjson/document.h>
+
+using std::stringstream;
+using Poco::Net::HTTPRequest;
+using Poco::Net::HTTPResponse;
+using Poco::Net::HTTPMessage;
+
+namespace
+{
+	// Sessions counting (re)connections, Poco reconnects on its own
+	class countingHTTPClientSession : public Poco::Net::HTTPClientSession
+	{
+		private:
+			wifibeat::utils::connectionStats & _stats;
+		protected:
+			void connect(const Poco::Net::SocketAddress & address) {
+				Poco::Net::HTTPClientSession::connect(address);
+				++this->_stats.connections;
+			}
+		public:
+			countingHTTPClientSession(const string & host, unsigned short int port, wifibeat::utils::connectionStats & stats)
+				: Poco::Net::HTTPClientSession(host, port), _stats(stats) { }
+	};
+
+	class countingHTTPSClientSession : public Poco::Net::HTTPSClientSession
+	{
+		private:
+			wifibeat::utils::connectionStats & _stats;
+		protected:
+			void connect(const Poco::Net::SocketAddress & address) {
+				// Reuses the session of the previous connection
+				Poco::Net::HTTPSClientSession::connect(address);
+				++this->_stats.connections;
+				Poco::Net::SecureStreamSocket socket(this->socket());
+				if (socket.sessionWasReused()) {
+					++this->_stats.resumedSessions;
+				} else {
+					++this->_stats.handshakes;
+				}
+			}
+		public:
+			countingHTTPSClientSession(const string & host, unsigned short int port, Poco::Net::Context::Ptr context,
+										wifibeat::utils::connectionStats & stats)
+				: Poco::Net::HTTPSClientSession(host, port, context), _stats(stats) { }
+	};
+}
+
+wifibeat::utils::esClient::esClient(const string & host, unsigned short int port, const ElasticSearchConnection & settings,
+										Poco::Net::Context::Ptr context)
+	: _scheme("http"), _host(host), _port(port), _settings(settings), _session(NULL), _context(context),
+		_version(""), _majorVersion(0), _string("")
+{
+	if (this->_settings.protocol == HTTPS) {
+		this->_scheme = "https";
+		if (this->_context.isNull()) {
+			this->_context = tls::clientContext(this->_settings.ssl);
+		}
+	}
+
+	// Bulk URI with the optional path and parameters
+	string path = this->_settings.HTTPPath;
+	if (!path.empty() && path[0] != '/') {
+		path = "/" + path;
+	}
+	while (!path.empty() && path[path.size() - 1] == '/') {
+		path.erase(path.size() - 1);
+	}
+	Poco::URI uri(path + "/_bulk");
+	for (const auto & kv: this->_settings.parameters) {
+		uri.addQueryParameter(kv.first, kv.second);
+	}
+	if (!this->_settings.pipeline.empty()) {
+		uri.addQueryParameter("pipeline", this->_settings.pipeline);
+	}
+	this->_bulkURI = uri.getPathAndQuery();
+
+	if (this->_settings.protocol == HTTPS) {
+		this->_session = new countingHTTPSClientSession(this->_host, this->_port, this->_context, this->_stats);
+	} else {
+		this->_session = new countingHTTPClientSession(this->_host, this->_port, this->_stats);
+	}
+	this->_session->setKeepAlive(true);
+	this->_session->setTimeout(Poco::Timespan(this->_settings.timeout, 0));
+}
+
+wifibeat::utils::esClient::~esClient()
+{
+	delete this->_session;
+}
+
+void wifibeat::utils::esClient::prepareRequest(HTTPRequest & request)
+{
+	request.setKeepAlive(true);
+	if (!this->_settings.username.empty()) {
+		Poco::Net::HTTPBasicCredentials credentials(this->_settings.username, this->_settings.password);
+		credentials.authenticate(request);
+	}
+	for (const auto & kv: this->_settings.headers) {
+		request.set(kv.first, kv.second);
+	}
+}
+
+int wifibeat::utils::esClient::request(const string & method, const string & path, const string & body, string & response)
+{
+	response.clear();
+	try {
+		HTTPRequest req(method, path, HTTPMessage::HTTP_1_1);
+		this->prepareRequest(req);
+		if (!body.empty() || method == HTTPRequest::HTTP_POST || method == HTTPRequest::HTTP_PUT) {
+			req.setContentType("application/json");
+			req.setContentLength(body.size());
+		}
+		std::ostream & os = this->_session->sendRequest(req);
+		if (!body.empty()) {
+			os.write(body.data(), body.size());
+		}
+
+		HTTPResponse resp;
+		std::istream & is = this->_session->receiveResponse(resp);
+		Poco::StreamCopier::copyToString(is, response);
+		return resp.getStatus();
+	} catch (const Poco::Exception & e) {
+		response = e.displayText();
+	} catch (const std::exception & e) {
+		response = e.what();
+	}
+
+	// Start over with a new connection next time
+	this->_session->reset();
+	return 0;
+}
+
+void wifibeat::utils::esClient::connect()
+{
+	string response;
+	int status = this->request(HTTPRequest::HTTP_GET, "/", "", response);
+	if (status != 200) {
+		stringstream ss;
+		ss << "HTTP status " << status << ": " << response;
+		throw ss.str();
+	}
+
+	rapidjson::Document d;
+	d.Parse(response.c_str());
+	if (d.HasParseError() || !d.IsObject() || !d.HasMember("version") || !d["version"].IsObject()
+			|| !d["version"].HasMember("number") || !d["version"]["number"].IsString()) {
+		throw string("Invalid response, version number not found");
+	}
+	this->_version = d["version"]["number"].GetString();
+	try {
+		this->_majorVersion = (unsigned int)std::stoul(this->_version);
+	} catch (const std::exception & e) {
+		throw string("Invalid version number: " + this->_version);
+	}
+}
+
+bool wifibeat::utils::esClient::bulk(const string & body, bulkResult & result)
+{
+	result = bulkResult();
+	string response;
+	try {
+		HTTPRequest req(HTTPRequest::HTTP_POST, this->_bulkURI, HTTPMessage::HTTP_1_1);
+		this->prepareRequest(req);
+		req.setContentType("application/x-ndjson");
+		req.setContentLength(body.size());
+
+		// Written directly to the socket, no copy of the body
+		std::ostream & os = this->_session->sendRequest(req);
+		os.write(body.data(), body.size());
+
+		HTTPResponse resp;
+		std::istream & is = this->_session->receiveResponse(resp);
+		Poco::StreamCopier::copyToString(is, response);
+		result.httpStatus = resp.getStatus();
+	} catch (const Poco::Exception & e) {
+		result.error = e.displayText();
+		this->_session->reset();
+		return false;
+	} catch (const std::exception & e) {
+		result.error = e.what();
+		this->_session->reset();
+		return false;
+	}
+
+	if (result.httpStatus != 200) {
+		result.error = response.substr(0, 512);
+		return false;
+	}
+
+	// "errors" comes right after "took": avoid parsing all the items when everything went fine
+	size_t pos = response.find("\"errors\":");
+	if (pos != string::npos && pos < 64 && response.compare(pos + 9, 5, "false") == 0) {
+		return true;
+	}
+
+	rapidjson::Document d;
+	d.Parse(response.c_str());
+	if (d.HasParseError() || !d.IsObject()) {
+		result.error = "Invalid _bulk response";
+		return false;
+	}
+	if (d.HasMember("errors") && d["errors"].IsBool()) {
+		result.errors = d["errors"].GetBool();
+	}
+	if (result.errors && d.HasMember("items") && d["items"].IsArray()) {
+		unsigned int index = 0;
+		for (const rapidjson::Value & item: d["items"].GetArray()) {
+			++index;
+			if (!item.IsObject() || item.MemberBegin() == item.MemberEnd()) {
+				continue;
+			}
+			const rapidjson::Value & action = item.MemberBegin()->value;
+			if (!action.IsObject() || !action.HasMember("status") || !action["status"].IsInt()) {
+				continue;
+			}
+			int status = action["status"].GetInt();
+			if (status >= 300) {
+				++result.failedItems;
+				if (status == 429 || status >= 500) {
+					result.retryItems.push_back(index - 1);
+				}
+				if (status == 429) {
+					++result.rejectedItems;
+				} else if (result.error.empty() && action.HasMember("error")) {
+					// Keep the first one for the logs
+					const rapidjson::Value & error = action["error"];
+					if (error.IsObject() && error.HasMember("reason") && error["reason"].IsString()) {
+						result.error = error["reason"].GetString();
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+string wifibeat::utils::esClient::items(const string & body, const vector<unsigned int> & indexes)
+{
+	string ret;
+	size_t pos = 0;
+	unsigned int item = 0;
+	for (unsigned int index: indexes) {
+		// Skip to the item
+		for (; item < index && pos < body.size(); ++item) {
+			for (int line = 0; line < 2 && pos != string::npos; ++line) {
+				pos = body.find('\n', pos);
+				if (pos != string::npos) {
+					++pos;
+				}
+			}
+		}
+		if (pos == string::npos || pos >= body.size()) {
+			break;
+		}
+
+		size_t start = pos;
+		for (int line = 0; line < 2 && pos != string::npos; ++line) {
+			pos = body.find('\n', pos);
+			if (pos != string::npos) {
+				++pos;
+			}
+		}
+		ret.append(body, start, (pos == string::npos) ? string::npos : pos - start);
+		++item;
+		if (pos == string::npos) {
+			break;
+		}
+	}
+	return ret;
+}
+
+bool wifibeat::utils::esClient::nodes(bool dataOnly, vector<IPPort> & hosts, string & error)
+{
+	string response;
+	int status = this->request(HTTPRequest::HTTP_GET, "/_nodes/http", "", response);
+	if (status != 200) {
+		stringstream ss;
+		ss << "HTTP status " << status << ": " << response.substr(0, 512);
+		error = ss.str();
+		return false;
+	}
+	return parseNodes(response, dataOnly, hosts, error);
+}
+
+bool wifibeat::utils::esClient::parseNodes(const string & json, bool dataOnly, vector<IPPort> & hosts, string & error)
+{
+	hosts.clear();
+	rapidjson::Document d;
+	d.Parse(json.c_str());
+	if (d.HasParseError() || !d.IsObject() || !d.HasMember("nodes") || !d["nodes"].IsObject()) {
+		error = "Invalid _nodes response";
+		return false;
+	}
+
+	for (const auto & node: d["nodes"].GetObject()) {
+		const rapidjson::Value & n = node.value;
+		if (!n.IsObject() || !n.HasMember("http") || !n["http"].IsObject()
+				|| !n["http"].HasMember("publish_address") || !n["http"]["publish_address"].IsString()) {
+			// HTTP disabled on that node
+			continue;
+		}
+
+		if (dataOnly) {
+			bool data = true;
+			if (n.HasMember("roles") && n["roles"].IsArray()) {
+				// 5.0+: data, or data_hot/data_content/... since 7.10
+				data = false;
+				for (const rapidjson::Value & role: n["roles"].GetArray()) {
+					if (role.IsString() && string(role.GetString()).compare(0, 4, "data") == 0) {
+						data = true;
+						break;
+					}
+				}
+			} else if (n.HasMember("attributes") && n["attributes"].IsObject() && n["attributes"].HasMember("data")
+					&& n["attributes"]["data"].IsString()) {
+				// Before 5.0
+				data = string(n["attributes"]["data"].GetString()) != "false";
+			}
+			if (!data) {
+				continue;
+			}
+		}
+
+		// Formats: 10.0.0.1:9200, hostname/10.0.0.1:9200, inet[/10.0.0.1:9200], [::1]:9200
+		string address = n["http"]["publish_address"].GetString();
+		if (address.compare(0, 5, "inet[") == 0 && address[address.size() - 1] == ']') {
+			address = address.substr(5, address.size() - 6);
+		}
+
+		// Keep the hostname when there is one, it's what certificates usually are issued for
+		string hostname;
+		size_t slash = address.find('/');
+		if (slash != string::npos) {
+			hostname = address.substr(0, slash);
+			address = address.substr(slash + 1);
+		}
+		size_t colon = address.rfind(':');
+		if (colon == string::npos || colon == 0) {
+			continue;
+		}
+		string host = (hostname.empty()) ? address.substr(0, colon) : hostname;
+		if (host.size() > 2 && host[0] == '[' && host[host.size() - 1] == ']') {
+			host = host.substr(1, host.size() - 2);
+		}
+		unsigned long port = 0;
+		try {
+			port = std::stoul(address.substr(colon + 1));
+		} catch (const std::exception & e) {
+			continue;
+		}
+		if (port == 0 || port > 65535) {
+			continue;
+		}
+		hosts.push_back(IPPort(host, (unsigned short int)port));
+	}
+
+	return true;
+}
+
+const wifibeat::utils::connectionStats & wifibeat::utils::esClient::Stats()
+{
+	return this->_stats;
+}
+
+string wifibeat::utils::esClient::Version()
+{
+	return this->_version;
+}
+
+unsigned int wifibeat::utils::esClient::MajorVersion()
+{
+	return this->_majorVersion;
+}
+
+string wifibeat::utils::esClient::Host()
+{
+	return this->_host;
+}
+
+unsigned short int wifibeat::utils::esClient::Port()
+{
+	return this->_port;
+}
+
+string wifibeat::utils::esClient::toString()
+{
+	if (this->_string.empty()) {
+		stringstream ss;
+		ss << this->_scheme << "://" << this->_host << ':' << this->_port;
+		this->_string = ss.str();
+	}
+	return this->_string;
+}
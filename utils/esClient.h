@@ -0,0 +1,106 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UTILS_ESCLIENT_H
+#define UTILS_ESCLIENT_H
+
+#include <string>
+#include <vector>
+#include <Poco/Net/HTTPClientSession.h>
+#include <Poco/Net/Context.h>
+#include "config/es.h"
+
+using std::string;
+using std::vector;
+
+namespace wifibeat
+{
+	namespace utils
+	{
+		struct bulkResult {
+			int httpStatus; // 0 if the request couldn't be sent or the response received
+			bool errors; // At least one item failed
+			unsigned int failedItems;
+			unsigned int rejectedItems; // Failed with 429
+			vector<unsigned int> retryItems; // Failed with 429 or 5xx, worth sending again (index in the request)
+			string error;
+			bulkResult() : httpStatus(0), errors(false), failedItems(0), rejectedItems(0), error("") { }
+		};
+
+		struct connectionStats {
+			unsigned long long int connections; // TCP connections opened
+			unsigned long long int handshakes; // Full TLS handshakes
+			unsigned long long int resumedSessions; // TLS handshakes resuming a previous session
+			connectionStats() : connections(0), handshakes(0), resumedSessions(0) { }
+		};
+
+		// HTTP(S) connection to a single Elasticsearch node. Not thread safe.
+		// The connection is kept alive between requests and TLS sessions are resumed when reconnecting.
+		class esClient
+		{
+			private:
+				string _scheme;
+				string _host;
+				unsigned short int _port;
+				const ElasticSearchConnection & _settings;
+				Poco::Net::HTTPClientSession * _session;
+				Poco::Net::Context::Ptr _context; // HTTPS only
+				connectionStats _stats;
+
+				string _version;
+				unsigned int _majorVersion;
+				string _bulkURI;
+				string _string;
+
+				void prepareRequest(Poco::Net::HTTPRequest & request);
+
+			public:
+				// With HTTPS, context should be shared by all the connections of an output
+				// (see tls::clientContext), one is created otherwise. Throws a string on failure.
+				esClient(const string & host, unsigned short int port, const ElasticSearchConnection & settings,
+							Poco::Net::Context::Ptr context = Poco::Net::Context::Ptr());
+				~esClient();
+
+				// GET /: fetch the version. Throws a string on failure.
+				void connect();
+
+				// POST _bulk: body is NDJSON (action line, source, ...) and is sent as is.
+				bool bulk(const string & body, bulkResult & result);
+
+				// Body of a bulk request with only some of the items of another one (index actions, two lines each)
+				static string items(const string & body, const vector<unsigned int> & indexes);
+
+				// GET _nodes/http: HTTP address of the nodes in the cluster.
+				// dataOnly skips nodes without a data role (master only, coordinating only, ...)
+				bool nodes(bool dataOnly, vector<IPPort> & hosts, string & error);
+				static bool parseNodes(const string & json, bool dataOnly, vector<IPPort> & hosts, string & error);
+
+				// Generic request, returns the HTTP status (0 if it failed)
+				int request(const string & method, const string & path, const string & body, string & response);
+
+				string Version();
+				unsigned int MajorVersion();
+				string Host();
+				unsigned short int Port();
+				const connectionStats & Stats();
+				string toString();
+		};
+	}
+}
+
+#endif // UTILS_ESCLIENT_H
@@ -0,0 +1,172 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "esTemplate.h"
+#include <sstream>
+
+using std::stringstream;
+
+string wifibeat::utils::esTemplate::mappings(unsigned int majorVersion)
+{
+	// Keyword type changed name in 5.0
+	string keyword, notIndexed, shortNotIndexed;
+	if (majorVersion < 5) {
+		keyword = "{\"type\":\"string\",\"index\":\"not_analyzed\",\"ignore_above\":" ES_TEMPLATE_IGNORE_ABOVE "}";
+		notIndexed = "{\"type\":\"string\",\"index\":\"no\"}";
+		shortNotIndexed = "{\"type\":\"short\",\"index\":\"no\"}";
+	} else {
+		keyword = "{\"type\":\"keyword\",\"ignore_above\":" ES_TEMPLATE_IGNORE_ABOVE "}";
+		notIndexed = "{\"type\":\"keyword\",\"index\":false,\"doc_values\":false}";
+		shortNotIndexed = "{\"type\":\"short\",\"index\":false,\"doc_values\":false}";
+	}
+	const string disabled = "{\"type\":\"object\",\"enabled\":false}";
+	const string byteType = "{\"type\":\"byte\"}";
+	const string shortType = "{\"type\":\"short\"}";
+	const string integerType = "{\"type\":\"integer\"}";
+	const string longType = "{\"type\":\"long\"}";
+	const string booleanType = "{\"type\":\"boolean\"}";
+	// 64 bit TSF: unsigned_long exists since 7.10, long would reject values above 2^63
+	const string unsignedLongType = (majorVersion >= 8) ? "{\"type\":\"unsigned_long\"}" : keyword;
+
+	stringstream ss;
+	ss << '{';
+
+	// Any string that isn't listed below
+	ss << "\"dynamic_templates\":[{\"strings_as_keyword\":{\"match_mapping_type\":\"string\",\"mapping\":" << keyword << "}}],";
+	if (majorVersion < 6) {
+		ss << "\"_all\":{\"enabled\":false},";
+	}
+
+	ss << "\"properties\":{"
+		<< "\"@timestamp\":{\"type\":\"date\"},"
+		<< "\"duplicates\":" << integerType << ','
+		<< "\"beat\":{\"properties\":{"
+			<< "\"hostname\":" << keyword << ','
+			<< "\"name\":" << keyword << ','
+			<< "\"version\":" << keyword
+		<< "}},"
+		<< "\"wlan\":{\"properties\":{"
+			<< "\"size\":" << integerType << ','
+			<< "\"duration\":" << integerType << ','
+			<< "\"seq\":" << integerType << ','
+			<< "\"frag\":" << shortType << ','
+			<< "\"wds\":" << byteType << ','
+			<< "\"ra\":" << keyword << ','
+			<< "\"ta\":" << keyword << ','
+			<< "\"sa\":" << keyword << ','
+			<< "\"da\":" << keyword << ','
+			<< "\"bssid\":" << keyword << ','
+			<< "\"sta\":" << keyword << ','
+			<< "\"fc\":{\"properties\":{"
+				<< "\"version\":" << byteType << ','
+				<< "\"type\":" << byteType << ','
+				<< "\"subtype\":" << byteType << ','
+				<< "\"type_str\":" << keyword << ','
+				<< "\"type_subtype\":" << keyword << ','
+				<< "\"tods\":" << booleanType << ','
+				<< "\"fromds\":" << booleanType << ','
+				<< "\"ds\":" << byteType << ','
+				<< "\"frag\":" << booleanType << ','
+				<< "\"retry\":" << booleanType << ','
+				<< "\"pwrmgt\":" << booleanType << ','
+				<< "\"moredata\":" << booleanType << ','
+				<< "\"protected\":" << booleanType << ','
+				<< "\"order\":" << booleanType
+			<< "}}"
+		<< "}},"
+		<< "\"wlan_mgt\":{\"properties\":{"
+			<< "\"ssid\":" << keyword << ','
+			<< "\"fixed\":{\"properties\":{"
+				<< "\"timestamp\":" << unsignedLongType << ','
+				<< "\"timestamp_hex\":" << notIndexed << ','
+				<< "\"beacon\":" << integerType << ','
+				<< "\"beacon_interval_usec\":" << longType << ','
+				<< "\"listen_ival\":" << integerType << ','
+				<< "\"aid\":" << integerType << ','
+				<< "\"auth_seq\":" << shortType << ','
+				<< "\"status_code\":" << shortType << ','
+				<< "\"status_code_parsed\":" << keyword << ','
+				<< "\"reason_code\":" << shortType << ','
+				<< "\"reason_code_parsed\":" << keyword
+			<< "}},"
+			<< "\"ds\":{\"properties\":{\"current_channel\":" << shortType << "}},"
+			<< "\"tim\":{\"properties\":{"
+				<< "\"dtim_count\":" << shortType << ','
+				<< "\"dtim_period\":" << shortType << ','
+				<< "\"partial_virtual_bitmap\":" << shortNotIndexed
+			<< "}},"
+			// Raw tagged parameters: the useful ones are already parsed in wlan_mgt
+			<< "\"tagged\":" << disabled
+		<< "}},"
+		<< "\"data\":" << disabled
+	<< "}}";
+
+	return ss.str();
+}
+
+string wifibeat::utils::esTemplate::build(unsigned int majorVersion, const vector<string> & indexPatterns,
+											const string & refreshInterval, const string & documentType)
+{
+	stringstream settings;
+	settings << "{\"index\":{";
+	if (!refreshInterval.empty()) {
+		settings << "\"refresh_interval\":\"" << refreshInterval << "\",";
+	}
+	if (majorVersion >= 5) {
+		settings << "\"mapping\":{\"total_fields\":{\"limit\":" ES_TEMPLATE_TOTAL_FIELDS_LIMIT "}},";
+	}
+	settings << "\"codec\":\"best_compression\"}}";
+
+	// Mappings are per document type before 7
+	string mapping = mappings(majorVersion);
+	if (majorVersion < 7) {
+		mapping = "{\"" + ((documentType.empty()) ? string("doc") : documentType) + "\":" + mapping + '}';
+	}
+
+	stringstream ss;
+	ss << '{';
+	if (majorVersion < 6) {
+		// Only a single pattern is supported
+		ss << "\"template\":\"" << ((indexPatterns.empty()) ? "*" : indexPatterns[0]) << "\",";
+	} else {
+		ss << "\"index_patterns\":[";
+		for (size_t i = 0; i < indexPatterns.size(); ++i) {
+			if (i) {
+				ss << ',';
+			}
+			ss << '"' << indexPatterns[i] << '"';
+		}
+		ss << "],";
+	}
+
+	if (majorVersion >= 8) {
+		ss << "\"priority\":100,\"template\":{\"settings\":" << settings.str() << ",\"mappings\":" << mapping << "}}";
+	} else {
+		ss << "\"order\":1,\"settings\":" << settings.str() << ",\"mappings\":" << mapping << '}';
+	}
+
+	return ss.str();
+}
+
+string wifibeat::utils::esTemplate::path(unsigned int majorVersion, const string & name)
+{
+	if (majorVersion >= 8) {
+		return "/_index_template/" + name;
+	}
+	return "/_template/" + name;
+}
@@ -0,0 +1,57 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UTILS_ESTEMPLATE_H
+#define UTILS_ESTEMPLATE_H
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+#define ES_TEMPLATE_IGNORE_ABOVE "1024"
+#define ES_TEMPLATE_TOTAL_FIELDS_LIMIT "2000"
+
+namespace wifibeat
+{
+	namespace utils
+	{
+		// Index template shipped with WiFiBeat.
+		// Instead of letting dynamic mapping create text + keyword for every string:
+		// - MACs, enumerations and other strings are keywords (no norms, no analysis)
+		// - Counters and numbers get the smallest numeric type that fits
+		// - Fields nobody searches on (raw tags, hex values) aren't indexed, only kept in _source
+		class esTemplate
+		{
+			private:
+				static string mappings(unsigned int majorVersion);
+
+			public:
+				// Full template body for the given Elasticsearch major version.
+				// 8+ uses composable templates (_index_template), others use _template.
+				static string build(unsigned int majorVersion, const vector<string> & indexPatterns,
+									const string & refreshInterval, const string & documentType);
+
+				// API path to install/check the template
+				static string path(unsigned int majorVersion, const string & name);
+		};
+	}
+}
+
+#endif // UTILS_ESTEMPLATE_H
@@ -22,6 +22,7 @@
 #include <unistd.h>
 #include <ostream>
 #include <fstream>
+#include <sstream>
 
 bool wifibeat::utils::file::exists(const string & path) {
 	if (path.empty()) {
@@ -56,4 +57,18 @@ bool wifibeat::utils::file::rm(const std::string & path) {
 	}
 	
 	return remove(path.c_str()) == 0;
+}
+
+bool wifibeat::utils::file::read(const string & path, string & content)
+{
+	std::ifstream fs(path, std::ios::in | std::ios::binary);
+	if (!fs) {
+		return false;
+	}
+
+	std::stringstream ss;
+	ss << fs.rdbuf();
+	content = ss.str();
+
+	return !fs.bad();
 }
\ No newline at end of file
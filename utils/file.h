@@ -32,6 +32,7 @@ namespace wifibeat
 				static bool exists(const string & path);
 				static bool writePID(const string & path);
 				static bool rm(const string & path);
+				static bool read(const string & path, string & content);
 		};
 	}
 }
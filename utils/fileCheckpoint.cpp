@@ -0,0 +1,257 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "fileCheckpoint.h"
+#include "Locker.h"
+#include "logger.h"
+#include "file.h"
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/stat.h>
+
+bool wifibeat::utils::fileIdentity::operator==(const fileIdentity & other) const
+{
+	return this->device == other.device && this->inode == other.inode && this->size == other.size
+		&& this->mtime.tv_sec == other.mtime.tv_sec && this->mtime.tv_nsec == other.mtime.tv_nsec;
+}
+
+wifibeat::utils::fileCheckpoint::fileCheckpoint(const string & path, std::chrono::milliseconds interval)
+	: _path(path), _interval(interval), _dirty(false), _mutexInit(false)
+{
+	if (this->_path.empty()) {
+		this->_path = FILECHECKPOINT_DEFAULT_PATH;
+	}
+	if (pthread_mutex_init(&this->_mutex, NULL) != 0) {
+		LOG_CRITICAL("Failed initializing file checkpoint mutex");
+		throw string("Failed initializing file checkpoint mutex");
+	}
+	this->_mutexInit = true;
+	this->_lastSave = std::chrono::steady_clock::now();
+}
+
+wifibeat::utils::fileCheckpoint::~fileCheckpoint()
+{
+	if (this->_dirty) {
+		this->saveLocked();
+	}
+	if (this->_mutexInit) {
+		pthread_mutex_destroy(&this->_mutex);
+	}
+}
+
+bool wifibeat::utils::fileCheckpoint::identity(const string & file, fileIdentity & id)
+{
+	struct stat st;
+	if (stat(file.c_str(), &st) != 0) {
+		return false;
+	}
+	id.device = st.st_dev;
+	id.inode = st.st_ino;
+	id.size = st.st_size;
+	id.mtime = st.st_mtim;
+	return true;
+}
+
+bool wifibeat::utils::fileCheckpoint::load()
+{
+	Locker l(&this->_mutex);
+	if (!file::exists(this->_path)) {
+		return true;
+	}
+	std::ifstream f(this->_path);
+	if (!f.is_open()) {
+		LOG_ERROR("Failed reading file checkpoint <" + this->_path + ">");
+		return false;
+	}
+
+	string line;
+	while (std::getline(f, line)) {
+		std::stringstream ss(line);
+		fileProgress progress;
+		long long int sec = 0, nsec = 0;
+		char state = 0;
+		if (!(ss >> progress.position >> state >> progress.identity.device >> progress.identity.inode
+				>> progress.identity.size >> sec >> nsec)) {
+			continue;
+		}
+		progress.state = (state == 'd') ? FileDone : ((state == 'f') ? FileFailed : FileReading);
+		progress.identity.mtime.tv_sec = (time_t)sec;
+		progress.identity.mtime.tv_nsec = (long)nsec;
+		string name;
+		std::getline(ss, name);
+		if (name.size() < 2) {
+			continue;
+		}
+		name.erase(0, 1);
+		this->_files[name] = progress;
+	}
+	return true;
+}
+
+bool wifibeat::utils::fileCheckpoint::save()
+{
+	Locker l(&this->_mutex);
+	return !this->_dirty || this->saveLocked();
+}
+
+bool wifibeat::utils::fileCheckpoint::saveLocked()
+{
+	string tmp = this->_path + ".tmp";
+	FILE * f = fopen(tmp.c_str(), "w");
+	if (f == NULL) {
+		LOG_ERROR("Failed saving file checkpoint <" + tmp + ">: " + strerror(errno));
+		return false;
+	}
+	for (auto & kv: this->_files) {
+		if (kv.second.stale) {
+			identity(kv.first, kv.second.identity);
+			kv.second.stale = false;
+		}
+		const fileIdentity & id = kv.second.identity;
+		char state = (kv.second.state == FileDone) ? 'd' : ((kv.second.state == FileFailed) ? 'f' : 'p');
+		fprintf(f, "%llu %c %llu %llu %llu %lld %ld %s\n", kv.second.position, state, id.device, id.inode, id.size,
+			(long long int)id.mtime.tv_sec, (long)id.mtime.tv_nsec, kv.first.c_str());
+	}
+	fflush(f);
+	fdatasync(fileno(f));
+	fclose(f);
+	if (rename(tmp.c_str(), this->_path.c_str()) != 0) {
+		LOG_ERROR("Failed saving file checkpoint <" + this->_path + ">: " + strerror(errno));
+		return false;
+	}
+	this->_dirty = false;
+	this->_lastSave = std::chrono::steady_clock::now();
+	return true;
+}
+
+unsigned long long int wifibeat::utils::fileCheckpoint::position(const string & file, bool growing)
+{
+	fileIdentity id;
+	if (!identity(file, id)) {
+		return 0;
+	}
+
+	Locker l(&this->_mutex);
+	std::map<string, fileProgress>::iterator it = this->_files.find(file);
+	if (it == this->_files.end()) {
+		return 0;
+	}
+	bool same = (growing) ? it->second.identity.device == id.device && it->second.identity.inode == id.inode
+							&& id.size >= it->second.position
+						: it->second.identity == id;
+	if (!same) {
+		LOG_NOTICE("<" + file + "> changed since it was last read, reading it from the start");
+		this->_files.erase(it);
+		this->_dirty = true;
+		return 0;
+	}
+	return it->second.position;
+}
+
+wifibeat::utils::fileState wifibeat::utils::fileCheckpoint::state(const string & file)
+{
+	Locker l(&this->_mutex);
+	std::map<string, fileProgress>::const_iterator it = this->_files.find(file);
+	return (it == this->_files.end()) ? FileReading : it->second.state;
+}
+
+void wifibeat::utils::fileCheckpoint::finish(const string & file, bool failed)
+{
+	Locker l(&this->_mutex);
+	fileProgress & progress = this->_files[file];
+	identity(file, progress.identity);
+	progress.state = (failed) ? FileFailed : FileDone;
+	this->saveLocked();
+}
+
+void wifibeat::utils::fileCheckpoint::remove(const string & file)
+{
+	Locker l(&this->_mutex);
+	if (this->_files.erase(file)) {
+		this->_dirty = true;
+	}
+}
+
+std::vector<string> wifibeat::utils::fileCheckpoint::files()
+{
+	Locker l(&this->_mutex);
+	std::vector<string> ret;
+	for (const auto & kv: this->_files) {
+		ret.push_back(kv.first);
+	}
+	return ret;
+}
+
+unsigned int wifibeat::utils::fileCheckpoint::track(const string & file)
+{
+	Locker l(&this->_mutex);
+	std::vector<string>::iterator it = std::find(this->_tracked.begin(), this->_tracked.end(), file);
+	if (it != this->_tracked.end()) {
+		return (it - this->_tracked.begin()) + 1;
+	}
+	this->_tracked.push_back(file);
+	return this->_tracked.size();
+}
+
+void wifibeat::utils::fileCheckpoint::update(unsigned int file, unsigned long long int position)
+{
+	Locker l(&this->_mutex);
+	if (file && file <= this->_tracked.size()) {
+		this->updateLocked(this->_tracked[file - 1], position);
+	}
+}
+
+unsigned long long int wifibeat::utils::fileCheckpoint::updated(unsigned int file)
+{
+	Locker l(&this->_mutex);
+	if (file == 0 || file > this->_tracked.size()) {
+		return 0;
+	}
+	std::map<string, fileProgress>::const_iterator it = this->_files.find(this->_tracked[file - 1]);
+	return (it == this->_files.end()) ? 0 : it->second.position;
+}
+
+void wifibeat::utils::fileCheckpoint::update(const string & file, unsigned long long int position)
+{
+	Locker l(&this->_mutex);
+	this->updateLocked(file, position);
+}
+
+void wifibeat::utils::fileCheckpoint::updateLocked(const string & file, unsigned long long int position)
+{
+	fileProgress & progress = this->_files[file];
+	if (progress.position == position && progress.identity.inode) {
+		return;
+	}
+	if (progress.identity.inode == 0 && !identity(file, progress.identity)) {
+		this->_files.erase(file);
+		return;
+	}
+	progress.position = position;
+	progress.stale = true;
+	this->_dirty = true;
+
+	if (std::chrono::steady_clock::now() - this->_lastSave >= this->_interval) {
+		this->saveLocked();
+	}
+}
@@ -0,0 +1,121 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Progress of the files being read, so ingestion resumes where it stopped when
+// the same file is read again after a restart. Used for wifibeat.files, where
+// positions are updated once the outputs acknowledged the frames (see
+// threads/persistence.h), and for watched directories (the same way with the
+// persistent queue).
+// A file is only resumed if it is still the same: device, inode, size and
+// modification time must match (only device and inode for files still being
+// written to). The position is the byte offset of the next record for pcap
+// files and the number of records already read for pcapng and compressed files
+// (they can't be seeked into). Saved to a temporary file then renamed, at most
+// once per interval, one line per file:
+// <position> <state> <dev> <inode> <size> <mtime s> <mtime ns> <path>
+#ifndef UTILS_FILECHECKPOINT_H
+#define UTILS_FILECHECKPOINT_H
+
+#include <string>
+#include <map>
+#include <vector>
+#include <chrono>
+#include <pthread.h>
+#include <time.h>
+
+using std::string;
+
+#define FILECHECKPOINT_DEFAULT_PATH ".wifibeat-files-checkpoint"
+
+namespace wifibeat
+{
+	namespace utils
+	{
+		struct fileIdentity {
+			unsigned long long int device;
+			unsigned long long int inode;
+			unsigned long long int size;
+			struct timespec mtime;
+			fileIdentity() : device(0), inode(0), size(0), mtime({0, 0}) { }
+			bool operator==(const fileIdentity & other) const;
+		};
+
+		enum fileState {
+			FileReading,
+			FileDone,
+			FileFailed
+		};
+
+		class fileCheckpoint
+		{
+			private:
+				struct fileProgress {
+					fileIdentity identity;
+					unsigned long long int position;
+					fileState state;
+					bool stale; // Identity to refresh when saving, the file may have grown
+					fileProgress() : position(0), state(FileReading), stale(false) { }
+				};
+
+				string _path;
+				std::chrono::milliseconds _interval;
+				std::map<string, fileProgress> _files;
+				std::vector<string> _tracked;
+				bool _dirty;
+				std::chrono::steady_clock::time_point _lastSave;
+
+				pthread_mutex_t _mutex;
+				bool _mutexInit;
+
+				bool saveLocked();
+				void updateLocked(const string & file, unsigned long long int position);
+
+			public:
+				fileCheckpoint(const string & path, std::chrono::milliseconds interval);
+				~fileCheckpoint(); // Saves it
+
+				// A missing checkpoint file isn't an error
+				bool load();
+				bool save(); // Only if something changed
+
+				// Where to start reading that file, 0 if it wasn't read before or if it changed.
+				// A growing file is the same as long as it wasn't truncated.
+				unsigned long long int position(const string & file, bool growing = false);
+				fileState state(const string & file);
+
+				// Saves the checkpoint if the interval elapsed
+				void update(const string & file, unsigned long long int position);
+
+				// Id to tag frames with instead of the file name, above 0
+				unsigned int track(const string & file);
+				void update(unsigned int file, unsigned long long int position);
+				unsigned long long int updated(unsigned int file); // Last position given to update(), the file isn't checked
+
+				// Done with the file (or failed reading it), saves the checkpoint
+				void finish(const string & file, bool failed);
+
+				// Forget about a file (deleted, moved). Saved with the next update.
+				void remove(const string & file);
+				std::vector<string> files();
+
+				static bool identity(const string & file, fileIdentity & id);
+		};
+	}
+}
+
+#endif // UTILS_FILECHECKPOINT_H
@@ -0,0 +1,77 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "hash.h"
+#include <cstring>
+
+#define MURMUR64_M 0xc6a4a7935bd1e995ULL
+#define MURMUR64_R 47
+
+uint64_t wifibeat::utils::hash::murmur64(const void * data, size_t length, uint64_t seed)
+{
+	const unsigned char * bytes = static_cast<const unsigned char *>(data);
+	uint64_t h = seed ^ (length * MURMUR64_M);
+
+	// 8 bytes at a time. memcpy avoids unaligned reads.
+	const unsigned char * end = bytes + (length & ~((size_t)7));
+	for (; bytes != end; bytes += 8) {
+		uint64_t k;
+		memcpy(&k, bytes, sizeof(k));
+
+		k *= MURMUR64_M;
+		k ^= k >> MURMUR64_R;
+		k *= MURMUR64_M;
+
+		h ^= k;
+		h *= MURMUR64_M;
+	}
+
+	// Remaining bytes
+	switch (length & 7) {
+		case 7: h ^= uint64_t(bytes[6]) << 48;
+			[[fallthrough]];
+		case 6: h ^= uint64_t(bytes[5]) << 40;
+			[[fallthrough]];
+		case 5: h ^= uint64_t(bytes[4]) << 32;
+			[[fallthrough]];
+		case 4: h ^= uint64_t(bytes[3]) << 24;
+			[[fallthrough]];
+		case 3: h ^= uint64_t(bytes[2]) << 16;
+			[[fallthrough]];
+		case 2: h ^= uint64_t(bytes[1]) << 8;
+			[[fallthrough]];
+		case 1: h ^= uint64_t(bytes[0]);
+			h *= MURMUR64_M;
+	}
+
+	h ^= h >> MURMUR64_R;
+	h *= MURMUR64_M;
+	h ^= h >> MURMUR64_R;
+
+	return h;
+}
+
+uint64_t wifibeat::utils::hash::mix64(uint64_t value)
+{
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdULL;
+	value ^= value >> 33;
+	value *= 0xc4ceb9fe1a85ec53ULL;
+	value ^= value >> 33;
+	return value;
+}
@@ -0,0 +1,41 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UTILS_HASH_H
+#define UTILS_HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace wifibeat
+{
+	namespace utils
+	{
+		// Fast non-cryptographic hashing (MurmurHash64A), don't use it for anything security related.
+		class hash
+		{
+			public:
+				static uint64_t murmur64(const void * data, size_t length, uint64_t seed);
+
+				// Finalizer, spreads the bits of a single value
+				static uint64_t mix64(uint64_t value);
+		};
+	}
+}
+
+#endif // UTILS_HASH_H
@@ -0,0 +1,220 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "indexRouter.h"
+#include <stdexcept>
+#include <cctype>
+
+static const string frameTypeNames[INDEX_ROUTER_FRAME_TYPES] = { "management", "control", "data", "other" };
+
+wifibeat::utils::indexRouter::indexRouter(const string & defaultPattern, const map<string, string> & perTypePatterns, const string & documentType)
+	: _documentType(documentType)
+{
+	string error;
+	for (unsigned int i = 0; i < INDEX_ROUTER_FRAME_TYPES; ++i) {
+		string pattern = defaultPattern;
+		auto it = perTypePatterns.find(frameTypeNames[i]);
+		if (it != perTypePatterns.end()) {
+			pattern = it->second;
+		}
+		if (!isValidPattern(pattern, error)) {
+			throw string("Invalid index pattern <" + pattern + ">: " + error);
+		}
+		this->_patterns[i] = compile(pattern, frameTypeNames[i]);
+	}
+}
+
+string wifibeat::utils::indexRouter::frameTypeName(unsigned int frameType)
+{
+	if (frameType >= INDEX_ROUTER_FRAME_TYPES) {
+		frameType = INDEX_ROUTER_FRAME_TYPES - 1;
+	}
+	return frameTypeNames[frameType];
+}
+
+string wifibeat::utils::indexRouter::wildcard(const string & pattern)
+{
+	return pattern.substr(0, pattern.find("%{")) + '*';
+}
+
+bool wifibeat::utils::indexRouter::isValidPattern(const string & pattern, string & error)
+{
+	if (pattern.empty()) {
+		error = "index cannot be empty";
+		return false;
+	}
+	for (size_t i = 0; i < pattern.size(); ++i) {
+		if (pattern[i] == '%' && i + 1 < pattern.size() && pattern[i + 1] == '{') {
+			size_t end = pattern.find('}', i);
+			if (end == string::npos) {
+				error = "missing closing brace";
+				return false;
+			}
+			string var = pattern.substr(i + 2, end - i - 2);
+			if (var != "type" && (var.size() < 2 || var[0] != '+')) {
+				error = "unknown variable <" + var + ">";
+				return false;
+			}
+			i = end;
+			continue;
+		}
+
+		// Elasticsearch index names must be lowercase and can't contain some characters
+		char c = pattern[i];
+		if (isupper(static_cast<unsigned char>(c)) || c == ' ' || c == '"' || c == '*' || c == '\\'
+				|| c == '<' || c == '>' || c == '|' || c == ',' || c == '/' || c == '?' || c == '#') {
+			error = string("invalid character '") + c + "'";
+			return false;
+		}
+	}
+	return true;
+}
+
+wifibeat::utils::indexRouter::compiledPattern wifibeat::utils::indexRouter::compile(const string & pattern, const string & frameType)
+{
+	compiledPattern ret;
+	ret.granularity = 0;
+
+	for (size_t i = 0; i < pattern.size(); ++i) {
+		if (pattern[i] == '%' && i + 1 < pattern.size() && pattern[i + 1] == '{') {
+			size_t end = pattern.find('}', i);
+			string var = pattern.substr(i + 2, end - i - 2);
+			i = end;
+
+			if (var == "type") {
+				ret.format += frameType;
+				continue;
+			}
+
+			// Date: convert Joda tokens to strftime
+			for (size_t j = 1; j < var.size(); ++j) {
+				if (var.compare(j, 4, "yyyy") == 0) {
+					ret.format += "%Y";
+					j += 3;
+				} else if (var.compare(j, 2, "yy") == 0) {
+					ret.format += "%y";
+					j += 1;
+				} else if (var.compare(j, 2, "MM") == 0) {
+					ret.format += "%m";
+					j += 1;
+				} else if (var.compare(j, 2, "dd") == 0) {
+					ret.format += "%d";
+					j += 1;
+				} else if (var.compare(j, 2, "HH") == 0) {
+					ret.format += "%H";
+					j += 1;
+					if (ret.granularity == 0 || ret.granularity > 3600) {
+						ret.granularity = 3600;
+					}
+					continue;
+				} else if (var.compare(j, 2, "mm") == 0) {
+					ret.format += "%M";
+					j += 1;
+					ret.granularity = 60;
+					continue;
+				} else if (var[j] == '%') {
+					ret.format += "%%";
+					continue;
+				} else {
+					ret.format += var[j];
+					continue;
+				}
+
+				// Years, months and days are re-evaluated daily
+				if (ret.granularity == 0) {
+					ret.granularity = 86400;
+				}
+			}
+			continue;
+		}
+
+		if (pattern[i] == '%') {
+			ret.format += "%%";
+		} else {
+			ret.format += pattern[i];
+		}
+	}
+
+	return ret;
+}
+
+const wifibeat::utils::indexRouter::target * wifibeat::utils::indexRouter::getTarget(const string & index)
+{
+	auto it = this->_targets.find(index);
+	if (it != this->_targets.end()) {
+		return &(it->second);
+	}
+
+	// Avoid growing forever when replaying years of captures
+	if (this->_targets.size() >= INDEX_ROUTER_MAX_TARGETS) {
+		for (unsigned int i = 0; i < INDEX_ROUTER_FRAME_TYPES; ++i) {
+			this->_last[i] = cacheEntry();
+		}
+		this->_targets.clear();
+	}
+
+	target t;
+	t.index = index;
+	t.actionPrefix = "{\"index\":{\"_index\":\"" + index + "\"";
+	if (!this->_documentType.empty()) {
+		t.actionPrefix += ",\"_type\":\"" + this->_documentType + "\"";
+	}
+	t.actionLine = t.actionPrefix + "}}\n";
+	return &(this->_targets.insert({index, t}).first->second);
+}
+
+const wifibeat::utils::indexRouter::target * wifibeat::utils::indexRouter::route(unsigned int frameType, const struct timespec & ts)
+{
+	if (frameType >= INDEX_ROUTER_FRAME_TYPES) {
+		frameType = INDEX_ROUTER_FRAME_TYPES - 1;
+	}
+
+	// Same bucket as the previous frame of that type: nothing to do.
+	const compiledPattern & pattern = this->_patterns[frameType];
+	long long int bucket = 0;
+	if (pattern.granularity != 0) {
+		bucket = ts.tv_sec / pattern.granularity;
+	}
+	cacheEntry & last = this->_last[frameType];
+	if (last.t != NULL && last.bucket == bucket) {
+		return last.t;
+	}
+
+	string index = pattern.format;
+	if (pattern.granularity != 0) {
+		struct tm gm;
+		char buf[256];
+		if (gmtime_r(&ts.tv_sec, &gm) == NULL || strftime(buf, sizeof(buf), pattern.format.c_str(), &gm) == 0) {
+			throw string("Failed generating index name from <" + pattern.format + ">");
+		}
+		index = buf;
+	} else {
+		// No date, so strftime was never called to unescape
+		string::size_type pos = 0;
+		while ((pos = index.find("%%", pos)) != string::npos) {
+			index.erase(pos, 1);
+			++pos;
+		}
+	}
+
+	const target * t = this->getTarget(index);
+	last = cacheEntry();
+	last.bucket = bucket;
+	last.t = t;
+	return t;
+}
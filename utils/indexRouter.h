@@ -0,0 +1,86 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UTILS_INDEXROUTER_H
+#define UTILS_INDEXROUTER_H
+
+#include <string>
+#include <map>
+#include <time.h>
+
+using std::string;
+using std::map;
+
+// Index patterns use the same syntax as the other beats:
+// - %{+yyyy.MM.dd} is replaced by the (UTC) capture date of the frame.
+//   Supported: yyyy, yy, MM, dd, HH and mm.
+// - %{type} is replaced by the frame type: management, control, data (or other)
+// Example: wifibeat-%{type}-%{+yyyy.MM.dd} or wifibeat-%{+yyyy.MM.dd.HH}
+
+#define INDEX_ROUTER_FRAME_TYPES 4
+#define INDEX_ROUTER_MAX_TARGETS 256
+
+namespace wifibeat
+{
+	namespace utils
+	{
+		class indexRouter
+		{
+			public:
+				struct target {
+					string index;
+					string actionLine; // Pre-serialized _bulk action line, including the trailing newline
+					string actionPrefix; // Action line without the closing braces, to add an _id
+				};
+
+				// documentType: _type in the action line, only for Elasticsearch before 7.0 (empty to omit it)
+				indexRouter(const string & defaultPattern, const map<string, string> & perTypePatterns, const string & documentType = "");
+
+				// frameType is the 802.11 type (0: management, 1: control, 2: data, anything else: other)
+				// Returned pointer is valid until the next call.
+				const target * route(unsigned int frameType, const struct timespec & ts);
+
+				static bool isValidPattern(const string & pattern, string & error);
+				static string frameTypeName(unsigned int frameType);
+
+				// Wildcard matching every index a pattern can generate (for index templates)
+				static string wildcard(const string & pattern);
+
+			private:
+				struct compiledPattern {
+					string format; // strftime() format
+					time_t granularity; // Seconds, 0 if there is no date in the pattern
+				};
+				struct cacheEntry {
+					long long int bucket;
+					const target * t;
+					cacheEntry() : bucket(-1), t(NULL) { }
+				};
+
+				compiledPattern _patterns[INDEX_ROUTER_FRAME_TYPES];
+				cacheEntry _last[INDEX_ROUTER_FRAME_TYPES];
+				map<string, target> _targets;
+				string _documentType;
+
+				static compiledPattern compile(const string & pattern, const string & frameType);
+				const target * getTarget(const string & index);
+		};
+	}
+}
+
+#endif // UTILS_INDEXROUTER_H
@@ -0,0 +1,33 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Classic pcap file layout (all fields in the byte order of the magic):
+// 24 bytes file header (magic, version, timezone, accuracy, snaplen, link type)
+// then for each record a 16 bytes header (seconds, microseconds or nanoseconds,
+// captured length, original length) followed by the captured bytes.
+#ifndef UTILS_PCAPFORMAT_H
+#define UTILS_PCAPFORMAT_H
+
+#define PCAP_MAGIC_MICROSECONDS 0xa1b2c3d4
+#define PCAP_MAGIC_NANOSECONDS 0xa1b23c4d
+#define PCAPNG_MAGIC 0x0a0d0d0a // Section header block
+#define PCAP_FILE_HEADER_SIZE 24
+#define PCAP_RECORD_HEADER_SIZE 16
+#define PCAP_MAX_RECORD_SIZE (256 * 1024) // Anything bigger means the file is corrupted
+
+#endif // UTILS_PCAPFORMAT_H
@@ -0,0 +1,423 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "pcapIndex.h"
+#include "pcapMap.h"
+#include "logger.h"
+#include <pcap.h>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#define PCAPINDEX_HEADER_SIZE 48
+#define PCAPINDEX_BLOCK_SIZE 32
+#define PCAPINDEX_MAC_SIZE 24
+#define PCAPINDEX_BROADCAST 0xFFFFFFFFFFFFULL
+#define PCAPINDEX_BUILD_CHUNK (8 * 1024 * 1024)
+
+static void put64(vector<uint8_t> & buffer, uint64_t value)
+{
+	for (int i = 0; i < 8; ++i) {
+		buffer.push_back((uint8_t)(value >> (8 * i)));
+	}
+}
+
+static void put32(vector<uint8_t> & buffer, uint32_t value)
+{
+	for (int i = 0; i < 4; ++i) {
+		buffer.push_back((uint8_t)(value >> (8 * i)));
+	}
+}
+
+static uint64_t get64(const uint8_t * data)
+{
+	uint64_t value = 0;
+	for (int i = 7; i >= 0; --i) {
+		value = (value << 8) | data[i];
+	}
+	return value;
+}
+
+static uint32_t get32(const uint8_t * data)
+{
+	return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static uint64_t mac2int(const uint8_t * mac)
+{
+	uint64_t value = 0;
+	for (int i = 0; i < 6; ++i) {
+		value = (value << 8) | mac[i];
+	}
+	return value;
+}
+
+wifibeat::utils::pcapIndexBuilder::pcapIndexBuilder() : _records(0)
+{
+}
+
+void wifibeat::utils::pcapIndexBuilder::add(uint64_t offset, const struct timespec & ts, int linkType, const uint8_t * data, uint32_t length)
+{
+	int64_t time = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	if (this->_records % PCAPINDEX_BLOCK_RECORDS == 0) {
+		pcapIndexBlock block;
+		block.offset = offset;
+		block.earliest = time;
+		block.latest = time;
+		block.records = 0;
+		this->_blocks.push_back(block);
+	}
+	pcapIndexBlock & block = this->_blocks.back();
+	block.earliest = std::min(block.earliest, time);
+	block.latest = std::max(block.latest, time);
+	++block.records;
+	++this->_records;
+
+	uint64_t macs[4];
+	unsigned int count = pcapIndex::addresses(linkType, data, length, macs);
+	for (unsigned int i = 0; i < count; ++i) {
+		// Offsets only go up, deltas are small
+		postingList & list = this->_postings[macs[i]];
+		uint64_t delta = offset - list.last;
+		while (delta >= 0x80) {
+			list.deltas.push_back((uint8_t)(delta | 0x80));
+			delta >>= 7;
+		}
+		list.deltas.push_back((uint8_t)delta);
+		list.last = offset;
+		++list.count;
+	}
+}
+
+unsigned long long int wifibeat::utils::pcapIndexBuilder::Records() const
+{
+	return this->_records;
+}
+
+bool wifibeat::utils::pcapIndexBuilder::write(const string & path, uint64_t fileSize, int linkType, string & error) const
+{
+	vector<uint8_t> buffer;
+	buffer.reserve(PCAPINDEX_HEADER_SIZE + this->_blocks.size() * PCAPINDEX_BLOCK_SIZE + this->_postings.size() * PCAPINDEX_MAC_SIZE);
+	put32(buffer, PCAPINDEX_MAGIC);
+	put32(buffer, PCAPINDEX_VERSION);
+	put32(buffer, (uint32_t)linkType);
+	put32(buffer, 0);
+	put64(buffer, fileSize);
+	put64(buffer, this->_records);
+	put64(buffer, this->_blocks.size());
+	put64(buffer, this->_postings.size());
+
+	for (const pcapIndexBlock & block: this->_blocks) {
+		put64(buffer, block.offset);
+		put64(buffer, (uint64_t)block.earliest);
+		put64(buffer, (uint64_t)block.latest);
+		put32(buffer, block.records);
+		put32(buffer, 0);
+	}
+
+	size_t postings = 0;
+	for (const auto & kv: this->_postings) {
+		put64(buffer, kv.first);
+		put64(buffer, kv.second.count);
+		put64(buffer, kv.second.deltas.size());
+		postings += kv.second.deltas.size();
+	}
+	buffer.reserve(buffer.size() + postings);
+	for (const auto & kv: this->_postings) {
+		buffer.insert(buffer.end(), kv.second.deltas.begin(), kv.second.deltas.end());
+	}
+
+	string tmp = path + ".tmp";
+	FILE * f = fopen(tmp.c_str(), "w");
+	if (f == NULL) {
+		error = "Failed creating index <" + tmp + ">: " + strerror(errno);
+		return false;
+	}
+	bool written = fwrite(buffer.data(), 1, buffer.size(), f) == buffer.size();
+	written = (fflush(f) == 0) && written;
+	fclose(f);
+	if (!written) {
+		error = "Failed writing index <" + tmp + ">";
+		unlink(tmp.c_str());
+		return false;
+	}
+	if (rename(tmp.c_str(), path.c_str()) != 0) {
+		error = "Failed creating index <" + path + ">: " + strerror(errno);
+		unlink(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool wifibeat::utils::pcapIndexBuilder::build(const string & pcapPath, string & error)
+{
+	pcapMap map;
+	if (!map.open(pcapPath, error)) {
+		return false;
+	}
+
+	pcapIndexBuilder builder;
+	size_t offset = map.First();
+	pcapChunk chunk;
+	string scanError;
+	while (map.scan(offset, PCAPINDEX_BUILD_CHUNK, chunk, scanError)) {
+		size_t record = chunk.offset;
+		for (unsigned int i = 0; i < chunk.frames; ++i) {
+			size_t recordOffset = record;
+			struct timespec ts;
+			const uint8_t * data = NULL;
+			uint32_t length = 0;
+			map.record(record, ts, data, length);
+			builder.add(recordOffset, ts, map.LinkType(), data, length);
+		}
+		map.release(chunk);
+	}
+	if (!scanError.empty()) {
+		// Index what could be read
+		LOG_WARN(scanError);
+	}
+
+	return builder.write(pcapPath + PCAPINDEX_EXTENSION, map.Size(), map.LinkType(), error);
+}
+
+wifibeat::utils::pcapIndex::pcapIndex() : _fileSize(0), _linkType(0)
+{
+}
+
+bool wifibeat::utils::pcapIndex::load(const string & path, string & error)
+{
+	FILE * f = fopen(path.c_str(), "r");
+	if (f == NULL) {
+		error = "Failed opening index <" + path + ">: " + strerror(errno);
+		return false;
+	}
+	vector<uint8_t> buffer;
+	uint8_t block[65536];
+	size_t read;
+	while ((read = fread(block, 1, sizeof(block), f)) > 0) {
+		buffer.insert(buffer.end(), block, block + read);
+	}
+	fclose(f);
+
+	if (buffer.size() < PCAPINDEX_HEADER_SIZE || get32(buffer.data()) != PCAPINDEX_MAGIC) {
+		error = "<" + path + "> is not an index";
+		return false;
+	}
+	if (get32(buffer.data() + 4) != PCAPINDEX_VERSION) {
+		error = "<" + path + "> is an index of an unsupported version";
+		return false;
+	}
+	this->_linkType = (int)get32(buffer.data() + 8);
+	this->_fileSize = get64(buffer.data() + 16);
+	uint64_t blocks = get64(buffer.data() + 32);
+	uint64_t macs = get64(buffer.data() + 40);
+
+	size_t position = PCAPINDEX_HEADER_SIZE;
+	if (blocks > (buffer.size() - position) / PCAPINDEX_BLOCK_SIZE) {
+		error = "<" + path + "> is truncated";
+		return false;
+	}
+	this->_blocks.clear();
+	this->_blocks.reserve(blocks);
+	for (uint64_t i = 0; i < blocks; ++i, position += PCAPINDEX_BLOCK_SIZE) {
+		pcapIndexBlock b;
+		b.offset = get64(buffer.data() + position);
+		b.earliest = (int64_t)get64(buffer.data() + position + 8);
+		b.latest = (int64_t)get64(buffer.data() + position + 16);
+		b.records = get32(buffer.data() + position + 24);
+		this->_blocks.push_back(b);
+	}
+
+	if (macs > (buffer.size() - position) / PCAPINDEX_MAC_SIZE) {
+		error = "<" + path + "> is truncated";
+		return false;
+	}
+	size_t postings = position + macs * PCAPINDEX_MAC_SIZE;
+	size_t postingPosition = 0;
+	this->_macs.clear();
+	for (uint64_t i = 0; i < macs; ++i, position += PCAPINDEX_MAC_SIZE) {
+		postingList list;
+		list.position = postingPosition;
+		list.count = get64(buffer.data() + position + 8);
+		postingPosition += get64(buffer.data() + position + 16);
+		this->_macs[get64(buffer.data() + position)] = list;
+	}
+	if (postingPosition != buffer.size() - postings) {
+		error = "<" + path + "> is corrupted";
+		return false;
+	}
+	this->_postings.assign(buffer.begin() + postings, buffer.end());
+
+	return true;
+}
+
+uint64_t wifibeat::utils::pcapIndex::FileSize() const
+{
+	return this->_fileSize;
+}
+
+uint64_t wifibeat::utils::pcapIndex::Records() const
+{
+	uint64_t records = 0;
+	for (const pcapIndexBlock & block: this->_blocks) {
+		records += block.records;
+	}
+	return records;
+}
+
+void wifibeat::utils::pcapIndex::offsets(uint64_t mac, vector<uint64_t> & offsets) const
+{
+	std::map<uint64_t, postingList>::const_iterator it = this->_macs.find(mac);
+	if (it == this->_macs.end()) {
+		return;
+	}
+
+	size_t position = it->second.position;
+	uint64_t offset = 0;
+	for (uint64_t i = 0; i < it->second.count && position < this->_postings.size(); ++i) {
+		uint64_t delta = 0;
+		for (unsigned int shift = 0; position < this->_postings.size() && shift < 64; shift += 7) {
+			uint8_t byte = this->_postings[position++];
+			delta |= (uint64_t)(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) {
+				break;
+			}
+		}
+		offset += delta;
+		offsets.push_back(offset);
+	}
+}
+
+bool wifibeat::utils::pcapIndex::overlaps(size_t block, int64_t from, int64_t to) const
+{
+	return this->_blocks[block].latest >= from && this->_blocks[block].earliest <= to;
+}
+
+void wifibeat::utils::pcapIndex::lookup(int64_t from, int64_t to, const vector<uint64_t> & macs, vector<pcapIndexRange> & ranges) const
+{
+	ranges.clear();
+	bool byTime = from <= to;
+
+	if (macs.empty()) {
+		for (size_t i = 0; i < this->_blocks.size(); ++i) {
+			if (byTime && !this->overlaps(i, from, to)) {
+				continue;
+			}
+			uint64_t start = this->_blocks[i].offset;
+			uint64_t end = (i + 1 < this->_blocks.size()) ? this->_blocks[i + 1].offset : UINT64_MAX;
+			if (!ranges.empty() && ranges.back().end == start) {
+				ranges.back().end = end;
+			} else {
+				ranges.push_back({start, end});
+			}
+		}
+		return;
+	}
+
+	vector<uint64_t> records;
+	for (uint64_t mac: macs) {
+		this->offsets(mac, records);
+	}
+	std::sort(records.begin(), records.end());
+	records.erase(std::unique(records.begin(), records.end()), records.end());
+
+	for (uint64_t offset: records) {
+		if (byTime) {
+			// Block the record is in
+			vector<pcapIndexBlock>::const_iterator it = std::upper_bound(this->_blocks.begin(), this->_blocks.end(), offset,
+				[](uint64_t value, const pcapIndexBlock & block) { return value < block.offset; });
+			if (it == this->_blocks.begin() || !this->overlaps(it - this->_blocks.begin() - 1, from, to)) {
+				continue;
+			}
+		}
+		ranges.push_back({offset, offset + 1});
+	}
+}
+
+unsigned int wifibeat::utils::pcapIndex::addresses(int linkType, const uint8_t * data, uint32_t length, uint64_t macs[4])
+{
+	// Skip radiotap header
+	if (linkType == DLT_IEEE802_11_RADIO) {
+		if (length < 4) {
+			return 0;
+		}
+		uint16_t header = (uint16_t)(data[2] | (data[3] << 8));
+		if (header > length) {
+			return 0;
+		}
+		data += header;
+		length -= header;
+	} else if (linkType != DLT_IEEE802_11) {
+		return 0;
+	}
+	if (length < 10) {
+		return 0;
+	}
+
+	unsigned int type = (data[0] >> 2) & 0x03;
+	unsigned int subtype = (data[0] >> 4) & 0x0F;
+	bool toDS = (data[1] & 0x01) != 0;
+	bool fromDS = (data[1] & 0x02) != 0;
+
+	// Offsets of the addresses in the header
+	unsigned int positions[4] = { 4, 0, 0, 0 };
+	unsigned int count = 1;
+	if (type == 1) {
+		// Control frames: CTS and ACK only have a receiver
+		if (subtype != 12 && subtype != 13 && length >= 16) {
+			positions[count++] = 10;
+		}
+	} else if (type == 0 || type == 2) {
+		if (length >= 16) {
+			positions[count++] = 10;
+		}
+		if (length >= 22) {
+			positions[count++] = 16;
+		}
+		if (type == 2 && toDS && fromDS && length >= 30) {
+			positions[count++] = 24;
+		}
+	}
+
+	unsigned int found = 0;
+	for (unsigned int i = 0; i < count; ++i) {
+		uint64_t mac = mac2int(data + positions[i]);
+		if (mac == PCAPINDEX_BROADCAST || std::find(macs, macs + found, mac) != macs + found) {
+			continue;
+		}
+		macs[found++] = mac;
+	}
+	return found;
+}
+
+bool wifibeat::utils::pcapIndex::parseMac(const string & mac, uint64_t & value)
+{
+	unsigned int bytes[6];
+	char end;
+	if (sscanf(mac.c_str(), "%2x:%2x:%2x:%2x:%2x:%2x%c", &bytes[0], &bytes[1], &bytes[2], &bytes[3], &bytes[4], &bytes[5], &end) != 6
+		&& sscanf(mac.c_str(), "%2x-%2x-%2x-%2x-%2x-%2x%c", &bytes[0], &bytes[1], &bytes[2], &bytes[3], &bytes[4], &bytes[5], &end) != 6) {
+		return false;
+	}
+	value = 0;
+	for (int i = 0; i < 6; ++i) {
+		value = (value << 8) | bytes[i];
+	}
+	return true;
+}
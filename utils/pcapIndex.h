@@ -0,0 +1,128 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Sidecar index of a pcap file (<file>.idx), to only read the records of a
+// time range or of some MAC addresses instead of the whole file:
+// - Records are grouped in blocks of PCAPINDEX_BLOCK_RECORDS, with the offset of
+//   the first one and the earliest and latest timestamps of the block (capture
+//   files aren't always in time order).
+// - Each MAC address in the 802.11 header (except broadcast) has the list of the
+//   offsets of its records, delta and varint encoded. They are encoded as the
+//   records are added, a few bytes per record and address.
+// All integers are little endian. The index can be written again as the pcap
+// file grows, it then covers the records before the file size it holds.
+#ifndef UTILS_PCAPINDEX_H
+#define UTILS_PCAPINDEX_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <stdint.h>
+#include <time.h>
+
+using std::string;
+using std::vector;
+
+#define PCAPINDEX_MAGIC 0x58494257 // "WBIX"
+#define PCAPINDEX_VERSION 1
+#define PCAPINDEX_EXTENSION ".idx"
+#define PCAPINDEX_BLOCK_RECORDS 256
+
+namespace wifibeat
+{
+	namespace utils
+	{
+		// Records starting in [start, end)
+		struct pcapIndexRange {
+			uint64_t start;
+			uint64_t end;
+		};
+
+		struct pcapIndexBlock {
+			uint64_t offset; // First record
+			int64_t earliest; // ns since epoch
+			int64_t latest;
+			uint32_t records;
+		};
+
+		class pcapIndexBuilder
+		{
+			private:
+				struct postingList {
+					vector<uint8_t> deltas;
+					uint64_t last;
+					uint64_t count;
+					postingList() : last(0), count(0) { }
+				};
+
+				vector<pcapIndexBlock> _blocks;
+				std::map<uint64_t, postingList> _postings;
+				unsigned long long int _records;
+
+			public:
+				pcapIndexBuilder();
+
+				// Records must be added in file order
+				void add(uint64_t offset, const struct timespec & ts, int linkType, const uint8_t * data, uint32_t length);
+				unsigned long long int Records() const;
+
+				// Written to a temporary file first, then renamed
+				bool write(const string & path, uint64_t fileSize, int linkType, string & error) const;
+
+				// Indexes an existing pcap file (not pcapng, not compressed)
+				static bool build(const string & pcapPath, string & error);
+		};
+
+		class pcapIndex
+		{
+			private:
+				uint64_t _fileSize;
+				int _linkType;
+				vector<pcapIndexBlock> _blocks;
+				struct postingList {
+					size_t position; // In _postings
+					uint64_t count;
+				};
+				std::map<uint64_t, postingList> _macs;
+				vector<uint8_t> _postings;
+
+				void offsets(uint64_t mac, vector<uint64_t> & offsets) const;
+				bool overlaps(size_t block, int64_t from, int64_t to) const;
+
+			public:
+				pcapIndex();
+
+				bool load(const string & path, string & error);
+
+				// Size of the pcap file when it was indexed
+				uint64_t FileSize() const;
+				uint64_t Records() const;
+
+				// Ranges of records that may match, in file order. Records have to be
+				// checked again: blocks only narrow down the time range.
+				// No MAC means all of them, from > to means any time.
+				void lookup(int64_t from, int64_t to, const vector<uint64_t> & macs, vector<pcapIndexRange> & ranges) const;
+
+				// MAC addresses of a frame, as indexed. Returns how many were found (up to 4).
+				static unsigned int addresses(int linkType, const uint8_t * data, uint32_t length, uint64_t macs[4]);
+				static bool parseMac(const string & mac, uint64_t & value);
+		};
+	}
+}
+
+#endif // UTILS_PCAPINDEX_H
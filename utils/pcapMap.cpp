@@ -0,0 +1,233 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "pcapMap.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+wifibeat::utils::pcapMap::pcapMap()
+	: _fd(-1), _data(NULL), _size(0), _swapped(false), _nanoseconds(false), _linkType(0), _snaplen(0)
+{
+}
+
+wifibeat::utils::pcapMap::~pcapMap()
+{
+	this->close();
+}
+
+uint32_t wifibeat::utils::pcapMap::read32(size_t offset) const
+{
+	uint32_t value;
+	memcpy(&value, this->_data + offset, sizeof(value));
+	return (this->_swapped) ? __builtin_bswap32(value) : value;
+}
+
+bool wifibeat::utils::pcapMap::open(const string & path, string & error)
+{
+	this->close();
+	this->_path = path;
+
+	this->_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (this->_fd == -1) {
+		error = "Failed opening <" + path + ">: " + strerror(errno);
+		return false;
+	}
+
+	if (!this->map(error)) {
+		this->close();
+		return false;
+	}
+	if (this->_size < PCAP_FILE_HEADER_SIZE) {
+		error = "<" + path + "> is too small to be a pcap file";
+		this->close();
+		return false;
+	}
+
+	uint32_t magic;
+	memcpy(&magic, this->_data, sizeof(magic));
+	if (magic == PCAP_MAGIC_MICROSECONDS || magic == PCAP_MAGIC_NANOSECONDS) {
+		this->_swapped = false;
+	} else if (__builtin_bswap32(magic) == PCAP_MAGIC_MICROSECONDS || __builtin_bswap32(magic) == PCAP_MAGIC_NANOSECONDS) {
+		this->_swapped = true;
+		magic = __builtin_bswap32(magic);
+	} else if (magic == PCAPNG_MAGIC) {
+		error = "<" + path + "> is a pcapng file, only pcap files can be read in parallel";
+		this->close();
+		return false;
+	} else {
+		error = "<" + path + "> is not a pcap file";
+		this->close();
+		return false;
+	}
+	this->_nanoseconds = (magic == PCAP_MAGIC_NANOSECONDS);
+	this->_snaplen = this->read32(16);
+	// Upper bits are FCS information
+	this->_linkType = (int)(this->read32(20) & 0x0FFFFFFF);
+
+	return true;
+}
+
+bool wifibeat::utils::pcapMap::map(string & error)
+{
+	struct stat st;
+	if (fstat(this->_fd, &st) == -1) {
+		error = "Failed getting the size of <" + this->_path + ">: " + strerror(errno);
+		return false;
+	}
+	if (this->_data && (size_t)st.st_size <= this->_size) {
+		return true;
+	}
+	if ((size_t)st.st_size == 0) {
+		return true;
+	}
+
+	void * map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, this->_fd, 0);
+	if (map == MAP_FAILED) {
+		error = "Failed mapping <" + this->_path + ">: " + strerror(errno);
+		return false;
+	}
+	if (this->_data) {
+		munmap(const_cast<uint8_t *>(this->_data), this->_size);
+	}
+	this->_data = static_cast<const uint8_t *>(map);
+	this->_size = (size_t)st.st_size;
+
+	// Read once, front to back: more readahead, pages can be dropped early
+	madvise(map, this->_size, MADV_SEQUENTIAL);
+	return true;
+}
+
+bool wifibeat::utils::pcapMap::refresh(string & error)
+{
+	return this->map(error);
+}
+
+uint32_t wifibeat::utils::pcapMap::maxLength() const
+{
+	return (this->_snaplen > PCAP_MAX_RECORD_SIZE) ? this->_snaplen : PCAP_MAX_RECORD_SIZE;
+}
+
+void wifibeat::utils::pcapMap::close()
+{
+	if (this->_data) {
+		munmap(const_cast<uint8_t *>(this->_data), this->_size);
+		this->_data = NULL;
+	}
+	this->_size = 0;
+	if (this->_fd != -1) {
+		::close(this->_fd);
+		this->_fd = -1;
+	}
+}
+
+bool wifibeat::utils::pcapMap::scan(size_t & offset, size_t chunkSize, pcapChunk & chunk, string & error) const
+{
+	chunk.offset = offset;
+	chunk.length = 0;
+	chunk.frames = 0;
+
+	uint32_t maxLength = this->maxLength();
+	while (offset + PCAP_RECORD_HEADER_SIZE <= this->_size && (chunk.frames == 0 || chunk.length < chunkSize)) {
+		uint32_t length = this->read32(offset + 8);
+		if (length > maxLength) {
+			error = "<" + this->_path + "> is corrupted at offset " + std::to_string(offset);
+			break;
+		}
+		if (offset + PCAP_RECORD_HEADER_SIZE + length > this->_size) {
+			error = "<" + this->_path + "> is truncated, last frame is incomplete";
+			break;
+		}
+		offset += PCAP_RECORD_HEADER_SIZE + length;
+		chunk.length += PCAP_RECORD_HEADER_SIZE + length;
+		++chunk.frames;
+	}
+
+	if (chunk.frames && error.empty() && offset < this->_size && offset + PCAP_RECORD_HEADER_SIZE > this->_size) {
+		error = "<" + this->_path + "> is truncated, last frame header is incomplete";
+	}
+	if (!error.empty()) {
+		// Don't read anything past the problem
+		offset = this->_size;
+	}
+
+	return chunk.frames != 0;
+}
+
+void wifibeat::utils::pcapMap::record(size_t & offset, struct timespec & ts, const uint8_t *& data, uint32_t & length) const
+{
+	ts.tv_sec = this->read32(offset);
+	ts.tv_nsec = this->read32(offset + 4);
+	if (!this->_nanoseconds) {
+		ts.tv_nsec *= 1000;
+	}
+	length = this->read32(offset + 8);
+	data = this->_data + offset + PCAP_RECORD_HEADER_SIZE;
+	offset += PCAP_RECORD_HEADER_SIZE + length;
+}
+
+bool wifibeat::utils::pcapMap::next(size_t & offset, struct timespec & ts, const uint8_t *& data, uint32_t & length, string & error) const
+{
+	if (offset + PCAP_RECORD_HEADER_SIZE > this->_size) {
+		return false;
+	}
+	uint32_t recordLength = this->read32(offset + 8);
+	if (recordLength > this->maxLength()) {
+		error = "<" + this->_path + "> is corrupted at offset " + std::to_string(offset);
+		return false;
+	}
+	if (offset + PCAP_RECORD_HEADER_SIZE + recordLength > this->_size) {
+		return false;
+	}
+	this->record(offset, ts, data, length);
+	return true;
+}
+
+void wifibeat::utils::pcapMap::release(const pcapChunk & chunk) const
+{
+	// Only whole pages that are entirely in the chunk
+	long pageSize = sysconf(_SC_PAGESIZE);
+	size_t start = ((chunk.offset + pageSize - 1) / pageSize) * pageSize;
+	size_t end = ((chunk.offset + chunk.length) / pageSize) * pageSize;
+	if (end > start) {
+		madvise(const_cast<uint8_t *>(this->_data) + start, end - start, MADV_DONTNEED);
+	}
+}
+
+size_t wifibeat::utils::pcapMap::First() const
+{
+	return PCAP_FILE_HEADER_SIZE;
+}
+
+size_t wifibeat::utils::pcapMap::Size() const
+{
+	return this->_size;
+}
+
+int wifibeat::utils::pcapMap::LinkType() const
+{
+	return this->_linkType;
+}
+
+const string & wifibeat::utils::pcapMap::Path() const
+{
+	return this->_path;
+}
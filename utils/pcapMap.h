@@ -0,0 +1,98 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Read-only memory mapping of a classic pcap file (not pcapng). Record headers
+// are scanned to cut the file into chunks that can be read independently, on
+// several threads, straight from the mapping. Files still being written to
+// can be read record by record, mapping them again as they grow.
+#ifndef UTILS_PCAPMAP_H
+#define UTILS_PCAPMAP_H
+
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include "pcapFormat.h"
+
+using std::string;
+
+namespace wifibeat
+{
+	namespace utils
+	{
+		// Records from offset to offset + length
+		struct pcapChunk {
+			size_t offset;
+			size_t length;
+			unsigned int frames;
+		};
+
+		class pcapMap
+		{
+			private:
+				string _path;
+				int _fd;
+				const uint8_t * _data;
+				size_t _size;
+				bool _swapped;
+				bool _nanoseconds;
+				int _linkType;
+				uint32_t _snaplen;
+
+				uint32_t read32(size_t offset) const;
+				bool map(string & error);
+				uint32_t maxLength() const;
+
+			public:
+				pcapMap();
+				~pcapMap();
+
+				bool open(const string & path, string & error);
+				void close();
+
+				// Cuts the next chunk of about chunkSize bytes (at least one record) at
+				// offset, then moves offset to the following record. Returns false when
+				// there is nothing left or when the rest of the file is truncated or corrupted
+				// (error is set then).
+				bool scan(size_t & offset, size_t chunkSize, pcapChunk & chunk, string & error) const;
+
+				// Reads the record at offset and moves it to the next one. The chunk must
+				// have been returned by scan().
+				void record(size_t & offset, struct timespec & ts, const uint8_t *& data, uint32_t & length) const;
+
+				// Same without scan(), for files still being written to: returns false if
+				// the record at offset isn't complete (yet) or if it is corrupted (error
+				// is set then).
+				bool next(size_t & offset, struct timespec & ts, const uint8_t *& data, uint32_t & length, string & error) const;
+
+				// Maps the file again if it grew
+				bool refresh(string & error);
+
+				// The pages of the chunk won't be needed anymore
+				void release(const pcapChunk & chunk) const;
+
+				// Offset of the first record
+				size_t First() const;
+				size_t Size() const;
+				int LinkType() const;
+				const string & Path() const;
+		};
+	}
+}
+
+#endif // UTILS_PCAPMAP_H
@@ -0,0 +1,791 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "pcapStream.h"
+#include "pcapFormat.h"
+#include <zlib.h>
+#include <zstd.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <string.h>
+#include <errno.h>
+
+#define GZIP_MAGIC "\x1f\x8b"
+#define ZSTD_MAGIC "\x28\xb5\x2f\xfd"
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1a2b3c4d
+
+// pcapng block types
+#define PCAPNG_SECTION_HEADER PCAPNG_MAGIC
+#define PCAPNG_INTERFACE_DESCRIPTION 1
+#define PCAPNG_PACKET 2 // Obsolete
+#define PCAPNG_SIMPLE_PACKET 3
+#define PCAPNG_ENHANCED_PACKET 6
+
+// Interface description options
+#define PCAPNG_OPTION_END 0
+#define PCAPNG_OPTION_TSRESOL 9
+#define PCAPNG_OPTION_TSOFFSET 14
+
+static bool readMagic(const string & path, uint8_t magic[4])
+{
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return false;
+	}
+	ssize_t len = pread(fd, magic, 4, 0);
+	::close(fd);
+	return len == 4;
+}
+
+/**************************** decompressingReader ****************************/
+
+wifibeat::utils::decompressingReader::decompressingReader()
+	: _fd(-1), _compression(NoCompression), _thread(NULL), _stop(false), _eof(false)
+{
+}
+
+wifibeat::utils::decompressingReader::~decompressingReader()
+{
+	this->close();
+}
+
+bool wifibeat::utils::decompressingReader::open(const string & path, string & error)
+{
+	this->close();
+
+	if (path == PCAPSTREAM_STDIN) {
+		this->_fd = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 0);
+	} else {
+		// Named pipes would block until there is a writer: the reader thread waits for it instead
+		this->_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+	}
+	if (this->_fd == -1) {
+		error = "Failed opening <" + path + ">: " + strerror(errno);
+		return false;
+	}
+	int flags = fcntl(this->_fd, F_GETFL);
+	if (flags == -1 || fcntl(this->_fd, F_SETFL, flags & ~O_NONBLOCK) == -1) {
+		error = "Failed opening <" + path + ">: " + strerror(errno);
+		::close(this->_fd);
+		this->_fd = -1;
+		return false;
+	}
+	posix_fadvise(this->_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	this->_compression = NoCompression;
+	this->_prefix.clear();
+	this->_stop = false;
+	this->_eof = false;
+	this->_error.clear();
+	this->_thread = new std::thread(&decompressingReader::run, this);
+	return true;
+}
+
+void wifibeat::utils::decompressingReader::close()
+{
+	if (this->_thread) {
+		this->_stop = true;
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			this->_condition.notify_all();
+		}
+		this->_thread->join();
+		delete this->_thread;
+		this->_thread = NULL;
+	}
+	if (this->_fd != -1) {
+		::close(this->_fd);
+		this->_fd = -1;
+	}
+	this->_blocks.clear();
+}
+
+wifibeat::utils::streamCompression wifibeat::utils::decompressingReader::Compression()
+{
+	std::lock_guard<std::mutex> lock(this->_mutex);
+	return this->_compression;
+}
+
+void wifibeat::utils::decompressingReader::Interrupt(std::function<bool()> interrupted)
+{
+	this->_interrupted = interrupted;
+}
+
+ssize_t wifibeat::utils::decompressingReader::readInput(uint8_t * buffer, size_t length)
+{
+	if (!this->_prefix.empty()) {
+		size_t len = std::min(length, this->_prefix.size());
+		memcpy(buffer, this->_prefix.data(), len);
+		this->_prefix.erase(this->_prefix.begin(), this->_prefix.begin() + len);
+		return (ssize_t)len;
+	}
+
+	// Pipes can stay without data for a while, don't block stopping
+	struct pollfd pfd = { this->_fd, POLLIN, 0 };
+	while (!this->_stop) {
+		int ret = poll(&pfd, 1, PCAPSTREAM_POLL_MS);
+		if (ret > 0) {
+			return read(this->_fd, buffer, length);
+		}
+		if (ret == -1 && errno != EINTR) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void wifibeat::utils::decompressingReader::run()
+{
+	// Compression, from the beginning of the data so that pipes can be read too
+	uint8_t magic[4];
+	size_t magicLength = 0;
+	while (magicLength < sizeof(magic) && !this->_stop) {
+		ssize_t len = this->readInput(magic + magicLength, sizeof(magic) - magicLength);
+		if (len == -1 && errno == EINTR) {
+			continue;
+		}
+		if (len <= 0) {
+			break;
+		}
+		magicLength += (size_t)len;
+	}
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		if (magicLength >= 2 && memcmp(magic, GZIP_MAGIC, 2) == 0) {
+			this->_compression = Gzip;
+		} else if (magicLength == 4 && memcmp(magic, ZSTD_MAGIC, 4) == 0) {
+			this->_compression = Zstd;
+		}
+	}
+	this->_prefix.assign(magic, magic + magicLength);
+
+	bool success;
+	switch (this->_compression) {
+		case Gzip:
+			success = this->readGzip();
+			break;
+		case Zstd:
+			success = this->readZstd();
+			break;
+		default:
+			success = this->readRaw();
+			break;
+	}
+
+	std::lock_guard<std::mutex> lock(this->_mutex);
+	if (!success && this->_error.empty()) {
+		this->_error = "Failed reading file";
+	}
+	this->_eof = true;
+	this->_condition.notify_all();
+}
+
+bool wifibeat::utils::decompressingReader::push(vector<uint8_t> & block)
+{
+	std::unique_lock<std::mutex> lock(this->_mutex);
+	this->_condition.wait(lock, [this] {
+		return this->_stop || this->_blocks.size() < PCAPSTREAM_BLOCKS_AHEAD;
+	});
+	if (this->_stop) {
+		return false;
+	}
+	this->_blocks.push_back(std::move(block));
+	this->_condition.notify_all();
+	block = vector<uint8_t>();
+	return true;
+}
+
+bool wifibeat::utils::decompressingReader::next(vector<uint8_t> & block, string & error)
+{
+	std::unique_lock<std::mutex> lock(this->_mutex);
+	while (!this->_condition.wait_for(lock, std::chrono::milliseconds(PCAPSTREAM_POLL_MS), [this] {
+				return !this->_blocks.empty() || this->_eof;
+			})) {
+		if (this->_interrupted && this->_interrupted()) {
+			return false;
+		}
+	}
+	if (this->_blocks.empty()) {
+		error = this->_error;
+		return false;
+	}
+	block = std::move(this->_blocks.front());
+	this->_blocks.pop_front();
+	this->_condition.notify_all();
+	return true;
+}
+
+bool wifibeat::utils::decompressingReader::readRaw()
+{
+	while (!this->_stop) {
+		vector<uint8_t> block(PCAPSTREAM_BLOCK_SIZE);
+		ssize_t len = this->readInput(block.data(), block.size());
+		if (len == -1 && errno == EINTR) {
+			continue;
+		}
+		if (len == -1) {
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			this->_error = string("Failed reading: ") + strerror(errno);
+			return false;
+		}
+		if (len == 0) {
+			break;
+		}
+		block.resize((size_t)len);
+		if (!this->push(block)) {
+			break;
+		}
+	}
+	return true;
+}
+
+bool wifibeat::utils::decompressingReader::readGzip()
+{
+	z_stream strm;
+	memset(&strm, 0, sizeof(strm));
+	// Gzip or zlib header
+	if (inflateInit2(&strm, 15 + 32) != Z_OK) {
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		this->_error = "Failed initializing gzip decompression";
+		return false;
+	}
+
+	vector<uint8_t> in(PCAPSTREAM_BLOCK_SIZE);
+	vector<uint8_t> out(PCAPSTREAM_BLOCK_SIZE);
+	strm.next_out = out.data();
+	strm.avail_out = (uInt)out.size();
+	bool inMember = false; // Data since the end of the last gzip member
+	string error;
+	while (!this->_stop && error.empty()) {
+		ssize_t len = this->readInput(in.data(), in.size());
+		if (len == -1 && errno == EINTR) {
+			continue;
+		}
+		if (len == -1) {
+			error = string("Failed reading: ") + strerror(errno);
+			break;
+		}
+		if (len == 0) {
+			if (inMember) {
+				error = "Truncated gzip data";
+			}
+			break;
+		}
+
+		strm.next_in = in.data();
+		strm.avail_in = (uInt)len;
+		// Also loop when the output was full: there might be more to get out of zlib
+		bool full = false;
+		while ((strm.avail_in > 0 || full) && error.empty() && !this->_stop) {
+			int ret = inflate(&strm, Z_NO_FLUSH);
+			if (ret == Z_STREAM_END) {
+				// Concatenated gzip files are a valid gzip file
+				inMember = false;
+				inflateReset(&strm);
+			} else if (ret == Z_OK || ret == Z_BUF_ERROR) {
+				inMember = true;
+			} else {
+				error = string("Failed decompressing gzip data: ") + ((strm.msg) ? strm.msg : "invalid data");
+				break;
+			}
+
+			full = (strm.avail_out == 0);
+			if (full) {
+				if (!this->push(out)) {
+					break;
+				}
+				out.resize(PCAPSTREAM_BLOCK_SIZE);
+				strm.next_out = out.data();
+				strm.avail_out = (uInt)out.size();
+			}
+		}
+	}
+
+	// What's left, even if the rest is invalid
+	if (!this->_stop && strm.avail_out < out.size()) {
+		out.resize(out.size() - strm.avail_out);
+		this->push(out);
+	}
+	inflateEnd(&strm);
+
+	if (!error.empty()) {
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		this->_error = error;
+		return false;
+	}
+	return true;
+}
+
+bool wifibeat::utils::decompressingReader::readZstd()
+{
+	ZSTD_DStream * stream = ZSTD_createDStream();
+	if (stream == NULL || ZSTD_isError(ZSTD_initDStream(stream))) {
+		if (stream) {
+			ZSTD_freeDStream(stream);
+		}
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		this->_error = "Failed initializing zstd decompression";
+		return false;
+	}
+
+	vector<uint8_t> in(PCAPSTREAM_BLOCK_SIZE);
+	vector<uint8_t> out(PCAPSTREAM_BLOCK_SIZE);
+	ZSTD_outBuffer output = { out.data(), out.size(), 0 };
+	bool inFrame = false; // Data since the end of the last zstd frame
+	string error;
+	while (!this->_stop && error.empty()) {
+		ssize_t len = this->readInput(in.data(), in.size());
+		if (len == -1 && errno == EINTR) {
+			continue;
+		}
+		if (len == -1) {
+			error = string("Failed reading: ") + strerror(errno);
+			break;
+		}
+		if (len == 0) {
+			if (inFrame) {
+				error = "Truncated zstd data";
+			}
+			break;
+		}
+
+		ZSTD_inBuffer input = { in.data(), (size_t)len, 0 };
+		while (!this->_stop) {
+			size_t ret = ZSTD_decompressStream(stream, &output, &input);
+			if (ZSTD_isError(ret)) {
+				error = string("Failed decompressing zstd data: ") + ZSTD_getErrorName(ret);
+				break;
+			}
+			// 0: end of a frame. Several frames can follow each other.
+			inFrame = (ret != 0);
+
+			// When the output is full, there might be more to flush
+			bool full = (output.pos == output.size);
+			if (full) {
+				if (!this->push(out)) {
+					break;
+				}
+				out.resize(PCAPSTREAM_BLOCK_SIZE);
+				output.dst = out.data();
+				output.pos = 0;
+			}
+			if (!full && input.pos == input.size) {
+				break;
+			}
+		}
+	}
+
+	if (!this->_stop && output.pos) {
+		out.resize(output.pos);
+		this->push(out);
+	}
+	ZSTD_freeDStream(stream);
+
+	if (!error.empty()) {
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		this->_error = error;
+		return false;
+	}
+	return true;
+}
+
+/********************************* pcapStream ********************************/
+
+wifibeat::utils::pcapStream::pcapStream()
+	: _position(0), _eof(false), _pcapng(false), _swapped(false), _nanoseconds(false), _linkType(0)
+{
+}
+
+wifibeat::utils::pcapStream::~pcapStream()
+{
+	this->close();
+}
+
+bool wifibeat::utils::pcapStream::pipe(const string & path)
+{
+	struct stat st;
+	return path == PCAPSTREAM_STDIN || (stat(path.c_str(), &st) == 0 && S_ISFIFO(st.st_mode));
+}
+
+bool wifibeat::utils::pcapStream::needed(const string & path)
+{
+	// Reading its beginning would consume it
+	if (pipe(path)) {
+		return true;
+	}
+
+	uint8_t magic[4];
+	if (!readMagic(path, magic)) {
+		return false;
+	}
+	uint32_t value;
+	memcpy(&value, magic, sizeof(value));
+	return memcmp(magic, GZIP_MAGIC, 2) == 0 || memcmp(magic, ZSTD_MAGIC, 4) == 0 || value == PCAPNG_SECTION_HEADER;
+}
+
+bool wifibeat::utils::pcapStream::open(const string & path)
+{
+	this->close();
+	this->_path = path;
+	this->_error.clear();
+	this->_eof = false;
+
+	if (!this->_reader.open(path, this->_error)) {
+		return false;
+	}
+
+	return this->readHeader();
+}
+
+void wifibeat::utils::pcapStream::close()
+{
+	this->_reader.close();
+	this->_buffer.clear();
+	this->_position = 0;
+	this->_interfaces.clear();
+}
+
+void wifibeat::utils::pcapStream::Interrupt(std::function<bool()> interrupted)
+{
+	this->_reader.Interrupt(interrupted);
+}
+
+const string & wifibeat::utils::pcapStream::Error() const
+{
+	return this->_error;
+}
+
+string wifibeat::utils::pcapStream::Format() const
+{
+	string format = (this->_pcapng) ? "pcapng" : "pcap";
+	switch (const_cast<decompressingReader &>(this->_reader).Compression()) {
+		case Gzip:
+			format += ", gzip";
+			break;
+		case Zstd:
+			format += ", zstd";
+			break;
+		default:
+			break;
+	}
+	return format;
+}
+
+bool wifibeat::utils::pcapStream::ensure(size_t length)
+{
+	while (this->_buffer.size() - this->_position < length) {
+		if (this->_eof) {
+			return false;
+		}
+
+		// Drop what was read already
+		if (this->_position) {
+			this->_buffer.erase(this->_buffer.begin(), this->_buffer.begin() + this->_position);
+			this->_position = 0;
+		}
+
+		vector<uint8_t> block;
+		if (!this->_reader.next(block, this->_error)) {
+			this->_eof = true;
+			if (!this->_error.empty()) {
+				this->_error = "Failed reading <" + this->_path + ">: " + this->_error;
+			}
+			return false;
+		}
+		this->_buffer.insert(this->_buffer.end(), block.begin(), block.end());
+	}
+
+	return true;
+}
+
+uint16_t wifibeat::utils::pcapStream::read16(size_t offset) const
+{
+	uint16_t value;
+	memcpy(&value, this->_buffer.data() + offset, sizeof(value));
+	return (this->_swapped) ? __builtin_bswap16(value) : value;
+}
+
+uint32_t wifibeat::utils::pcapStream::read32(size_t offset) const
+{
+	uint32_t value;
+	memcpy(&value, this->_buffer.data() + offset, sizeof(value));
+	return (this->_swapped) ? __builtin_bswap32(value) : value;
+}
+
+bool wifibeat::utils::pcapStream::readHeader()
+{
+	if (!this->ensure(4)) {
+		if (this->_error.empty()) {
+			this->_error = "<" + this->_path + "> is empty";
+		}
+		return false;
+	}
+
+	uint32_t magic;
+	memcpy(&magic, this->_buffer.data(), sizeof(magic));
+	if (magic == PCAPNG_SECTION_HEADER) {
+		// Section header blocks are handled with the other blocks
+		this->_pcapng = true;
+		return true;
+	}
+
+	this->_pcapng = false;
+	if (magic == PCAP_MAGIC_MICROSECONDS || magic == PCAP_MAGIC_NANOSECONDS) {
+		this->_swapped = false;
+	} else if (__builtin_bswap32(magic) == PCAP_MAGIC_MICROSECONDS || __builtin_bswap32(magic) == PCAP_MAGIC_NANOSECONDS) {
+		this->_swapped = true;
+		magic = __builtin_bswap32(magic);
+	} else {
+		this->_error = "<" + this->_path + "> is not a pcap or pcapng file";
+		return false;
+	}
+	if (!this->ensure(PCAP_FILE_HEADER_SIZE)) {
+		this->_error = "<" + this->_path + "> is truncated";
+		return false;
+	}
+	this->_nanoseconds = (magic == PCAP_MAGIC_NANOSECONDS);
+	// Upper bits are FCS information
+	this->_linkType = (int)(this->read32(20) & 0x0FFFFFFF);
+	this->_position += PCAP_FILE_HEADER_SIZE;
+
+	return true;
+}
+
+bool wifibeat::utils::pcapStream::next(pcapRecord & record)
+{
+	if (!this->_error.empty()) {
+		return false;
+	}
+	return (this->_pcapng) ? this->nextPcapng(record) : this->nextPcap(record);
+}
+
+bool wifibeat::utils::pcapStream::nextPcap(pcapRecord & record)
+{
+	if (!this->ensure(PCAP_RECORD_HEADER_SIZE)) {
+		if (this->_error.empty() && this->_buffer.size() != this->_position) {
+			this->_error = "<" + this->_path + "> is truncated, last frame header is incomplete";
+		}
+		return false;
+	}
+
+	size_t header = this->_position;
+	uint32_t length = this->read32(header + 8);
+	if (length > PCAPSTREAM_MAX_BLOCK_LENGTH) {
+		this->_error = "<" + this->_path + "> is corrupted";
+		return false;
+	}
+	if (!this->ensure(PCAP_RECORD_HEADER_SIZE + length)) {
+		if (this->_error.empty()) {
+			this->_error = "<" + this->_path + "> is truncated, last frame is incomplete";
+		}
+		return false;
+	}
+	header = this->_position; // The buffer may have moved
+
+	record.ts.tv_sec = this->read32(header);
+	record.ts.tv_nsec = this->read32(header + 4);
+	if (!this->_nanoseconds) {
+		record.ts.tv_nsec *= 1000;
+	}
+	record.length = length;
+	record.data = this->_buffer.data() + header + PCAP_RECORD_HEADER_SIZE;
+	record.linkType = this->_linkType;
+	record.interface = 0;
+	this->_position += PCAP_RECORD_HEADER_SIZE + length;
+
+	return true;
+}
+
+bool wifibeat::utils::pcapStream::nextPcapng(pcapRecord & record)
+{
+	while (true) {
+		if (!this->ensure(12)) {
+			if (this->_error.empty() && this->_buffer.size() != this->_position) {
+				this->_error = "<" + this->_path + "> is truncated, last block is incomplete";
+			}
+			return false;
+		}
+
+		// Same value in both byte orders
+		uint32_t type;
+		memcpy(&type, this->_buffer.data() + this->_position, sizeof(type));
+		if (type == PCAPNG_SECTION_HEADER && !this->sectionHeader()) {
+			return false;
+		}
+		type = this->read32(this->_position);
+
+		uint32_t length = this->read32(this->_position + 4);
+		if (length < 12 || length % 4 || length > PCAPSTREAM_MAX_BLOCK_LENGTH) {
+			this->_error = "<" + this->_path + "> is corrupted, invalid block length";
+			return false;
+		}
+		if (!this->ensure(length)) {
+			if (this->_error.empty()) {
+				this->_error = "<" + this->_path + "> is truncated, last block is incomplete";
+			}
+			return false;
+		}
+
+		// Block stays in the buffer until the next call
+		size_t block = this->_position;
+		this->_position += length;
+
+		switch (type) {
+			case PCAPNG_SECTION_HEADER:
+				// New section, interfaces have to be described again
+				this->_interfaces.clear();
+				break;
+			case PCAPNG_INTERFACE_DESCRIPTION:
+				if (length < 20) {
+					this->_error = "<" + this->_path + "> is corrupted, invalid interface description";
+					return false;
+				}
+				this->interfaceDescription(block + 8, length - 12);
+				break;
+			case PCAPNG_ENHANCED_PACKET:
+			{
+				if (length < 32) {
+					this->_error = "<" + this->_path + "> is corrupted, invalid packet block";
+					return false;
+				}
+				uint32_t capturedLength = this->read32(block + 20);
+				if (28ULL + capturedLength > length) {
+					this->_error = "<" + this->_path + "> is corrupted, invalid packet length";
+					return false;
+				}
+				uint64_t timestamp = ((uint64_t)this->read32(block + 12) << 32) | this->read32(block + 16);
+				return this->packet(record, this->read32(block + 8), timestamp, capturedLength, block + 28);
+			}
+			case PCAPNG_PACKET:
+			{
+				if (length < 32) {
+					this->_error = "<" + this->_path + "> is corrupted, invalid packet block";
+					return false;
+				}
+				uint32_t capturedLength = this->read32(block + 20);
+				if (28ULL + capturedLength > length) {
+					this->_error = "<" + this->_path + "> is corrupted, invalid packet length";
+					return false;
+				}
+				uint64_t timestamp = ((uint64_t)this->read32(block + 12) << 32) | this->read32(block + 16);
+				return this->packet(record, this->read16(block + 8), timestamp, capturedLength, block + 28);
+			}
+			case PCAPNG_SIMPLE_PACKET:
+			{
+				// No timestamp, always the first interface
+				if (length < 16) {
+					this->_error = "<" + this->_path + "> is corrupted, invalid packet block";
+					return false;
+				}
+				uint32_t capturedLength = this->read32(block + 8);
+				if (capturedLength > length - 16) {
+					capturedLength = length - 16;
+				}
+				return this->packet(record, 0, 0, capturedLength, block + 12);
+			}
+			default:
+				// Statistics, name resolution, custom blocks, ...
+				break;
+		}
+	}
+}
+
+bool wifibeat::utils::pcapStream::sectionHeader()
+{
+	if (!this->ensure(12)) {
+		this->_error = "<" + this->_path + "> is truncated, last block is incomplete";
+		return false;
+	}
+
+	// Each section has its own byte order
+	uint32_t magic;
+	memcpy(&magic, this->_buffer.data() + this->_position + 8, sizeof(magic));
+	if (magic == PCAPNG_BYTE_ORDER_MAGIC) {
+		this->_swapped = false;
+	} else if (__builtin_bswap32(magic) == PCAPNG_BYTE_ORDER_MAGIC) {
+		this->_swapped = true;
+	} else {
+		this->_error = "<" + this->_path + "> is corrupted, invalid section header";
+		return false;
+	}
+	return true;
+}
+
+void wifibeat::utils::pcapStream::interfaceDescription(size_t body, size_t length)
+{
+	pcapngInterface interface;
+	interface.linkType = this->read16(body);
+	interface.unitsPerSecond = 1000000; // Microseconds by default
+	interface.offset = 0;
+
+	size_t option = body + 8;
+	size_t end = body + length;
+	while (option + 4 <= end) {
+		uint16_t code = this->read16(option);
+		uint16_t optionLength = this->read16(option + 2);
+		size_t value = option + 4;
+		if (code == PCAPNG_OPTION_END || value + optionLength > end) {
+			break;
+		}
+
+		if (code == PCAPNG_OPTION_TSRESOL && optionLength >= 1) {
+			// Negative power of 2 if the high bit is set, of 10 otherwise
+			uint8_t resolution = this->_buffer[value];
+			if (resolution & 0x80) {
+				if ((resolution & 0x7f) < 64) {
+					interface.unitsPerSecond = 1ULL << (resolution & 0x7f);
+				}
+			} else if (resolution <= 19) {
+				interface.unitsPerSecond = 1;
+				for (uint8_t i = 0; i < resolution; ++i) {
+					interface.unitsPerSecond *= 10;
+				}
+			}
+		} else if (code == PCAPNG_OPTION_TSOFFSET && optionLength >= 8) {
+			uint64_t offset;
+			memcpy(&offset, this->_buffer.data() + value, sizeof(offset));
+			interface.offset = (int64_t)((this->_swapped) ? __builtin_bswap64(offset) : offset);
+		}
+
+		// Values are padded to 32 bits
+		option = value + ((optionLength + 3) & ~3);
+	}
+
+	this->_interfaces.push_back(interface);
+}
+
+bool wifibeat::utils::pcapStream::packet(pcapRecord & record, uint32_t interface, uint64_t timestamp, uint32_t capturedLength, size_t data)
+{
+	if (interface >= this->_interfaces.size()) {
+		this->_error = "<" + this->_path + "> is corrupted, packet from an undescribed interface";
+		return false;
+	}
+
+	const pcapngInterface & iface = this->_interfaces[interface];
+	record.ts.tv_sec = (time_t)(timestamp / iface.unitsPerSecond + iface.offset);
+	record.ts.tv_nsec = (long)(((unsigned __int128)(timestamp % iface.unitsPerSecond) * 1000000000ULL) / iface.unitsPerSecond);
+	record.data = this->_buffer.data() + data;
+	record.length = capturedLength;
+	record.linkType = iface.linkType;
+	record.interface = interface;
+
+	return true;
+}
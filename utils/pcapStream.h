@@ -0,0 +1,169 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Sequential reader for pcap and pcapng files, optionally compressed with gzip
+// or zstd. The file is read and decompressed by a separate thread, a few blocks
+// ahead of the parsing, so nothing has to be decompressed to disk first.
+// pcapng: several interfaces (each with its own link type and timestamp
+// resolution) and several sections are supported.
+// It can also read from the standard input ("-") or from a named pipe, the
+// compression being detected from the data itself.
+#ifndef UTILS_PCAPSTREAM_H
+#define UTILS_PCAPSTREAM_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+#include <time.h>
+
+using std::string;
+using std::vector;
+
+#define PCAPSTREAM_BLOCK_SIZE (1024 * 1024) // Decompressed data handed to the parser at once
+#define PCAPSTREAM_BLOCKS_AHEAD 8
+#define PCAPSTREAM_MAX_BLOCK_LENGTH (16 * 1024 * 1024) // pcapng blocks bigger than that are corrupted
+#define PCAPSTREAM_STDIN "-"
+#define PCAPSTREAM_POLL_MS 100 // How often a pipe without data checks if it should stop
+
+namespace wifibeat
+{
+	namespace utils
+	{
+		enum streamCompression {
+			NoCompression,
+			Gzip,
+			Zstd
+		};
+
+		// Reads (and decompresses) a file on its own thread
+		class decompressingReader
+		{
+			private:
+				int _fd;
+				streamCompression _compression;
+				std::thread * _thread;
+				std::atomic<bool> _stop;
+
+				std::mutex _mutex;
+				std::condition_variable _condition;
+				std::deque<vector<uint8_t> > _blocks;
+				bool _eof;
+				string _error;
+				std::function<bool()> _interrupted;
+
+				// Beginning of the data, read to find out the compression
+				vector<uint8_t> _prefix;
+				ssize_t readInput(uint8_t * buffer, size_t length);
+
+				void run();
+				bool push(vector<uint8_t> & block); // false if stopping
+				bool readRaw();
+				bool readGzip();
+				bool readZstd();
+
+			public:
+				decompressingReader();
+				~decompressingReader();
+
+				bool open(const string & path, string & error);
+				void close();
+
+				// Waits for the next block. Returns false at the end of the file, with
+				// error set if it didn't end cleanly, or when interrupted.
+				bool next(vector<uint8_t> & block, string & error);
+
+				// Checked while waiting for data, returning true stops waiting
+				void Interrupt(std::function<bool()> interrupted);
+
+				streamCompression Compression();
+		};
+
+		struct pcapRecord {
+			struct timespec ts;
+			const uint8_t * data; // Valid until the next call to next()
+			uint32_t length;
+			int linkType;
+			uint32_t interface;
+		};
+
+		class pcapStream
+		{
+			private:
+				struct pcapngInterface {
+					int linkType;
+					uint64_t unitsPerSecond;
+					int64_t offset; // Seconds
+				};
+
+				string _path;
+				decompressingReader _reader;
+				vector<uint8_t> _buffer;
+				size_t _position; // Start of unread data in _buffer
+				bool _eof;
+				string _error;
+
+				bool _pcapng;
+				bool _swapped;
+				bool _nanoseconds; // pcap
+				int _linkType; // pcap
+				vector<pcapngInterface> _interfaces; // pcapng, current section
+
+				// Makes sure length bytes are available at _position
+				bool ensure(size_t length);
+				uint16_t read16(size_t offset) const;
+				uint32_t read32(size_t offset) const;
+				bool readHeader();
+				bool nextPcap(pcapRecord & record);
+				bool nextPcapng(pcapRecord & record);
+				bool sectionHeader();
+				void interfaceDescription(size_t body, size_t length);
+				bool packet(pcapRecord & record, uint32_t interface, uint64_t timestamp, uint32_t capturedLength, size_t data);
+
+			public:
+				pcapStream();
+				~pcapStream();
+
+				bool open(const string & path);
+				void close();
+
+				// Returns false at the end of the file or on error (see Error())
+				bool next(pcapRecord & record);
+
+				const string & Error() const;
+				string Format() const;
+
+				// Stops waiting for data from a pipe, next() then returns false
+				void Interrupt(std::function<bool()> interrupted);
+
+				// Files that libpcap can't read as is (or not completely): pcapng and compressed files,
+				// standard input and named pipes
+				static bool needed(const string & path);
+
+				// Standard input or named pipe: can't be seeked into nor read twice
+				static bool pipe(const string & path);
+		};
+	}
+}
+
+#endif // UTILS_PCAPSTREAM_H
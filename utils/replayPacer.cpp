@@ -0,0 +1,72 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "replayPacer.h"
+
+wifibeat::utils::replayPacer::replayPacer(double speed, unsigned int rate)
+	: _speed(speed), _rate(rate), _started(false), _first({0, 0}), _count(0)
+{
+}
+
+std::chrono::nanoseconds wifibeat::utils::replayPacer::delay(const struct timespec & ts)
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (!this->_started) {
+		this->_started = true;
+		this->_start = now;
+		this->_first = ts;
+		return std::chrono::nanoseconds(0);
+	}
+
+	std::chrono::nanoseconds offset(0);
+	if (this->_rate) {
+		offset = std::chrono::nanoseconds((long long int)(this->_count * 1e9 / this->_rate));
+	} else {
+		long long int captured = (ts.tv_sec - this->_first.tv_sec) * 1000000000LL + (ts.tv_nsec - this->_first.tv_nsec);
+		if (captured > 0) {
+			offset = std::chrono::nanoseconds((long long int)(captured / this->_speed));
+		}
+	}
+
+	std::chrono::steady_clock::time_point due = this->_start + offset;
+	if (due <= now) {
+		return std::chrono::nanoseconds(0);
+	}
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(due - now);
+}
+
+void wifibeat::utils::replayPacer::sent()
+{
+	++this->_count;
+}
+
+void wifibeat::utils::replayPacer::restart()
+{
+	this->_started = false;
+	this->_count = 0;
+}
+
+double wifibeat::utils::replayPacer::Speed()
+{
+	return this->_speed;
+}
+
+unsigned int wifibeat::utils::replayPacer::Rate()
+{
+	return this->_rate;
+}
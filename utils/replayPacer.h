@@ -0,0 +1,63 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Paces frames read from capture files: either at the pace they were captured
+// (optionally faster or slower), or at a fixed number of frames per second.
+// Schedules are absolute (from the first frame), so a late frame doesn't
+// slow the frames after it down.
+#ifndef UTILS_REPLAYPACER_H
+#define UTILS_REPLAYPACER_H
+
+#include <chrono>
+#include <time.h>
+
+// Longest sleep while waiting for a frame, so stopping isn't delayed
+#define _WIFIBEAT_REPLAY_MAX_SLEEP_NS 10000000 // 10ms
+
+namespace wifibeat
+{
+	namespace utils
+	{
+		class replayPacer
+		{
+			private:
+				double _speed; // Capture timing multiplier, 0 if using _rate
+				unsigned int _rate; // Frames per second
+
+				bool _started;
+				std::chrono::steady_clock::time_point _start;
+				struct timespec _first;
+				unsigned long long int _count; // Frames sent since the start
+
+			public:
+				replayPacer(double speed, unsigned int rate);
+
+				// Time left until the frame captured at ts is due. Zero when it can be sent.
+				std::chrono::nanoseconds delay(const struct timespec & ts);
+				void sent();
+
+				// Next frame starts a new schedule (looping)
+				void restart();
+
+				double Speed();
+				unsigned int Rate();
+		};
+	}
+}
+
+#endif // UTILS_REPLAYPACER_H
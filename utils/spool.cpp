@@ -0,0 +1,405 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "spool.h"
+#include "logger.h"
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <zlib.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+using std::stringstream;
+using std::vector;
+
+wifibeat::utils::spool::spool(const string & directory, unsigned long long int maxSize, unsigned long long int segmentSize, bool compress)
+	: _directory(directory), _maxSize(maxSize), _segmentSize(segmentSize), _compress(compress), _totalSize(0), _records(0),
+		_writeFd(-1), _writeSegment(0), _readFd(-1), _readSegment(0), _readOffset(0), _nextReadOffset(0)
+{
+	while (this->_directory.size() > 1 && this->_directory[this->_directory.size() - 1] == '/') {
+		this->_directory.erase(this->_directory.size() - 1);
+	}
+	if (this->_segmentSize > this->_maxSize) {
+		this->_segmentSize = this->_maxSize;
+	}
+}
+
+wifibeat::utils::spool::~spool()
+{
+	if (this->_writeFd != -1) {
+		fdatasync(this->_writeFd);
+		close(this->_writeFd);
+	}
+	this->closeReadSegment();
+	this->savePosition();
+}
+
+string wifibeat::utils::spool::segmentPath(unsigned long long int id)
+{
+	char name[64];
+	snprintf(name, sizeof(name), SPOOL_SEGMENT_PREFIX "%020llu" SPOOL_SEGMENT_SUFFIX, id);
+	return this->_directory + "/" + name;
+}
+
+bool wifibeat::utils::spool::open()
+{
+	if (this->_directory.empty()) {
+		LOG_ERROR("Spool directory cannot be empty");
+		return false;
+	}
+
+	// Create directory (and parents)
+	for (size_t pos = 1; pos != string::npos; ) {
+		pos = this->_directory.find('/', pos + 1);
+		string dir = this->_directory.substr(0, pos);
+		if (mkdir(dir.c_str(), 0750) != 0 && errno != EEXIST) {
+			LOG_ERROR("Failed creating spool directory <" + dir + ">: " + strerror(errno));
+			return false;
+		}
+	}
+
+	// Find existing segments
+	DIR * dir = opendir(this->_directory.c_str());
+	if (dir == NULL) {
+		LOG_ERROR("Failed opening spool directory <" + this->_directory + ">: " + strerror(errno));
+		return false;
+	}
+	struct dirent * entry = NULL;
+	while ((entry = readdir(dir)) != NULL) {
+		unsigned long long int id = 0;
+		char suffix[16] = { 0 };
+		if (sscanf(entry->d_name, SPOOL_SEGMENT_PREFIX "%20llu%15s", &id, suffix) != 2 || strcmp(suffix, SPOOL_SEGMENT_SUFFIX) != 0) {
+			continue;
+		}
+		struct stat st;
+		if (stat(this->segmentPath(id).c_str(), &st) != 0) {
+			continue;
+		}
+		this->_segments[id] = (unsigned long long int)st.st_size;
+		this->_totalSize += (unsigned long long int)st.st_size;
+	}
+	closedir(dir);
+
+	if (!this->_segments.empty()) {
+		this->loadPosition();
+		for (const auto & kv: this->_segments) {
+			this->_records += this->countRecords(kv.first, (kv.first == this->_readSegment) ? this->_readOffset : 0);
+		}
+		stringstream ss;
+		ss << "Spool <" << this->_directory << "> contains " << this->_records << " bulk requests to replay";
+		LOG_NOTICE(ss.str());
+	}
+
+	// Always start writing to a new segment
+	unsigned long long int next = (this->_segments.empty()) ? 1 : this->_segments.rbegin()->first + 1;
+	return this->openWriteSegment(next);
+}
+
+bool wifibeat::utils::spool::openWriteSegment(unsigned long long int id)
+{
+	if (this->_writeFd != -1) {
+		fdatasync(this->_writeFd);
+		close(this->_writeFd);
+		this->_writeFd = -1;
+	}
+
+	string path = this->segmentPath(id);
+	this->_writeFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0640);
+	if (this->_writeFd == -1) {
+		LOG_ERROR("Failed creating spool segment <" + path + ">: " + strerror(errno));
+		return false;
+	}
+	this->_writeSegment = id;
+	if (this->_segments.count(id) == 0) {
+		this->_segments[id] = 0;
+	}
+	return true;
+}
+
+void wifibeat::utils::spool::closeReadSegment()
+{
+	if (this->_readFd != -1) {
+		close(this->_readFd);
+		this->_readFd = -1;
+	}
+}
+
+void wifibeat::utils::spool::removeSegment(unsigned long long int id)
+{
+	auto it = this->_segments.find(id);
+	if (it == this->_segments.end()) {
+		return;
+	}
+	if (id == this->_readSegment) {
+		this->closeReadSegment();
+		this->_readSegment = 0;
+		this->_readOffset = 0;
+		this->_nextReadOffset = 0;
+	}
+	unlink(this->segmentPath(id).c_str());
+	this->_totalSize -= it->second;
+	this->_segments.erase(it);
+}
+
+unsigned long long int wifibeat::utils::spool::countRecords(unsigned long long int id, unsigned long long int from)
+{
+	int fd = ::open(this->segmentPath(id).c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return 0;
+	}
+	unsigned long long int ret = 0;
+	spoolRecordHeader header;
+	off_t offset = (off_t)from;
+	while (pread(fd, &header, sizeof(header), offset) == (ssize_t)sizeof(header) && header.magic == SPOOL_MAGIC) {
+		++ret;
+		offset += (off_t)(sizeof(header) + header.storedLength);
+	}
+	close(fd);
+	return ret;
+}
+
+bool wifibeat::utils::spool::evict(unsigned long long int needed)
+{
+	while (this->_totalSize + needed > this->_maxSize && !this->_segments.empty()) {
+		unsigned long long int oldest = this->_segments.begin()->first;
+		if (oldest == this->_writeSegment) {
+			// Only the segment being written is left
+			if (this->_segments.size() == 1 && this->_segments.begin()->second == 0) {
+				return false;
+			}
+			if (!this->openWriteSegment(this->_writeSegment + 1)) {
+				return false;
+			}
+		}
+		unsigned long long int lost = this->countRecords(oldest, (oldest == this->_readSegment) ? this->_readOffset : 0);
+		stringstream ss;
+		ss << "Spool <" << this->_directory << "> is full, dropping oldest segment (" << lost << " bulk requests)";
+		LOG_WARN(ss.str());
+		this->_records -= (lost > this->_records) ? this->_records : lost;
+		this->removeSegment(oldest);
+	}
+	return true;
+}
+
+bool wifibeat::utils::spool::write(const string & body, unsigned int documents)
+{
+	if (this->_writeFd == -1 || body.empty()) {
+		return false;
+	}
+
+	spoolRecordHeader header;
+	header.magic = SPOOL_MAGIC;
+	header.flags = 0;
+	header.length = (uint32_t)body.size();
+	header.documents = documents;
+
+	const Bytef * data = reinterpret_cast<const Bytef *>(body.data());
+	uLongf length = body.size();
+	vector<Bytef> compressed;
+	if (this->_compress) {
+		uLongf compressedLength = compressBound(body.size());
+		compressed.resize(compressedLength);
+		if (compress2(compressed.data(), &compressedLength, data, body.size(), Z_BEST_SPEED) == Z_OK) {
+			header.flags |= SPOOL_FLAG_DEFLATE;
+			data = compressed.data();
+			length = compressedLength;
+		}
+	}
+	header.storedLength = (uint32_t)length;
+	header.crc = (uint32_t)crc32(0L, data, length);
+
+	unsigned long long int recordSize = sizeof(header) + length;
+	if (recordSize > this->_maxSize) {
+		LOG_ERROR("Bulk request is larger than the spool size, dropping it");
+		return false;
+	}
+
+	// Rotate then make room
+	if (this->_segments[this->_writeSegment] + recordSize > this->_segmentSize && this->_segments[this->_writeSegment] != 0) {
+		if (!this->openWriteSegment(this->_writeSegment + 1)) {
+			return false;
+		}
+	}
+	if (!this->evict(recordSize)) {
+		return false;
+	}
+
+	struct iovec iov[2];
+	iov[0].iov_base = &header;
+	iov[0].iov_len = sizeof(header);
+	iov[1].iov_base = const_cast<Bytef *>(data);
+	iov[1].iov_len = length;
+	ssize_t written = writev(this->_writeFd, iov, 2);
+	if (written != (ssize_t)recordSize) {
+		LOG_ERROR("Failed writing to spool segment <" + this->segmentPath(this->_writeSegment) + ">: " + strerror(errno));
+		if (written > 0) {
+			// Don't leave a partial record behind
+			if (ftruncate(this->_writeFd, (off_t)this->_segments[this->_writeSegment]) != 0) {
+				this->openWriteSegment(this->_writeSegment + 1);
+			}
+		}
+		return false;
+	}
+
+	this->_segments[this->_writeSegment] += recordSize;
+	this->_totalSize += recordSize;
+	++this->_records;
+	return true;
+}
+
+bool wifibeat::utils::spool::peek(string & body, unsigned int & documents)
+{
+	while (this->_records) {
+		// Oldest segment
+		if (this->_readFd == -1 || this->_readSegment != this->_segments.begin()->first) {
+			this->closeReadSegment();
+			if (this->_readSegment != this->_segments.begin()->first) {
+				this->_readSegment = this->_segments.begin()->first;
+				this->_readOffset = 0;
+			}
+			this->_readFd = ::open(this->segmentPath(this->_readSegment).c_str(), O_RDONLY | O_CLOEXEC);
+			if (this->_readFd == -1) {
+				LOG_ERROR("Failed opening spool segment <" + this->segmentPath(this->_readSegment) + ">: " + strerror(errno));
+				this->removeSegment(this->_segments.begin()->first);
+				continue;
+			}
+			posix_fadvise(this->_readFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+		}
+
+		spoolRecordHeader header;
+		ssize_t r = pread(this->_readFd, &header, sizeof(header), (off_t)this->_readOffset);
+		if (r == 0 && this->_readSegment == this->_writeSegment) {
+			// Everything was read
+			this->_records = 0;
+			return false;
+		}
+		bool valid = r == (ssize_t)sizeof(header) && header.magic == SPOOL_MAGIC;
+		vector<Bytef> stored;
+		if (valid) {
+			stored.resize(header.storedLength);
+			valid = pread(this->_readFd, stored.data(), header.storedLength, (off_t)(this->_readOffset + sizeof(header))) == (ssize_t)header.storedLength
+					&& (uint32_t)crc32(0L, stored.data(), header.storedLength) == header.crc;
+		}
+		if (valid) {
+			if (header.flags & SPOOL_FLAG_DEFLATE) {
+				body.resize(header.length);
+				uLongf length = header.length;
+				valid = uncompress(reinterpret_cast<Bytef *>(&body[0]), &length, stored.data(), header.storedLength) == Z_OK
+						&& length == header.length;
+			} else {
+				body.assign(reinterpret_cast<const char *>(stored.data()), header.storedLength);
+			}
+		}
+
+		if (valid) {
+			documents = header.documents;
+			this->_nextReadOffset = this->_readOffset + sizeof(header) + header.storedLength;
+			return true;
+		}
+
+		// End of segment (or corrupted): move to the next one
+		if (r != 0) {
+			LOG_ERROR("Corrupted spool segment <" + this->segmentPath(this->_readSegment) + ">, skipping the rest of it");
+		}
+		if (this->_readSegment == this->_writeSegment) {
+			if (!this->openWriteSegment(this->_writeSegment + 1)) {
+				return false;
+			}
+		}
+		this->removeSegment(this->_readSegment);
+		this->_records = 0;
+		for (const auto & kv: this->_segments) {
+			this->_records += this->countRecords(kv.first, 0);
+		}
+	}
+
+	return false;
+}
+
+void wifibeat::utils::spool::pop()
+{
+	if (this->_nextReadOffset == 0 || this->_readFd == -1) {
+		return;
+	}
+	this->_readOffset = this->_nextReadOffset;
+	this->_nextReadOffset = 0;
+	if (this->_records) {
+		--this->_records;
+	}
+
+	// Segment fully replayed
+	if (this->_readOffset >= this->_segments[this->_readSegment] && this->_readSegment != this->_writeSegment) {
+		this->removeSegment(this->_readSegment);
+	}
+	this->savePosition();
+}
+
+void wifibeat::utils::spool::savePosition()
+{
+	string path = this->_directory + "/" SPOOL_POSITION_FILE;
+	FILE * f = fopen(path.c_str(), "w");
+	if (f == NULL) {
+		return;
+	}
+	fprintf(f, "%llu %llu\n", this->_readSegment, this->_readOffset);
+	fclose(f);
+}
+
+void wifibeat::utils::spool::loadPosition()
+{
+	string path = this->_directory + "/" SPOOL_POSITION_FILE;
+	FILE * f = fopen(path.c_str(), "r");
+	if (f == NULL) {
+		return;
+	}
+	unsigned long long int segment = 0, offset = 0;
+	if (fscanf(f, "%llu %llu", &segment, &offset) == 2 && this->_segments.count(segment)) {
+		this->_readSegment = segment;
+		this->_readOffset = offset;
+	}
+	fclose(f);
+}
+
+bool wifibeat::utils::spool::empty()
+{
+	return this->_records == 0;
+}
+
+unsigned long long int wifibeat::utils::spool::Records()
+{
+	return this->_records;
+}
+
+unsigned long long int wifibeat::utils::spool::Size()
+{
+	return this->_totalSize;
+}
+
+string wifibeat::utils::spool::toString()
+{
+	stringstream ss;
+	ss << "Spool <" << this->_directory << ">: " << this->_records << " bulk requests, " << this->_totalSize << " bytes";
+	return ss.str();
+}
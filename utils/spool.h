@@ -0,0 +1,105 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// On-disk spool for already serialized bulk bodies. Bodies are appended to
+// segment files and read back oldest first. When the quota is reached,
+// the oldest segment is deleted.
+// Record: header (see spoolRecordHeader) followed by the (compressed) body.
+#ifndef UTILS_SPOOL_H
+#define UTILS_SPOOL_H
+
+#include <string>
+#include <map>
+#include <stdint.h>
+
+using std::string;
+using std::map;
+
+#define SPOOL_MAGIC 0x50534257 // WBSP
+#define SPOOL_FLAG_DEFLATE 1
+#define SPOOL_SEGMENT_PREFIX "segment-"
+#define SPOOL_SEGMENT_SUFFIX ".spool"
+#define SPOOL_POSITION_FILE "position"
+
+namespace wifibeat
+{
+	namespace utils
+	{
+		struct spoolRecordHeader {
+			uint32_t magic;
+			uint32_t flags;
+			uint32_t storedLength; // Length on disk, after the header
+			uint32_t length; // Uncompressed length
+			uint32_t documents;
+			uint32_t crc; // CRC32 of the stored data
+		};
+
+		class spool
+		{
+			private:
+				string _directory;
+				unsigned long long int _maxSize;
+				unsigned long long int _segmentSize;
+				bool _compress;
+
+				// Segment ID -> size
+				map<unsigned long long int, unsigned long long int> _segments;
+				unsigned long long int _totalSize;
+				unsigned long long int _records; // Amount of bodies waiting
+
+				// Writing (newest segment)
+				int _writeFd;
+				unsigned long long int _writeSegment;
+
+				// Reading (oldest segment)
+				int _readFd;
+				unsigned long long int _readSegment;
+				unsigned long long int _readOffset;
+				unsigned long long int _nextReadOffset; // After the record returned by peek()
+
+				string segmentPath(unsigned long long int id);
+				bool openWriteSegment(unsigned long long int id);
+				void closeReadSegment();
+				void removeSegment(unsigned long long int id);
+				bool evict(unsigned long long int needed);
+				void savePosition();
+				void loadPosition();
+				unsigned long long int countRecords(unsigned long long int id, unsigned long long int from);
+
+			public:
+				spool(const string & directory, unsigned long long int maxSize, unsigned long long int segmentSize, bool compress);
+				~spool();
+
+				// Create the directory if needed and pick up what was left by a previous run
+				bool open();
+
+				bool write(const string & body, unsigned int documents);
+
+				// Oldest body, it stays in the spool until pop() is called.
+				bool peek(string & body, unsigned int & documents);
+				void pop();
+
+				bool empty();
+				unsigned long long int Records();
+				unsigned long long int Size();
+				string toString();
+		};
+	}
+}
+
+#endif // UTILS_SPOOL_H
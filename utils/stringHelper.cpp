@@ -139,4 +139,98 @@ string wifibeat::utils::stringHelper::timespec2RFC3339string(struct timespec & t
 	string ret(buf);
 	delete[] buf;
 	return ret;
+}
+
+unsigned long long int wifibeat::utils::stringHelper::parseSize(const string & size)
+{
+	string value(size);
+	trim(value);
+	size_t pos = 0;
+	unsigned long long int ret = 0;
+	try {
+		ret = std::stoull(value, &pos);
+	} catch (const std::exception & e) {
+		throw string("Invalid size: " + size);
+	}
+	if (!value.empty() && value[0] == '-') {
+		throw string("Invalid size: " + size);
+	}
+
+	string unit = value.substr(pos);
+	trim(unit);
+	to_lower(unit);
+	if (unit.empty() || unit == "b") {
+		return ret;
+	} else if (unit == "k" || unit == "kb" || unit == "kib") {
+		return ret * 1024ULL;
+	} else if (unit == "m" || unit == "mb" || unit == "mib") {
+		return ret * 1024ULL * 1024ULL;
+	} else if (unit == "g" || unit == "gb" || unit == "gib") {
+		return ret * 1024ULL * 1024ULL * 1024ULL;
+	}
+
+	throw string("Invalid size unit: " + size);
+}
+
+std::chrono::milliseconds wifibeat::utils::stringHelper::parseDuration(const string & duration)
+{
+	string value(duration);
+	trim(value);
+	size_t pos = 0;
+	unsigned long long int ret = 0;
+	try {
+		ret = std::stoull(value, &pos);
+	} catch (const std::exception & e) {
+		throw string("Invalid duration: " + duration);
+	}
+	if (!value.empty() && value[0] == '-') {
+		throw string("Invalid duration: " + duration);
+	}
+
+	string unit = value.substr(pos);
+	trim(unit);
+	to_lower(unit);
+	if (unit == "ms") {
+		return std::chrono::milliseconds(ret);
+	} else if (unit.empty() || unit == "s") {
+		return std::chrono::seconds(ret);
+	} else if (unit == "m") {
+		return std::chrono::minutes(ret);
+	} else if (unit == "h") {
+		return std::chrono::hours(ret);
+	}
+
+	throw string("Invalid duration unit: " + duration);
+}
+
+struct timespec wifibeat::utils::stringHelper::parseTime(const string & time)
+{
+	string value(time);
+	trim(value);
+	struct timespec ret = { 0, 0 };
+
+	// Seconds since epoch
+	if (!value.empty() && value.find_first_not_of("0123456789.") == string::npos) {
+		char * end = NULL;
+		double seconds = strtod(value.c_str(), &end);
+		if (*end != '\0') {
+			throw string("Invalid time: " + time);
+		}
+		ret.tv_sec = (time_t)seconds;
+		ret.tv_nsec = (long)((seconds - (double)ret.tv_sec) * 1000000000.0);
+		return ret;
+	}
+
+	struct tm tm;
+	memset(&tm, 0, sizeof(tm));
+	const char * end = strptime(value.c_str(), "%Y-%m-%d %H:%M:%S", &tm);
+	if (end == NULL) {
+		memset(&tm, 0, sizeof(tm));
+		end = strptime(value.c_str(), "%Y-%m-%dT%H:%M:%S", &tm);
+	}
+	if (end == NULL || (*end != '\0' && strcmp(end, "Z") != 0)) {
+		throw string("Invalid time: " + time);
+	}
+	ret.tv_sec = timegm(&tm);
+	return ret;
 }
\ No newline at end of file
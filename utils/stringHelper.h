@@ -22,6 +22,7 @@
 #include <string>
 #include <vector>
 #include <time.h>
+#include <chrono>
 #include <tins/dot11.h>
 
 using std::string;
@@ -42,6 +43,13 @@ namespace wifibeat
 				static void rtrim(std::string &s);
 				static void trim(std::string &s);
 				static string timespec2RFC3339string(struct timespec & ts);
+
+				// Configuration values. They throw a string if the value is invalid.
+				// Sizes: 1024, 512KB, 64MB, 1GB (or KiB, MiB, GiB). Durations: 50ms, 1s, 5m, 1h
+				// Times (UTC): seconds since epoch (1500000000.5), 2017-07-14 02:40:00 or 2017-07-14T02:40:00Z
+				static unsigned long long int parseSize(const string & size);
+				static std::chrono::milliseconds parseDuration(const string & duration);
+				static struct timespec parseTime(const string & time);
 				char * hex2string(const uint8_t * data, unsigned int length, unsigned int offset, unsigned int howMany, bool useSeparator = true, char separator = '-');
 		};
 	}
@@ -56,10 +56,17 @@ JSONObject * wifibeat::utils::tins::PacketTimestamp2String(const PacketTimestamp
 	// TODO: Verify timestamp is good
 	struct timespec ts = frame->getTimespec();
 	doc->Add("@timestamp", stringHelper::timespec2RFC3339string(ts));
-
+	if (frame->Duplicates()) {
+		doc->Add("duplicates", frame->Duplicates());
+	}
 
 	// Get PDU to parse the frame
 	const PDU * pdu = frame->getPDU();
+	if (pdu == NULL) {
+		LOG_ERROR("Malformed frame");
+		delete doc;
+		return NULL;
+	}
 
 	// Parse radiotap header
 	const RadioTap * radiotapHeader = pdu->find_pdu<RadioTap>();
@@ -0,0 +1,151 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tls.h"
+#include <mutex>
+#include <openssl/ssl.h>
+#include <Poco/Exception.h>
+#include <Poco/Net/NetSSL.h>
+#include <Poco/Net/SSLManager.h>
+#include <Poco/Net/RejectCertificateHandler.h>
+
+using Poco::Net::Context;
+
+void wifibeat::utils::tls::initialize()
+{
+	static std::once_flag initialized;
+	std::call_once(initialized, [] {
+		Poco::Net::initializeSSL();
+
+		// Without handlers, SSLManager looks for them in the application configuration
+		Poco::Net::SSLManager::InvalidCertificateHandlerPtr reject = new Poco::Net::RejectCertificateHandler(false);
+		Poco::Net::SSLManager::instance().initializeClient(Poco::Net::SSLManager::PrivateKeyPassphraseHandlerPtr(), reject, Context::Ptr());
+		Poco::Net::SSLManager::instance().initializeServer(Poco::Net::SSLManager::PrivateKeyPassphraseHandlerPtr(), reject, Context::Ptr());
+	});
+}
+
+Context::Ptr wifibeat::utils::tls::clientContext(const outputSSLSettings & ssl)
+{
+	initialize();
+
+	// Same names as the Beats
+	int enabledProtocols = 0;
+	for (const string & protocol: ssl.supportedProtocols) {
+		if (protocol == "TLSv1.0" || protocol == "TLSv1") {
+			enabledProtocols |= Context::PROTO_TLSV1;
+		} else if (protocol == "TLSv1.1") {
+			enabledProtocols |= Context::PROTO_TLSV1_1;
+		} else if (protocol == "TLSv1.2") {
+			enabledProtocols |= Context::PROTO_TLSV1_2;
+		} else if (protocol == "TLSv1.3") {
+			enabledProtocols |= Context::PROTO_TLSV1_3;
+		} else {
+			throw string("Unsupported TLS protocol <" + protocol + ">");
+		}
+	}
+	if (enabledProtocols == 0) {
+		throw string("No TLS protocol enabled");
+	}
+
+	Context::Params params;
+	params.loadDefaultCAs = true;
+	params.verificationDepth = 9;
+	params.verificationMode = (ssl.verification_mode == "none") ? Context::VERIFY_NONE : Context::VERIFY_RELAXED;
+	if (!ssl.cipherSuites.empty()) {
+		params.cipherList.clear();
+		for (const string & cipher: ssl.cipherSuites) {
+			if (!params.cipherList.empty()) {
+				params.cipherList += ':';
+			}
+			params.cipherList += cipher;
+		}
+	}
+
+	Context::Ptr context;
+	try {
+		context = new Context(Context::TLS_CLIENT_USE, params);
+	} catch (const Poco::Exception & e) {
+		throw string("Failed creating TLS context: " + e.displayText());
+	}
+	context->disableProtocols(Context::PROTO_SSLV2 | Context::PROTO_SSLV3
+		| (~enabledProtocols & (Context::PROTO_TLSV1 | Context::PROTO_TLSV1_1 | Context::PROTO_TLSV1_2 | Context::PROTO_TLSV1_3)));
+
+	// full checks the hostname, certificate only checks the chain
+	context->enableExtendedCertificateVerification(ssl.verification_mode == "full");
+
+	// Reconnecting (keep-alive timeout, node restart, ...) resumes the session
+	context->enableSessionCache(true);
+
+	SSL_CTX * sslContext = context->sslContext();
+	for (const string & ca: ssl.certificateAuthorities) {
+		if (SSL_CTX_load_verify_locations(sslContext, ca.c_str(), NULL) != 1) {
+			throw string("Failed loading certificate authority <" + ca + ">");
+		}
+	}
+	if (!ssl.curveTypes.empty()) {
+		string curves;
+		for (const string & curve: ssl.curveTypes) {
+			if (!curves.empty()) {
+				curves += ':';
+			}
+			curves += curve;
+		}
+		if (SSL_CTX_set1_curves_list(sslContext, curves.c_str()) != 1) {
+			throw string("Invalid curve types <" + curves + ">");
+		}
+	}
+
+	// Client certificate. Loaded here rather than by Poco to use the passphrase from the configuration.
+	if (!ssl.certificate.empty() || !ssl.key.empty()) {
+		if (ssl.certificate.empty() || ssl.key.empty()) {
+			throw string("Both certificate and key are required for client authentication");
+		}
+		if (SSL_CTX_use_certificate_chain_file(sslContext, ssl.certificate.c_str()) != 1) {
+			throw string("Failed loading certificate <" + ssl.certificate + ">");
+		}
+		// Default callback uses the user data as passphrase
+		SSL_CTX_set_default_passwd_cb(sslContext, NULL);
+		SSL_CTX_set_default_passwd_cb_userdata(sslContext, (ssl.keyPassphrase.empty()) ? NULL : (void *)ssl.keyPassphrase.c_str());
+		int ret = SSL_CTX_use_PrivateKey_file(sslContext, ssl.key.c_str(), SSL_FILETYPE_PEM);
+		SSL_CTX_set_default_passwd_cb_userdata(sslContext, NULL);
+		if (ret != 1) {
+			throw string("Failed loading key <" + ssl.key + ">");
+		}
+		if (SSL_CTX_check_private_key(sslContext) != 1) {
+			throw string("Key <" + ssl.key + "> doesn't match certificate <" + ssl.certificate + ">");
+		}
+	}
+
+	return context;
+}
+
+Context::Ptr wifibeat::utils::tls::serverContext(const string & certificate, const string & key)
+{
+	initialize();
+
+	Context::Ptr context;
+	try {
+		context = new Context(Context::TLS_SERVER_USE, key, certificate, "", Context::VERIFY_NONE);
+	} catch (const Poco::Exception & e) {
+		throw string("Failed creating TLS server context: " + e.displayText());
+	}
+	context->enableSessionCache(true, "wifibeat");
+	context->setSessionTimeout(3600);
+
+	return context;
+}
@@ -0,0 +1,48 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef UTILS_TLS_H
+#define UTILS_TLS_H
+
+#include <string>
+#include <Poco/Net/Context.h>
+#include "config/outputBase.h"
+
+using std::string;
+
+namespace wifibeat
+{
+	namespace utils
+	{
+		class tls {
+			public:
+				// Initialize OpenSSL (once). Certificates failing verification are rejected.
+				static void initialize();
+
+				// Client context for an output, with session caching so that reconnecting
+				// resumes the previous TLS session instead of a full handshake.
+				// Throws a string on failure (missing file, invalid protocol, ...).
+				static Poco::Net::Context::Ptr clientContext(const outputSSLSettings & ssl);
+
+				// Self-signed server for testing. Throws a string on failure.
+				static Poco::Net::Context::Ptr serverContext(const string & certificate, const string & key);
+		};
+	}
+}
+
+#endif // UTILS_TLS_H
@@ -0,0 +1,445 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "wal.h"
+#include "logger.h"
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <zlib.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define WAL_VERSION 1
+#define WAL_ALIGN(x) (((x) + 7ULL) & ~7ULL)
+
+using std::stringstream;
+
+wifibeat::utils::wal::wal(const string & directory, unsigned long long int maxSize, unsigned long long int segmentSize)
+	: _directory(directory), _maxSize(maxSize), _segmentSize(segmentSize), _writeSegment(0), _nextSequence(1),
+		_acknowledged(0), _savedAcknowledged(0), _recovered(0)
+{
+	while (this->_directory.size() > 1 && this->_directory[this->_directory.size() - 1] == '/') {
+		this->_directory.erase(this->_directory.size() - 1);
+	}
+	if (this->_segmentSize > this->_maxSize) {
+		this->_segmentSize = this->_maxSize;
+	}
+}
+
+wifibeat::utils::wal::~wal()
+{
+	this->sync();
+	while (!this->_segments.empty()) {
+		this->closeSegment(this->_segments.begin(), false);
+	}
+}
+
+string wifibeat::utils::wal::segmentPath(uint64_t firstSequence)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "%020llu" WAL_SEGMENT_SUFFIX, (unsigned long long int)firstSequence);
+	return this->_directory + "/" + name;
+}
+
+bool wifibeat::utils::wal::open()
+{
+	if (this->_directory.empty()) {
+		LOG_ERROR("Persistent queue directory cannot be empty");
+		return false;
+	}
+
+	// Create directory (and parents)
+	for (size_t pos = 1; pos != string::npos; ) {
+		pos = this->_directory.find('/', pos + 1);
+		string dir = this->_directory.substr(0, pos);
+		if (mkdir(dir.c_str(), 0750) != 0 && errno != EEXIST) {
+			LOG_ERROR("Failed creating persistent queue directory <" + dir + ">: " + strerror(errno));
+			return false;
+		}
+	}
+
+	// Last sequence all outputs were done with
+	FILE * f = fopen((this->_directory + "/" WAL_ACKNOWLEDGED_FILE).c_str(), "r");
+	if (f) {
+		unsigned long long int acknowledged = 0;
+		if (fscanf(f, "%llu", &acknowledged) == 1) {
+			this->_acknowledged = this->_savedAcknowledged = acknowledged;
+		}
+		fclose(f);
+	}
+
+	// Find existing segments
+	DIR * dir = opendir(this->_directory.c_str());
+	if (dir == NULL) {
+		LOG_ERROR("Failed opening persistent queue directory <" + this->_directory + ">: " + strerror(errno));
+		return false;
+	}
+	struct dirent * entry = NULL;
+	while ((entry = readdir(dir)) != NULL) {
+		unsigned long long int first = 0;
+		char suffix[16] = { 0 };
+		if (sscanf(entry->d_name, "%20llu%15s", &first, suffix) != 2 || strcmp(suffix, WAL_SEGMENT_SUFFIX) != 0) {
+			continue;
+		}
+		if (this->openSegment(first, false)) {
+			this->scanSegment(first);
+		}
+	}
+	closedir(dir);
+
+	// Drop what was already acknowledged
+	for (auto it = this->_segments.begin(); it != this->_segments.end(); ) {
+		auto current = it++;
+		if (current->second.lastSequence == 0 || current->second.lastSequence <= this->_acknowledged) {
+			this->closeSegment(current, true);
+		} else if (current->second.lastSequence > this->_recovered) {
+			this->_recovered = current->second.lastSequence;
+		}
+	}
+
+	this->_nextSequence = ((this->_recovered > this->_acknowledged) ? this->_recovered : this->_acknowledged) + 1;
+	if (this->_recovered) {
+		stringstream ss;
+		ss << "Persistent queue <" << this->_directory << "> contains frames " << this->_acknowledged + 1
+			<< " to " << this->_recovered << " that weren't acknowledged by all outputs";
+		LOG_NOTICE(ss.str());
+	}
+
+	return true;
+}
+
+bool wifibeat::utils::wal::openSegment(uint64_t firstSequence, bool create)
+{
+	string path = this->segmentPath(firstSequence);
+	int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC | ((create) ? O_CREAT | O_EXCL : 0), 0640);
+	if (fd == -1) {
+		LOG_ERROR("Failed opening persistent queue segment <" + path + ">: " + strerror(errno));
+		return false;
+	}
+
+	uint64_t size = this->_segmentSize;
+	if (create) {
+		// Allocated (and zeroed) upfront: no metadata update while appending, no SIGBUS if the disk is full
+		int ret = posix_fallocate(fd, 0, (off_t)size);
+		if (ret != 0) {
+			LOG_ERROR("Failed allocating persistent queue segment <" + path + ">: " + strerror(ret));
+			close(fd);
+			unlink(path.c_str());
+			return false;
+		}
+	} else {
+		struct stat st;
+		if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(walSegmentHeader)) {
+			LOG_WARN("Invalid persistent queue segment <" + path + ">, deleting it");
+			close(fd);
+			unlink(path.c_str());
+			return false;
+		}
+		size = (uint64_t)st.st_size;
+	}
+
+	void * map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		LOG_ERROR("Failed mapping persistent queue segment <" + path + ">: " + strerror(errno));
+		close(fd);
+		if (create) {
+			unlink(path.c_str());
+		}
+		return false;
+	}
+
+	segment & seg = this->_segments[firstSequence];
+	seg.path = path;
+	seg.fd = fd;
+	seg.map = (uint8_t *)map;
+	seg.size = size;
+	seg.used = sizeof(walSegmentHeader);
+	seg.lastSequence = 0;
+	seg.dirty = false;
+
+	if (create) {
+		walSegmentHeader header;
+		header.magic = WAL_MAGIC;
+		header.version = WAL_VERSION;
+		header.firstSequence = firstSequence;
+		memcpy(seg.map, &header, sizeof(header));
+		seg.dirty = true;
+	}
+
+	return true;
+}
+
+void wifibeat::utils::wal::closeSegment(map<uint64_t, segment>::iterator it, bool remove)
+{
+	segment & seg = it->second;
+	if (seg.dirty && !remove) {
+		msync(seg.map, seg.used, MS_SYNC);
+	}
+	munmap(seg.map, seg.size);
+	close(seg.fd);
+	if (remove) {
+		unlink(seg.path.c_str());
+	}
+	if (it->first == this->_writeSegment) {
+		this->_writeSegment = 0;
+	}
+	this->_segments.erase(it);
+}
+
+void wifibeat::utils::wal::scanSegment(uint64_t firstSequence)
+{
+	segment & seg = this->_segments[firstSequence];
+	walSegmentHeader header;
+	memcpy(&header, seg.map, sizeof(header));
+	if (header.magic != WAL_MAGIC || header.version != WAL_VERSION || header.firstSequence != firstSequence) {
+		LOG_WARN("Invalid persistent queue segment <" + seg.path + ">, ignoring it");
+		return;
+	}
+
+	// Stops at the first record that isn't complete: that's where writing stopped
+	uint64_t offset = sizeof(walSegmentHeader);
+	while (offset + sizeof(walRecordHeader) <= seg.size) {
+		walRecordHeader record;
+		memcpy(&record, seg.map + offset, sizeof(record));
+		if (record.magic != WAL_MAGIC || offset + sizeof(record) + record.length > seg.size) {
+			break;
+		}
+		uint32_t crc = record.crc;
+		record.crc = 0;
+		uLong computed = crc32(0L, (const Bytef *)&record, sizeof(record));
+		computed = crc32(computed, seg.map + offset + sizeof(record), record.length);
+		if ((uint32_t)computed != crc) {
+			stringstream ss;
+			ss << "Persistent queue segment <" << seg.path << "> is corrupted at offset " << offset << ", ignoring the rest of it";
+			LOG_WARN(ss.str());
+			break;
+		}
+		seg.lastSequence = record.sequence;
+		offset += WAL_ALIGN(sizeof(record) + record.length);
+	}
+	seg.used = (offset < seg.size) ? offset : seg.size;
+}
+
+bool wifibeat::utils::wal::createSegment()
+{
+	if (this->_writeSegment) {
+		// Let the kernel write it back, sync() waits for it
+		segment & previous = this->_segments[this->_writeSegment];
+		msync(previous.map, previous.used, MS_ASYNC);
+		this->_writeSegment = 0;
+	}
+
+	// Quota: drop the oldest frames
+	while (!this->_segments.empty() && (this->_segments.size() + 1) * this->_segmentSize > this->_maxSize) {
+		auto oldest = this->_segments.begin();
+		if (oldest->second.lastSequence > this->_acknowledged) {
+			uint64_t from = (oldest->first > this->_acknowledged) ? oldest->first : this->_acknowledged + 1;
+			stringstream ss;
+			ss << "Persistent queue full, dropping " << oldest->second.lastSequence - from + 1
+				<< " frames that weren't acknowledged by all outputs";
+			LOG_ERROR(ss.str());
+			this->_acknowledged = oldest->second.lastSequence;
+		}
+		this->closeSegment(oldest, true);
+	}
+
+	if (!this->openSegment(this->_nextSequence, true)) {
+		return false;
+	}
+	this->_writeSegment = this->_nextSequence;
+	return true;
+}
+
+uint64_t wifibeat::utils::wal::append(const uint8_t * data, uint32_t length, int linkType, const struct timespec & ts)
+{
+	if (data == NULL || length == 0) {
+		return 0;
+	}
+	uint64_t recordSize = WAL_ALIGN(sizeof(walRecordHeader) + length);
+	if (recordSize + sizeof(walSegmentHeader) > this->_segmentSize) {
+		stringstream ss;
+		ss << "Frame of " << length << " bytes is too large for the persistent queue";
+		LOG_ERROR(ss.str());
+		return 0;
+	}
+	if (this->_writeSegment == 0 || this->_segments[this->_writeSegment].used + recordSize > this->_segments[this->_writeSegment].size) {
+		if (!this->createSegment()) {
+			return 0;
+		}
+	}
+	segment & seg = this->_segments[this->_writeSegment];
+
+	walRecordHeader record;
+	record.magic = WAL_MAGIC;
+	record.length = length;
+	record.sequence = this->_nextSequence;
+	record.seconds = (int64_t)ts.tv_sec;
+	record.nanoseconds = (int32_t)ts.tv_nsec;
+	record.linkType = (int32_t)linkType;
+	record.crc = 0;
+	record.reserved = 0;
+	uLong crc = crc32(0L, (const Bytef *)&record, sizeof(record));
+	record.crc = (uint32_t)crc32(crc, data, length);
+
+	// Frame first, the header makes the record visible
+	memcpy(seg.map + seg.used + sizeof(record), data, length);
+	memcpy(seg.map + seg.used, &record, sizeof(record));
+	seg.used += recordSize;
+	seg.lastSequence = this->_nextSequence;
+	seg.dirty = true;
+
+	return this->_nextSequence++;
+}
+
+bool wifibeat::utils::wal::read(walCursor & cursor, walRecord & record)
+{
+	auto it = this->_segments.lower_bound(cursor.segment);
+	if (it == this->_segments.end()) {
+		return false;
+	}
+	if (it->first != cursor.segment) {
+		// Released or dropped
+		cursor.segment = it->first;
+		cursor.offset = 0;
+	}
+
+	while (true) {
+		const segment & seg = it->second;
+		if (cursor.offset < sizeof(walSegmentHeader)) {
+			cursor.offset = sizeof(walSegmentHeader);
+		}
+		while (cursor.offset + sizeof(walRecordHeader) <= seg.used) {
+			walRecordHeader header;
+			memcpy(&header, seg.map + cursor.offset, sizeof(header));
+			uint64_t offset = cursor.offset;
+			cursor.offset += WAL_ALIGN(sizeof(header) + header.length);
+			if (header.sequence < cursor.sequence) {
+				continue;
+			}
+
+			record.data = seg.map + offset + sizeof(header);
+			record.length = header.length;
+			record.linkType = header.linkType;
+			record.ts.tv_sec = (time_t)header.seconds;
+			record.ts.tv_nsec = (long)header.nanoseconds;
+			record.sequence = header.sequence;
+			cursor.sequence = header.sequence + 1;
+			return true;
+		}
+
+		if (++it == this->_segments.end()) {
+			return false;
+		}
+		cursor.segment = it->first;
+		cursor.offset = 0;
+	}
+}
+
+void wifibeat::utils::wal::acknowledge(uint64_t sequence)
+{
+	if (sequence <= this->_acknowledged) {
+		return;
+	}
+	this->_acknowledged = sequence;
+
+	// Segments are in order, stop at the first one still needed
+	while (!this->_segments.empty()) {
+		auto oldest = this->_segments.begin();
+		if (oldest->first == this->_writeSegment || oldest->second.lastSequence > this->_acknowledged) {
+			break;
+		}
+		this->closeSegment(oldest, true);
+	}
+}
+
+bool wifibeat::utils::wal::saveAcknowledged()
+{
+	string path = this->_directory + "/" WAL_ACKNOWLEDGED_FILE;
+	string tmp = path + ".tmp";
+	FILE * f = fopen(tmp.c_str(), "w");
+	if (f == NULL) {
+		LOG_ERROR("Failed saving persistent queue position <" + tmp + ">: " + strerror(errno));
+		return false;
+	}
+	fprintf(f, "%llu\n", (unsigned long long int)this->_acknowledged);
+	fflush(f);
+	fdatasync(fileno(f));
+	fclose(f);
+	if (rename(tmp.c_str(), path.c_str()) != 0) {
+		LOG_ERROR("Failed saving persistent queue position <" + path + ">: " + strerror(errno));
+		return false;
+	}
+	this->_savedAcknowledged = this->_acknowledged;
+	return true;
+}
+
+bool wifibeat::utils::wal::sync()
+{
+	bool ret = true;
+	for (auto & kv: this->_segments) {
+		if (kv.second.dirty) {
+			if (msync(kv.second.map, kv.second.used, MS_SYNC) != 0) {
+				LOG_ERROR("Failed syncing persistent queue segment <" + kv.second.path + ">: " + strerror(errno));
+				ret = false;
+			}
+			kv.second.dirty = false;
+		}
+	}
+	if (this->_acknowledged != this->_savedAcknowledged) {
+		ret = this->saveAcknowledged() && ret;
+	}
+	return ret;
+}
+
+uint64_t wifibeat::utils::wal::Acknowledged()
+{
+	return this->_acknowledged;
+}
+
+uint64_t wifibeat::utils::wal::Recovered()
+{
+	return this->_recovered;
+}
+
+uint64_t wifibeat::utils::wal::LastSequence()
+{
+	return this->_nextSequence - 1;
+}
+
+unsigned long long int wifibeat::utils::wal::Size()
+{
+	unsigned long long int size = 0;
+	for (const auto & kv: this->_segments) {
+		size += kv.second.size;
+	}
+	return size;
+}
+
+string wifibeat::utils::wal::toString()
+{
+	stringstream ss;
+	ss << "Persistent queue <" << this->_directory << ">: " << this->_segments.size() << " segment(s), "
+		<< this->Size() / 1048576 << "MB, last frame " << this->LastSequence() << ", acknowledged " << this->_acknowledged;
+	return ss.str();
+}
@@ -0,0 +1,140 @@
+/*
+ *    WiFiBeat - Parse 802.11 frames and store them in ElasticSearch
+ *    Copyright (C) 2017 Thomas d'Otreppe de Bouvette 
+ *                       <tdotreppe@aircrack-ng.org>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Write-ahead log of captured frames. Frames are appended to preallocated,
+// memory mapped segment files and numbered with a sequence number. Pages are
+// flushed in the background by the kernel and explicitly by sync(), there is no
+// fsync per frame: a crash of the process loses nothing, a crash of the system
+// loses what was written since the last sync().
+// Segments are deleted once every frame they contain has been acknowledged.
+// Segment: walSegmentHeader, then records (walRecordHeader followed by the
+// frame, padded to 8 bytes). Unused space is zeroed.
+#ifndef UTILS_WAL_H
+#define UTILS_WAL_H
+
+#include <string>
+#include <map>
+#include <stdint.h>
+#include <time.h>
+
+using std::string;
+using std::map;
+
+#define WAL_MAGIC 0x4c415742 // BWAL
+#define WAL_SEGMENT_SUFFIX ".wal"
+#define WAL_ACKNOWLEDGED_FILE "acknowledged"
+
+namespace wifibeat
+{
+	namespace utils
+	{
+		struct walSegmentHeader {
+			uint32_t magic;
+			uint32_t version;
+			uint64_t firstSequence;
+		};
+
+		struct walRecordHeader {
+			uint32_t magic;
+			uint32_t length; // Frame length
+			uint64_t sequence;
+			int64_t seconds;
+			int32_t nanoseconds;
+			int32_t linkType;
+			uint32_t crc; // CRC32 of the header (with crc set to 0) and the frame
+			uint32_t reserved;
+		};
+
+		// Frame read back, pointing into the mapped segment
+		struct walRecord {
+			const uint8_t * data;
+			uint32_t length;
+			int linkType;
+			struct timespec ts;
+			uint64_t sequence;
+		};
+
+		// Position of a reader. Start with a default one to read from the oldest frame.
+		struct walCursor {
+			uint64_t segment; // First sequence of the segment
+			uint64_t offset;
+			uint64_t sequence; // Next sequence wanted
+			walCursor() : segment(0), offset(0), sequence(0) { }
+		};
+
+		class wal
+		{
+			private:
+				struct segment {
+					string path;
+					int fd;
+					uint8_t * map;
+					uint64_t size; // Mapped
+					uint64_t used; // Bytes, header included
+					uint64_t lastSequence; // 0 when empty
+					bool dirty; // Written since the last sync
+				};
+
+				string _directory;
+				unsigned long long int _maxSize;
+				unsigned long long int _segmentSize;
+
+				// First sequence -> segment. The last one is written to.
+				map<uint64_t, segment> _segments;
+				uint64_t _writeSegment; // Segment being written to (created by this run), 0 if none yet
+				uint64_t _nextSequence;
+				uint64_t _acknowledged;
+				uint64_t _savedAcknowledged;
+				uint64_t _recovered; // Last sequence written by the previous run
+
+				string segmentPath(uint64_t firstSequence);
+				bool openSegment(uint64_t firstSequence, bool create);
+				void closeSegment(map<uint64_t, segment>::iterator it, bool remove);
+				bool createSegment();
+				void scanSegment(uint64_t firstSequence);
+				bool saveAcknowledged();
+
+			public:
+				wal(const string & directory, unsigned long long int maxSize, unsigned long long int segmentSize);
+				~wal();
+
+				// Create the directory if needed and pick up what was left by a previous run
+				bool open();
+
+				// Returns the sequence number of the frame, 0 on failure
+				uint64_t append(const uint8_t * data, uint32_t length, int linkType, const struct timespec & ts);
+
+				// Next record at or after cursor.sequence, false if there is none (yet)
+				bool read(walCursor & cursor, walRecord & record);
+
+				// Every frame up to sequence is done with: release segments
+				void acknowledge(uint64_t sequence);
+
+				// Flush mapped pages and the acknowledged sequence to disk
+				bool sync();
+
+				uint64_t Acknowledged();
+				uint64_t Recovered();
+				uint64_t LastSequence();
+				unsigned long long int Size();
+				string toString();
+		};
+	}
+}
+
+#endif // UTILS_WAL_H
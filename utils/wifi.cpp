@@ -107,4 +107,104 @@ vector <string> wifibeat::utils::wifi::interfaces()
 	// --- See iw code, interfaces.c -> iw dev
 
 	return ret;
-}
\ No newline at end of file
+}
+
+bool wifibeat::utils::wifi::radiotapFlags(const uint8_t * data, size_t length, uint8_t & flags)
+{
+	if (data == NULL || length < 8) {
+		return false;
+	}
+	size_t header = data[2] | (data[3] << 8);
+	if (header > length) {
+		return false;
+	}
+	uint32_t present = data[4] | (data[5] << 8) | (data[6] << 16) | ((uint32_t)data[7] << 24);
+	if ((present & (1 << RADIOTAP_FLAGS)) == 0) {
+		return false;
+	}
+
+	// Fields start after the last present bitmap
+	size_t offset = 4;
+	uint32_t bitmap = present;
+	while (bitmap & (1U << RADIOTAP_EXT)) {
+		offset += 4;
+		if (offset + 4 > header) {
+			return false;
+		}
+		bitmap = data[offset] | (data[offset + 1] << 8) | (data[offset + 2] << 16) | ((uint32_t)data[offset + 3] << 24);
+	}
+	offset += 4;
+
+	// TSFT comes first, 8 bytes aligned on 8
+	if (present & (1 << RADIOTAP_TSFT)) {
+		offset = ((offset + 7) & ~((size_t)7)) + 8;
+	}
+	if (offset >= header) {
+		return false;
+	}
+	flags = data[offset];
+	return true;
+}
+
+bool wifibeat::utils::wifi::ieee80211Frame(int linkType, const uint8_t * data, size_t length,
+											const uint8_t ** frame, size_t * frameLength)
+{
+	if (linkType == DLT_IEEE802_11) {
+		*frame = data;
+		*frameLength = length;
+		return length > 0;
+	}
+	if (linkType != DLT_IEEE802_11_RADIO || length < 4) {
+		return false;
+	}
+	size_t header = data[2] | (data[3] << 8);
+	if (header >= length) {
+		return false;
+	}
+	*frame = data + header;
+	*frameLength = length - header;
+
+	// Not all of them keep the FCS
+	uint8_t flags = 0;
+	if (radiotapFlags(data, length, flags) && (flags & RADIOTAP_FLAGS_FCS) && *frameLength > 4) {
+		*frameLength -= 4;
+	}
+	return true;
+}
+
+wifibeat::utils::frameCorruption wifibeat::utils::wifi::corruption(int linkType, const uint8_t * data, size_t length)
+{
+	size_t header = 0;
+	bool fcs = false;
+	if (linkType == DLT_IEEE802_11_RADIO) {
+		if (length < 8) {
+			return Truncated;
+		}
+		header = data[2] | (data[3] << 8);
+		if (header < 8 || header > length) {
+			return Truncated;
+		}
+		uint8_t flags = 0;
+		if (radiotapFlags(data, length, flags)) {
+			if (flags & RADIOTAP_FLAGS_BAD_FCS) {
+				return BadFCS;
+			}
+			fcs = (flags & RADIOTAP_FLAGS_FCS) != 0;
+		}
+	} else if (linkType != DLT_IEEE802_11) {
+		return NotCorrupted;
+	}
+
+	// Shortest 802.11 header for its type: 10 bytes for ACK and CTS
+	if (length - header < ((fcs) ? 14U : 10U)) {
+		return Truncated;
+	}
+	size_t frameLength = length - header - ((fcs) ? 4 : 0);
+	unsigned int type = (data[header] >> 2) & 0x03;
+	unsigned int subtype = (data[header] >> 4) & 0x0F;
+	size_t minimum = 24;
+	if (type == 1) {
+		minimum = (subtype == 12 || subtype == 13) ? 10 : 16;
+	}
+	return (frameLength < minimum) ? Truncated : NotCorrupted;
+}
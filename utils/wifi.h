@@ -21,20 +21,45 @@
 
 #include <string>
 #include <vector>
+#include <stdint.h>
+#include <stddef.h>
 
 using std::vector;
 using std::string;
 
+// Radiotap present bits and flags (see radiotap.org)
+#define RADIOTAP_TSFT 0
+#define RADIOTAP_FLAGS 1
+#define RADIOTAP_EXT 31
+#define RADIOTAP_FLAGS_FCS 0x10 // Frame ends with the FCS
+#define RADIOTAP_FLAGS_BAD_FCS 0x40
+
 namespace wifibeat
 {
 	namespace utils
 	{
+		enum frameCorruption {
+			NotCorrupted,
+			BadFCS, // Radiotap says the FCS is wrong
+			Truncated // Radiotap or 802.11 header doesn't fit
+		};
+
 		class wifi {
 			public:
 				static int channel2frequency(const unsigned int chan);
 				static bool isInterfaceValid(const string & iface);
 				static vector <string> interfaces();
 				static bool setInterfaceUp(const string & iface);
+
+				// Radiotap flags field, read from the raw header. False if it isn't there.
+				static bool radiotapFlags(const uint8_t * data, size_t length, uint8_t & flags);
+
+				// 802.11 frame, without the radiotap header and the FCS
+				static bool ieee80211Frame(int linkType, const uint8_t * data, size_t length,
+											const uint8_t ** frame, size_t * frameLength);
+
+				// Cheap check on the raw frame, before anything gets dissected
+				static frameCorruption corruption(int linkType, const uint8_t * data, size_t length);
 		};
 	}
 }